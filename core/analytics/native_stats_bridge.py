@@ -10,9 +10,11 @@ Requirements: 6.1, 6.3
 
 import asyncio
 import logging
+import mmap
+import struct
 import time
 import threading
-from typing import Dict, Any, Optional, Callable
+from typing import Dict, Any, Optional, Callable, List
 from dataclasses import dataclass
 from datetime import datetime
 
@@ -49,6 +51,143 @@ class NativeStatsSnapshot:
         )
 
 
+class SharedStatsReader:
+    """
+    Reader for the C shim's shared-memory telemetry region.
+    
+    The shim's publisher thread (stats_shm_create) copies every per-worker
+    stats block into a memory-mapped file. Each slot is a seqlock, so reads
+    here are plain memory copies: no syscalls, FFI calls or GIL-held native
+    code. The reader exposes get_stats(), so it can be registered with
+    NativeStatsBridge like any engine.
+    
+    Layout mirrors stats_shm_header_t / stats_shm_slot_t in driver_shim.h.
+    """
+    
+    MAGIC = 0x5354534E
+    VERSION = 1
+    LATENCY_BUCKETS = 32
+    HEADER = struct.Struct('<IIIIQQ32x')
+    SLOT = struct.Struct('<QQII5Q%dQ' % LATENCY_BUCKETS)
+    MAX_RETRIES = 1000
+    
+    def __init__(self, path: str, backend: str = 'native_shm'):
+        """
+        Map an existing telemetry region.
+        
+        Args:
+            path: File passed to stats_shm_create() (e.g. under /dev/shm)
+            backend: Backend name reported in get_stats()
+        """
+        self.path = path
+        self.backend = backend
+        self._file = open(path, 'rb')
+        try:
+            self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        except Exception:
+            self._file.close()
+            raise
+        
+        magic, version, num_slots, slot_size, interval_us, _ = self.HEADER.unpack_from(self._map, 0)
+        if magic != self.MAGIC or version != self.VERSION or slot_size != self.SLOT.size:
+            self.close()
+            raise ValueError(f"{path} is not a version {self.VERSION} stats region")
+        
+        self.num_slots = num_slots
+        self.interval_us = interval_us
+        self._start_time = time.time()
+        self._last_aggregate = None
+        self._last_rates = (0.0, 0.0)
+    
+    def _slot_offset(self, index: int) -> int:
+        # Aggregate slot (-1) follows the header, block slots follow it
+        return self.HEADER.size + (index + 1) * self.SLOT.size
+    
+    def read_slot(self, index: int) -> Optional[Dict[str, Any]]:
+        """
+        Read one slot consistently.
+        
+        Args:
+            index: Block slot, or -1 for the aggregate of all blocks
+            
+        Returns:
+            Slot contents, or None if the writer kept it busy
+        """
+        if index < -1 or index >= self.num_slots:
+            raise IndexError(f"slot {index} out of range")
+        
+        offset = self._slot_offset(index)
+        for _ in range(self.MAX_RETRIES):
+            seq = struct.unpack_from('<Q', self._map, offset)[0]
+            if seq & 1:
+                continue
+            fields = self.SLOT.unpack(self._map[offset:offset + self.SLOT.size])
+            if fields[0] != seq or struct.unpack_from('<Q', self._map, offset)[0] != seq:
+                continue
+            return {
+                'seq': seq,
+                'timestamp_us': fields[1],
+                'active': bool(fields[2]),
+                'packets_sent': fields[4],
+                'packets_received': fields[5],
+                'bytes_sent': fields[6],
+                'bytes_received': fields[7],
+                'errors': fields[8],
+                'latency_histogram': list(fields[9:]),
+            }
+        return None
+    
+    def read_queues(self) -> List[Dict[str, Any]]:
+        """Read all active per-worker slots."""
+        queues = []
+        for index in range(self.num_slots):
+            slot = self.read_slot(index)
+            if slot and slot['active']:
+                slot['slot'] = index
+                queues.append(slot)
+        return queues
+    
+    def get_stats(self) -> Dict[str, Any]:
+        """Aggregate stats in the format NativeStatsSnapshot.from_native_dict expects."""
+        slot = self.read_slot(-1) or self._last_aggregate or {}
+        
+        # Rates between publishes; kept when polled faster than the publisher
+        prev = self._last_aggregate
+        if prev and slot.get('timestamp_us', 0) > prev['timestamp_us']:
+            elapsed = (slot['timestamp_us'] - prev['timestamp_us']) / 1e6
+            self._last_rates = (
+                (slot['packets_sent'] - prev['packets_sent']) / elapsed,
+                (slot['bytes_sent'] - prev['bytes_sent']) / elapsed,
+            )
+        if slot:
+            self._last_aggregate = slot
+        
+        stats = dict(slot)
+        stats.update({
+            'packets_per_second': self._last_rates[0],
+            'bytes_per_second': self._last_rates[1],
+            'duration_secs': time.time() - self._start_time,
+            'backend': self.backend,
+            'is_native': True,
+        })
+        return stats
+    
+    def close(self) -> None:
+        """Unmap the region."""
+        if getattr(self, '_map', None) is not None:
+            self._map.close()
+            self._map = None
+        if getattr(self, '_file', None) is not None:
+            self._file.close()
+            self._file = None
+    
+    def __enter__(self) -> 'SharedStatsReader':
+        return self
+    
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+
 class NativeStatsBridge:
     """
     Bridge between native Rust engine and Python analytics system.
@@ -378,6 +517,7 @@ async def stop_native_stats_collection() -> None:
 __all__ = [
     'NativeStatsBridge',
     'NativeStatsSnapshot',
+    'SharedStatsReader',
     'get_native_stats_bridge',
     'register_native_engine',
     'unregister_native_engine',
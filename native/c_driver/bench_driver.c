@@ -0,0 +1,571 @@
+/**
+ * NetStress C Driver Benchmarks
+ * Sweeps send backends across packet sizes, batch sizes and thread counts
+ * and prints one machine-readable row per run.
+ *
+ * Socket backends send UDP to a local sink (127.0.0.1 by default);
+ * AF_XDP needs --iface (e.g. one end of a veth pair) and DPDK needs
+ * --dpdk-port plus EAL arguments after "--".
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "driver_shim.h"
+
+#define BENCH_MAX_LIST 16
+#define BENCH_MAX_THREADS 64
+#define BENCH_MAX_BATCH 1024
+#define BENCH_DEFAULT_PORT 19999
+
+typedef struct {
+    backend_type_t backends[BENCH_MAX_LIST];
+    int num_backends;
+    uint32_t sizes[BENCH_MAX_LIST];
+    int num_sizes;
+    uint32_t batches[BENCH_MAX_LIST];
+    int num_batches;
+    uint32_t threads[BENCH_MAX_LIST];
+    int num_threads;
+    uint32_t duration_ms;
+    uint32_t dst_ip;        /* network order */
+    uint16_t dst_port;      /* host order */
+    const char* iface;
+    int dpdk_port;
+    int json;
+} bench_options_t;
+
+typedef struct {
+    const bench_options_t* opts;
+    backend_type_t backend;
+    uint32_t size;
+    uint32_t batch;
+    int index;
+    volatile int* start;
+    volatile int* stop;
+    
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t errors;
+    int failed;
+    latency_probe_t* latency;  /* per-call send latency */
+} bench_worker_t;
+
+/* ============================================================================
+ * Packet Construction
+ * ============================================================================ */
+
+static uint16_t fold_checksum(const uint8_t* data, uint32_t len) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i + 1 < len; i += 2) {
+        sum += (uint32_t)((data[i] << 8) | data[i + 1]);
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+/* Ethernet/IPv4/UDP frame of exactly len bytes for the frame backends */
+static void build_frame(uint8_t* frame, uint32_t len, uint32_t dst_ip, uint16_t dst_port) {
+    memset(frame, 0, len);
+    memset(frame, 0xFF, 6);
+    frame[6] = 0x02;
+    frame[12] = 0x08;
+    
+    uint8_t* ip = frame + 14;
+    uint16_t ip_len = (uint16_t)(len - 14);
+    ip[0] = 0x45;
+    ip[2] = (uint8_t)(ip_len >> 8);
+    ip[3] = (uint8_t)ip_len;
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    uint32_t src = htonl(0x7F000001);
+    memcpy(ip + 12, &src, 4);
+    memcpy(ip + 16, &dst_ip, 4);
+    uint16_t csum = fold_checksum(ip, 20);
+    ip[10] = (uint8_t)(csum >> 8);
+    ip[11] = (uint8_t)csum;
+    
+    uint8_t* udp = ip + 20;
+    uint16_t udp_len = (uint16_t)(ip_len - 20);
+    udp[0] = 0x30;
+    udp[1] = 0x39;
+    udp[2] = (uint8_t)(dst_port >> 8);
+    udp[3] = (uint8_t)dst_port;
+    udp[4] = (uint8_t)(udp_len >> 8);
+    udp[5] = (uint8_t)udp_len;
+}
+
+/* ============================================================================
+ * Workers
+ * ============================================================================ */
+
+/* Times one send call into the worker's HDR histogram */
+#define TIMED_SEND(w, ret, call) do {                                      \
+        uint64_t start_ns_ = get_timestamp_ns();                            \
+        (ret) = (call);                                                     \
+        latency_probe_record((w)->latency, get_timestamp_ns() - start_ns_); \
+    } while (0)
+
+static void account(bench_worker_t* w, int ret) {
+    if (ret > 0) {
+        w->packets += (uint64_t)ret;
+        w->bytes += (uint64_t)ret * w->size;
+    } else if (ret < 0) {
+        w->errors++;
+    }
+}
+
+static void* bench_worker(void* arg) {
+    bench_worker_t* w = (bench_worker_t*)arg;
+    const bench_options_t* opts = w->opts;
+    int frames = w->backend == BACKEND_AF_XDP || w->backend == BACKEND_DPDK;
+    uint32_t len = w->size;
+    
+    pin_to_cpu(w->index % get_cpu_count());
+    
+    uint8_t* packet = (uint8_t*)calloc(1, len);
+    const uint8_t* packets[BENCH_MAX_BATCH];
+    uint32_t lengths[BENCH_MAX_BATCH];
+    struct sockaddr_in dests[BENCH_MAX_BATCH];
+    if (packet == NULL) {
+        w->failed = 1;
+        return NULL;
+    }
+    if (frames) {
+        build_frame(packet, len, opts->dst_ip, opts->dst_port);
+    } else {
+        memset(packet, 0xA5, len);
+    }
+    for (uint32_t i = 0; i < w->batch; i++) {
+        packets[i] = packet;
+        lengths[i] = len;
+        memset(&dests[i], 0, sizeof(dests[i]));
+        dests[i].sin_family = AF_INET;
+        dests[i].sin_addr.s_addr = opts->dst_ip;
+        dests[i].sin_port = htons(opts->dst_port);
+    }
+    
+    int sockfd = -1;
+    sendmmsg_ctx_t* mctx = NULL;
+    io_uring_ctx_t* uctx = NULL;
+    af_xdp_queue_t* xq = NULL;
+    uint8_t* raw = NULL;
+    
+    switch (w->backend) {
+        case BACKEND_RAW_SOCKET:
+            /* The kernel adds the IP header; send UDP header + payload */
+            sockfd = raw_socket_create(IPPROTO_UDP);
+            raw = (uint8_t*)calloc(1, len + 8);
+            if (raw != NULL) {
+                memcpy(raw + 8, packet, len);
+                raw[2] = (uint8_t)(opts->dst_port >> 8);
+                raw[3] = (uint8_t)opts->dst_port;
+                raw[4] = (uint8_t)((len + 8) >> 8);
+                raw[5] = (uint8_t)(len + 8);
+            }
+            w->failed = sockfd < 0 || raw == NULL;
+            break;
+        case BACKEND_SENDMMSG:
+            sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+            mctx = sendmmsg_ctx_create(sockfd, w->batch);
+            w->failed = mctx == NULL;
+            break;
+        case BACKEND_IO_URING: {
+            io_uring_config_t cfg;
+            memset(&cfg, 0, sizeof(cfg));
+            cfg.buffer_size = len > 2048 ? len : 0;
+            uctx = io_uring_ctx_create(&cfg);
+            w->failed = uctx == NULL;
+            break;
+        }
+        case BACKEND_AF_XDP: {
+            af_xdp_config_t cfg;
+            memset(&cfg, 0, sizeof(cfg));
+            xq = af_xdp_queue_create(opts->iface, (uint32_t)w->index, &cfg);
+            w->failed = xq == NULL;
+            break;
+        }
+        case BACKEND_DPDK:
+            w->failed = dpdk_get_queue_count(opts->dpdk_port) <= w->index;
+            break;
+        default:
+            w->failed = 1;
+            break;
+    }
+    
+    while (!*w->start) {
+    }
+    
+    while (!w->failed && !*w->stop) {
+        int ret = 0;
+        switch (w->backend) {
+            case BACKEND_RAW_SOCKET:
+                TIMED_SEND(w, ret, raw_socket_send(sockfd, opts->dst_ip, raw, len + 8) > 0 ? 1 : -1);
+                break;
+            case BACKEND_SENDMMSG:
+                TIMED_SEND(w, ret, sendmmsg_ctx_send_same_dest(mctx, packets, lengths, opts->dst_ip,
+                                                               opts->dst_port, w->batch));
+                break;
+            case BACKEND_IO_URING:
+                TIMED_SEND(w, ret, io_uring_ctx_send_batch(uctx, packets, lengths, dests, w->batch));
+                break;
+            case BACKEND_AF_XDP:
+                TIMED_SEND(w, ret, af_xdp_queue_send_batch(xq, packets, lengths, w->batch));
+                break;
+            case BACKEND_DPDK:
+                TIMED_SEND(w, ret, dpdk_send_burst_queue(opts->dpdk_port, (uint16_t)w->index,
+                                                         packets, lengths, w->batch));
+                break;
+            default:
+                break;
+        }
+        account(w, ret);
+    }
+    
+    io_uring_ctx_drain(uctx);
+    io_uring_ctx_destroy(uctx);
+    af_xdp_queue_destroy(xq);
+    sendmmsg_ctx_destroy(mctx);
+    if (sockfd >= 0) {
+        close(sockfd);
+    }
+    free(raw);
+    free(packet);
+    return NULL;
+}
+
+/* ============================================================================
+ * Runner
+ * ============================================================================ */
+
+static int run_one(const bench_options_t* opts, backend_type_t backend,
+                   uint32_t size, uint32_t batch, uint32_t threads) {
+    bench_worker_t workers[BENCH_MAX_THREADS];
+    pthread_t tids[BENCH_MAX_THREADS];
+    volatile int start = 0, stop = 0;
+    uint32_t started = 0;
+    int failed = 0;
+    
+    /* Raw sockets send one packet per call, and the row says so */
+    if (backend == BACKEND_RAW_SOCKET) {
+        batch = 1;
+    }
+    
+    memset(workers, 0, sizeof(workers));
+    for (uint32_t t = 0; t < threads; t++) {
+        workers[t].opts = opts;
+        workers[t].backend = backend;
+        workers[t].size = size;
+        workers[t].batch = batch;
+        workers[t].index = (int)t;
+        workers[t].start = &start;
+        workers[t].stop = &stop;
+        workers[t].latency = latency_probe_create(t, 0, NULL);
+        if (pthread_create(&tids[t], NULL, bench_worker, &workers[t]) != 0) {
+            latency_probe_destroy(workers[t].latency);
+            failed = 1;
+            break;
+        }
+        started++;
+    }
+    
+    /* Let workers set up, then time the run from the main thread */
+    uint64_t t0 = get_timestamp_ns();
+    if (!failed) {
+        struct timespec settle = { 0, 50000000 };
+        nanosleep(&settle, NULL);
+        t0 = get_timestamp_ns();
+        start = 1;
+        struct timespec run = { (time_t)(opts->duration_ms / 1000), (long)(opts->duration_ms % 1000) * 1000000L };
+        nanosleep(&run, NULL);
+    }
+    start = 1;
+    stop = 1;
+    uint64_t elapsed = get_timestamp_ns() - t0;
+    
+    uint64_t packets = 0, bytes = 0, errors = 0, p50 = 0, p99 = 0, p999 = 0;
+    for (uint32_t t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+        latency_report_t rep;
+        latency_probe_report(workers[t].latency, &rep);
+        latency_probe_destroy(workers[t].latency);
+        packets += workers[t].packets;
+        bytes += workers[t].bytes;
+        errors += workers[t].errors;
+        failed |= workers[t].failed;
+        /* Report the worst thread so one slow worker is not averaged away */
+        p50 = rep.p50_ns > p50 ? rep.p50_ns : p50;
+        p99 = rep.p99_ns > p99 ? rep.p99_ns : p99;
+        p999 = rep.p999_ns > p999 ? rep.p999_ns : p999;
+    }
+    if (failed) {
+        fprintf(stderr, "skip: %s size=%u batch=%u threads=%u (backend setup failed)\n",
+                backend_name(backend), size, batch, threads);
+        return -1;
+    }
+    
+    double secs = (double)elapsed / 1e9;
+    double pps = (double)packets / secs;
+    double gbps = (double)bytes * 8.0 / secs / 1e9;
+    /* Busy workers: elapsed TSC ticks across all threads per packet */
+    double cycles = packets > 0 && clock_tsc_hz() > 0 ?
+                    secs * (double)clock_tsc_hz() * threads / (double)packets : 0.0;
+    
+    if (opts->json) {
+        printf("{\"backend\":\"%s\",\"size\":%u,\"batch\":%u,\"threads\":%u,\"duration_s\":%.3f,"
+               "\"packets\":%llu,\"errors\":%llu,\"pps\":%.0f,\"gbps\":%.3f,\"cycles_per_packet\":%.1f,"
+               "\"send_p50_ns\":%llu,\"send_p99_ns\":%llu,\"send_p999_ns\":%llu}\n",
+               backend_name(backend), size, batch, threads, secs,
+               (unsigned long long)packets, (unsigned long long)errors, pps, gbps, cycles,
+               (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999);
+    } else {
+        printf("%s,%u,%u,%u,%.3f,%llu,%llu,%.0f,%.3f,%.1f,%llu,%llu,%llu\n",
+               backend_name(backend), size, batch, threads, secs,
+               (unsigned long long)packets, (unsigned long long)errors, pps, gbps, cycles,
+               (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+/* ============================================================================
+ * Options
+ * ============================================================================ */
+
+static int parse_list(const char* arg, uint32_t* out, int max) {
+    int n = 0;
+    const char* p = arg;
+    while (*p && n < max) {
+        char* end;
+        unsigned long v = strtoul(p, &end, 10);
+        if (end == p || v == 0) {
+            return -1;
+        }
+        out[n++] = (uint32_t)v;
+        p = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') {
+            return -1;
+        }
+    }
+    return n;
+}
+
+static backend_type_t parse_backend(const char* name) {
+    for (int b = BACKEND_RAW_SOCKET; b <= BACKEND_DPDK; b++) {
+        if (strcmp(name, backend_name((backend_type_t)b)) == 0) {
+            return (backend_type_t)b;
+        }
+    }
+    return BACKEND_NONE;
+}
+
+/* Every backend select_best_backend() could pick on this system */
+static int available_backends(backend_type_t* out) {
+    system_capabilities_t caps;
+    detect_capabilities(&caps);
+    
+    int n = 0;
+    out[n++] = BACKEND_SENDMMSG;
+    if (caps.has_raw_socket) {
+        out[n++] = BACKEND_RAW_SOCKET;
+    }
+    if (caps.has_io_uring) {
+        out[n++] = BACKEND_IO_URING;
+    }
+#ifdef HAS_AF_XDP
+    out[n++] = BACKEND_AF_XDP;
+#endif
+#ifdef HAS_DPDK
+    out[n++] = BACKEND_DPDK;
+#endif
+    return n;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options] [-- EAL args]\n"
+            "  --backends LIST     Comma-separated backend names (default: all available)\n"
+            "  --sizes LIST        Packet sizes in bytes (default: 64,512,1472,9000)\n"
+            "  --batches LIST      Packets per send call (default: 1,32,256)\n"
+            "  --threads LIST      Worker thread counts (default: 1,2,4)\n"
+            "  --duration-ms N     Time per run (default: 1000)\n"
+            "  --dst IP:PORT       Destination (default: 127.0.0.1:%d)\n"
+            "  --iface NAME        Interface for AF_XDP\n"
+            "  --dpdk-port N       Port for DPDK (EAL args follow --)\n"
+            "  --json              One JSON object per line instead of CSV\n",
+            prog, BENCH_DEFAULT_PORT);
+}
+
+static int parse_options(int argc, char** argv, bench_options_t* opts, int* eal_argc, char*** eal_argv) {
+    static const uint32_t default_sizes[] = { 64, 512, 1472, 9000 };
+    static const uint32_t default_batches[] = { 1, 32, 256 };
+    static const uint32_t default_threads[] = { 1, 2, 4 };
+    
+    memset(opts, 0, sizeof(*opts));
+    opts->num_sizes = 4;
+    memcpy(opts->sizes, default_sizes, sizeof(default_sizes));
+    opts->num_batches = 3;
+    memcpy(opts->batches, default_batches, sizeof(default_batches));
+    opts->num_threads = 3;
+    memcpy(opts->threads, default_threads, sizeof(default_threads));
+    opts->duration_ms = 1000;
+    opts->dst_ip = htonl(0x7F000001);
+    opts->dst_port = BENCH_DEFAULT_PORT;
+    opts->dpdk_port = -1;
+    *eal_argc = 0;
+    *eal_argv = NULL;
+    
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--") == 0) {
+            /* rte_eal_init() expects a program name first */
+            *eal_argc = argc - i;
+            *eal_argv = &argv[i];
+            break;
+        } else if (strcmp(arg, "--json") == 0) {
+            opts->json = 1;
+            continue;
+        } else if (val == NULL) {
+            return -1;
+        }
+    
+        if (strcmp(arg, "--sizes") == 0) {
+            opts->num_sizes = parse_list(val, opts->sizes, BENCH_MAX_LIST);
+        } else if (strcmp(arg, "--batches") == 0) {
+            opts->num_batches = parse_list(val, opts->batches, BENCH_MAX_LIST);
+        } else if (strcmp(arg, "--threads") == 0) {
+            opts->num_threads = parse_list(val, opts->threads, BENCH_MAX_LIST);
+        } else if (strcmp(arg, "--duration-ms") == 0) {
+            opts->duration_ms = (uint32_t)strtoul(val, NULL, 10);
+        } else if (strcmp(arg, "--iface") == 0) {
+            opts->iface = val;
+        } else if (strcmp(arg, "--dpdk-port") == 0) {
+            opts->dpdk_port = atoi(val);
+        } else if (strcmp(arg, "--dst") == 0) {
+            char host[64];
+            const char* colon = strchr(val, ':');
+            size_t n = colon ? (size_t)(colon - val) : strlen(val);
+            if (n >= sizeof(host)) {
+                return -1;
+            }
+            memcpy(host, val, n);
+            host[n] = '\0';
+            if (inet_pton(AF_INET, host, &opts->dst_ip) != 1) {
+                return -1;
+            }
+            if (colon) {
+                opts->dst_port = (uint16_t)atoi(colon + 1);
+            }
+        } else if (strcmp(arg, "--backends") == 0) {
+            char list[256];
+            strncpy(list, val, sizeof(list) - 1);
+            list[sizeof(list) - 1] = '\0';
+            for (char* tok = strtok(list, ","); tok && opts->num_backends < BENCH_MAX_LIST; tok = strtok(NULL, ",")) {
+                backend_type_t b = parse_backend(tok);
+                if (b == BACKEND_NONE) {
+                    return -1;
+                }
+                opts->backends[opts->num_backends++] = b;
+            }
+        } else {
+            return -1;
+        }
+        i++;
+    }
+    
+    if (opts->num_sizes <= 0 || opts->num_batches <= 0 || opts->num_threads <= 0 || opts->duration_ms == 0) {
+        return -1;
+    }
+    if (opts->num_backends == 0) {
+        opts->num_backends = available_backends(opts->backends);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    bench_options_t opts;
+    int eal_argc;
+    char** eal_argv;
+    if (parse_options(argc, argv, &opts, &eal_argc, &eal_argv) != 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    
+    /* Bound but never read: the kernel drops at the socket queue */
+    int sink = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = opts.dst_ip;
+    addr.sin_port = htons(opts.dst_port);
+    if (sink >= 0 && bind(sink, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(sink);
+        sink = -1;
+    }
+    
+    uint32_t max_threads = 0;
+    for (int i = 0; i < opts.num_threads; i++) {
+        if (opts.threads[i] > BENCH_MAX_THREADS) {
+            opts.threads[i] = BENCH_MAX_THREADS;
+        }
+        max_threads = opts.threads[i] > max_threads ? opts.threads[i] : max_threads;
+    }
+    for (int i = 0; i < opts.num_batches; i++) {
+        if (opts.batches[i] > BENCH_MAX_BATCH) {
+            opts.batches[i] = BENCH_MAX_BATCH;
+        }
+    }
+    
+    for (int b = 0; b < opts.num_backends; b++) {
+        if (opts.backends[b] == BACKEND_DPDK && opts.dpdk_port >= 0 && eal_argc > 0) {
+            driver_config_t cfg;
+            memset(&cfg, 0, sizeof(cfg));
+            cfg.port_id = (uint16_t)opts.dpdk_port;
+            cfg.num_queues = max_threads;
+            if (dpdk_init(eal_argc, eal_argv) < 0 || init_dpdk_port_config(&cfg) < 0) {
+                fprintf(stderr, "DPDK port %d setup failed\n", opts.dpdk_port);
+            }
+        }
+    }
+    
+    fprintf(stderr, "clock=%s tsc_hz=%llu checksum=%s\n", clock_source_name(clock_get_source()),
+            (unsigned long long)clock_tsc_hz(), checksum_impl_name(checksum_get_impl()));
+    if (!opts.json) {
+        printf("backend,size,batch,threads,duration_s,packets,errors,pps,gbps,cycles_per_packet,"
+               "send_p50_ns,send_p99_ns,send_p999_ns\n");
+    }
+    
+    for (int b = 0; b < opts.num_backends; b++) {
+        for (int s = 0; s < opts.num_sizes; s++) {
+            for (int k = 0; k < opts.num_batches; k++) {
+                /* Raw sockets send one packet per call; batching does not apply */
+                if (opts.backends[b] == BACKEND_RAW_SOCKET && k > 0) {
+                    break;
+                }
+                for (int t = 0; t < opts.num_threads; t++) {
+                    run_one(&opts, opts.backends[b], opts.sizes[s], opts.batches[k], opts.threads[t]);
+                }
+            }
+        }
+    }
+    
+    cleanup_dpdk();
+    if (sink >= 0) {
+        close(sink);
+    }
+    return 0;
+}
@@ -3,10 +3,15 @@
  * Platform-specific low-level networking operations
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "driver_shim.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -16,11 +21,15 @@
 #else
     #include <sys/socket.h>
     #include <sys/time.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
     #include <netinet/in.h>
     #include <netinet/ip.h>
     #include <arpa/inet.h>
     #include <unistd.h>
-    #include <errno.h>
+    #include <fcntl.h>
+    #include <time.h>
+    #include <pthread.h>
     #define CLOSE_SOCKET close
     #define SOCKET int
     #define INVALID_SOCKET -1
@@ -28,15 +37,40 @@
 
 #ifdef __linux__
     #include <sched.h>
-    #include <pthread.h>
     #include <sys/utsname.h>
     #include <sys/sendfile.h>
+    #include <sys/syscall.h>
+    #include <sys/ioctl.h>
+    #include <net/if.h>
+    #include <linux/net_tstamp.h>
+    #include <linux/errqueue.h>
+    #include <linux/sockios.h>
+    #include <linux/magic.h>
+    #include <sys/vfs.h>
+
+    /* From <numaif.h>; defined here to avoid a libnuma dependency */
+    #define SHIM_MPOL_PREFERRED 1
+#endif
+
+/* SIMD checksum kernels (selected at runtime, see checksum_set_impl) */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #include <cpuid.h>
+    #define CSUM_HAVE_X86_SIMD 1
+    #define CLOCK_HAVE_TSC 1
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define CSUM_HAVE_NEON 1
 #endif
 
 /* ============================================================================
  * Raw Socket Implementation
  * ============================================================================ */
 
+static int safety_watches(backend_type_t backend);
+
 int raw_socket_create(int protocol) {
 #ifdef _WIN32
     WSADATA wsa;
@@ -67,7 +101,37 @@ int raw_socket_set_hdrincl(int sockfd) {
 #endif
 }
 
+static int raw_socket_hdrincl(int sockfd) {
+    int on = 0;
+#ifdef _WIN32
+    int optlen = sizeof(on);
+    if (getsockopt((SOCKET)sockfd, IPPROTO_IP, IP_HDRINCL, (char*)&on, &optlen) != 0) {
+        return 0;
+    }
+#else
+    socklen_t optlen = sizeof(on);
+    if (getsockopt(sockfd, IPPROTO_IP, IP_HDRINCL, &on, &optlen) != 0) {
+        return 0;
+    }
+#endif
+    return on != 0;
+}
+
 int raw_socket_send(int sockfd, uint32_t dst_ip, const uint8_t* data, uint32_t len) {
+    /* With IP_HDRINCL the header's destination is what goes out, so that is
+     * the one the envelope checks; the option is only looked up when armed */
+    uint32_t checked = dst_ip;
+    if (safety_watches(BACKEND_RAW_SOCKET) && raw_socket_hdrincl(sockfd)) {
+        if (data == NULL || len < 20) {
+            return -1;
+        }
+        memcpy(&checked, data + 16, 4);
+    }
+    int admitted = safety_admit(BACKEND_RAW_SOCKET, &checked, 1, &len, 1, 1);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    
     struct sockaddr_in dest;
     memset(&dest, 0, sizeof(dest));
     dest.sin_family = AF_INET;
@@ -108,32 +172,263 @@ void raw_socket_close(int sockfd) {
  * Checksum Calculations
  * ============================================================================ */
 
-uint16_t calculate_checksum(const uint8_t* data, size_t len) {
-    uint32_t sum = 0;
-    size_t i;
+/*
+ * Every kernel returns an unfolded ones-complement sum of the buffer read
+ * as native-endian words. The ones-complement sum is byte-order independent
+ * (RFC 1071), so folding and - on little-endian hosts - swapping the 16-bit
+ * result gives exactly the big-endian sum of the original word-at-a-time
+ * loop. Kernels accumulate into 64-bit lanes, so no carry is lost for any
+ * buffer below several gigabytes.
+ */
+typedef uint64_t (*csum_partial_fn)(const uint8_t* data, size_t len);
+
+static inline uint64_t csum_add64(uint64_t sum, uint64_t word) {
+    sum += word;
+    return sum + (sum < word);  /* End-around carry */
+}
+
+static inline uint64_t csum_tail(const uint8_t* data, size_t len, uint64_t sum) {
+    uint32_t w32;
+    uint16_t w16;
+    
+    while (len >= 4) {
+        memcpy(&w32, data, 4);
+        sum = csum_add64(sum, w32);
+        data += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        memcpy(&w16, data, 2);
+        sum = csum_add64(sum, w16);
+        data += 2;
+        len -= 2;
+    }
+    if (len) {
+        /* Odd byte is the first byte of a zero-padded word */
+        w16 = 0;
+        memcpy(&w16, data, 1);
+        sum = csum_add64(sum, w16);
+    }
+    return sum;
+}
+
+/* Fold a native-endian partial sum to a big-endian 16-bit sum (no invert) */
+static inline uint16_t csum_fold(uint64_t sum) {
+    sum = (sum & 0xFFFFFFFFULL) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFFULL) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    
+    uint16_t folded = (uint16_t)sum;
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    folded = (uint16_t)((folded >> 8) | (folded << 8));
+#endif
+    return folded;
+}
 
-    /* Sum 16-bit words */
-    for (i = 0; i + 1 < len; i += 2) {
-        sum += ((uint16_t)data[i] << 8) | data[i + 1];
+static uint64_t csum_partial_portable(const uint8_t* data, size_t len) {
+    uint64_t sum0 = 0, sum1 = 0;
+    uint64_t w0, w1, w2, w3;
+    
+    /* Four 64-bit words per iteration across two carry chains */
+    while (len >= 32) {
+        memcpy(&w0, data, 8);
+        memcpy(&w1, data + 8, 8);
+        memcpy(&w2, data + 16, 8);
+        memcpy(&w3, data + 24, 8);
+        sum0 = csum_add64(sum0, w0);
+        sum1 = csum_add64(sum1, w1);
+        sum0 = csum_add64(sum0, w2);
+        sum1 = csum_add64(sum1, w3);
+        data += 32;
+        len -= 32;
     }
+    while (len >= 8) {
+        memcpy(&w0, data, 8);
+        sum0 = csum_add64(sum0, w0);
+        data += 8;
+        len -= 8;
+    }
+    
+    return csum_tail(data, len, csum_add64(sum0, sum1));
+}
 
-    /* Add odd byte if present */
-    if (i < len) {
-        sum += (uint16_t)data[i] << 8;
+#ifdef CSUM_HAVE_X86_SIMD
+/* Zero-extend 32-bit words into 64-bit lanes so lanes never overflow */
+__attribute__((target("avx2")))
+static uint64_t csum_partial_avx2(const uint8_t* data, size_t len) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = zero, acc1 = zero;
+    
+    while (len >= 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)data);
+        __m256i b = _mm256_loadu_si256((const __m256i*)(data + 32));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(a, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(a, zero));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(b, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(b, zero));
+        data += 64;
+        len -= 64;
     }
+    if (len >= 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)data);
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(a, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(a, zero));
+        data += 32;
+        len -= 32;
+    }
+    
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi64(acc0, acc1));
+    uint64_t sum = csum_add64(csum_add64(lanes[0], lanes[1]),
+                              csum_add64(lanes[2], lanes[3]));
+    return csum_tail(data, len, sum);
+}
 
-    /* Fold 32-bit sum to 16 bits */
-    while (sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
+__attribute__((target("avx512f")))
+static uint64_t csum_partial_avx512(const uint8_t* data, size_t len) {
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i acc0 = zero, acc1 = zero;
+    
+    while (len >= 128) {
+        __m512i a = _mm512_loadu_si512((const void*)data);
+        __m512i b = _mm512_loadu_si512((const void*)(data + 64));
+        acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(a, zero));
+        acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(a, zero));
+        acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(b, zero));
+        acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(b, zero));
+        data += 128;
+        len -= 128;
+    }
+    if (len >= 64) {
+        __m512i a = _mm512_loadu_si512((const void*)data);
+        acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(a, zero));
+        acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(a, zero));
+        data += 64;
+        len -= 64;
+    }
+    
+    uint64_t lanes[8];
+    _mm512_storeu_si512((void*)lanes, _mm512_add_epi64(acc0, acc1));
+    uint64_t sum = 0;
+    for (int i = 0; i < 8; i++) {
+        sum = csum_add64(sum, lanes[i]);
     }
+    return csum_tail(data, len, sum);
+}
+#endif /* CSUM_HAVE_X86_SIMD */
 
-    return (uint16_t)(~sum);
+#ifdef CSUM_HAVE_NEON
+static uint64_t csum_partial_neon(const uint8_t* data, size_t len) {
+    uint64x2_t acc0 = vdupq_n_u64(0);
+    uint64x2_t acc1 = vdupq_n_u64(0);
+    
+    /* Pairwise add-accumulate 32-bit words into 64-bit lanes */
+    while (len >= 32) {
+        acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(vld1q_u8(data)));
+        acc1 = vpadalq_u32(acc1, vreinterpretq_u32_u8(vld1q_u8(data + 16)));
+        data += 32;
+        len -= 32;
+    }
+    if (len >= 16) {
+        acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(vld1q_u8(data)));
+        data += 16;
+        len -= 16;
+    }
+    
+    acc0 = vaddq_u64(acc0, acc1);
+    uint64_t sum = csum_add64(vgetq_lane_u64(acc0, 0), vgetq_lane_u64(acc0, 1));
+    return csum_tail(data, len, sum);
+}
+#endif /* CSUM_HAVE_NEON */
+
+static csum_partial_fn csum_kernel = NULL;
+static checksum_impl_t csum_kernel_impl = CHECKSUM_IMPL_AUTO;
+
+static csum_partial_fn csum_lookup(checksum_impl_t impl) {
+    switch (impl) {
+        case CHECKSUM_IMPL_PORTABLE:
+            return csum_partial_portable;
+#ifdef CSUM_HAVE_X86_SIMD
+        case CHECKSUM_IMPL_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? csum_partial_avx2 : NULL;
+        case CHECKSUM_IMPL_AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f") ? csum_partial_avx512 : NULL;
+#endif
+#ifdef CSUM_HAVE_NEON
+        case CHECKSUM_IMPL_NEON:
+            return csum_partial_neon;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+static checksum_impl_t csum_best_impl(void) {
+    static const checksum_impl_t order[] = {
+        CHECKSUM_IMPL_AVX512, CHECKSUM_IMPL_AVX2, CHECKSUM_IMPL_NEON
+    };
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        if (csum_lookup(order[i])) {
+            return order[i];
+        }
+    }
+    return CHECKSUM_IMPL_PORTABLE;
+}
+
+static inline uint64_t csum_partial(const uint8_t* data, size_t len) {
+    if (!csum_kernel) {
+        checksum_set_impl(CHECKSUM_IMPL_AUTO);
+    }
+    return csum_kernel(data, len);
+}
+
+int checksum_set_impl(checksum_impl_t impl) {
+    if (impl == CHECKSUM_IMPL_AUTO) {
+        impl = csum_best_impl();
+    }
+    
+    csum_partial_fn fn = csum_lookup(impl);
+    if (!fn) {
+        return -1;
+    }
+    
+    csum_kernel = fn;
+    csum_kernel_impl = impl;
+    return 0;
+}
+
+checksum_impl_t checksum_get_impl(void) {
+    if (!csum_kernel) {
+        checksum_set_impl(CHECKSUM_IMPL_AUTO);
+    }
+    return csum_kernel_impl;
+}
+
+const char* checksum_impl_name(checksum_impl_t impl) {
+    switch (impl) {
+        case CHECKSUM_IMPL_AUTO: return "auto";
+        case CHECKSUM_IMPL_PORTABLE: return "portable";
+        case CHECKSUM_IMPL_AVX2: return "avx2";
+        case CHECKSUM_IMPL_AVX512: return "avx512";
+        case CHECKSUM_IMPL_NEON: return "neon";
+        default: return "unknown";
+    }
+}
+
+uint16_t calculate_checksum(const uint8_t* data, size_t len) {
+    if (!data || len == 0) {
+        return 0xFFFF;
+    }
+    
+    return (uint16_t)~csum_fold(csum_partial(data, len));
 }
 
 uint16_t calculate_transport_checksum(uint32_t src_ip, uint32_t dst_ip,
                                        uint8_t protocol, const uint8_t* data, size_t len) {
     uint32_t sum = 0;
-    size_t i;
 
     /* Pseudo-header */
     sum += (src_ip >> 16) & 0xFFFF;
@@ -144,11 +439,8 @@ uint16_t calculate_transport_checksum(uint32_t src_ip, uint32_t dst_ip,
     sum += len;
 
     /* Data */
-    for (i = 0; i + 1 < len; i += 2) {
-        sum += ((uint16_t)data[i] << 8) | data[i + 1];
-    }
-    if (i < len) {
-        sum += (uint16_t)data[i] << 8;
+    if (data && len) {
+        sum += csum_fold(csum_partial(data, len));
     }
 
     /* Fold */
@@ -159,783 +451,9699 @@ uint16_t calculate_transport_checksum(uint32_t src_ip, uint32_t dst_ip,
     return (uint16_t)(~sum);
 }
 
-/* ============================================================================
- * Utility Functions
- * ============================================================================ */
+/*
+ * Incremental updates per RFC 1624 eqn. 3: HC' = ~(~HC + ~m + m').
+ * Unlike eqn. 2 this never turns a valid checksum into -0 (0xFFFF).
+ */
+static inline uint16_t csum_adjust(uint16_t checksum, uint32_t sum) {
+    sum += (uint16_t)~checksum;
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
 
-uint64_t get_timestamp_us(void) {
-#ifdef _WIN32
-    LARGE_INTEGER freq, count;
-    QueryPerformanceFrequency(&freq);
-    QueryPerformanceCounter(&count);
-    return (uint64_t)(count.QuadPart * 1000000 / freq.QuadPart);
-#else
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
-#endif
+uint16_t checksum_update16(uint16_t checksum, uint16_t old_value, uint16_t new_value) {
+    return csum_adjust(checksum, (uint32_t)(uint16_t)~old_value + new_value);
 }
 
-int get_cpu_count(void) {
-#ifdef _WIN32
-    SYSTEM_INFO sysinfo;
-    GetSystemInfo(&sysinfo);
-    return sysinfo.dwNumberOfProcessors;
-#elif defined(__linux__)
-    return sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    return 1;
-#endif
+uint16_t checksum_update32(uint16_t checksum, uint32_t old_value, uint32_t new_value) {
+    uint32_t sum = (uint16_t)~(old_value >> 16);
+    sum += (uint16_t)~(old_value & 0xFFFF);
+    sum += new_value >> 16;
+    sum += new_value & 0xFFFF;
+    return csum_adjust(checksum, sum);
 }
 
-int pin_to_cpu(int cpu_id) {
-#ifdef __linux__
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(cpu_id, &cpuset);
-    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
-#else
-    (void)cpu_id;
-    return -1;  /* Not supported */
-#endif
+static inline uint16_t load_be16(const uint8_t* p) {
+    return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
 }
 
-/* ============================================================================
- * DPDK Implementation (when available)
- * ============================================================================ */
+static inline void store_be16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
 
-#ifdef HAS_DPDK
+static inline uint32_t load_be32(const uint8_t* p) {
+    return ((uint32_t)load_be16(p) << 16) | load_be16(p + 2);
+}
 
-#include <rte_eal.h>
-#include <rte_ethdev.h>
-#include <rte_mbuf.h>
-#include <rte_mempool.h>
+static inline void store_be32(uint8_t* p, uint32_t v) {
+    store_be16(p, (uint16_t)(v >> 16));
+    store_be16(p + 2, (uint16_t)v);
+}
 
-static struct rte_mempool* mbuf_pool = NULL;
-static int dpdk_initialized = 0;
+/*
+ * A field at an odd offset straddles two checksum words; its bytes then
+ * contribute swapped, so the old and new halves are swapped to match.
+ */
+static inline uint16_t csum_word_at(uint16_t v, uint32_t offset) {
+    return (offset & 1) ? (uint16_t)((v >> 8) | (v << 8)) : v;
+}
 
-int dpdk_init(int argc, char** argv) {
-    int ret = rte_eal_init(argc, argv);
-    if (ret < 0) {
-        return -1;
-    }
+static inline void rewrite16(uint8_t* packet, uint32_t field_offset,
+                             uint32_t csum_offset, uint16_t value) {
+    uint16_t old_value = load_be16(packet + field_offset);
+    store_be16(packet + field_offset, value);
     
-    /* Create mbuf pool */
-    mbuf_pool = rte_pktmbuf_pool_create("MBUF_POOL", 8192,
-                                         256, 0, RTE_MBUF_DEFAULT_BUF_SIZE,
-                                         rte_socket_id());
-    if (mbuf_pool == NULL) {
-        return -1;
-    }
+    uint16_t checksum = load_be16(packet + csum_offset);
+    checksum = checksum_update16(checksum, csum_word_at(old_value, field_offset),
+                                 csum_word_at(value, field_offset));
+    store_be16(packet + csum_offset, checksum);
+}
+
+static inline void rewrite32(uint8_t* packet, uint32_t field_offset,
+                             uint32_t csum_offset, uint32_t value) {
+    uint8_t* f = packet + field_offset;
+    uint32_t old_hi = load_be16(f), old_lo = load_be16(f + 2);
+    store_be16(f, (uint16_t)(value >> 16));
+    store_be16(f + 2, (uint16_t)value);
     
-    dpdk_initialized = 1;
-    return ret;
+    uint32_t old_value = ((uint32_t)csum_word_at((uint16_t)old_hi, field_offset) << 16) |
+                         csum_word_at((uint16_t)old_lo, field_offset);
+    uint32_t new_value = ((uint32_t)csum_word_at((uint16_t)(value >> 16), field_offset) << 16) |
+                         csum_word_at((uint16_t)value, field_offset);
+    
+    uint16_t checksum = load_be16(packet + csum_offset);
+    store_be16(packet + csum_offset, checksum_update32(checksum, old_value, new_value));
 }
 
-int init_dpdk_port(int port_id) {
-    if (!dpdk_initialized) {
+static inline int rewrite_fits(uint32_t len, uint32_t field_offset, uint32_t field_size,
+                               uint32_t csum_offset) {
+    return (uint64_t)field_offset + field_size <= len &&
+           (uint64_t)csum_offset + 2 <= len &&
+           (csum_offset + 2 <= field_offset || field_offset + field_size <= csum_offset);
+}
+
+int packet_rewrite16(uint8_t* packet, uint32_t len, uint32_t field_offset,
+                     uint32_t csum_offset, uint16_t value) {
+    if (!packet || !rewrite_fits(len, field_offset, 2, csum_offset)) {
         return -1;
     }
     
-    struct rte_eth_conf port_conf = {0};
-    struct rte_eth_dev_info dev_info;
-    
-    int ret = rte_eth_dev_info_get(port_id, &dev_info);
-    if (ret != 0) {
-        return ret;
+    rewrite16(packet, field_offset, csum_offset, value);
+    return 0;
+}
+
+int packet_rewrite32(uint8_t* packet, uint32_t len, uint32_t field_offset,
+                     uint32_t csum_offset, uint32_t value) {
+    if (!packet || !rewrite_fits(len, field_offset, 4, csum_offset)) {
+        return -1;
     }
     
-    /* Configure port */
-    ret = rte_eth_dev_configure(port_id, 1, 1, &port_conf);
-    if (ret != 0) {
-        return ret;
+    rewrite32(packet, field_offset, csum_offset, value);
+    return 0;
+}
+
+int packet_rewrite16_batch(uint8_t** packets, const uint32_t* lengths, uint32_t count,
+                           uint32_t field_offset, uint32_t csum_offset, const uint16_t* values) {
+    if (!packets || !lengths || !values) {
+        return -1;
     }
     
-    /* Setup RX queue */
-    ret = rte_eth_rx_queue_setup(port_id, 0, 1024,
-                                  rte_eth_dev_socket_id(port_id),
-                                  NULL, mbuf_pool);
-    if (ret < 0) {
-        return ret;
+    int rewritten = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!packets[i] || !rewrite_fits(lengths[i], field_offset, 2, csum_offset)) {
+            continue;
+        }
+        rewrite16(packets[i], field_offset, csum_offset, values[i]);
+        rewritten++;
     }
     
-    /* Setup TX queue */
-    ret = rte_eth_tx_queue_setup(port_id, 0, 1024,
-                                  rte_eth_dev_socket_id(port_id),
-                                  NULL);
-    if (ret < 0) {
-        return ret;
+    return rewritten;
+}
+
+int packet_rewrite32_batch(uint8_t** packets, const uint32_t* lengths, uint32_t count,
+                           uint32_t field_offset, uint32_t csum_offset, const uint32_t* values) {
+    if (!packets || !lengths || !values) {
+        return -1;
     }
     
-    /* Start port */
-    ret = rte_eth_dev_start(port_id);
-    if (ret < 0) {
-        return ret;
+    int rewritten = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!packets[i] || !rewrite_fits(lengths[i], field_offset, 4, csum_offset)) {
+            continue;
+        }
+        rewrite32(packets[i], field_offset, csum_offset, values[i]);
+        rewritten++;
     }
     
-    /* Enable promiscuous mode */
-    ret = rte_eth_promiscuous_enable(port_id);
-    
-    return 0;
+    return rewritten;
 }
 
-int dpdk_send_burst(int port_id, const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
-    if (!dpdk_initialized || mbuf_pool == NULL) {
+/* Header layout of an Ethernet/IPv4 TCP or UDP frame, used for offloads */
+typedef struct {
+    uint16_t l2_len;
+    uint16_t l3_len;
+    uint16_t l4_len;
+    uint8_t proto;
+} frame_layout_t;
+
+static inline int parse_frame_layout(const uint8_t* frame, uint32_t len, frame_layout_t* out) {
+    uint32_t l2 = 14;
+    if (len < l2 + 20) {
         return -1;
     }
     
-    struct rte_mbuf* mbufs[count];
-    uint32_t i;
-    
-    /* Allocate mbufs and copy data */
-    for (i = 0; i < count; i++) {
-        mbufs[i] = rte_pktmbuf_alloc(mbuf_pool);
-        if (mbufs[i] == NULL) {
-            /* Free already allocated */
-            for (uint32_t j = 0; j < i; j++) {
-                rte_pktmbuf_free(mbufs[j]);
-            }
+    uint16_t ethertype = load_be16(frame + 12);
+    if (ethertype == 0x8100) {
+        l2 += 4;
+        if (len < l2 + 20) {
             return -1;
         }
-        
-        char* data = rte_pktmbuf_append(mbufs[i], lengths[i]);
-        if (data == NULL) {
-            rte_pktmbuf_free(mbufs[i]);
-            for (uint32_t j = 0; j < i; j++) {
-                rte_pktmbuf_free(mbufs[j]);
-            }
-            return -1;
-        }
-        memcpy(data, packets[i], lengths[i]);
+        ethertype = load_be16(frame + 16);
     }
-    
-    /* Send burst */
-    uint16_t sent = rte_eth_tx_burst(port_id, 0, mbufs, count);
-    
-    /* Free unsent mbufs */
-    for (i = sent; i < count; i++) {
-        rte_pktmbuf_free(mbufs[i]);
+    if (ethertype != 0x0800) {
+        return -1;
     }
     
-    return sent;
-}
-
-int dpdk_recv_burst(int port_id, uint8_t** packets, uint32_t max_count) {
-    if (!dpdk_initialized) {
+    const uint8_t* ip = frame + l2;
+    uint32_t l3 = (uint32_t)(ip[0] & 0x0F) * 4;
+    /* Fragments cannot be checksummed per packet */
+    if ((ip[0] >> 4) != 4 || l3 < 20 || (load_be16(ip + 6) & 0x3FFF) != 0) {
         return -1;
     }
     
-    struct rte_mbuf* mbufs[max_count];
-    uint16_t received = rte_eth_rx_burst(port_id, 0, mbufs, max_count);
-    
-    for (uint16_t i = 0; i < received; i++) {
-        packets[i] = rte_pktmbuf_mtod(mbufs[i], uint8_t*);
+    uint32_t l4;
+    if (ip[9] == IPPROTO_UDP) {
+        l4 = 8;
+    } else if (ip[9] == IPPROTO_TCP) {
+        if (len < l2 + l3 + 20) {
+            return -1;
+        }
+        l4 = (uint32_t)(ip[l3 + 12] >> 4) * 4;
+    } else {
+        return -1;
     }
-    
-    return received;
-}
-
-int dpdk_get_stats(int port_id, driver_stats_t* stats) {
-    struct rte_eth_stats eth_stats;
-    int ret = rte_eth_stats_get(port_id, &eth_stats);
-    if (ret != 0) {
-        return ret;
+    if (len < l2 + l3 + l4) {
+        return -1;
     }
     
-    stats->packets_sent = eth_stats.opackets;
-    stats->packets_received = eth_stats.ipackets;
-    stats->bytes_sent = eth_stats.obytes;
-    stats->bytes_received = eth_stats.ibytes;
-    stats->errors = eth_stats.oerrors + eth_stats.ierrors;
-    
-    return 0;
-}
-
-int cleanup_dpdk(void) {
-    if (dpdk_initialized) {
-        rte_eal_cleanup();
-        dpdk_initialized = 0;
-    }
+    out->l2_len = (uint16_t)l2;
+    out->l3_len = (uint16_t)l3;
+    out->l4_len = (uint16_t)l4;
+    out->proto = ip[9];
     return 0;
 }
 
-#endif /* HAS_DPDK */
-
 /* ============================================================================
- * AF_XDP Implementation (when available)
+ * Utility Functions
  * ============================================================================ */
 
-#ifdef HAS_AF_XDP
+#ifndef _WIN32
 
-#include <linux/if_xdp.h>
-#include <linux/if_link.h>
-#include <bpf/xsk.h>
-#include <bpf/libbpf.h>
-#include <net/if.h>
+#ifndef CLOCK_MONOTONIC_RAW
+#define CLOCK_MONOTONIC_RAW CLOCK_MONOTONIC
+#endif
 
-static struct xsk_socket* xsk = NULL;
-static struct xsk_umem* umem = NULL;
-static void* umem_area = NULL;
-static struct xsk_ring_prod tx_ring;
-static struct xsk_ring_cons rx_ring;
-static struct xsk_ring_prod fq;
-static struct xsk_ring_cons cq;
+#define TSC_CALIBRATION_NS 10000000ULL  /* 10ms against CLOCK_MONOTONIC_RAW */
 
-#define FRAME_SIZE XSK_UMEM__DEFAULT_FRAME_SIZE
-#define NUM_FRAMES 4096
+/*
+ * TSC ticks are converted as ns = base_ns + delta * mult / 2^32, split into
+ * high and low halves of delta so the product never overflows 64 bits.
+ */
+static clock_source_t clock_source = CLOCK_SOURCE_MONOTONIC_RAW;
+static uint64_t tsc_hz;
+static uint64_t tsc_mult;
+static uint64_t tsc_base;
+static uint64_t tsc_base_ns;
+static pthread_once_t clock_once = PTHREAD_ONCE_INIT;
+
+static inline uint64_t monotonic_raw_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#ifdef CLOCK_HAVE_TSC
+static int tsc_is_trusted(void) {
+    unsigned int eax, ebx, ecx, edx;
+    /* CPUID 0x80000007 EDX[8]: invariant TSC (constant rate, runs in C-states) */
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1U << 8))) {
+        return 0;
+    }
+    
+#ifdef __linux__
+    /* The kernel demotes a TSC it finds unsynchronized across cores */
+    FILE* f = fopen("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+    if (f) {
+        char buf[32] = {0};
+        int ok = fgets(buf, sizeof(buf), f) != NULL && strncmp(buf, "tsc", 3) == 0;
+        fclose(f);
+        return ok;
+    }
+#endif
+    return 1;
+}
+#endif
+
+static void clock_init(void) {
+#ifdef CLOCK_HAVE_TSC
+    if (!tsc_is_trusted()) {
+        return;
+    }
+    
+    uint64_t ns0 = monotonic_raw_ns();
+    uint64_t tsc0 = __builtin_ia32_rdtsc();
+    uint64_t ns1, tsc1;
+    do {
+        ns1 = monotonic_raw_ns();
+        tsc1 = __builtin_ia32_rdtsc();
+    } while (ns1 - ns0 < TSC_CALIBRATION_NS);
+    
+    uint64_t hz = (tsc1 - tsc0) * 1000000000ULL / (ns1 - ns0);
+    if (hz < 1000000ULL) {
+        return;
+    }
+    tsc_hz = hz;
+    tsc_mult = (1000000000ULL << 32) / hz;
+    tsc_base = tsc1;
+    tsc_base_ns = ns1;
+    clock_source = CLOCK_SOURCE_TSC;
+#endif
+}
+
+uint64_t get_timestamp_ns(void) {
+    pthread_once(&clock_once, clock_init);
+    
+#ifdef CLOCK_HAVE_TSC
+    if (clock_source == CLOCK_SOURCE_TSC) {
+        uint64_t delta = __builtin_ia32_rdtsc() - tsc_base;
+        return tsc_base_ns + (delta >> 32) * tsc_mult + (((delta & 0xFFFFFFFFULL) * tsc_mult) >> 32);
+    }
+#endif
+    return monotonic_raw_ns();
+}
+
+clock_source_t clock_get_source(void) {
+    pthread_once(&clock_once, clock_init);
+    return clock_source;
+}
+
+uint64_t clock_tsc_hz(void) {
+    pthread_once(&clock_once, clock_init);
+    return tsc_hz;
+}
+
+#else
+
+/* QPC is already TSC-backed and invariant on supported Windows versions */
+uint64_t get_timestamp_ns(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&count);
+    uint64_t ticks = (uint64_t)count.QuadPart;
+    uint64_t hz = (uint64_t)freq.QuadPart;
+    return (ticks / hz) * 1000000000ULL + (ticks % hz) * 1000000000ULL / hz;
+}
+
+clock_source_t clock_get_source(void) {
+    return CLOCK_SOURCE_QPC;
+}
+
+uint64_t clock_tsc_hz(void) {
+    return 0;
+}
+
+#endif /* _WIN32 */
+
+uint64_t get_timestamp_us(void) {
+    return get_timestamp_ns() / 1000;
+}
+
+const char* clock_source_name(clock_source_t source) {
+    switch (source) {
+        case CLOCK_SOURCE_MONOTONIC_RAW: return "monotonic_raw";
+        case CLOCK_SOURCE_TSC: return "tsc";
+        case CLOCK_SOURCE_QPC: return "qpc";
+        default: return "unknown";
+    }
+}
+
+int get_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    return sysinfo.dwNumberOfProcessors;
+#elif defined(__linux__)
+    return sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    return 1;
+#endif
+}
+
+int pin_to_cpu(int cpu_id) {
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu_id, &cpuset);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+#else
+    (void)cpu_id;
+    return -1;  /* Not supported */
+#endif
+}
+
+#ifdef __linux__
+/* Parse a sysfs cpulist such as "0-7,16-23" */
+static int parse_cpulist(const char* list, int* cpus, int max_cpus) {
+    int count = 0;
+    const char* p = list;
+    
+    while (*p && *p != '\n') {
+        char* end;
+        long start = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        long stop = start;
+        p = end;
+        if (*p == '-') {
+            stop = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = start; cpu <= stop && count < max_cpus; cpu++) {
+            cpus[count++] = (int)cpu;
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    
+    return count;
+}
+
+static int read_sysfs_int(const char* path, int* value) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    int ret = fscanf(f, "%d", value) == 1 ? 0 : -1;
+    fclose(f);
+    return ret;
+}
+#endif
+
+int get_numa_node_cpus(int numa_node, int* cpus, int max_cpus) {
+#ifdef __linux__
+    if (numa_node < 0 || cpus == NULL || max_cpus <= 0) {
+        return -1;
+    }
+    
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", numa_node);
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    
+    char buf[1024];
+    int count = -1;
+    if (fgets(buf, sizeof(buf), f)) {
+        count = parse_cpulist(buf, cpus, max_cpus);
+    }
+    fclose(f);
+    return count;
+#else
+    (void)numa_node; (void)cpus; (void)max_cpus;
+    return -1;
+#endif
+}
+
+int get_cpu_numa_node(int cpu_id) {
+#ifdef __linux__
+    if (cpu_id < 0) {
+        return -1;
+    }
+    
+    int cpus[1024];
+    for (int node = 0; node < 64; node++) {
+        int count = get_numa_node_cpus(node, cpus, 1024);
+        if (count < 0) {
+            /* Node directories are contiguous on all but exotic systems */
+            if (node > 0) {
+                break;
+            }
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            if (cpus[i] == cpu_id) {
+                return node;
+            }
+        }
+    }
+    return -1;
+#else
+    (void)cpu_id;
+    return -1;
+#endif
+}
+
+int get_netdev_numa_node(const char* ifname) {
+#ifdef __linux__
+    if (ifname == NULL || strchr(ifname, '/') != NULL) {
+        return -1;
+    }
+    
+    char path[128];
+    int node = -1;
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device/numa_node", ifname);
+    if (read_sysfs_int(path, &node) != 0) {
+        return -1;
+    }
+    return node;  /* kernel reports -1 when the device has no affinity */
+#else
+    (void)ifname;
+    return -1;
+#endif
+}
+
+int pin_to_numa_cpu(int numa_node, int worker_index) {
+    if (worker_index < 0) {
+        return -1;
+    }
+    
+    int cpus[1024];
+    int count = get_numa_node_cpus(numa_node, cpus, 1024);
+    int cpu_id;
+    if (count > 0) {
+        cpu_id = cpus[worker_index % count];
+    } else {
+        int cpu_count = get_cpu_count();
+        cpu_id = worker_index % (cpu_count > 0 ? cpu_count : 1);
+    }
+    
+    if (pin_to_cpu(cpu_id) != 0) {
+        return -1;
+    }
+    return cpu_id;
+}
+
+#ifndef _WIN32
+/* Preferred rather than bound: fall back to remote memory instead of failing.
+ * Must run before the pages are first touched. */
+static void mem_bind_node(void* addr, size_t size, int numa_node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    if (numa_node >= 0 && numa_node < (int)(8 * sizeof(unsigned long))) {
+        unsigned long nodemask = 1UL << numa_node;
+        syscall(SYS_mbind, addr, size, SHIM_MPOL_PREFERRED, &nodemask,
+                8 * sizeof(nodemask), 0);
+    }
+#else
+    (void)addr;
+    (void)size;
+    (void)numa_node;
+#endif
+}
+#endif
+
+void* alloc_numa_memory(size_t size, int numa_node) {
+    if (size == 0) {
+        return NULL;
+    }
+#ifdef _WIN32
+    (void)numa_node;
+    return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+    mem_bind_node(addr, size, numa_node);
+    return addr;
+#endif
+}
+
+void free_numa_memory(void* addr, size_t size) {
+    if (addr == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(addr, 0, MEM_RELEASE);
+#else
+    munmap(addr, size);
+#endif
+}
+
+#ifdef __linux__
+    #ifndef MAP_HUGETLB
+        #define MAP_HUGETLB 0x40000
+    #endif
+    #ifndef MAP_HUGE_SHIFT
+        #define MAP_HUGE_SHIFT 26
+    #endif
+    #define MEM_MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+    #define MEM_MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+static size_t mem_page_bytes(mem_page_size_t pages) {
+    switch (pages) {
+        case MEM_PAGES_2M: return (size_t)2 << 20;
+        case MEM_PAGES_1G: return (size_t)1 << 30;
+        default: break;
+    }
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+void mem_region_config_init(mem_region_config_t* config) {
+    if (config == NULL) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->pages = MEM_PAGES_DEFAULT;
+    config->numa_node = -1;
+}
+
+#ifdef __linux__
+/* Huge pages from a hugetlbfs mount; the page size is the mount's */
+static void* mem_map_hugetlbfs(const char* dir, size_t* size, mem_page_size_t* pages) {
+    char path[256];
+    int n = snprintf(path, sizeof(path), "%s/netstress-XXXXXX", dir);
+    if (n < 0 || (size_t)n >= sizeof(path)) {
+        return NULL;
+    }
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    unlink(path);
+    
+    struct statfs fs;
+    void* addr = MAP_FAILED;
+    if (fstatfs(fd, &fs) == 0 && fs.f_type == HUGETLBFS_MAGIC) {
+        *pages = (size_t)fs.f_bsize >= mem_page_bytes(MEM_PAGES_1G) ? MEM_PAGES_1G : MEM_PAGES_2M;
+        size_t page = (size_t)fs.f_bsize;
+        *size = (*size + page - 1) & ~(page - 1);
+        if (ftruncate(fd, (off_t)*size) == 0) {
+            addr = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+    }
+    close(fd);
+    return addr != MAP_FAILED ? addr : NULL;
+}
+#endif
+
+/* Map size bytes of the requested page size, rounding size up to it */
+static void* mem_map(const mem_region_config_t* config, mem_page_size_t pages, size_t* size,
+                     mem_page_size_t* got) {
+    size_t page = mem_page_bytes(pages);
+    *size = (*size + page - 1) & ~(page - 1);
+    *got = pages;
+#ifdef _WIN32
+    (void)config;
+    if (pages != MEM_PAGES_DEFAULT) {
+        return NULL;  /* Large pages need SeLockMemoryPrivilege; not attempted */
+    }
+    return VirtualAlloc(NULL, *size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (pages != MEM_PAGES_DEFAULT) {
+#ifdef __linux__
+        if (config->hugetlbfs_dir != NULL) {
+            return mem_map_hugetlbfs(config->hugetlbfs_dir, size, got);
+        }
+        flags |= MAP_HUGETLB | (pages == MEM_PAGES_1G ? MEM_MAP_HUGE_1GB : MEM_MAP_HUGE_2MB);
+#else
+        return NULL;
+#endif
+    }
+    void* addr = mmap(NULL, *size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    return addr != MAP_FAILED ? addr : NULL;
+#endif
+}
+
+int mem_region_alloc(mem_region_t* region, size_t size, const mem_region_config_t* config) {
+    if (region == NULL || size == 0) {
+        return -1;
+    }
+    mem_region_config_t defaults;
+    if (config == NULL) {
+        mem_region_config_init(&defaults);
+        config = &defaults;
+    }
+    memset(region, 0, sizeof(*region));
+    
+    size_t mapped = size;
+    mem_page_size_t got;
+    void* addr = mem_map(config, config->pages, &mapped, &got);
+    if (addr == NULL && config->pages != MEM_PAGES_DEFAULT && !config->require_huge) {
+        mapped = size;
+        addr = mem_map(config, MEM_PAGES_DEFAULT, &mapped, &got);
+    }
+    if (addr == NULL) {
+        return -1;
+    }
+    
+#ifndef _WIN32
+    mem_bind_node(addr, mapped, config->numa_node);
+#endif
+    /* One write per page faults everything in now, after the node policy is
+     * set, so first-touch faults stay out of the send path */
+    if (config->prefault || config->lock) {
+        size_t page = mem_page_bytes(got);
+        for (size_t off = 0; off < mapped; off += page) {
+            ((volatile uint8_t*)addr)[off] = 0;
+        }
+    }
+    if (config->lock) {
+#ifdef _WIN32
+        region->locked = VirtualLock(addr, mapped) ? 1 : 0;
+#else
+        region->locked = mlock(addr, mapped) == 0;
+#endif
+    }
+    
+    region->addr = addr;
+    region->size = mapped;
+    region->pages = got;
+    return 0;
+}
+
+void mem_region_free(mem_region_t* region) {
+    if (region == NULL || region->addr == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    if (region->locked) {
+        VirtualUnlock(region->addr, region->size);
+    }
+    VirtualFree(region->addr, 0, MEM_RELEASE);
+#else
+    /* munmap drops the lock with the mapping */
+    munmap(region->addr, region->size);
+#endif
+    memset(region, 0, sizeof(*region));
+}
+
+/* ============================================================================
+ * Hardware Timestamping (SO_TIMESTAMPING, Linux)
+ * ============================================================================ */
+
+#ifdef __linux__
+
+static inline uint64_t timespec_to_ns(const struct timespec* ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ULL + (uint64_t)ts->tv_nsec;
+}
+
+int net_enable_hw_timestamps(const char* ifname) {
+    if (ifname == NULL) {
+        return -1;
+    }
+    
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    struct hwtstamp_config cfg;
+    struct ifreq ifr;
+    memset(&cfg, 0, sizeof(cfg));
+    memset(&ifr, 0, sizeof(ifr));
+    cfg.tx_type = HWTSTAMP_TX_ON;
+    cfg.rx_filter = HWTSTAMP_FILTER_ALL;
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    ifr.ifr_data = (char*)&cfg;
+    
+    int ret = ioctl(fd, SIOCSHWTSTAMP, &ifr);
+    close(fd);
+    return ret == 0 ? 0 : -1;
+}
+
+int socket_enable_timestamps(int sockfd, int flags) {
+    unsigned int opts = SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    
+    if (flags & TIMESTAMP_SOFTWARE) {
+        opts |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+                SOF_TIMESTAMPING_SOFTWARE;
+    }
+    if (flags & TIMESTAMP_HARDWARE) {
+        opts |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE |
+                SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+    if (!(flags & (TIMESTAMP_SOFTWARE | TIMESTAMP_HARDWARE))) {
+        return -1;
+    }
+    
+    return setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPING, &opts, sizeof(opts)) == 0 ? 0 : -1;
+}
+
+/* scm_timestamping: ts[0] software, ts[2] raw hardware */
+static void parse_timestamps(struct msghdr* msg, uint64_t* sw_ns, uint64_t* hw_ns, uint32_t* id) {
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+            struct scm_timestamping tss;
+            memcpy(&tss, CMSG_DATA(cm), sizeof(tss));
+            if (sw_ns) {
+                *sw_ns = timespec_to_ns(&tss.ts[0]);
+            }
+            if (hw_ns) {
+                *hw_ns = timespec_to_ns(&tss.ts[2]);
+            }
+        } else if (id && ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                          (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cm), sizeof(err));
+            if (err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                *id = err.ee_data;
+            }
+        }
+    }
+}
+
+int socket_recv_timestamped(int sockfd, uint8_t* buffer, uint32_t max_len,
+                            uint64_t* sw_ns, uint64_t* hw_ns) {
+    if (buffer == NULL) {
+        return -1;
+    }
+    
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+    struct iovec iov = { .iov_base = buffer, .iov_len = max_len };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    
+    if (sw_ns) {
+        *sw_ns = 0;
+    }
+    if (hw_ns) {
+        *hw_ns = 0;
+    }
+    
+    ssize_t n = recvmsg(sockfd, &msg, MSG_DONTWAIT);
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    
+    parse_timestamps(&msg, sw_ns, hw_ns, NULL);
+    return (int)n;
+}
+
+int socket_read_tx_timestamp(int sockfd, uint32_t* id, uint64_t* sw_ns, uint64_t* hw_ns) {
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping)) +
+                 CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    
+    if (sw_ns) {
+        *sw_ns = 0;
+    }
+    if (hw_ns) {
+        *hw_ns = 0;
+    }
+    
+    /* OPT_TSONLY: the error queue carries no packet payload */
+    if (recvmsg(sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    
+    parse_timestamps(&msg, sw_ns, hw_ns, id);
+    return 1;
+}
+
+#else
+
+int net_enable_hw_timestamps(const char* ifname) {
+    (void)ifname;
+    return -1;
+}
+
+int socket_enable_timestamps(int sockfd, int flags) {
+    (void)sockfd;
+    (void)flags;
+    return -1;
+}
+
+int socket_recv_timestamped(int sockfd, uint8_t* buffer, uint32_t max_len,
+                            uint64_t* sw_ns, uint64_t* hw_ns) {
+    (void)sockfd;
+    (void)buffer;
+    (void)max_len;
+    (void)sw_ns;
+    (void)hw_ns;
+    return -1;
+}
+
+int socket_read_tx_timestamp(int sockfd, uint32_t* id, uint64_t* sw_ns, uint64_t* hw_ns) {
+    (void)sockfd;
+    (void)id;
+    (void)sw_ns;
+    (void)hw_ns;
+    return -1;
+}
+
+#endif /* __linux__ */
+
+/* ============================================================================
+ * Pacing
+ * ============================================================================ */
+
+/*
+ * Virtual-clock token bucket: next_ns is when the next slot opens, and each
+ * charge pushes it by the cost of what was sent. Costs are kept in 1/65536 ns
+ * so rates that do not divide 1e9 evenly do not drift.
+ */
+#define PACER_FRAC_BITS 16
+#define PACER_FRAC_MASK ((1ULL << PACER_FRAC_BITS) - 1)
+#define PACER_SPIN_NS 50000ULL  /* below this, spin; above, sleep (timer slack) */
+
+struct pacer {
+    uint64_t pkt_cost;   /* per packet, fixed point ns */
+    uint64_t byte_cost;  /* per byte, fixed point ns */
+    uint64_t next_ns;
+    uint64_t next_frac;
+    uint64_t slack_ns;   /* idle credit kept, one burst */
+    uint32_t burst;
+};
+
+static inline void cpu_relax(void) {
+#if defined(CLOCK_HAVE_TSC)
+    _mm_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#elif defined(_WIN32)
+    YieldProcessor();
+#endif
+}
+
+static void pacer_sleep_until(uint64_t deadline_ns) {
+    uint64_t now = get_timestamp_ns();
+    while (now < deadline_ns) {
+        uint64_t left = deadline_ns - now;
+        if (left > PACER_SPIN_NS) {
+            left -= PACER_SPIN_NS;
+#ifdef _WIN32
+            if (left >= 2000000ULL) {
+                Sleep((DWORD)(left / 1000000ULL));
+            } else {
+                cpu_relax();
+            }
+#else
+            struct timespec ts = { (time_t)(left / 1000000000ULL), (long)(left % 1000000000ULL) };
+            nanosleep(&ts, NULL);
+#endif
+        } else {
+            cpu_relax();
+        }
+        now = get_timestamp_ns();
+    }
+}
+
+pacer_t* pacer_create(uint64_t rate_pps, uint64_t rate_bps, uint32_t burst) {
+    pacer_t* pacer = (pacer_t*)calloc(1, sizeof(*pacer));
+    if (pacer == NULL) {
+        return NULL;
+    }
+    pacer_set_rate(pacer, rate_pps, rate_bps, burst);
+    return pacer;
+}
+
+int pacer_set_rate(pacer_t* pacer, uint64_t rate_pps, uint64_t rate_bps, uint32_t burst) {
+    if (pacer == NULL) {
+        return -1;
+    }
+    
+    pacer->burst = burst > 0 ? burst : 1;
+    pacer->pkt_cost = rate_pps > 0 ? (1000000000ULL << PACER_FRAC_BITS) / rate_pps : 0;
+    pacer->byte_cost = rate_bps > 0 ? (8000000000ULL << PACER_FRAC_BITS) / rate_bps : 0;
+    pacer->slack_ns = (pacer->burst * pacer->pkt_cost) >> PACER_FRAC_BITS;
+    pacer->next_ns = get_timestamp_ns();
+    pacer->next_frac = 0;
+    return 0;
+}
+
+uint32_t pacer_burst(const pacer_t* pacer) {
+    return pacer ? pacer->burst : 0;
+}
+
+void pacer_wait(pacer_t* pacer) {
+    if (pacer != NULL) {
+        pacer_sleep_until(pacer->next_ns);
+    }
+}
+
+uint64_t pacer_charge(pacer_t* pacer, uint32_t packets, uint64_t bytes) {
+    if (pacer == NULL) {
+        return 0;
+    }
+    
+    /* Catch up after an oversleep, but never bank more than one burst */
+    uint64_t now = get_timestamp_ns();
+    if (now > pacer->next_ns + pacer->slack_ns) {
+        pacer->next_ns = now - pacer->slack_ns;
+        pacer->next_frac = 0;
+    }
+    uint64_t departure = pacer->next_ns > now ? pacer->next_ns : now;
+    
+    /* With both limits set, the slower one decides */
+    uint64_t pkt = packets * pacer->pkt_cost;
+    uint64_t byt = bytes * pacer->byte_cost;
+    uint64_t cost = pacer->next_frac + (pkt > byt ? pkt : byt);
+    pacer->next_ns += cost >> PACER_FRAC_BITS;
+    pacer->next_frac = cost & PACER_FRAC_MASK;
+    
+    return departure;
+}
+
+void pacer_destroy(pacer_t* pacer) {
+    free(pacer);
+}
+
+#ifdef __linux__
+
+#ifndef SO_TXTIME
+#define SO_TXTIME 61
+#define SCM_TXTIME SO_TXTIME
+#endif
+
+int socket_set_pacing_rate(int sockfd, uint64_t bytes_per_sec) {
+    /* The kernel takes an unsigned long on 64-bit; ~0U means unlimited */
+    unsigned long rate = bytes_per_sec > 0 ? (unsigned long)bytes_per_sec : ~0UL;
+    if (sizeof(rate) > sizeof(uint32_t) && rate < 0xFFFFFFFFUL) {
+        uint32_t rate32 = (uint32_t)rate;
+        return setsockopt(sockfd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate32, sizeof(rate32)) == 0 ? 0 : -1;
+    }
+    return setsockopt(sockfd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) == 0 ? 0 : -1;
+}
+
+int socket_enable_txtime(int sockfd) {
+    struct sock_txtime cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.clockid = CLOCK_MONOTONIC;
+    return setsockopt(sockfd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) == 0 ? 0 : -1;
+}
+
+#else
+
+int socket_set_pacing_rate(int sockfd, uint64_t bytes_per_sec) {
+    (void)sockfd;
+    (void)bytes_per_sec;
+    return -1;
+}
+
+int socket_enable_txtime(int sockfd) {
+    (void)sockfd;
+    return -1;
+}
+
+#endif /* __linux__ */
+
+/* ============================================================================
+ * Per-Worker Statistics
+ * ============================================================================ */
+
+/*
+ * Blocks live in a static, cache-line-aligned table so readers can scan it
+ * while writers run. Each block has a single writer that publishes with
+ * relaxed 64-bit stores (no locked RMW); the lock only orders claim,
+ * release and snapshot against each other.
+ */
+#if defined(_MSC_VER)
+    #define SHIM_CACHE_ALIGNED __declspec(align(64))
+    #define SHIM_UNLIKELY(x) (x)
+    #define STATS_LOAD(p) (*(volatile const uint64_t*)(p))
+    #define STATS_ADD(p, v) (*(volatile uint64_t*)(p) += (v))
+    #define STATS_STORE(p, v) (*(volatile uint64_t*)(p) = (v))
+#else
+    #define SHIM_CACHE_ALIGNED __attribute__((aligned(64)))
+    #define SHIM_UNLIKELY(x) __builtin_expect(!!(x), 0)
+    #define STATS_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+    #define STATS_ADD(p, v) __atomic_store_n((p), *(p) + (v), __ATOMIC_RELAXED)
+    #define STATS_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#endif
+
+struct SHIM_CACHE_ALIGNED driver_stats_block {
+    uint64_t packets_sent;
+    uint64_t packets_received;
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    uint64_t errors;
+    int in_use;
+    uint64_t latency[STATS_LATENCY_BUCKETS];
+    stage_stats_t stages;
+};
+
+static driver_stats_block_t stats_blocks[DRIVER_STATS_MAX_BLOCKS];
+/* Counts from released blocks, so aggregates stay monotonic */
+static driver_stats_t stats_retired;
+static uint64_t stats_retired_latency[STATS_LATENCY_BUCKETS];
+static stage_stats_t stats_retired_stages;
+
+#ifdef _WIN32
+static SRWLOCK stats_lock = SRWLOCK_INIT;
+#define STATS_LOCK() AcquireSRWLockExclusive(&stats_lock)
+#define STATS_UNLOCK() ReleaseSRWLockExclusive(&stats_lock)
+#else
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+#define STATS_LOCK() pthread_mutex_lock(&stats_lock)
+#define STATS_UNLOCK() pthread_mutex_unlock(&stats_lock)
+#endif
+
+/*
+ * Stage accounting: STAGE_BEGIN(t, stages) starts a mark, and each
+ * STAGE_END(t, stage) charges the time since the previous mark to stage and
+ * restarts it; STAGE_MARK(t) restarts without charging. Without
+ * NETSTRESS_STAGE_CYCLES all three compile away and stages is unevaluated.
+ */
+#ifdef NETSTRESS_STAGE_CYCLES
+static inline uint64_t stage_clock(void) {
+#ifdef CLOCK_HAVE_TSC
+    return __builtin_ia32_rdtsc();
+#else
+    return get_timestamp_ns();
+#endif
+}
+
+static inline void stage_charge(stage_stats_t* stages, stats_stage_t stage, uint64_t* mark) {
+    uint64_t now = stage_clock();
+    if (stages != NULL) {
+        STATS_ADD(&stages->cycles[stage], now - *mark);
+        STATS_ADD(&stages->calls[stage], 1);
+    }
+    *mark = now;
+}
+
+#define STAGE_BEGIN(t, stages) stage_stats_t* const t##_stages = (stages); uint64_t t = stage_clock()
+#define STAGE_END(t, stage) stage_charge(t##_stages, (stage), &(t))
+#define STAGE_MARK(t) ((t) = stage_clock())
+#else
+#define STAGE_BEGIN(t, stages) (void)sizeof(stages)
+#define STAGE_END(t, stage) do { } while (0)
+#define STAGE_MARK(t) do { } while (0)
+#endif
+
+/* USDT tracepoints: a single nop each until a tracer attaches. On by
+ * default wherever <sys/sdt.h> exists; NETSTRESS_NO_USDT opts out. */
+#if !defined(HAS_USDT) && !defined(NETSTRESS_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define HAS_USDT
+#endif
+#endif
+
+#ifdef HAS_USDT
+#include <sys/sdt.h>
+#define SHIM_PROBE(name, backend, queue, packets) \
+    DTRACE_PROBE3(netstress, name, (int)(backend), (uint32_t)(queue), (uint32_t)(packets))
+#else
+#define SHIM_PROBE(name, backend, queue, packets) do { } while (0)
+#endif
+
+static void stages_load(const stage_stats_t* src, stage_stats_t* dst) {
+    for (int i = 0; i < STATS_STAGE_COUNT; i++) {
+        dst->cycles[i] = STATS_LOAD(&src->cycles[i]);
+        dst->calls[i] = STATS_LOAD(&src->calls[i]);
+    }
+}
+
+static void stages_accumulate(stage_stats_t* total, const stage_stats_t* add) {
+    for (int i = 0; i < STATS_STAGE_COUNT; i++) {
+        total->cycles[i] += add->cycles[i];
+        total->calls[i] += add->calls[i];
+    }
+}
+
+static void stats_block_load(const driver_stats_block_t* block, driver_stats_t* stats) {
+    stats->packets_sent = STATS_LOAD(&block->packets_sent);
+    stats->packets_received = STATS_LOAD(&block->packets_received);
+    stats->bytes_sent = STATS_LOAD(&block->bytes_sent);
+    stats->bytes_received = STATS_LOAD(&block->bytes_received);
+    stats->errors = STATS_LOAD(&block->errors);
+}
+
+static void stats_accumulate(driver_stats_t* total, const driver_stats_t* add) {
+    total->packets_sent += add->packets_sent;
+    total->packets_received += add->packets_received;
+    total->bytes_sent += add->bytes_sent;
+    total->bytes_received += add->bytes_received;
+    total->errors += add->errors;
+}
+
+driver_stats_block_t* stats_block_create(void) {
+    driver_stats_block_t* block = NULL;
+    
+    STATS_LOCK();
+    for (int i = 0; i < DRIVER_STATS_MAX_BLOCKS; i++) {
+        if (!stats_blocks[i].in_use) {
+            block = &stats_blocks[i];
+            memset(block, 0, sizeof(*block));
+            block->in_use = 1;
+            break;
+        }
+    }
+    STATS_UNLOCK();
+    
+    return block;
+}
+
+void stats_block_add_tx(driver_stats_block_t* block, uint64_t packets, uint64_t bytes) {
+    STATS_ADD(&block->packets_sent, packets);
+    STATS_ADD(&block->bytes_sent, bytes);
+}
+
+void stats_block_add_rx(driver_stats_block_t* block, uint64_t packets, uint64_t bytes) {
+    STATS_ADD(&block->packets_received, packets);
+    STATS_ADD(&block->bytes_received, bytes);
+}
+
+void stats_block_add_errors(driver_stats_block_t* block, uint64_t errors) {
+    STATS_ADD(&block->errors, errors);
+}
+
+void stats_block_record_latency(driver_stats_block_t* block, uint64_t latency_ns) {
+    int bucket = 0;
+#if defined(__GNUC__) || defined(__clang__)
+    if (latency_ns > 1) {
+        bucket = 63 - __builtin_clzll(latency_ns);
+    }
+#else
+    while (latency_ns >>= 1) {
+        bucket++;
+    }
+#endif
+    if (bucket >= STATS_LATENCY_BUCKETS) {
+        bucket = STATS_LATENCY_BUCKETS - 1;
+    }
+    STATS_ADD(&block->latency[bucket], 1);
+}
+
+int stats_block_read(const driver_stats_block_t* block, driver_stats_t* stats) {
+    if (block == NULL || stats == NULL) {
+        return -1;
+    }
+    stats_block_load(block, stats);
+    return 0;
+}
+
+void stats_block_destroy(driver_stats_block_t* block) {
+    if (block == NULL) {
+        return;
+    }
+    
+    driver_stats_t final;
+    STATS_LOCK();
+    stats_block_load(block, &final);
+    stats_accumulate(&stats_retired, &final);
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+        stats_retired_latency[i] += STATS_LOAD(&block->latency[i]);
+    }
+    stage_stats_t stages;
+    stages_load(&block->stages, &stages);
+    stages_accumulate(&stats_retired_stages, &stages);
+    block->in_use = 0;
+    STATS_UNLOCK();
+}
+
+int driver_stats_snapshot(driver_stats_t* stats) {
+    if (stats == NULL) {
+        return -1;
+    }
+    
+    int live = 0;
+    STATS_LOCK();
+    *stats = stats_retired;
+    for (int i = 0; i < DRIVER_STATS_MAX_BLOCKS; i++) {
+        if (stats_blocks[i].in_use) {
+            driver_stats_t block;
+            stats_block_load(&stats_blocks[i], &block);
+            stats_accumulate(stats, &block);
+            live++;
+        }
+    }
+    STATS_UNLOCK();
+    
+    return live;
+}
+
+int stats_stages_enabled(void) {
+#ifdef NETSTRESS_STAGE_CYCLES
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+const char* stats_stage_name(stats_stage_t stage) {
+    static const char* const names[STATS_STAGE_COUNT] = {"alloc", "copy", "reserve", "kick", "reap"};
+    if ((unsigned)stage >= STATS_STAGE_COUNT) {
+        return "unknown";
+    }
+    return names[stage];
+}
+
+int stats_block_read_stages(const driver_stats_block_t* block, stage_stats_t* stages) {
+    if (block == NULL || stages == NULL) {
+        return -1;
+    }
+    stages_load(&block->stages, stages);
+    return 0;
+}
+
+int driver_stages_snapshot(stage_stats_t* stages) {
+    if (stages == NULL) {
+        return -1;
+    }
+    
+    int live = 0;
+    STATS_LOCK();
+    *stages = stats_retired_stages;
+    for (int i = 0; i < DRIVER_STATS_MAX_BLOCKS; i++) {
+        if (stats_blocks[i].in_use) {
+            stage_stats_t block;
+            stages_load(&stats_blocks[i].stages, &block);
+            stages_accumulate(stages, &block);
+            live++;
+        }
+    }
+    STATS_UNLOCK();
+    
+    return live;
+}
+
+#ifndef _WIN32
+
+/* Seqlock primitives for the shared-memory region */
+#define SEQ_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SEQ_LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define SEQ_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define SEQ_STORE_RELAXED(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define SEQ_FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define SEQ_FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+/* Torn reads tolerated before a reader gives up on a writer that died mid-update */
+#define STATS_SHM_READ_RETRIES (1u << 20)
+
+struct stats_shm {
+    uint8_t* region;
+    size_t size;
+    char* path;
+    uint32_t interval_us;
+    pthread_t thread;
+    int thread_running;
+    volatile int stop;
+};
+
+static inline stats_shm_header_t* shm_header(const void* region) {
+    return (stats_shm_header_t*)region;
+}
+
+static inline stats_shm_slot_t* shm_slot(const void* region, int slot) {
+    /* Aggregate slot sits right after the header, block slots follow */
+    return (stats_shm_slot_t*)((uint8_t*)region + sizeof(stats_shm_header_t)) + (slot + 1);
+}
+
+static void shm_write_slot(stats_shm_slot_t* slot, uint64_t now_us, uint32_t active,
+                           const driver_stats_t* counters, const uint64_t* latency) {
+    uint64_t seq = slot->seq;
+    SEQ_STORE_RELAXED(&slot->seq, seq + 1);
+    SEQ_FENCE_RELEASE();
+    
+    const uint64_t* src = (const uint64_t*)counters;
+    uint64_t* dst = (uint64_t*)&slot->counters;
+    for (size_t i = 0; i < sizeof(driver_stats_t) / sizeof(uint64_t); i++) {
+        SEQ_STORE_RELAXED(&dst[i], src[i]);
+    }
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+        SEQ_STORE_RELAXED(&slot->latency[i], latency[i]);
+    }
+    SEQ_STORE_RELAXED(&slot->timestamp_us, now_us);
+    slot->active = active;
+    
+    SEQ_STORE_RELEASE(&slot->seq, seq + 2);
+}
+
+int stats_shm_publish(stats_shm_t* shm) {
+    if (shm == NULL) {
+        return -1;
+    }
+    
+    uint64_t now = get_timestamp_us();
+    driver_stats_t total;
+    uint64_t total_latency[STATS_LATENCY_BUCKETS];
+    int live = 0;
+    
+    /* Only the lock holder writes slots, so each slot has one writer */
+    STATS_LOCK();
+    total = stats_retired;
+    memcpy(total_latency, stats_retired_latency, sizeof(total_latency));
+    
+    for (int i = 0; i < DRIVER_STATS_MAX_BLOCKS; i++) {
+        const driver_stats_block_t* block = &stats_blocks[i];
+        driver_stats_t counters;
+        uint64_t latency[STATS_LATENCY_BUCKETS];
+        
+        if (block->in_use) {
+            stats_block_load(block, &counters);
+            for (int b = 0; b < STATS_LATENCY_BUCKETS; b++) {
+                latency[b] = STATS_LOAD(&block->latency[b]);
+                total_latency[b] += latency[b];
+            }
+            stats_accumulate(&total, &counters);
+            live++;
+        } else {
+            /* Released blocks are folded into the aggregate */
+            memset(&counters, 0, sizeof(counters));
+            memset(latency, 0, sizeof(latency));
+        }
+        shm_write_slot(shm_slot(shm->region, i), now, (uint32_t)block->in_use, &counters, latency);
+    }
+    
+    shm_write_slot(shm_slot(shm->region, -1), now, 1, &total, total_latency);
+    SEQ_STORE_RELEASE(&shm_header(shm->region)->publish_count,
+                      shm_header(shm->region)->publish_count + 1);
+    STATS_UNLOCK();
+    
+    return live;
+}
+
+static void* stats_shm_thread(void* arg) {
+    stats_shm_t* shm = (stats_shm_t*)arg;
+    struct timespec period;
+    period.tv_sec = shm->interval_us / 1000000;
+    period.tv_nsec = (long)(shm->interval_us % 1000000) * 1000;
+    
+    while (!shm->stop) {
+        stats_shm_publish(shm);
+        nanosleep(&period, NULL);
+    }
+    return NULL;
+}
+
+stats_shm_t* stats_shm_create(const char* path, uint32_t interval_us) {
+    if (path == NULL) {
+        return NULL;
+    }
+    
+    stats_shm_t* shm = (stats_shm_t*)calloc(1, sizeof(*shm));
+    if (shm == NULL) {
+        return NULL;
+    }
+    shm->size = sizeof(stats_shm_header_t) + (DRIVER_STATS_MAX_BLOCKS + 1) * sizeof(stats_shm_slot_t);
+    shm->interval_us = interval_us;
+    shm->path = strdup(path);
+    
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (shm->path == NULL || fd < 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(shm->path);
+        free(shm);
+        return NULL;
+    }
+    
+    void* region = MAP_FAILED;
+    if (ftruncate(fd, (off_t)shm->size) == 0) {
+        region = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (region == MAP_FAILED) {
+        unlink(path);
+        free(shm->path);
+        free(shm);
+        return NULL;
+    }
+    shm->region = (uint8_t*)region;
+    
+    stats_shm_header_t* hdr = shm_header(shm->region);
+    hdr->version = STATS_SHM_VERSION;
+    hdr->num_slots = DRIVER_STATS_MAX_BLOCKS;
+    hdr->slot_size = sizeof(stats_shm_slot_t);
+    hdr->interval_us = interval_us;
+    stats_shm_publish(shm);
+    /* Magic last: readers treat the region as valid once it appears */
+    SEQ_STORE_RELEASE(&hdr->magic, STATS_SHM_MAGIC);
+    
+    if (interval_us > 0) {
+        if (pthread_create(&shm->thread, NULL, stats_shm_thread, shm) != 0) {
+            stats_shm_destroy(shm);
+            return NULL;
+        }
+        shm->thread_running = 1;
+    }
+    
+    return shm;
+}
+
+const void* stats_shm_region(const stats_shm_t* shm) {
+    return shm != NULL ? shm->region : NULL;
+}
+
+int stats_shm_read(const void* region, int slot, stats_shm_slot_t* out) {
+    if (region == NULL || out == NULL) {
+        return -1;
+    }
+    
+    const stats_shm_header_t* hdr = shm_header(region);
+    if (SEQ_LOAD_ACQUIRE(&hdr->magic) != STATS_SHM_MAGIC ||
+        slot < -1 || slot >= (int)hdr->num_slots) {
+        return -1;
+    }
+    
+    const stats_shm_slot_t* src = shm_slot(region, slot);
+    for (uint32_t tries = 0; tries < STATS_SHM_READ_RETRIES; tries++) {
+        uint64_t seq = SEQ_LOAD_ACQUIRE(&src->seq);
+        if (seq & 1) {
+            cpu_relax();
+            continue;
+        }
+        memcpy(out, src, sizeof(*out));
+        SEQ_FENCE_ACQUIRE();
+        if (SEQ_LOAD_RELAXED(&src->seq) == seq) {
+            out->seq = seq;
+            return 0;
+        }
+    }
+    return -EAGAIN;
+}
+
+void stats_shm_destroy(stats_shm_t* shm) {
+    if (shm == NULL) {
+        return;
+    }
+    if (shm->thread_running) {
+        shm->stop = 1;
+        pthread_join(shm->thread, NULL);
+    }
+    munmap(shm->region, shm->size);
+    unlink(shm->path);
+    free(shm->path);
+    free(shm);
+}
+
+#else
+
+/* Shared-memory telemetry needs mmap; not provided on Windows */
+stats_shm_t* stats_shm_create(const char* path, uint32_t interval_us) {
+    (void)path;
+    (void)interval_us;
+    return NULL;
+}
+
+int stats_shm_publish(stats_shm_t* shm) {
+    (void)shm;
+    return -1;
+}
+
+const void* stats_shm_region(const stats_shm_t* shm) {
+    (void)shm;
+    return NULL;
+}
+
+int stats_shm_read(const void* region, int slot, stats_shm_slot_t* out) {
+    (void)region;
+    (void)slot;
+    (void)out;
+    return -1;
+}
+
+void stats_shm_destroy(stats_shm_t* shm) {
+    (void)shm;
+}
+
+#endif /* _WIN32 */
+
+/* ============================================================================
+ * Latency Probing
+ * ============================================================================ */
+
+/*
+ * Log-linear histogram: values below 32 get exact buckets, then every power
+ * of two [2^e, 2^(e+1)) is split into 32 equal sub-buckets. Index is
+ * (e - 5) * 32 + (v >> (e - 5)), continuous with the exact range.
+ */
+#define LAT_HIST_SUB_BITS 5
+#define LAT_HIST_SUB (1U << LAT_HIST_SUB_BITS)
+#define LAT_HIST_MAX_EXP 40                        /* ~18 minutes */
+#define LAT_HIST_MAX_VALUE ((1ULL << (LAT_HIST_MAX_EXP + 1)) - 1)
+#define LAT_HIST_BUCKETS ((LAT_HIST_MAX_EXP - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB + LAT_HIST_SUB)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t probe_id;
+    uint64_t seq;
+    uint64_t tx_ns;
+} latency_probe_hdr_t;
+
+struct latency_probe {
+    uint32_t probe_id;
+    uint32_t offset;
+    driver_stats_block_t* stats;
+    
+    /* Written by the stamping thread */
+    SHIM_CACHE_ALIGNED uint64_t sent;
+    
+    /* Written by the matching thread */
+    SHIM_CACHE_ALIGNED uint64_t received;
+    uint64_t reordered;
+    uint64_t highest_seq;  /* highest seq seen + 1, 0 before the first reply */
+    uint64_t sum_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LAT_HIST_BUCKETS];
+};
+
+static inline uint32_t lat_hist_index(uint64_t v) {
+    if (v < LAT_HIST_SUB) {
+        return (uint32_t)v;
+    }
+    if (v > LAT_HIST_MAX_VALUE) {
+        v = LAT_HIST_MAX_VALUE;
+    }
+    uint32_t e = 0;
+#if defined(__GNUC__) || defined(__clang__)
+    e = 63 - (uint32_t)__builtin_clzll(v);
+#else
+    for (uint64_t t = v; t >>= 1;) {
+        e++;
+    }
+#endif
+    uint32_t shift = e - LAT_HIST_SUB_BITS;
+    return shift * LAT_HIST_SUB + (uint32_t)(v >> shift);
+}
+
+/* Highest value that lands in a bucket */
+static inline uint64_t lat_hist_value(uint32_t index) {
+    if (index < 2 * LAT_HIST_SUB) {
+        return index;
+    }
+    uint32_t shift = index / LAT_HIST_SUB - 1;
+    uint64_t mantissa = LAT_HIST_SUB + index % LAT_HIST_SUB;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/* Locate the probe header; frames get it after their L4 header */
+static int probe_locate(const latency_probe_t* probe, const uint8_t* packet, uint32_t len,
+                        frame_layout_t* layout, uint32_t* offset) {
+    if (probe->offset == LATENCY_PROBE_AUTO) {
+        if (parse_frame_layout(packet, len, layout) != 0) {
+            return -1;
+        }
+        *offset = (uint32_t)layout->l2_len + layout->l3_len + layout->l4_len;
+    } else {
+        memset(layout, 0, sizeof(*layout));
+        *offset = probe->offset;
+    }
+    return (uint64_t)*offset + LATENCY_PROBE_HDR_LEN <= len ? 0 : -1;
+}
+
+static int probe_stamp(latency_probe_t* probe, uint8_t* packet, uint32_t len, int fix_csum) {
+    frame_layout_t layout;
+    uint32_t offset;
+    if (probe_locate(probe, packet, len, &layout, &offset) != 0) {
+        return -1;
+    }
+    
+    latency_probe_hdr_t hdr;
+    hdr.magic = LATENCY_PROBE_MAGIC;
+    hdr.probe_id = probe->probe_id;
+    hdr.seq = probe->sent;
+    hdr.tx_ns = get_timestamp_ns();
+    
+    uint8_t* dst = packet + offset;
+    uint32_t csum_offset = 0;
+    if (fix_csum && layout.proto == IPPROTO_UDP) {
+        csum_offset = (uint32_t)layout.l2_len + layout.l3_len + 6;
+    } else if (fix_csum && layout.proto == IPPROTO_TCP) {
+        csum_offset = (uint32_t)layout.l2_len + layout.l3_len + 16;
+    }
+    
+    /* The payload starts on an even offset from the L4 header, so its
+     * 16-bit words line up with checksum words */
+    if (csum_offset != 0 && load_be16(packet + csum_offset) != 0) {
+        uint8_t next[LATENCY_PROBE_HDR_LEN];
+        memcpy(next, &hdr, sizeof(hdr));
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < LATENCY_PROBE_HDR_LEN; i += 2) {
+            sum += (uint16_t)~load_be16(dst + i);
+            sum += load_be16(next + i);
+        }
+        store_be16(packet + csum_offset, csum_adjust(load_be16(packet + csum_offset), sum));
+    }
+    
+    memcpy(dst, &hdr, sizeof(hdr));
+    STATS_ADD(&probe->sent, 1);
+    return 0;
+}
+
+latency_probe_t* latency_probe_create(uint32_t probe_id, uint32_t offset, driver_stats_block_t* stats) {
+    /* Zeroed and page-aligned, which keeps the two writers' lines apart */
+    latency_probe_t* probe = (latency_probe_t*)alloc_numa_memory(sizeof(*probe), -1);
+    if (probe == NULL) {
+        return NULL;
+    }
+    probe->probe_id = probe_id;
+    probe->offset = offset;
+    probe->stats = stats;
+    probe->min_ns = UINT64_MAX;
+    return probe;
+}
+
+int latency_probe_stamp(latency_probe_t* probe, uint8_t* packet, uint32_t len) {
+    if (probe == NULL || packet == NULL) {
+        return -1;
+    }
+    return probe_stamp(probe, packet, len, 1);
+}
+
+void latency_probe_record(latency_probe_t* probe, uint64_t latency_ns) {
+    if (probe == NULL) {
+        return;
+    }
+    if (latency_ns < probe->min_ns) {
+        STATS_STORE(&probe->min_ns, latency_ns);
+    }
+    if (latency_ns > probe->max_ns) {
+        STATS_STORE(&probe->max_ns, latency_ns);
+    }
+    STATS_ADD(&probe->sum_ns, latency_ns);
+    STATS_ADD(&probe->buckets[lat_hist_index(latency_ns)], 1);
+    STATS_ADD(&probe->received, 1);
+    
+    if (probe->stats != NULL) {
+        stats_block_record_latency(probe->stats, latency_ns);
+    }
+}
+
+int latency_probe_match(latency_probe_t* probe, const uint8_t* packet, uint32_t len, uint64_t rx_ns) {
+    if (probe == NULL || packet == NULL) {
+        return 0;
+    }
+    
+    frame_layout_t layout;
+    uint32_t offset;
+    if (probe_locate(probe, packet, len, &layout, &offset) != 0) {
+        return 0;
+    }
+    
+    latency_probe_hdr_t hdr;
+    memcpy(&hdr, packet + offset, sizeof(hdr));
+    if (hdr.magic != LATENCY_PROBE_MAGIC || hdr.probe_id != probe->probe_id) {
+        return 0;
+    }
+    
+    if (hdr.seq < probe->highest_seq) {
+        STATS_ADD(&probe->reordered, 1);
+    } else {
+        STATS_STORE(&probe->highest_seq, hdr.seq + 1);
+    }
+    latency_probe_record(probe, rx_ns > hdr.tx_ns ? rx_ns - hdr.tx_ns : 0);
+    return 1;
+}
+
+/* Value at a percentile of a histogram, capped at the largest sample */
+static uint64_t lat_hist_percentile(const uint64_t* buckets, uint64_t max_ns, double percentile) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < LAT_HIST_BUCKETS; i++) {
+        total += STATS_LOAD(&buckets[i]);
+    }
+    if (total == 0) {
+        return 0;
+    }
+    
+    if (percentile < 0.0) {
+        percentile = 0.0;
+    } else if (percentile > 100.0) {
+        percentile = 100.0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LAT_HIST_BUCKETS; i++) {
+        seen += STATS_LOAD(&buckets[i]);
+        if (seen >= rank) {
+            uint64_t value = lat_hist_value(i);
+            return value < max_ns ? value : max_ns;
+        }
+    }
+    return max_ns;
+}
+
+uint64_t latency_probe_percentile(const latency_probe_t* probe, double percentile) {
+    if (probe == NULL) {
+        return 0;
+    }
+    return lat_hist_percentile(probe->buckets, STATS_LOAD(&probe->max_ns), percentile);
+}
+
+int latency_probe_report(const latency_probe_t* probe, latency_report_t* report) {
+    if (probe == NULL || report == NULL) {
+        return -1;
+    }
+    
+    memset(report, 0, sizeof(*report));
+    report->sent = STATS_LOAD(&probe->sent);
+    report->received = STATS_LOAD(&probe->received);
+    report->reordered = STATS_LOAD(&probe->reordered);
+    if (report->received > 0) {
+        report->min_ns = STATS_LOAD(&probe->min_ns);
+        report->max_ns = STATS_LOAD(&probe->max_ns);
+        report->mean_ns = STATS_LOAD(&probe->sum_ns) / report->received;
+    }
+    report->p50_ns = latency_probe_percentile(probe, 50.0);
+    report->p99_ns = latency_probe_percentile(probe, 99.0);
+    report->p999_ns = latency_probe_percentile(probe, 99.9);
+    return 0;
+}
+
+void latency_probe_destroy(latency_probe_t* probe) {
+    if (probe != NULL) {
+        free_numa_memory(probe, sizeof(*probe));
+    }
+}
+
+/* ============================================================================
+ * Packet Batches
+ * ============================================================================ */
+
+static inline size_t pkt_align(size_t n) {
+    return (n + PKT_BATCH_ALIGN - 1) & ~(size_t)(PKT_BATCH_ALIGN - 1);
+}
+
+/* Region record, header, offsets, lengths, [dst_ips, dst_ports,] arena -
+ * each section starting on a cache line */
+#define PKT_BATCH_PREFIX pkt_align(sizeof(mem_region_t))
+
+static size_t pkt_batch_layout(uint32_t capacity, uint32_t arena_size, int per_packet_dests,
+                               size_t* sections) {
+    size_t off = PKT_BATCH_PREFIX + pkt_align(sizeof(pkt_batch_t));
+    sections[0] = off;
+    off += pkt_align((size_t)capacity * sizeof(uint32_t));
+    sections[1] = off;
+    off += pkt_align((size_t)capacity * sizeof(uint32_t));
+    sections[2] = per_packet_dests ? off : 0;
+    off += per_packet_dests ? pkt_align((size_t)capacity * sizeof(uint32_t)) : 0;
+    sections[3] = per_packet_dests ? off : 0;
+    off += per_packet_dests ? pkt_align((size_t)capacity * sizeof(uint16_t)) : 0;
+    sections[4] = off;
+    return off + pkt_align(arena_size);
+}
+
+pkt_batch_t* pkt_batch_create_in(uint32_t capacity, uint32_t arena_size, int per_packet_dests,
+                                 const mem_region_config_t* mem) {
+    if (capacity == 0 || arena_size == 0) {
+        return NULL;
+    }
+    
+    size_t sections[5];
+    size_t size = pkt_batch_layout(capacity, arena_size, per_packet_dests, sections);
+    mem_region_t region;
+    if (mem_region_alloc(&region, size, mem) != 0) {
+        return NULL;
+    }
+    
+    /* The region record sits in front of the header for pkt_batch_destroy() */
+    uint8_t* base = (uint8_t*)region.addr;
+    memcpy(base, &region, sizeof(region));
+    pkt_batch_t* batch = (pkt_batch_t*)(base + PKT_BATCH_PREFIX);
+    memset(batch, 0, sizeof(*batch));
+    batch->offsets = (uint32_t*)(base + sections[0]);
+    batch->lengths = (uint32_t*)(base + sections[1]);
+    batch->dst_ips = per_packet_dests ? (uint32_t*)(base + sections[2]) : NULL;
+    batch->dst_ports = per_packet_dests ? (uint16_t*)(base + sections[3]) : NULL;
+    batch->arena = base + sections[4];
+    batch->capacity = capacity;
+    batch->arena_size = arena_size;
+    return batch;
+}
+
+pkt_batch_t* pkt_batch_create(uint32_t capacity, uint32_t arena_size, int per_packet_dests, int numa_node) {
+    mem_region_config_t mem;
+    mem_region_config_init(&mem);
+    mem.numa_node = numa_node;
+    return pkt_batch_create_in(capacity, arena_size, per_packet_dests, &mem);
+}
+
+uint8_t* pkt_batch_reserve(pkt_batch_t* batch, uint32_t len, uint32_t dst_ip, uint16_t dst_port) {
+    if (batch == NULL || batch->count >= batch->capacity) {
+        return NULL;
+    }
+    
+    size_t offset = pkt_align(batch->arena_used);
+    if (offset + len > batch->arena_size) {
+        return NULL;
+    }
+    
+    uint32_t i = batch->count++;
+    batch->offsets[i] = (uint32_t)offset;
+    batch->lengths[i] = len;
+    if (batch->dst_ips) {
+        batch->dst_ips[i] = dst_ip;
+    }
+    if (batch->dst_ports) {
+        batch->dst_ports[i] = dst_port;
+    }
+    batch->arena_used = (uint32_t)(offset + len);
+    return batch->arena + offset;
+}
+
+int pkt_batch_append(pkt_batch_t* batch, const uint8_t* data, uint32_t len,
+                     uint32_t dst_ip, uint16_t dst_port) {
+    if (data == NULL) {
+        return -1;
+    }
+    uint8_t* slot = pkt_batch_reserve(batch, len, dst_ip, dst_port);
+    if (slot == NULL) {
+        return -1;
+    }
+    memcpy(slot, data, len);
+    return (int)(batch->count - 1);
+}
+
+void pkt_batch_reset(pkt_batch_t* batch) {
+    if (batch != NULL) {
+        batch->count = 0;
+        batch->arena_used = 0;
+    }
+}
+
+void pkt_batch_destroy(pkt_batch_t* batch) {
+    if (batch == NULL) {
+        return;
+    }
+    mem_region_t region;
+    memcpy(&region, (uint8_t*)batch - PKT_BATCH_PREFIX, sizeof(region));
+    mem_region_free(&region);
+}
+
+static inline void pkt_batch_dest(const pkt_batch_t* batch, uint32_t i, struct sockaddr_in* dest) {
+    memset(dest, 0, sizeof(*dest));
+    dest->sin_family = AF_INET;
+    dest->sin_addr.s_addr = batch->dst_ips ? batch->dst_ips[i] : batch->dst_ip;
+    dest->sin_port = htons(batch->dst_ports ? batch->dst_ports[i] : batch->dst_port);
+}
+
+/* Where a send path reads packet i: a pointer array, or a batch arena */
+typedef struct {
+    const uint8_t** packets;
+    const uint8_t* arena;
+    const uint32_t* offsets;
+} pkt_src_t;
+
+static inline const uint8_t* pkt_src_get(const pkt_src_t* src, uint32_t i) {
+    return src->packets ? src->packets[i] : src->arena + src->offsets[i];
+}
+
+static inline pkt_src_t pkt_src_from_batch(const pkt_batch_t* batch, uint32_t first) {
+    pkt_src_t src = {NULL, batch->arena, batch->offsets + first};
+    return src;
+}
+
+/* ============================================================================
+ * Packet Templates
+ * ============================================================================ */
+
+#define PKT_TEMPLATE_CHUNK 64
+
+typedef struct {
+    uint8_t kind;
+    uint8_t size;
+    uint8_t swap;               /* Odd offset: words contribute byte-swapped */
+    uint8_t reserved;
+    uint32_t offset;
+    uint32_t start;
+    uint32_t step;
+    uint32_t span;              /* RANGE and LIST period */
+    uint32_t cursor;            /* COUNTER: next value; RANGE, LIST: next position */
+    uint32_t* table;
+} tmpl_field_t;
+
+typedef void (*tmpl_csum_fn)(uint32_t base, const uint32_t* const* words, uint32_t word_count,
+                             uint32_t* out, uint32_t first, uint32_t n);
+
+struct pkt_template {
+    uint8_t* packet;
+    uint32_t len;
+    uint32_t field_count;
+    uint32_t csum_count;
+    uint64_t position;
+    tmpl_field_t fields[PKT_TEMPLATE_MAX_FIELDS];
+    uint32_t csum_offsets[PKT_TEMPLATE_MAX_CSUMS];
+    uint32_t csum_base[PKT_TEMPLATE_MAX_CSUMS];     /* ~checksum + ~old words */
+    uint32_t csum_fields[PKT_TEMPLATE_MAX_CSUMS];   /* Bit per covered field */
+    
+    /* One chunk of values, checksum words and results */
+    SHIM_CACHE_ALIGNED uint32_t values[PKT_TEMPLATE_MAX_FIELDS][PKT_TEMPLATE_CHUNK];
+    uint32_t words[PKT_TEMPLATE_MAX_FIELDS][PKT_TEMPLATE_CHUNK];
+    uint32_t sums[PKT_TEMPLATE_MAX_CSUMS][PKT_TEMPLATE_CHUNK];
+};
+
+/* base + every word, folded and inverted: RFC 1624 with the old words
+ * already taken out of base */
+static void tmpl_csum_portable(uint32_t base, const uint32_t* const* words, uint32_t word_count,
+                               uint32_t* out, uint32_t first, uint32_t n) {
+    for (uint32_t i = first; i < n; i++) {
+        uint32_t sum = base;
+        for (uint32_t w = 0; w < word_count; w++) {
+            sum += words[w][i];
+        }
+        sum = (sum & 0xFFFF) + (sum >> 16);
+        sum = (sum & 0xFFFF) + (sum >> 16);
+        out[i] = ~sum & 0xFFFF;
+    }
+}
+
+#ifdef CSUM_HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static void tmpl_csum_avx2(uint32_t base, const uint32_t* const* words, uint32_t word_count,
+                           uint32_t* out, uint32_t first, uint32_t n) {
+    const __m256i low = _mm256_set1_epi32(0xFFFF);
+    const __m256i start = _mm256_set1_epi32((int)base);
+    uint32_t i = first;
+    
+    for (; i + 8 <= n; i += 8) {
+        __m256i sum = start;
+        for (uint32_t w = 0; w < word_count; w++) {
+            sum = _mm256_add_epi32(sum, _mm256_loadu_si256((const __m256i*)(words[w] + i)));
+        }
+        sum = _mm256_add_epi32(_mm256_and_si256(sum, low), _mm256_srli_epi32(sum, 16));
+        sum = _mm256_add_epi32(_mm256_and_si256(sum, low), _mm256_srli_epi32(sum, 16));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_andnot_si256(sum, low));
+    }
+    tmpl_csum_portable(base, words, word_count, out, i, n);
+}
+#endif
+
+#ifdef CSUM_HAVE_NEON
+static void tmpl_csum_neon(uint32_t base, const uint32_t* const* words, uint32_t word_count,
+                           uint32_t* out, uint32_t first, uint32_t n) {
+    const uint32x4_t low = vdupq_n_u32(0xFFFF);
+    const uint32x4_t start = vdupq_n_u32(base);
+    uint32_t i = first;
+    
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t sum = start;
+        for (uint32_t w = 0; w < word_count; w++) {
+            sum = vaddq_u32(sum, vld1q_u32(words[w] + i));
+        }
+        sum = vaddq_u32(vandq_u32(sum, low), vshrq_n_u32(sum, 16));
+        sum = vaddq_u32(vandq_u32(sum, low), vshrq_n_u32(sum, 16));
+        vst1q_u32(out + i, vbicq_u32(low, sum));
+    }
+    tmpl_csum_portable(base, words, word_count, out, i, n);
+}
+#endif
+
+/* Follows the checksum kernel so checksum_set_impl() picks both */
+static tmpl_csum_fn tmpl_csum_kernel(void) {
+    switch (checksum_get_impl()) {
+#ifdef CSUM_HAVE_X86_SIMD
+        case CHECKSUM_IMPL_AVX2:
+        case CHECKSUM_IMPL_AVX512:
+            return tmpl_csum_avx2;
+#endif
+#ifdef CSUM_HAVE_NEON
+        case CHECKSUM_IMPL_NEON:
+            return tmpl_csum_neon;
+#endif
+        default:
+            return tmpl_csum_portable;
+    }
+}
+
+static inline int tmpl_overlaps(uint32_t a, uint32_t a_len, uint32_t b, uint32_t b_len) {
+    return a < b + b_len && b < a + a_len;
+}
+
+/* Slot of a checksum offset, adding it if new; -1 when all slots are taken */
+static int tmpl_csum_slot(pkt_template_t* t, uint32_t offset) {
+    for (uint32_t c = 0; c < t->csum_count; c++) {
+        if (t->csum_offsets[c] == offset) {
+            return (int)c;
+        }
+    }
+    if (t->csum_count == PKT_TEMPLATE_MAX_CSUMS) {
+        return -1;
+    }
+    t->csum_offsets[t->csum_count] = offset;
+    t->csum_base[t->csum_count] = (uint16_t)~load_be16(t->packet + offset);
+    return (int)t->csum_count++;
+}
+
+/* Checksum words of a field value, oriented for its offset */
+static inline uint32_t tmpl_words(const tmpl_field_t* f, uint32_t v) {
+    if (f->size == 2) {
+        return csum_word_at((uint16_t)v, f->swap);
+    }
+    return (uint32_t)csum_word_at((uint16_t)(v >> 16), f->swap) + csum_word_at((uint16_t)v, f->swap);
+}
+
+static int tmpl_field_setup(pkt_template_t* t, uint32_t index, const pkt_field_t* in) {
+    tmpl_field_t* f = &t->fields[index];
+    if ((in->size != 2 && in->size != 4) || (uint64_t)in->offset + in->size > t->len) {
+        return -1;
+    }
+    f->kind = (uint8_t)in->kind;
+    f->size = (uint8_t)in->size;
+    f->swap = (uint8_t)(in->offset & 1);
+    f->offset = in->offset;
+    f->start = in->start;
+    f->step = in->step;
+    
+    switch (in->kind) {
+        case PKT_FIELD_COUNTER:
+            break;
+        case PKT_FIELD_RANGE:
+            if (in->max < in->start) {
+                return -1;
+            }
+            f->span = in->max - in->start + 1;
+            break;
+        case PKT_FIELD_LIST:
+            if (in->values == NULL || in->count == 0) {
+                return -1;
+            }
+            f->table = (uint32_t*)malloc((size_t)in->count * sizeof(uint32_t));
+            if (f->table == NULL) {
+                return -1;
+            }
+            memcpy(f->table, in->values, (size_t)in->count * sizeof(uint32_t));
+            f->span = in->count;
+            break;
+        default:
+            return -1;
+    }
+    /* A full 32-bit range wraps like a counter */
+    if (f->span == 0 && in->kind == PKT_FIELD_RANGE) {
+        f->kind = PKT_FIELD_COUNTER;
+    }
+    if (f->span != 0) {
+        f->step %= f->span;
+    }
+    
+    for (uint32_t k = 0; k < 2; k++) {
+        uint32_t off = in->csum_offsets[k];
+        if (off == PKT_FIELD_NO_CSUM) {
+            continue;
+        }
+        if ((uint64_t)off + 2 > t->len || tmpl_overlaps(off, 2, in->offset, in->size)) {
+            return -1;
+        }
+        int c = tmpl_csum_slot(t, off);
+        if (c < 0) {
+            return -1;
+        }
+        if (t->csum_fields[c] & (1U << index)) {
+            continue;
+        }
+        /* Take the template's own value out of the base once */
+        uint32_t old = in->size == 2 ? load_be16(t->packet + in->offset) : load_be32(t->packet + in->offset);
+        uint32_t words = in->size == 2 ? 0xFFFFU - tmpl_words(f, old)
+                                       : 2 * 0xFFFFU - tmpl_words(f, old);
+        t->csum_base[c] += words;
+        t->csum_fields[c] |= 1U << index;
+    }
+    return 0;
+}
+
+void pkt_field_init(pkt_field_t* field, pkt_field_kind_t kind, uint32_t offset, uint32_t size) {
+    if (field == NULL) {
+        return;
+    }
+    memset(field, 0, sizeof(*field));
+    field->kind = kind;
+    field->offset = offset;
+    field->size = size;
+    field->csum_offsets[0] = PKT_FIELD_NO_CSUM;
+    field->csum_offsets[1] = PKT_FIELD_NO_CSUM;
+    field->step = 1;
+}
+
+pkt_template_t* pkt_template_create(const uint8_t* packet, uint32_t len,
+                                    const pkt_field_t* fields, uint32_t field_count) {
+    if (packet == NULL || len == 0 || field_count > PKT_TEMPLATE_MAX_FIELDS ||
+        (field_count > 0 && fields == NULL)) {
+        return NULL;
+    }
+    
+    pkt_template_t* t = (pkt_template_t*)alloc_numa_memory(sizeof(*t), -1);
+    if (t == NULL) {
+        return NULL;
+    }
+    memset(t, 0, sizeof(*t));
+    t->packet = (uint8_t*)malloc(len);
+    if (t->packet == NULL) {
+        pkt_template_destroy(t);
+        return NULL;
+    }
+    memcpy(t->packet, packet, len);
+    t->len = len;
+    
+    for (uint32_t i = 0; i < field_count; i++) {
+        t->field_count = i + 1;
+        if (tmpl_field_setup(t, i, &fields[i]) != 0) {
+            pkt_template_destroy(t);
+            return NULL;
+        }
+        for (uint32_t j = 0; j < i; j++) {
+            if (tmpl_overlaps(fields[i].offset, fields[i].size, fields[j].offset, fields[j].size)) {
+                pkt_template_destroy(t);
+                return NULL;
+            }
+        }
+    }
+    /* Checksums written after the fields must not land on one */
+    for (uint32_t c = 0; c < t->csum_count; c++) {
+        for (uint32_t i = 0; i < field_count; i++) {
+            if (tmpl_overlaps(t->csum_offsets[c], 2, fields[i].offset, fields[i].size)) {
+                pkt_template_destroy(t);
+                return NULL;
+            }
+        }
+    }
+    pkt_template_seek(t, 0);
+    return t;
+}
+
+uint32_t pkt_template_len(const pkt_template_t* tmpl) {
+    return tmpl != NULL ? tmpl->len : 0;
+}
+
+/* Values for the next n packets (n <= PKT_TEMPLATE_CHUNK), then their checksums */
+static void tmpl_generate(pkt_template_t* t, uint32_t n) {
+    for (uint32_t k = 0; k < t->field_count; k++) {
+        tmpl_field_t* f = &t->fields[k];
+        uint32_t* values = t->values[k];
+        uint32_t v = f->cursor;
+        
+        if (f->kind == PKT_FIELD_COUNTER) {
+            for (uint32_t i = 0; i < n; i++) {
+                values[i] = v + i * f->step;
+            }
+            f->cursor = v + n * f->step;
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                values[i] = v;
+                v += f->step;
+                v = v >= f->span ? v - f->span : v;
+            }
+            f->cursor = v;
+            if (f->kind == PKT_FIELD_LIST) {
+                for (uint32_t i = 0; i < n; i++) {
+                    values[i] = f->table[values[i]];
+                }
+            } else {
+                for (uint32_t i = 0; i < n; i++) {
+                    values[i] += f->start;
+                }
+            }
+        }
+        if (f->size == 2) {
+            for (uint32_t i = 0; i < n; i++) {
+                values[i] &= 0xFFFF;
+            }
+        }
+        
+        uint32_t* words = t->words[k];
+        if (f->size == 2) {
+            for (uint32_t i = 0; i < n; i++) {
+                words[i] = csum_word_at((uint16_t)values[i], f->swap);
+            }
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                words[i] = tmpl_words(f, values[i]);
+            }
+        }
+    }
+    
+    tmpl_csum_fn kernel = tmpl_csum_kernel();
+    for (uint32_t c = 0; c < t->csum_count; c++) {
+        const uint32_t* words[PKT_TEMPLATE_MAX_FIELDS];
+        uint32_t word_count = 0;
+        for (uint32_t k = 0; k < t->field_count; k++) {
+            if (t->csum_fields[c] & (1U << k)) {
+                words[word_count++] = t->words[k];
+            }
+        }
+        kernel(t->csum_base[c], words, word_count, t->sums[c], 0, n);
+    }
+    t->position += n;
+}
+
+static void tmpl_stamp(pkt_template_t* t, uint8_t* const* bufs, uint32_t n) {
+    tmpl_generate(t, n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t* p = bufs[i];
+        memcpy(p, t->packet, t->len);
+        for (uint32_t k = 0; k < t->field_count; k++) {
+            const tmpl_field_t* f = &t->fields[k];
+            if (f->size == 2) {
+                store_be16(p + f->offset, (uint16_t)t->values[k][i]);
+            } else {
+                store_be32(p + f->offset, t->values[k][i]);
+            }
+        }
+        for (uint32_t c = 0; c < t->csum_count; c++) {
+            store_be16(p + t->csum_offsets[c], (uint16_t)t->sums[c][i]);
+        }
+    }
+}
+
+int pkt_template_fill(pkt_template_t* tmpl, uint8_t* const* bufs, uint32_t count) {
+    if (tmpl == NULL || (count > 0 && bufs == NULL)) {
+        return -1;
+    }
+    for (uint32_t done = 0; done < count;) {
+        uint32_t n = count - done < PKT_TEMPLATE_CHUNK ? count - done : PKT_TEMPLATE_CHUNK;
+        tmpl_stamp(tmpl, bufs + done, n);
+        done += n;
+    }
+    return (int)count;
+}
+
+int pkt_template_fill_batch(pkt_template_t* tmpl, pkt_batch_t* batch, uint32_t count) {
+    if (tmpl == NULL || batch == NULL) {
+        return -1;
+    }
+    
+    uint8_t* bufs[PKT_TEMPLATE_CHUNK];
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t want = count - done < PKT_TEMPLATE_CHUNK ? count - done : PKT_TEMPLATE_CHUNK;
+        uint32_t n = 0;
+        while (n < want && (bufs[n] = pkt_batch_reserve(batch, tmpl->len, 0, 0)) != NULL) {
+            n++;
+        }
+        if (n > 0) {
+            tmpl_stamp(tmpl, bufs, n);
+        }
+        done += n;
+        if (n < want) {
+            break;
+        }
+    }
+    return (int)done;
+}
+
+void pkt_template_seek(pkt_template_t* tmpl, uint64_t index) {
+    if (tmpl == NULL) {
+        return;
+    }
+    for (uint32_t k = 0; k < tmpl->field_count; k++) {
+        tmpl_field_t* f = &tmpl->fields[k];
+        if (f->kind == PKT_FIELD_COUNTER) {
+            f->cursor = f->start + (uint32_t)(index * f->step);
+        } else {
+            f->cursor = (uint32_t)((index % f->span) * f->step % f->span);
+        }
+    }
+    tmpl->position = index;
+}
+
+uint64_t pkt_template_tell(const pkt_template_t* tmpl) {
+    return tmpl != NULL ? tmpl->position : 0;
+}
+
+void pkt_template_destroy(pkt_template_t* tmpl) {
+    if (tmpl == NULL) {
+        return;
+    }
+    for (uint32_t k = 0; k < tmpl->field_count; k++) {
+        free(tmpl->fields[k].table);
+    }
+    free(tmpl->packet);
+    free_numa_memory(tmpl, sizeof(*tmpl));
+}
+
+/* ============================================================================
+ * Safety Envelope
+ * ============================================================================ */
+
+/*
+ * Allowlist: stride-8 multibit trie with prefix expansion, so a lookup is
+ * at most four dependent loads. Entries are 0 (deny), SAFETY_TRIE_ALLOW,
+ * or the index of the next level's node; node 0 is the root.
+ *
+ * Ceiling: GCRA on one shared theoretical arrival time (tat, ns). A send
+ * may push tat at most the tolerance past now; costs are ns in 16.16 fixed
+ * point and rounded up, so the ceiling never drifts above its rate.
+ */
+#define SAFETY_TRIE_FANOUT 256
+#define SAFETY_TRIE_ALLOW 0xFFFFFFFFu
+#define SAFETY_BURST_NS 1000000ULL
+#define SAFETY_MIN_BPS 8000
+#define SAFETY_GATHER 64
+#define SAFETY_MAX_PACKET 65536     /* IPv4 total length bound */
+
+#if defined(_MSC_VER)
+    #define SAFETY_LOAD(p) (*(p))
+    #define SAFETY_STORE(p, v) (*(p) = (v))
+    #define SAFETY_FETCH_ADD(p, v) InterlockedExchangeAdd64((volatile LONG64*)(p), (LONG64)(v))
+    #define SAFETY_CAS(p, expected, desired) \
+        (InterlockedCompareExchange64((volatile LONG64*)(p), (LONG64)(desired), (LONG64)(expected)) == \
+         (LONG64)(expected))
+#else
+    #define SAFETY_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+    #define SAFETY_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+    #define SAFETY_FETCH_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+    #define SAFETY_CAS(p, expected, desired) \
+        __atomic_compare_exchange_n((p), &(expected), (desired), 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#endif
+
+struct safety_envelope {
+    uint32_t (*nodes)[SAFETY_TRIE_FANOUT];
+    uint32_t node_count;
+    uint32_t node_capacity;
+    uint64_t pkt_cost;          /* ns per packet, 16.16; 0 = no pps ceiling */
+    uint64_t byte_cost;         /* ns per byte, 16.16; 0 = no bps ceiling */
+    uint64_t tolerance;         /* Burst allowance, ns in 16.16 */
+    volatile uint64_t tat;
+    volatile uint64_t admitted;
+    volatile uint64_t denied;
+    volatile uint64_t throttled;
+};
+
+static safety_envelope_t* volatile safety_table[BACKEND_DPDK + 1];
+static volatile int safety_killed;
+
+static int safety_trie_grow(safety_envelope_t* env) {
+    if (env->node_count < env->node_capacity) {
+        return 0;
+    }
+    uint32_t capacity = env->node_capacity ? env->node_capacity * 2 : 8;
+    uint32_t (*nodes)[SAFETY_TRIE_FANOUT] =
+        (uint32_t (*)[SAFETY_TRIE_FANOUT])realloc(env->nodes, (size_t)capacity * sizeof(*nodes));
+    if (nodes == NULL) {
+        return -1;
+    }
+    env->nodes = nodes;
+    env->node_capacity = capacity;
+    return 0;
+}
+
+safety_envelope_t* safety_envelope_create(void) {
+    safety_envelope_t* env = (safety_envelope_t*)calloc(1, sizeof(*env));
+    if (env == NULL) {
+        return NULL;
+    }
+    if (safety_trie_grow(env) != 0) {
+        free(env);
+        return NULL;
+    }
+    memset(env->nodes[0], 0, sizeof(env->nodes[0]));
+    env->node_count = 1;
+    return env;
+}
+
+int safety_envelope_allow(safety_envelope_t* env, uint32_t network, uint32_t prefix_len) {
+    if (env == NULL || prefix_len > 32) {
+        return -1;
+    }
+    
+    uint32_t host = ntohl(network);
+    uint32_t node = 0;
+    for (uint32_t level = 0; level < 4; level++) {
+        uint32_t shift = 24 - level * 8;
+        uint32_t index = (host >> shift) & 0xFF;
+    
+        if (prefix_len <= (level + 1) * 8) {
+            /* The prefix ends in this level: expand it over its entries */
+            uint32_t span = 1u << ((level + 1) * 8 - prefix_len);
+            index &= ~(span - 1);
+            for (uint32_t i = index; i < index + span; i++) {
+                env->nodes[node][i] = SAFETY_TRIE_ALLOW;
+            }
+            return 0;
+        }
+    
+        uint32_t entry = env->nodes[node][index];
+        if (entry == SAFETY_TRIE_ALLOW) {
+            return 0;  /* Already covered by a shorter prefix */
+        }
+        if (entry == 0) {
+            if (safety_trie_grow(env) != 0) {
+                return -1;
+            }
+            entry = env->node_count++;
+            memset(env->nodes[entry], 0, sizeof(env->nodes[entry]));
+            env->nodes[node][index] = entry;
+        }
+        node = entry;
+    }
+    return 0;
+}
+
+int safety_envelope_allow_cidr(safety_envelope_t* env, const char* cidr) {
+    if (env == NULL || cidr == NULL) {
+        return -1;
+    }
+    
+    unsigned a, b, c, d, len = 32;
+    int used = 0;
+    if (sscanf(cidr, "%u.%u.%u.%u%n", &a, &b, &c, &d, &used) != 4) {
+        return -1;
+    }
+    const char* rest = cidr + used;
+    if (*rest == '/') {
+        int tail = 0;
+        if (sscanf(rest + 1, "%u%n", &len, &tail) != 1 || rest[1 + tail] != '\0') {
+            return -1;
+        }
+    } else if (*rest != '\0') {
+        return -1;
+    }
+    if (a > 255 || b > 255 || c > 255 || d > 255 || len > 32) {
+        return -1;
+    }
+    
+    uint32_t host = ((uint32_t)a << 24) | ((uint32_t)b << 16) | ((uint32_t)c << 8) | (uint32_t)d;
+    return safety_envelope_allow(env, htonl(host), len);
+}
+
+int safety_envelope_set_ceiling(safety_envelope_t* env, uint64_t max_pps, uint64_t max_bps) {
+    if (env == NULL || (max_bps > 0 && max_bps < SAFETY_MIN_BPS)) {
+        return -1;
+    }
+    env->pkt_cost = max_pps ? (1000000000ULL << 16) / max_pps : 0;
+    env->byte_cost = max_bps ? (8000000000ULL << 16) / max_bps : 0;
+    /* Rates above 2^16 Gpps or Gbps round to a cost of 0; keep them bounded */
+    if (max_pps > 0 && env->pkt_cost == 0) {
+        env->pkt_cost = 1;
+    }
+    if (max_bps > 0 && env->byte_cost == 0) {
+        env->byte_cost = 1;
+    }
+    env->tolerance = SAFETY_BURST_NS << 16;
+    if (env->pkt_cost > env->tolerance) {
+        env->tolerance = env->pkt_cost;
+    }
+    return 0;
+}
+
+/* Returns the number of trie levels the match used (1-4), 0 if denied */
+static inline uint32_t safety_lookup(const safety_envelope_t* env, uint32_t dst_ip) {
+    const uint8_t* b = (const uint8_t*)&dst_ip;
+    uint32_t entry = env->nodes[0][b[0]];
+    uint32_t level = 1;
+    while (entry != SAFETY_TRIE_ALLOW) {
+        if (entry == 0 || level == 4) {
+            return 0;
+        }
+        entry = env->nodes[entry][b[level++]];
+    }
+    return level;
+}
+
+int safety_envelope_permits(const safety_envelope_t* env, uint32_t dst_ip) {
+    return env != NULL && safety_lookup(env, dst_ip) != 0;
+}
+
+/* Length of the allowed prefix of dst_ips. One vectorizable pass finds the
+ * bits all destinations share; when the first one matched within them the
+ * whole batch is allowed, and only mixed batches fall back to per-packet
+ * lookups. */
+static uint32_t safety_allowed_prefix(const safety_envelope_t* env, const uint32_t* dst_ips, uint32_t count) {
+    uint32_t levels = safety_lookup(env, dst_ips[0]);
+    if (levels == 0) {
+        return 0;
+    }
+    
+    uint32_t first = dst_ips[0];
+    uint32_t diff = 0;
+    for (uint32_t i = 1; i < count; i++) {
+        diff |= dst_ips[i] ^ first;
+    }
+    if ((ntohl(diff) >> (32 - levels * 8)) == 0) {
+        return count;
+    }
+    
+    for (uint32_t i = 1; i < count; i++) {
+        if (safety_lookup(env, dst_ips[i]) == 0) {
+            return i;
+        }
+    }
+    return count;
+}
+
+/* Largest prefix of count packets the ceiling admits now */
+static uint32_t safety_charge(safety_envelope_t* env, const uint32_t* lengths, uint32_t nlen, uint32_t count) {
+    if (env->pkt_cost == 0 && env->byte_cost == 0) {
+        return count;
+    }
+    
+    uint64_t now = get_timestamp_ns();
+    uint64_t tat = SAFETY_LOAD(&env->tat);
+    for (;;) {
+        uint64_t base = tat > now ? tat : now;
+        uint64_t ahead = (base - now) << 16;
+        if (ahead >= env->tolerance) {
+            return 0;
+        }
+        uint64_t budget = env->tolerance - ahead;
+    
+        uint32_t k = count;
+        if (env->pkt_cost > 0 && budget / env->pkt_cost < k) {
+            k = (uint32_t)(budget / env->pkt_cost);
+        }
+        uint64_t bytes = 0;
+        if (env->byte_cost > 0) {
+            uint64_t byte_budget = budget / env->byte_cost;
+            uint32_t i;
+            for (i = 0; i < k; i++) {
+                uint32_t len = lengths[nlen == 1 ? 0 : i];
+                if (bytes + len > byte_budget) {
+                    break;
+                }
+                bytes += len;
+            }
+            k = i;
+        }
+    
+        /* A packet costlier than the whole tolerance still goes out once
+         * the sender is fully caught up, and pays for it afterwards */
+        if (k == 0) {
+            if (base > now) {
+                return 0;
+            }
+            k = 1;
+            bytes = lengths[0] < SAFETY_MAX_PACKET ? lengths[0] : SAFETY_MAX_PACKET;
+        }
+    
+        uint64_t cost = (uint64_t)k * env->pkt_cost;
+        if (bytes * env->byte_cost > cost) {
+            cost = bytes * env->byte_cost;
+        }
+        uint64_t next = base + ((cost + 0xFFFF) >> 16);
+        if (SAFETY_CAS(&env->tat, tat, next)) {
+            return k;
+        }
+        tat = SAFETY_LOAD(&env->tat);
+    }
+}
+
+/* Allowlist, then ceiling, over contiguous destinations */
+static int safety_envelope_admit(safety_envelope_t* env, const uint32_t* dst_ips, uint32_t ndst,
+                                 const uint32_t* lengths, uint32_t nlen, uint32_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    
+    uint32_t allowed = ndst == 1 ? (safety_lookup(env, dst_ips[0]) ? count : 0) :
+                                   safety_allowed_prefix(env, dst_ips, count);
+    if (allowed == 0) {
+        SAFETY_FETCH_ADD(&env->denied, 1);
+        errno = EACCES;
+        return -1;
+    }
+    
+    uint32_t admitted = safety_charge(env, lengths, nlen, allowed);
+    if (admitted < allowed) {
+        SAFETY_FETCH_ADD(&env->throttled, 1);
+    }
+    SAFETY_FETCH_ADD(&env->admitted, admitted);
+    return (int)admitted;
+}
+
+int safety_envelope_get_stats(const safety_envelope_t* env, safety_stats_t* stats) {
+    if (env == NULL || stats == NULL) {
+        return -1;
+    }
+    stats->admitted = SAFETY_LOAD(&env->admitted);
+    stats->denied = SAFETY_LOAD(&env->denied);
+    stats->throttled = SAFETY_LOAD(&env->throttled);
+    return 0;
+}
+
+void safety_envelope_destroy(safety_envelope_t* env) {
+    if (env == NULL) {
+        return;
+    }
+    free(env->nodes);
+    free(env);
+}
+
+int safety_install(backend_type_t backend, safety_envelope_t* env) {
+    if (backend <= BACKEND_NONE || backend > BACKEND_DPDK) {
+        return -1;
+    }
+    SAFETY_STORE(&safety_table[backend], env);
+    return 0;
+}
+
+void safety_kill(void) {
+    SAFETY_STORE(&safety_killed, 1);
+}
+
+void safety_rearm(void) {
+    SAFETY_STORE(&safety_killed, 0);
+}
+
+int safety_is_killed(void) {
+    return SAFETY_LOAD(&safety_killed) != 0;
+}
+
+/* Fails with ECANCELED when killed; otherwise *env is the installed
+ * envelope, NULL when the backend is unrestricted */
+static inline int safety_gate(backend_type_t backend, safety_envelope_t** env) {
+    if (SAFETY_LOAD(&safety_killed)) {
+        errno = ECANCELED;
+        return -1;
+    }
+    *env = SAFETY_LOAD(&safety_table[backend]);
+    return 0;
+}
+
+static int safety_watches(backend_type_t backend) {
+    return SAFETY_LOAD(&safety_table[backend]) != NULL;
+}
+
+int safety_admit(backend_type_t backend, const uint32_t* dst_ips, uint32_t ndst,
+                 const uint32_t* lengths, uint32_t nlen, uint32_t count) {
+    if (backend <= BACKEND_NONE || backend > BACKEND_DPDK) {
+        return -1;
+    }
+    
+    safety_envelope_t* env;
+    if (safety_gate(backend, &env) != 0) {
+        return -1;
+    }
+    if (env == NULL) {
+        return (int)count;
+    }
+    if (dst_ips == NULL || lengths == NULL || ndst == 0 || nlen == 0) {
+        return -1;
+    }
+    return safety_envelope_admit(env, dst_ips, ndst, lengths, nlen, count);
+}
+
+/* Admit a batch's packets [first, first + count) by its socket destinations */
+static int safety_admit_batch(backend_type_t backend, const pkt_batch_t* batch, uint32_t first, uint32_t count) {
+    safety_envelope_t* env;
+    if (safety_gate(backend, &env) != 0) {
+        return -1;
+    }
+    if (env == NULL) {
+        return (int)count;
+    }
+    if (batch->dst_ips != NULL) {
+        return safety_envelope_admit(env, batch->dst_ips + first, count, batch->lengths + first, count, count);
+    }
+    return safety_envelope_admit(env, &batch->dst_ip, 1, batch->lengths + first, count, count);
+}
+
+/* Admit by sockaddr destinations: one per packet, or one shared */
+static int safety_admit_dests(backend_type_t backend, const struct sockaddr_in* dests, int same_dest,
+                              const uint32_t* lengths, uint32_t count) {
+    safety_envelope_t* env;
+    if (safety_gate(backend, &env) != 0) {
+        return -1;
+    }
+    if (env == NULL) {
+        return (int)count;
+    }
+    if (same_dest) {
+        uint32_t dst_ip = dests->sin_addr.s_addr;
+        return safety_envelope_admit(env, &dst_ip, 1, lengths, count, count);
+    }
+    
+    uint32_t dst_ips[SAFETY_GATHER];
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t n = count - done < SAFETY_GATHER ? count - done : SAFETY_GATHER;
+        for (uint32_t i = 0; i < n; i++) {
+            dst_ips[i] = dests[done + i].sin_addr.s_addr;
+        }
+        int admitted = safety_envelope_admit(env, dst_ips, n, lengths + done, n, n);
+        if (admitted < 0) {
+            return done > 0 ? (int)done : admitted;
+        }
+        done += (uint32_t)admitted;
+        if ((uint32_t)admitted < n) {
+            break;
+        }
+    }
+    return (int)done;
+}
+
+#if defined(HAS_DPDK) || defined(HAS_AF_XDP)
+
+/* IPv4 destination of an Ethernet frame, untagged or with one 802.1Q tag */
+static inline int frame_dst_ip(const uint8_t* frame, uint32_t len, uint32_t* dst_ip) {
+    uint32_t l2 = 14;
+    if (len < l2 + 20) {
+        return -1;
+    }
+    uint16_t ethertype = load_be16(frame + 12);
+    if (ethertype == 0x8100) {
+        l2 += 4;
+        if (len < l2 + 20) {
+            return -1;
+        }
+        ethertype = load_be16(frame + 16);
+    }
+    if (ethertype != 0x0800 || (frame[l2] >> 4) != 4) {
+        return -1;
+    }
+    memcpy(dst_ip, frame + l2 + 16, 4);
+    return 0;
+}
+
+/* Admit Ethernet frames src[first + i] with lengths[i] */
+static int safety_admit_frames(backend_type_t backend, const pkt_src_t* src, uint32_t first,
+                               const uint32_t* lengths, uint32_t count) {
+    safety_envelope_t* env;
+    if (safety_gate(backend, &env) != 0) {
+        return -1;
+    }
+    if (env == NULL) {
+        return (int)count;
+    }
+    
+    uint32_t dst_ips[SAFETY_GATHER];
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t n = count - done < SAFETY_GATHER ? count - done : SAFETY_GATHER;
+        uint32_t parsed;
+        for (parsed = 0; parsed < n; parsed++) {
+            uint32_t k = done + parsed;
+            if (frame_dst_ip(pkt_src_get(src, first + k), lengths[k], &dst_ips[parsed]) != 0) {
+                break;
+            }
+        }
+    
+        int admitted;
+        if (parsed == 0) {
+            SAFETY_FETCH_ADD(&env->denied, 1);
+            errno = EACCES;
+            admitted = -1;
+        } else {
+            admitted = safety_envelope_admit(env, dst_ips, parsed, lengths + done, parsed, parsed);
+        }
+        if (admitted < 0) {
+            return done > 0 ? (int)done : admitted;
+        }
+        done += (uint32_t)admitted;
+        if ((uint32_t)admitted < n) {
+            break;
+        }
+    }
+    return (int)done;
+}
+
+#endif /* HAS_DPDK || HAS_AF_XDP */
+
+/* ============================================================================
+ * Capture Tap
+ * ============================================================================ */
+
+#ifndef _WIN32
+
+#define TAP_MAX_RINGS 64
+#define TAP_DEFAULT_SNAPLEN 128
+#define TAP_MAX_SNAPLEN 65535
+#define TAP_DEFAULT_SLOTS 4096
+#define TAP_DEFAULT_DRAIN_US 1000
+#define TAP_WRITE_BUFFER (1u << 20)
+
+/* Capture slot header, followed by cap_len bytes of packet */
+typedef struct {
+    uint64_t ts_ns;
+    uint32_t orig_len;
+    uint16_t cap_len;
+    uint16_t dir;
+    uint32_t index;             /* Position in the batch while staged */
+    uint32_t reserved;
+} tap_slot_t;
+
+/*
+ * One producer, one consumer (the writer, under the tap lock). The producer
+ * stages copies past head and publishes the ones that were really sent;
+ * countdown is the 1-based position of the next sampled packet.
+ */
+struct tap_ring {
+    SHIM_CACHE_ALIGNED uint64_t head;
+    uint64_t tail_cache;
+    uint32_t countdown;
+    uint32_t staged;
+    uint64_t seen;
+    uint64_t captured;
+    uint64_t dropped;
+    SHIM_CACHE_ALIGNED uint64_t tail;
+    SHIM_CACHE_ALIGNED uint8_t* slots;
+    size_t size;
+    uint32_t mask;
+    uint32_t stride;
+    uint32_t snaplen;
+    uint32_t sample_every;
+    uint16_t linktype;
+    char name[32];
+};
+
+struct capture_tap {
+    capture_tap_config_t config;
+    FILE* file;
+    char* buffer;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    int stop;
+    int write_error;
+    uint32_t ring_count;
+    uint32_t described;         /* Rings with an IDB in the file */
+    uint64_t wall_offset_ns;    /* Realtime minus get_timestamp_ns() */
+    uint64_t written;
+    uint64_t bytes_written;
+    tap_ring_t* rings[TAP_MAX_RINGS];
+};
+
+static inline tap_slot_t* tap_slot(const tap_ring_t* ring, uint64_t pos) {
+    return (tap_slot_t*)(ring->slots + (size_t)(pos & ring->mask) * ring->stride);
+}
+
+/* Index of the first sampled packet of the next batch */
+static inline uint32_t tap_first(const tap_ring_t* ring) {
+    return ring->countdown - 1;
+}
+
+static inline void tap_begin(tap_ring_t* ring) {
+    ring->staged = 0;
+}
+
+/* Copy one sampled packet past head; a full ring leaves it out */
+static void tap_stage(tap_ring_t* ring, uint32_t index, const uint8_t* data, uint32_t len,
+                      uint32_t orig_len, uint16_t dir, uint64_t now) {
+    uint64_t pos = ring->head + ring->staged;
+    if (pos - ring->tail_cache > ring->mask) {
+        ring->tail_cache = SEQ_LOAD_ACQUIRE(&ring->tail);
+        if (pos - ring->tail_cache > ring->mask) {
+            return;
+        }
+    }
+    tap_slot_t* slot = tap_slot(ring, pos);
+    uint32_t cap = len < ring->snaplen ? len : ring->snaplen;
+    slot->ts_ns = now;
+    slot->orig_len = orig_len;
+    slot->cap_len = (uint16_t)cap;
+    slot->dir = dir;
+    slot->index = index;
+    memcpy(slot + 1, data, cap);
+    ring->staged++;
+}
+
+/* Publish the staged copies of the first done packets and move the sampling
+ * phase past them; sampled packets that found the ring full count as dropped */
+static void tap_commit(tap_ring_t* ring, uint32_t done) {
+    uint32_t keep = 0;
+    while (keep < ring->staged && tap_slot(ring, ring->head + keep)->index < done) {
+        keep++;
+    }
+    uint32_t every = ring->sample_every;
+    uint32_t next = ring->countdown;
+    uint64_t sampled = done >= next ? (done - next) / every + 1 : 0;
+    
+    STATS_ADD(&ring->seen, done);
+    STATS_ADD(&ring->captured, keep);
+    STATS_ADD(&ring->dropped, sampled - keep);
+    ring->countdown = (next - 1 + every - done % every) % every + 1;
+    ring->staged = 0;
+    if (keep > 0) {
+        SEQ_STORE_RELEASE(&ring->head, ring->head + keep);
+    }
+}
+
+static void tap_record_src(tap_ring_t* ring, const pkt_src_t* src, const uint32_t* lengths,
+                           uint32_t count, uint16_t dir) {
+    uint64_t now = get_timestamp_ns();
+    tap_begin(ring);
+    for (uint32_t i = tap_first(ring); i < count; i += ring->sample_every) {
+        tap_stage(ring, i, pkt_src_get(src, i), lengths[i], lengths[i], dir, now);
+    }
+    tap_commit(ring, count);
+}
+
+static void tap_record_descs(tap_ring_t* ring, const rx_desc_t* descs, uint32_t count) {
+    uint64_t now = get_timestamp_ns();
+    tap_begin(ring);
+    for (uint32_t i = tap_first(ring); i < count; i += ring->sample_every) {
+        tap_stage(ring, i, descs[i].data, descs[i].len, descs[i].len, TAP_DIR_RX, now);
+    }
+    tap_commit(ring, count);
+}
+
+static uint16_t tap_linktype(backend_layer_t layer) {
+    switch (layer) {
+        case BACKEND_LAYER_L2: return 1;       /* LINKTYPE_ETHERNET */
+        case BACKEND_LAYER_L3: return 228;     /* LINKTYPE_IPV4 */
+        default: return 147;                   /* LINKTYPE_USER0: bare payload */
+    }
+}
+
+static void tap_write(capture_tap_t* tap, const void* data, size_t len) {
+    if (fwrite(data, 1, len, tap->file) != len) {
+        tap->write_error = 1;
+    }
+    tap->bytes_written += len;
+}
+
+static void tap_write_u32(uint8_t* p, uint32_t v) {
+    memcpy(p, &v, 4);
+}
+
+/* Interface Description Block: linktype, snaplen, if_name, if_tsresol = 9 */
+static void tap_write_idb(capture_tap_t* tap, const tap_ring_t* ring) {
+    uint8_t block[96];
+    uint32_t name_len = (uint32_t)strlen(ring->name);
+    uint32_t name_pad = (name_len + 3) & ~3u;
+    uint32_t total = 16 + (name_len ? 4 + name_pad : 0) + 8 + 4 + 4;
+    memset(block, 0, sizeof(block));
+    tap_write_u32(block, 1);
+    tap_write_u32(block + 4, total);
+    memcpy(block + 8, &ring->linktype, 2);
+    tap_write_u32(block + 12, ring->snaplen);
+    uint32_t off = 16;
+    if (name_len) {
+        uint16_t opt[2] = {2, (uint16_t)name_len};
+        memcpy(block + off, opt, 4);
+        memcpy(block + off + 4, ring->name, name_len);
+        off += 4 + name_pad;
+    }
+    uint16_t tsresol[2] = {9, 1};
+    memcpy(block + off, tsresol, 4);
+    block[off + 4] = 9;
+    off += 8 + 4;               /* if_tsresol, opt_endofopt */
+    tap_write_u32(block + off, total);
+    tap_write(tap, block, total);
+}
+
+/* Enhanced Packet Block with epb_flags carrying the direction */
+static void tap_write_epb(capture_tap_t* tap, uint32_t if_id, const tap_slot_t* slot) {
+    uint8_t head[28];
+    uint8_t tail[20];
+    uint32_t pad = ((uint32_t)slot->cap_len + 3) & ~3u;
+    uint32_t total = 28 + pad + 12 + 4;
+    uint64_t ts = slot->ts_ns + tap->wall_offset_ns;
+    tap_write_u32(head, 6);
+    tap_write_u32(head + 4, total);
+    tap_write_u32(head + 8, if_id);
+    tap_write_u32(head + 12, (uint32_t)(ts >> 32));
+    tap_write_u32(head + 16, (uint32_t)ts);
+    tap_write_u32(head + 20, slot->cap_len);
+    tap_write_u32(head + 24, slot->orig_len);
+    tap_write(tap, head, sizeof(head));
+    tap_write(tap, slot + 1, slot->cap_len);
+    
+    memset(tail, 0, sizeof(tail));
+    uint16_t opt[2] = {2, 4};
+    memcpy(tail + (pad - slot->cap_len), opt, 4);
+    tap_write_u32(tail + (pad - slot->cap_len) + 4, slot->dir == TAP_DIR_RX ? 1 : 2);
+    tap_write_u32(tail + (pad - slot->cap_len) + 12, total);
+    tap_write(tap, tail, (pad - slot->cap_len) + 16);
+}
+
+/* Caller holds the tap lock; returns the number of packets written */
+static uint64_t tap_drain(capture_tap_t* tap) {
+    uint64_t total = 0;
+    for (uint32_t r = 0; r < tap->ring_count; r++) {
+        tap_ring_t* ring = tap->rings[r];
+        if (r >= tap->described) {
+            tap_write_idb(tap, ring);
+            tap->described = r + 1;
+        }
+        uint64_t tail = ring->tail;
+        uint64_t head = SEQ_LOAD_ACQUIRE(&ring->head);
+        for (; tail != head; tail++) {
+            tap_write_epb(tap, r, tap_slot(ring, tail));
+        }
+        total += head - ring->tail;
+        SEQ_STORE_RELEASE(&ring->tail, tail);
+    }
+    tap->written += total;
+    return total;
+}
+
+/* Drains until stopped, idling on the condition variable so destroy does not
+ * wait out a long interval */
+static void* capture_tap_thread(void* arg) {
+    capture_tap_t* tap = (capture_tap_t*)arg;
+    pthread_mutex_lock(&tap->lock);
+    while (!tap->stop) {
+        if (tap_drain(tap) > 0) {
+            pthread_mutex_unlock(&tap->lock);
+            pthread_mutex_lock(&tap->lock);
+            continue;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        uint64_t ns = (uint64_t)deadline.tv_nsec + (uint64_t)tap->config.drain_interval_us * 1000;
+        deadline.tv_sec += (time_t)(ns / 1000000000ULL);
+        deadline.tv_nsec = (long)(ns % 1000000000ULL);
+        pthread_cond_timedwait(&tap->wake, &tap->lock, &deadline);
+    }
+    pthread_mutex_unlock(&tap->lock);
+    return NULL;
+}
+
+void capture_tap_config_init(capture_tap_config_t* config) {
+    if (config == NULL) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->sample_every = 1;
+    config->snaplen = TAP_DEFAULT_SNAPLEN;
+    config->ring_slots = TAP_DEFAULT_SLOTS;
+    config->drain_interval_us = TAP_DEFAULT_DRAIN_US;
+}
+
+capture_tap_t* capture_tap_create(const char* path, const capture_tap_config_t* config) {
+    if (path == NULL) {
+        return NULL;
+    }
+    
+    capture_tap_t* tap = (capture_tap_t*)calloc(1, sizeof(*tap));
+    if (tap == NULL) {
+        return NULL;
+    }
+    capture_tap_config_init(&tap->config);
+    if (config != NULL) {
+        if (config->sample_every) {
+            tap->config.sample_every = config->sample_every;
+        }
+        if (config->snaplen) {
+            tap->config.snaplen = config->snaplen > TAP_MAX_SNAPLEN ? TAP_MAX_SNAPLEN : config->snaplen;
+        }
+        if (config->ring_slots) {
+            tap->config.ring_slots = config->ring_slots;
+        }
+        if (config->drain_interval_us) {
+            tap->config.drain_interval_us = config->drain_interval_us;
+        }
+    }
+    uint32_t slots = 1;
+    while (slots < tap->config.ring_slots && slots < (1u << 24)) {
+        slots <<= 1;
+    }
+    tap->config.ring_slots = slots;
+    
+    tap->file = fopen(path, "wb");
+    tap->buffer = (char*)malloc(TAP_WRITE_BUFFER);
+    if (tap->file == NULL || tap->buffer == NULL) {
+        if (tap->file != NULL) {
+            fclose(tap->file);
+        }
+        free(tap->buffer);
+        free(tap);
+        return NULL;
+    }
+    setvbuf(tap->file, tap->buffer, _IOFBF, TAP_WRITE_BUFFER);
+    
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    tap->wall_offset_ns = (uint64_t)wall.tv_sec * 1000000000ULL + (uint64_t)wall.tv_nsec -
+                          get_timestamp_ns();
+    
+    /* Section Header Block, version 1.0, unknown section length */
+    uint8_t shb[28];
+    uint16_t version[2] = {1, 0};
+    tap_write_u32(shb, 0x0A0D0D0A);
+    tap_write_u32(shb + 4, sizeof(shb));
+    tap_write_u32(shb + 8, 0x1A2B3C4D);
+    memcpy(shb + 12, version, 4);
+    memset(shb + 16, 0xFF, 8);
+    tap_write_u32(shb + 24, sizeof(shb));
+    tap_write(tap, shb, sizeof(shb));
+    
+    pthread_mutex_init(&tap->lock, NULL);
+    pthread_cond_init(&tap->wake, NULL);
+    if (pthread_create(&tap->thread, NULL, capture_tap_thread, tap) != 0) {
+        pthread_cond_destroy(&tap->wake);
+        pthread_mutex_destroy(&tap->lock);
+        fclose(tap->file);
+        free(tap->buffer);
+        free(tap);
+        return NULL;
+    }
+    return tap;
+}
+
+tap_ring_t* capture_tap_add_ring(capture_tap_t* tap, backend_layer_t layer, const char* name,
+                                 int numa_node) {
+    if (tap == NULL) {
+        return NULL;
+    }
+    
+    uint32_t slots = tap->config.ring_slots;
+    uint32_t stride = (uint32_t)((sizeof(tap_slot_t) + tap->config.snaplen + 63) & ~(size_t)63);
+    size_t header = (sizeof(tap_ring_t) + 63) & ~(size_t)63;
+    size_t size = header + (size_t)slots * stride;
+    
+    pthread_mutex_lock(&tap->lock);
+    tap_ring_t* ring = NULL;
+    if (tap->ring_count < TAP_MAX_RINGS) {
+        ring = (tap_ring_t*)alloc_numa_memory(size, numa_node);
+    }
+    if (ring != NULL) {
+        ring->slots = (uint8_t*)ring + header;
+        ring->size = size;
+        ring->mask = slots - 1;
+        ring->stride = stride;
+        ring->snaplen = tap->config.snaplen;
+        ring->sample_every = tap->config.sample_every;
+        ring->countdown = 1;
+        ring->linktype = tap_linktype(layer);
+        if (name != NULL) {
+            snprintf(ring->name, sizeof(ring->name), "%s", name);
+        }
+        tap->rings[tap->ring_count++] = ring;
+    }
+    pthread_mutex_unlock(&tap->lock);
+    return ring;
+}
+
+int tap_ring_record(tap_ring_t* ring, const uint8_t** packets, const uint32_t* lengths,
+                    uint32_t count, tap_direction_t dir) {
+    if (ring == NULL || packets == NULL || lengths == NULL) {
+        return -1;
+    }
+    uint64_t before = ring->captured;
+    pkt_src_t src = {packets, NULL, NULL};
+    tap_record_src(ring, &src, lengths, count, (uint16_t)dir);
+    return (int)(ring->captured - before);
+}
+
+int capture_tap_flush(capture_tap_t* tap) {
+    if (tap == NULL) {
+        return -1;
+    }
+    pthread_mutex_lock(&tap->lock);
+    tap_drain(tap);
+    if (fflush(tap->file) != 0) {
+        tap->write_error = 1;
+    }
+    int ret = tap->write_error ? -1 : 0;
+    pthread_mutex_unlock(&tap->lock);
+    return ret;
+}
+
+int capture_tap_get_stats(capture_tap_t* tap, capture_tap_stats_t* stats) {
+    if (tap == NULL || stats == NULL) {
+        return -1;
+    }
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&tap->lock);
+    for (uint32_t r = 0; r < tap->ring_count; r++) {
+        stats->seen += STATS_LOAD(&tap->rings[r]->seen);
+        stats->captured += STATS_LOAD(&tap->rings[r]->captured);
+        stats->dropped += STATS_LOAD(&tap->rings[r]->dropped);
+    }
+    stats->written = tap->written;
+    stats->bytes_written = tap->bytes_written;
+    pthread_mutex_unlock(&tap->lock);
+    return 0;
+}
+
+void capture_tap_destroy(capture_tap_t* tap) {
+    if (tap == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&tap->lock);
+    tap->stop = 1;
+    pthread_cond_signal(&tap->wake);
+    pthread_mutex_unlock(&tap->lock);
+    pthread_join(tap->thread, NULL);
+    tap_drain(tap);
+    fclose(tap->file);
+    free(tap->buffer);
+    for (uint32_t r = 0; r < tap->ring_count; r++) {
+        free_numa_memory(tap->rings[r], tap->rings[r]->size);
+    }
+    pthread_cond_destroy(&tap->wake);
+    pthread_mutex_destroy(&tap->lock);
+    free(tap);
+}
+
+#else
+
+/* The writer thread and ring atomics are POSIX only; rings never exist on
+ * Windows, so the hooks below are never reached */
+static void tap_record_src(tap_ring_t* ring, const pkt_src_t* src, const uint32_t* lengths,
+                           uint32_t count, uint16_t dir) {
+    (void)ring; (void)src; (void)lengths; (void)count; (void)dir;
+}
+
+static void tap_record_descs(tap_ring_t* ring, const rx_desc_t* descs, uint32_t count) {
+    (void)ring; (void)descs; (void)count;
+}
+
+void capture_tap_config_init(capture_tap_config_t* config) {
+    if (config != NULL) {
+        memset(config, 0, sizeof(*config));
+    }
+}
+
+capture_tap_t* capture_tap_create(const char* path, const capture_tap_config_t* config) {
+    (void)path;
+    (void)config;
+    return NULL;
+}
+
+tap_ring_t* capture_tap_add_ring(capture_tap_t* tap, backend_layer_t layer, const char* name,
+                                 int numa_node) {
+    (void)tap; (void)layer; (void)name; (void)numa_node;
+    return NULL;
+}
+
+int tap_ring_record(tap_ring_t* ring, const uint8_t** packets, const uint32_t* lengths,
+                    uint32_t count, tap_direction_t dir) {
+    (void)ring; (void)packets; (void)lengths; (void)count; (void)dir;
+    return -1;
+}
+
+int capture_tap_flush(capture_tap_t* tap) {
+    (void)tap;
+    return -1;
+}
+
+int capture_tap_get_stats(capture_tap_t* tap, capture_tap_stats_t* stats) {
+    (void)tap;
+    (void)stats;
+    return -1;
+}
+
+void capture_tap_destroy(capture_tap_t* tap) {
+    (void)tap;
+}
+
+#endif /* _WIN32 */
+
+/* ============================================================================
+ * DPDK Implementation (when available)
+ * ============================================================================ */
+
+#ifdef HAS_DPDK
+
+#include <rte_eal.h>
+#include <rte_ethdev.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#define DPDK_POOL_SIZE 8192
+#define DPDK_DEFAULT_RING_SIZE 1024
+#define DPDK_MAX_BURST 1024
+
+/* Default pool on the main lcore's socket, plus one pool per NUMA node
+ * that hosts a port. Pools are only created from the control path. */
+static struct rte_mempool* mbuf_pool = NULL;
+static struct rte_mempool* socket_pools[RTE_MAX_NUMA_NODES];
+static int dpdk_initialized = 0;
+
+/* Queue pairs configured per port; 0 means the port is not started */
+static uint16_t dpdk_port_queues[RTE_MAX_ETHPORTS];
+/* Pool local to each port's NIC */
+static struct rte_mempool* dpdk_port_pools[RTE_MAX_ETHPORTS];
+/* OFFLOAD_* flags negotiated per port */
+static uint32_t dpdk_port_offloads[RTE_MAX_ETHPORTS];
+/* Optional per-queue pacer, latency probe, capture taps, stage counters,
+ * RX stats block, mbufs held for TX retry and the burst last handed out by
+ * dpdk_recv_burst_queue(); allocated on first use */
+typedef struct {
+    pacer_t* pacer;
+    latency_probe_t* probe;
+    driver_stats_block_t* rx_stats;
+    tap_ring_t* tx_tap;
+    tap_ring_t* rx_tap;
+    stage_stats_t stages;
+    int tx_hold;
+    uint16_t tx_held_count;
+    uint16_t rx_held_count;
+    struct rte_mbuf* tx_held[DPDK_MAX_BURST];
+    struct rte_mbuf* rx_held[DPDK_MAX_BURST];
+} dpdk_queue_hooks_t;
+static dpdk_queue_hooks_t* dpdk_queue_hooks[RTE_MAX_ETHPORTS];
+
+#define OFFLOAD_CKSUM_MASK (OFFLOAD_IPV4_CKSUM | OFFLOAD_UDP_CKSUM | OFFLOAD_TCP_CKSUM)
+
+static const struct {
+    uint32_t flag;
+    uint64_t dpdk;
+} dpdk_offload_map[] = {
+    { OFFLOAD_IPV4_CKSUM, RTE_ETH_TX_OFFLOAD_IPV4_CKSUM },
+    { OFFLOAD_UDP_CKSUM, RTE_ETH_TX_OFFLOAD_UDP_CKSUM },
+    { OFFLOAD_TCP_CKSUM, RTE_ETH_TX_OFFLOAD_TCP_CKSUM },
+    { OFFLOAD_TCP_TSO, RTE_ETH_TX_OFFLOAD_TCP_TSO },
+};
+
+static struct rte_mempool* dpdk_socket_pool(int socket_id) {
+    if (socket_id < 0 || socket_id >= RTE_MAX_NUMA_NODES) {
+        return mbuf_pool;
+    }
+    if (socket_pools[socket_id] == NULL) {
+        char name[RTE_MEMPOOL_NAMESIZE];
+        snprintf(name, sizeof(name), "MBUF_POOL_%d", socket_id);
+        socket_pools[socket_id] = rte_pktmbuf_pool_create(name, DPDK_POOL_SIZE,
+                                                          256, 0, RTE_MBUF_DEFAULT_BUF_SIZE,
+                                                          socket_id);
+    }
+    return socket_pools[socket_id];
+}
+
+static inline struct rte_mempool* dpdk_port_pool(int port_id) {
+    struct rte_mempool* pool = dpdk_port_pools[port_id];
+    return pool != NULL ? pool : mbuf_pool;
+}
+
+static void dpdk_free_queue_hooks(int port_id) {
+    if (dpdk_queue_hooks[port_id] == NULL) {
+        return;
+    }
+    for (uint16_t q = 0; q < dpdk_port_queues[port_id]; q++) {
+        dpdk_queue_hooks_t* hooks = &dpdk_queue_hooks[port_id][q];
+        pacer_destroy(hooks->pacer);
+        stats_block_destroy(hooks->rx_stats);
+        if (hooks->tx_held_count > 0) {
+            rte_pktmbuf_free_bulk(hooks->tx_held, hooks->tx_held_count);
+        }
+        if (hooks->rx_held_count > 0) {
+            rte_pktmbuf_free_bulk(hooks->rx_held, hooks->rx_held_count);
+        }
+    }
+    free(dpdk_queue_hooks[port_id]);
+    dpdk_queue_hooks[port_id] = NULL;
+}
+
+int dpdk_init(int argc, char** argv) {
+    int ret = rte_eal_init(argc, argv);
+    if (ret < 0) {
+        return -1;
+    }
+    
+    /* Create mbuf pool */
+    int socket_id = (int)rte_socket_id();
+    if (socket_id < 0 || socket_id >= RTE_MAX_NUMA_NODES) {
+        mbuf_pool = rte_pktmbuf_pool_create("MBUF_POOL", DPDK_POOL_SIZE,
+                                             256, 0, RTE_MBUF_DEFAULT_BUF_SIZE,
+                                             SOCKET_ID_ANY);
+    } else {
+        mbuf_pool = dpdk_socket_pool(socket_id);
+    }
+    if (mbuf_pool == NULL) {
+        return -1;
+    }
+    
+    dpdk_initialized = 1;
+    return ret;
+}
+
+int init_dpdk_port_config(const driver_config_t* config) {
+    if (!dpdk_initialized || config == NULL) {
+        return -1;
+    }
+    if (config->num_queues > UINT16_MAX || config->ring_size > UINT16_MAX) {
+        return -1;
+    }
+    
+    uint16_t port_id = config->port_id;
+    if (!rte_eth_dev_is_valid_port(port_id)) {
+        return -1;
+    }
+    
+    struct rte_eth_conf port_conf;
+    struct rte_eth_dev_info dev_info;
+    memset(&port_conf, 0, sizeof(port_conf));
+    
+    int ret = rte_eth_dev_info_get(port_id, &dev_info);
+    if (ret != 0) {
+        return ret;
+    }
+    
+    /* Clamp requested queue pairs to what the device supports */
+    uint16_t nb_queues = config->num_queues > 0 ? (uint16_t)config->num_queues : 1;
+    if (nb_queues > dev_info.max_tx_queues) {
+        nb_queues = dev_info.max_tx_queues;
+    }
+    if (nb_queues > dev_info.max_rx_queues) {
+        nb_queues = dev_info.max_rx_queues;
+    }
+    if (nb_queues == 0) {
+        return -1;
+    }
+    
+    /* Spread RX across queues with RSS when more than one is used */
+    if (nb_queues > 1) {
+        uint64_t rss_hf = RTE_ETH_RSS_IP | RTE_ETH_RSS_UDP | RTE_ETH_RSS_TCP;
+        port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+        port_conf.rx_adv_conf.rss_conf.rss_key = NULL;
+        port_conf.rx_adv_conf.rss_conf.rss_hf = rss_hf & dev_info.flow_type_rss_offloads;
+    }
+    
+    /* Enable the requested TX offloads the NIC actually has */
+    uint32_t wanted = config->tx_offloads ? config->tx_offloads : OFFLOAD_ALL;
+    uint32_t enabled = 0;
+    for (size_t i = 0; i < sizeof(dpdk_offload_map) / sizeof(dpdk_offload_map[0]); i++) {
+        if ((wanted & dpdk_offload_map[i].flag) &&
+            (dev_info.tx_offload_capa & dpdk_offload_map[i].dpdk)) {
+            port_conf.txmode.offloads |= dpdk_offload_map[i].dpdk;
+            enabled |= dpdk_offload_map[i].flag;
+        }
+    }
+    
+    /* Configure port */
+    ret = rte_eth_dev_configure(port_id, nb_queues, nb_queues, &port_conf);
+    if (ret != 0) {
+        return ret;
+    }
+    
+    uint16_t nb_rxd = config->ring_size > 0 ? (uint16_t)config->ring_size : DPDK_DEFAULT_RING_SIZE;
+    uint16_t nb_txd = nb_rxd;
+    ret = rte_eth_dev_adjust_nb_rx_tx_desc(port_id, &nb_rxd, &nb_txd);
+    if (ret != 0) {
+        return ret;
+    }
+    
+    /* Place descriptor rings and mbufs on the NIC's NUMA node */
+    int socket_id = rte_eth_dev_socket_id(port_id);
+    struct rte_mempool* pool = dpdk_socket_pool(socket_id);
+    if (pool == NULL) {
+        return -1;
+    }
+    
+    /* Setup one RX/TX queue pair per worker */
+    for (uint16_t q = 0; q < nb_queues; q++) {
+        ret = rte_eth_rx_queue_setup(port_id, q, nb_rxd, socket_id, NULL, pool);
+        if (ret < 0) {
+            return ret;
+        }
+        
+        ret = rte_eth_tx_queue_setup(port_id, q, nb_txd, socket_id, NULL);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    
+    /* Start port */
+    ret = rte_eth_dev_start(port_id);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    if (config->promiscuous) {
+        rte_eth_promiscuous_enable(port_id);
+    }
+    
+    dpdk_free_queue_hooks(port_id);
+    dpdk_port_pools[port_id] = pool;
+    dpdk_port_queues[port_id] = nb_queues;
+    dpdk_port_offloads[port_id] = enabled;
+    return nb_queues;
+}
+
+int init_dpdk_port(int port_id) {
+    driver_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.port_id = (uint16_t)port_id;
+    config.num_queues = 1;
+    config.ring_size = DPDK_DEFAULT_RING_SIZE;
+    config.promiscuous = 1;
+    
+    int ret = init_dpdk_port_config(&config);
+    return ret < 0 ? ret : 0;
+}
+
+int dpdk_get_queue_count(int port_id) {
+    if (port_id < 0 || port_id >= RTE_MAX_ETHPORTS) {
+        return 0;
+    }
+    return dpdk_port_queues[port_id];
+}
+
+int dpdk_get_port_numa_node(int port_id) {
+    if (port_id < 0 || port_id >= RTE_MAX_ETHPORTS || dpdk_port_queues[port_id] == 0) {
+        return -1;
+    }
+    return dpdk_port_pool(port_id)->socket_id;
+}
+
+uint32_t dpdk_get_tx_offloads(int port_id) {
+    if (port_id < 0 || port_id >= RTE_MAX_ETHPORTS || dpdk_port_queues[port_id] == 0) {
+        return 0;
+    }
+    return dpdk_port_offloads[port_id];
+}
+
+int dpdk_tx_offload_prepare(int port_id, uint16_t queue_id, struct rte_mbuf** mbufs,
+                            uint32_t count, uint16_t tso_segsz) {
+    if (!dpdk_initialized || mbufs == NULL) {
+        return -1;
+    }
+    if (port_id < 0 || port_id >= RTE_MAX_ETHPORTS || queue_id >= dpdk_port_queues[port_id]) {
+        return -1;
+    }
+    
+    uint32_t offloads = dpdk_port_offloads[port_id];
+    if (offloads == 0 || count == 0) {
+        return (int)count;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        struct rte_mbuf* m = mbufs[i];
+        frame_layout_t layout;
+        if (parse_frame_layout(rte_pktmbuf_mtod(m, const uint8_t*), m->data_len, &layout) != 0) {
+            continue;
+        }
+        
+        uint64_t flags = 0;
+        if (offloads & OFFLOAD_IPV4_CKSUM) {
+            flags |= RTE_MBUF_F_TX_IP_CKSUM;
+        }
+        if (layout.proto == IPPROTO_TCP) {
+            uint32_t headers = (uint32_t)layout.l2_len + layout.l3_len + layout.l4_len;
+            if (tso_segsz > 0 && (offloads & OFFLOAD_TCP_TSO) && m->pkt_len > headers + tso_segsz) {
+                flags |= RTE_MBUF_F_TX_TCP_SEG;
+                m->tso_segsz = tso_segsz;
+            } else if (offloads & OFFLOAD_TCP_CKSUM) {
+                flags |= RTE_MBUF_F_TX_TCP_CKSUM;
+            }
+        } else if (offloads & OFFLOAD_UDP_CKSUM) {
+            flags |= RTE_MBUF_F_TX_UDP_CKSUM;
+        }
+        if (flags == 0) {
+            continue;
+        }
+        
+        m->l2_len = layout.l2_len;
+        m->l3_len = layout.l3_len;
+        m->l4_len = layout.l4_len;
+        m->ol_flags |= flags | RTE_MBUF_F_TX_IPV4;
+    }
+    
+    /* Driver-specific fixups: pseudo-header sums, zeroed IP checksum */
+    return rte_eth_tx_prepare((uint16_t)port_id, queue_id, mbufs, (uint16_t)count);
+}
+
+static dpdk_queue_hooks_t* dpdk_get_queue_hooks(int port_id, uint16_t queue_id) {
+    if (!dpdk_initialized || port_id < 0 || port_id >= RTE_MAX_ETHPORTS ||
+        queue_id >= dpdk_port_queues[port_id]) {
+        return NULL;
+    }
+    if (dpdk_queue_hooks[port_id] == NULL) {
+        dpdk_queue_hooks[port_id] = (dpdk_queue_hooks_t*)calloc(dpdk_port_queues[port_id],
+                                                                sizeof(dpdk_queue_hooks_t));
+        if (dpdk_queue_hooks[port_id] == NULL) {
+            return NULL;
+        }
+    }
+    return &dpdk_queue_hooks[port_id][queue_id];
+}
+
+/* RX counters go to a stats block claimed on the queue's first receive,
+ * so they show up in driver_stats_snapshot() like AF_XDP's */
+static void dpdk_queue_count_rx(dpdk_queue_hooks_t* hooks, uint64_t packets, uint64_t bytes) {
+    if (hooks->rx_stats == NULL) {
+        hooks->rx_stats = stats_block_create();
+        if (hooks->rx_stats == NULL) {
+            return;
+        }
+    }
+    stats_block_add_rx(hooks->rx_stats, packets, bytes);
+}
+
+/* Only referenced by STAGE_BEGIN, so unused in builds without stage counters */
+static inline stage_stats_t* dpdk_queue_stages(int port_id, uint16_t queue_id) {
+    dpdk_queue_hooks_t* hooks = dpdk_get_queue_hooks(port_id, queue_id);
+    return hooks ? &hooks->stages : NULL;
+}
+
+int dpdk_get_queue_stages(int port_id, uint16_t queue_id, stage_stats_t* stages) {
+    if (stages == NULL || !dpdk_initialized || port_id < 0 || port_id >= RTE_MAX_ETHPORTS ||
+        queue_id >= dpdk_port_queues[port_id]) {
+        return -1;
+    }
+    /* Never sent on: no hooks allocated, nothing charged */
+    if (dpdk_queue_hooks[port_id] == NULL) {
+        memset(stages, 0, sizeof(*stages));
+        return 0;
+    }
+    stages_load(&dpdk_queue_hooks[port_id][queue_id].stages, stages);
+    return 0;
+}
+
+int dpdk_set_queue_rate(int port_id, uint16_t queue_id, uint64_t rate_pps,
+                        uint64_t rate_bps, uint32_t burst) {
+    dpdk_queue_hooks_t* hooks = dpdk_get_queue_hooks(port_id, queue_id);
+    if (hooks == NULL) {
+        return -1;
+    }
+    
+    if (rate_pps == 0 && rate_bps == 0) {
+        pacer_destroy(hooks->pacer);
+        hooks->pacer = NULL;
+        return 0;
+    }
+    if (hooks->pacer != NULL) {
+        return pacer_set_rate(hooks->pacer, rate_pps, rate_bps, burst);
+    }
+    hooks->pacer = pacer_create(rate_pps, rate_bps, burst);
+    return hooks->pacer != NULL ? 0 : -1;
+}
+
+int dpdk_set_queue_latency_probe(int port_id, uint16_t queue_id, latency_probe_t* probe) {
+    dpdk_queue_hooks_t* hooks = dpdk_get_queue_hooks(port_id, queue_id);
+    if (hooks == NULL) {
+        return -1;
+    }
+    hooks->probe = probe;
+    return 0;
+}
+
+int dpdk_set_queue_tx_hold(int port_id, uint16_t queue_id, int enable) {
+    dpdk_queue_hooks_t* hooks = dpdk_get_queue_hooks(port_id, queue_id);
+    if (hooks == NULL) {
+        return -1;
+    }
+    if (!enable && hooks->tx_held_count > 0) {
+        rte_pktmbuf_free_bulk(hooks->tx_held, hooks->tx_held_count);
+        hooks->tx_held_count = 0;
+    }
+    hooks->tx_hold = enable != 0;
+    return 0;
+}
+
+int dpdk_get_queue_tx_held(int port_id, uint16_t queue_id) {
+    if (!dpdk_initialized || port_id < 0 || port_id >= RTE_MAX_ETHPORTS ||
+        queue_id >= dpdk_port_queues[port_id]) {
+        return -1;
+    }
+    if (dpdk_queue_hooks[port_id] == NULL) {
+        return 0;
+    }
+    return dpdk_queue_hooks[port_id][queue_id].tx_held_count;
+}
+
+int dpdk_set_queue_tap(int port_id, uint16_t queue_id, tap_ring_t* tx_ring, tap_ring_t* rx_ring) {
+    dpdk_queue_hooks_t* hooks = dpdk_get_queue_hooks(port_id, queue_id);
+    if (hooks == NULL) {
+        return -1;
+    }
+    hooks->tx_tap = tx_ring;
+    hooks->rx_tap = rx_ring;
+    return 0;
+}
+
+/* The mbufs belong to the driver once sent, so copies are staged before the
+ * burst and only those of accepted mbufs are published */
+static uint16_t dpdk_tx_burst_tap(tap_ring_t* ring, int port_id, uint16_t queue_id,
+                                  struct rte_mbuf** mbufs, uint32_t count) {
+    if (ring == NULL) {
+        return rte_eth_tx_burst((uint16_t)port_id, queue_id, mbufs, (uint16_t)count);
+    }
+    uint64_t now = get_timestamp_ns();
+    tap_begin(ring);
+    for (uint32_t i = tap_first(ring); i < count; i += ring->sample_every) {
+        struct rte_mbuf* m = mbufs[i];
+        tap_stage(ring, i, rte_pktmbuf_mtod(m, const uint8_t*), m->data_len, m->pkt_len, TAP_DIR_TX, now);
+    }
+    uint16_t sent = rte_eth_tx_burst((uint16_t)port_id, queue_id, mbufs, (uint16_t)count);
+    tap_commit(ring, sent);
+    return sent;
+}
+
+/* Stamp right before the burst so pacing waits do not count as latency.
+ * Offloaded L4 checksums are left to the NIC; shared mbufs are skipped. */
+static void dpdk_probe_stamp(latency_probe_t* probe, struct rte_mbuf** mbufs, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        struct rte_mbuf* m = mbufs[i];
+        if (rte_mbuf_refcnt_read(m) > 1) {
+            continue;
+        }
+        int fix_csum = (m->ol_flags & (RTE_MBUF_F_TX_L4_MASK | RTE_MBUF_F_TX_TCP_SEG)) == 0;
+        probe_stamp(probe, rte_pktmbuf_mtod(m, uint8_t*), m->data_len, fix_csum);
+    }
+}
+
+/* Give back the seqs stamped into mbufs a burst refused, so the probe only
+ * counts what went out; a refused mbuf sent again is stamped afresh */
+static void dpdk_probe_unstamp(latency_probe_t* probe, struct rte_mbuf** mbufs, uint32_t count) {
+    uint64_t stamped = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        struct rte_mbuf* m = mbufs[i];
+        frame_layout_t layout;
+        uint32_t offset;
+        if (rte_mbuf_refcnt_read(m) <= 1 &&
+            probe_locate(probe, rte_pktmbuf_mtod(m, uint8_t*), m->data_len, &layout, &offset) == 0) {
+            stamped++;
+        }
+    }
+    if (stamped > 0) {
+        STATS_STORE(&probe->sent, probe->sent - stamped);
+    }
+}
+
+/* rte_eth_tx_burst() through the queue's hooks: one pacer slot per burst,
+ * latency stamps and tap copies just before each burst. At most
+ * DPDK_MAX_BURST mbufs go out per call, so the count fits a uint16_t. */
+static uint16_t dpdk_tx_burst_hooked(int port_id, uint16_t queue_id,
+                                     struct rte_mbuf** mbufs, uint32_t count) {
+    if (count > DPDK_MAX_BURST) {
+        count = DPDK_MAX_BURST;
+    }
+    dpdk_queue_hooks_t* hooks = dpdk_queue_hooks[port_id] ? &dpdk_queue_hooks[port_id][queue_id] : NULL;
+    if (hooks == NULL || (hooks->pacer == NULL && hooks->probe == NULL && hooks->tx_tap == NULL)) {
+        return rte_eth_tx_burst((uint16_t)port_id, queue_id, mbufs, (uint16_t)count);
+    }
+    if (hooks->pacer == NULL) {
+        if (hooks->probe == NULL) {
+            return dpdk_tx_burst_tap(hooks->tx_tap, port_id, queue_id, mbufs, count);
+        }
+        dpdk_probe_stamp(hooks->probe, mbufs, count);
+        uint16_t sent = dpdk_tx_burst_tap(hooks->tx_tap, port_id, queue_id, mbufs, count);
+        if (sent < count) {
+            dpdk_probe_unstamp(hooks->probe, &mbufs[sent], count - sent);
+        }
+        return sent;
+    }
+    
+    pacer_t* pacer = hooks->pacer;
+    uint32_t burst = pacer_burst(pacer);
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t n = count - done < burst ? count - done : burst;
+        pacer_wait(pacer);
+        if (hooks->probe != NULL) {
+            dpdk_probe_stamp(hooks->probe, &mbufs[done], n);
+        }
+        
+        uint16_t sent = dpdk_tx_burst_tap(hooks->tx_tap, port_id, queue_id, &mbufs[done], n);
+        if (hooks->probe != NULL && sent < n) {
+            dpdk_probe_unstamp(hooks->probe, &mbufs[done + sent], n - sent);
+        }
+        uint64_t bytes = 0;
+        for (uint16_t i = 0; i < sent; i++) {
+            bytes += mbufs[done + i]->pkt_len;
+        }
+        pacer_charge(pacer, sent, bytes);
+        done += sent;
+        if (sent < n) {
+            break;
+        }
+    }
+    
+    return (uint16_t)done;
+}
+
+/* Safety envelope admission for caller-filled mbufs */
+static int dpdk_safety_admit_mbufs(struct rte_mbuf** mbufs, uint32_t count) {
+    safety_envelope_t* env;
+    if (safety_gate(BACKEND_DPDK, &env) != 0) {
+        return -1;
+    }
+    if (env == NULL) {
+        return (int)count;
+    }
+    
+    const uint8_t* frames[SAFETY_GATHER];
+    uint32_t lengths[SAFETY_GATHER];
+    uint32_t done = 0;
+    
+    while (done < count) {
+        uint32_t n = count - done < SAFETY_GATHER ? count - done : SAFETY_GATHER;
+        for (uint32_t i = 0; i < n; i++) {
+            frames[i] = rte_pktmbuf_mtod(mbufs[done + i], const uint8_t*);
+            lengths[i] = mbufs[done + i]->pkt_len;
+        }
+        pkt_src_t src = {frames, NULL, NULL};
+        int admitted = safety_admit_frames(BACKEND_DPDK, &src, 0, lengths, n);
+        if (admitted < 0) {
+            return done > 0 ? (int)done : admitted;
+        }
+        done += (uint32_t)admitted;
+        if ((uint32_t)admitted < n) {
+            break;
+        }
+    }
+    
+    return (int)done;
+}
+
+/* Retry mbufs an earlier burst refused; returns how many are still held.
+ * They were admitted when built, so only the kill switch stops them now,
+ * and they are stamped afresh as the burst goes out. */
+static uint32_t dpdk_flush_tx_held(int port_id, uint16_t queue_id, dpdk_queue_hooks_t* hooks) {
+    safety_envelope_t* env;
+    if (safety_gate(BACKEND_DPDK, &env) != 0) {
+        rte_pktmbuf_free_bulk(hooks->tx_held, hooks->tx_held_count);
+        hooks->tx_held_count = 0;
+        return 0;
+    }
+    
+    uint16_t sent = dpdk_tx_burst_hooked(port_id, queue_id, hooks->tx_held, hooks->tx_held_count);
+    if (sent > 0) {
+        hooks->tx_held_count = (uint16_t)(hooks->tx_held_count - sent);
+        memmove(hooks->tx_held, &hooks->tx_held[sent], hooks->tx_held_count * sizeof(struct rte_mbuf*));
+    }
+    return hooks->tx_held_count;
+}
+
+/* Held mbufs go out before anything newer on the queue; nonzero while
+ * some are still refused */
+static int dpdk_tx_backed_up(int port_id, uint16_t queue_id) {
+    dpdk_queue_hooks_t* hooks = dpdk_queue_hooks[port_id] ? &dpdk_queue_hooks[port_id][queue_id] : NULL;
+    return hooks != NULL && hooks->tx_held_count > 0 && dpdk_flush_tx_held(port_id, queue_id, hooks) > 0;
+}
+
+static int dpdk_send_src(int port_id, uint16_t queue_id, const pkt_src_t* src,
+                         const uint32_t* lengths, uint32_t count) {
+    if (!dpdk_initialized) {
+        return -1;
+    }
+    if (port_id < 0 || port_id >= RTE_MAX_ETHPORTS || queue_id >= dpdk_port_queues[port_id]) {
+        return -1;
+    }
+    
+    /* A queue still backed up gets nothing new built for it */
+    dpdk_queue_hooks_t* hooks = dpdk_queue_hooks[port_id] ? &dpdk_queue_hooks[port_id][queue_id] : NULL;
+    int hold = hooks != NULL && hooks->tx_hold;
+    if (dpdk_tx_backed_up(port_id, queue_id)) {
+        return 0;
+    }
+    
+    /* The mbuf array lives on the stack; callers resume from the count returned */
+    if (count > DPDK_MAX_BURST) {
+        count = DPDK_MAX_BURST;
+    }
+    
+    /* Checked on the caller's copy, before any mbuf is taken */
+    int admitted = safety_admit_frames(BACKEND_DPDK, src, 0, lengths, count);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    count = (uint32_t)admitted;
+    
+    struct rte_mempool* pool = dpdk_port_pool(port_id);
+    struct rte_mbuf* mbufs[count];
+    uint32_t allocated = count;
+    uint32_t filled = 0;
+    uint32_t i;
+    STAGE_BEGIN(t, dpdk_queue_stages(port_id, queue_id));
+    
+    /* Bulk allocation is all-or-nothing; on a nearly empty pool fall back
+     * to taking what is left so a partial batch still goes out */
+    if (rte_pktmbuf_alloc_bulk(pool, mbufs, count) != 0) {
+        for (allocated = 0; allocated < count; allocated++) {
+            mbufs[allocated] = rte_pktmbuf_alloc(pool);
+            if (mbufs[allocated] == NULL) {
+                break;
+            }
+        }
+    }
+    STAGE_END(t, STATS_STAGE_ALLOC);
+    
+    /* Copy data, stopping at the first packet that does not fit in an mbuf
+     * so the count returned still indexes the caller's packets */
+    for (i = 0; i < allocated; i++) {
+        char* data = rte_pktmbuf_append(mbufs[i], lengths[i]);
+        if (data == NULL) {
+            break;
+        }
+        memcpy(data, pkt_src_get(src, i), lengths[i]);
+        filled++;
+    }
+    STAGE_END(t, STATS_STAGE_COPY);
+    
+    /* Let the NIC fill checksums so callers can skip them in software */
+    if (dpdk_port_offloads[port_id] & OFFLOAD_CKSUM_MASK) {
+        int prepared = dpdk_tx_offload_prepare(port_id, queue_id, mbufs, filled, 0);
+        filled = prepared > 0 ? (uint32_t)prepared : 0;
+    }
+    
+    /* Send burst; the PMD reclaims completed descriptors inside tx_burst */
+    SHIM_PROBE(tx_submit, BACKEND_DPDK, queue_id, filled);
+    STAGE_MARK(t);
+    uint16_t sent = dpdk_tx_burst_hooked(port_id, queue_id, mbufs, filled);
+    STAGE_END(t, STATS_STAGE_KICK);
+    SHIM_PROBE(tx_complete, BACKEND_DPDK, queue_id, sent);
+    
+    /* Keep built but refused mbufs for the next call when holding */
+    uint32_t kept = 0;
+    if (hold && sent < filled) {
+        kept = filled - sent < DPDK_MAX_BURST ? filled - sent : DPDK_MAX_BURST;
+        memcpy(hooks->tx_held, &mbufs[sent], kept * sizeof(struct rte_mbuf*));
+        hooks->tx_held_count = (uint16_t)kept;
+    }
+    
+    /* Free unsent and unused mbufs */
+    if (sent + kept < allocated) {
+        rte_pktmbuf_free_bulk(&mbufs[sent + kept], allocated - sent - kept);
+    }
+    
+    return (int)(sent + kept);
+}
+
+int dpdk_send_burst_queue(int port_id, uint16_t queue_id, const uint8_t** packets,
+                          const uint32_t* lengths, uint32_t count) {
+    if (packets == NULL || lengths == NULL) {
+        return -1;
+    }
+    pkt_src_t src = {packets, NULL, NULL};
+    return dpdk_send_src(port_id, queue_id, &src, lengths, count);
+}
+
+int dpdk_send_pkt_batch(int port_id, uint16_t queue_id, const pkt_batch_t* batch, uint32_t first) {
+    if (batch == NULL || first > batch->count) {
+        return -1;
+    }
+    pkt_src_t src = pkt_src_from_batch(batch, first);
+    return dpdk_send_src(port_id, queue_id, &src, batch->lengths + first, batch->count - first);
+}
+
+int dpdk_send_template(int port_id, uint16_t queue_id, pkt_template_t* tmpl, uint32_t count) {
+    if (!dpdk_initialized || tmpl == NULL) {
+        return -1;
+    }
+    if (port_id < 0 || port_id >= RTE_MAX_ETHPORTS || queue_id >= dpdk_port_queues[port_id]) {
+        return -1;
+    }
+    if (count == 0 || dpdk_tx_backed_up(port_id, queue_id)) {
+        return 0;
+    }
+    if (count > DPDK_MAX_BURST) {
+        count = DPDK_MAX_BURST;
+    }
+    
+    struct rte_mempool* pool = dpdk_port_pool(port_id);
+    struct rte_mbuf* mbufs[count];
+    uint8_t* bufs[count];
+    uint32_t len = pkt_template_len(tmpl);
+    uint32_t allocated = count;
+    uint32_t filled = 0;
+    
+    if (rte_pktmbuf_alloc_bulk(pool, mbufs, count) != 0) {
+        for (allocated = 0; allocated < count; allocated++) {
+            mbufs[allocated] = rte_pktmbuf_alloc(pool);
+            if (mbufs[allocated] == NULL) {
+                break;
+            }
+        }
+    }
+    
+    /* Generated in place: the template is the only copy */
+    while (filled < allocated) {
+        bufs[filled] = (uint8_t*)rte_pktmbuf_append(mbufs[filled], len);
+        if (bufs[filled] == NULL) {
+            break;
+        }
+        filled++;
+    }
+    pkt_template_fill(tmpl, bufs, filled);
+    
+    int admitted = dpdk_safety_admit_mbufs(mbufs, filled);
+    uint32_t ready = admitted > 0 ? (uint32_t)admitted : 0;
+    if (ready > 0 && (dpdk_port_offloads[port_id] & OFFLOAD_CKSUM_MASK)) {
+        int prepared = dpdk_tx_offload_prepare(port_id, queue_id, mbufs, ready, 0);
+        ready = prepared > 0 ? (uint32_t)prepared : 0;
+    }
+    uint16_t sent = ready > 0 ? dpdk_tx_burst_hooked(port_id, queue_id, mbufs, ready) : 0;
+    
+    if (sent < allocated) {
+        rte_pktmbuf_free_bulk(&mbufs[sent], allocated - sent);
+    }
+    pkt_template_seek(tmpl, pkt_template_tell(tmpl) - (filled - sent));
+    return admitted < 0 && sent == 0 ? admitted : (int)sent;
+}
+
+int dpdk_send_burst(int port_id, const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
+    return dpdk_send_burst_queue(port_id, 0, packets, lengths, count);
+}
+
+int dpdk_recv_burst_queue(int port_id, uint16_t queue_id, uint8_t** packets, uint32_t max_count) {
+    if (!dpdk_initialized) {
+        return -1;
+    }
+    if (port_id < 0 || port_id >= RTE_MAX_ETHPORTS || queue_id >= dpdk_port_queues[port_id]) {
+        return -1;
+    }
+    
+    dpdk_queue_hooks_t* hooks = dpdk_get_queue_hooks(port_id, queue_id);
+    if (hooks == NULL) {
+        return -1;
+    }
+    
+    /* The caller only gets data pointers, so the shim keeps the mbufs
+     * until the next call instead of leaking them */
+    if (hooks->rx_held_count > 0) {
+        rte_pktmbuf_free_bulk(hooks->rx_held, hooks->rx_held_count);
+        hooks->rx_held_count = 0;
+    }
+    if (max_count > DPDK_MAX_BURST) {
+        max_count = DPDK_MAX_BURST;
+    }
+    
+    uint16_t received = rte_eth_rx_burst(port_id, queue_id, hooks->rx_held, (uint16_t)max_count);
+    uint64_t bytes = 0;
+    for (uint16_t i = 0; i < received; i++) {
+        packets[i] = rte_pktmbuf_mtod(hooks->rx_held[i], uint8_t*);
+        bytes += hooks->rx_held[i]->pkt_len;
+    }
+    hooks->rx_held_count = received;
+    if (received > 0) {
+        dpdk_queue_count_rx(hooks, received, bytes);
+    }
+    
+    if (hooks->probe != NULL && received > 0) {
+        uint64_t now = get_timestamp_ns();
+        for (uint16_t i = 0; i < received; i++) {
+            latency_probe_match(hooks->probe, packets[i], hooks->rx_held[i]->data_len, now);
+        }
+    }
+    if (SHIM_UNLIKELY(hooks->rx_tap != NULL) && received > 0) {
+        uint64_t now = get_timestamp_ns();
+        tap_ring_t* ring = hooks->rx_tap;
+        tap_begin(ring);
+        for (uint32_t i = tap_first(ring); i < received; i += ring->sample_every) {
+            struct rte_mbuf* m = hooks->rx_held[i];
+            tap_stage(ring, i, packets[i], m->data_len, m->pkt_len, TAP_DIR_RX, now);
+        }
+        tap_commit(ring, received);
+    }
+    
+    return received;
+}
+
+int dpdk_rx_burst_borrow(int port_id, uint16_t queue_id, rx_desc_t* descs, uint32_t max_count) {
+    if (!dpdk_initialized || descs == NULL) {
+        return -1;
+    }
+    if (port_id < 0 || port_id >= RTE_MAX_ETHPORTS || queue_id >= dpdk_port_queues[port_id]) {
+        return -1;
+    }
+    if (max_count > DPDK_MAX_BURST) {
+        max_count = DPDK_MAX_BURST;
+    }
+    
+    struct rte_mbuf* mbufs[DPDK_MAX_BURST];
+    uint16_t received = rte_eth_rx_burst(port_id, queue_id, mbufs, (uint16_t)max_count);
+    uint64_t bytes = 0;
+    for (uint16_t i = 0; i < received; i++) {
+        descs[i].data = rte_pktmbuf_mtod(mbufs[i], uint8_t*);
+        descs[i].len = mbufs[i]->data_len;
+        descs[i].reserved = 0;
+        descs[i].handle = (uint64_t)(uintptr_t)mbufs[i];
+        bytes += mbufs[i]->pkt_len;
+    }
+    
+    dpdk_queue_hooks_t* hooks = received > 0 ? dpdk_get_queue_hooks(port_id, queue_id) : NULL;
+    if (hooks != NULL) {
+        dpdk_queue_count_rx(hooks, received, bytes);
+    }
+    if (hooks != NULL && hooks->probe != NULL && received > 0) {
+        uint64_t now = get_timestamp_ns();
+        for (uint16_t i = 0; i < received; i++) {
+            latency_probe_match(hooks->probe, descs[i].data, descs[i].len, now);
+        }
+    }
+    if (hooks != NULL && SHIM_UNLIKELY(hooks->rx_tap != NULL) && received > 0) {
+        tap_record_descs(hooks->rx_tap, descs, received);
+    }
+    
+    return received;
+}
+
+void dpdk_rx_release(rx_desc_t* descs, uint32_t count) {
+    if (descs == NULL) {
+        return;
+    }
+    
+    struct rte_mbuf* mbufs[DPDK_MAX_BURST];
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t n = count - done < DPDK_MAX_BURST ? count - done : DPDK_MAX_BURST;
+        for (uint32_t i = 0; i < n; i++) {
+            mbufs[i] = (struct rte_mbuf*)(uintptr_t)descs[done + i].handle;
+        }
+        rte_pktmbuf_free_bulk(mbufs, n);
+        done += n;
+    }
+}
+
+int dpdk_recv_burst(int port_id, uint8_t** packets, uint32_t max_count) {
+    return dpdk_recv_burst_queue(port_id, 0, packets, max_count);
+}
+
+int dpdk_tx_alloc_bulk(int port_id, struct rte_mbuf** mbufs, uint8_t** data,
+                       uint32_t len, uint32_t count) {
+    if (!dpdk_initialized || mbufs == NULL) {
+        return -1;
+    }
+    if (port_id < 0 || port_id >= RTE_MAX_ETHPORTS) {
+        return -1;
+    }
+    
+    struct rte_mempool* pool = dpdk_port_pool(port_id);
+    if (len > (uint32_t)(rte_pktmbuf_data_room_size(pool) - RTE_PKTMBUF_HEADROOM)) {
+        return -1;
+    }
+    if (rte_pktmbuf_alloc_bulk(pool, mbufs, count) != 0) {
+        return 0;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        mbufs[i]->data_len = (uint16_t)len;
+        mbufs[i]->pkt_len = len;
+        if (data) {
+            data[i] = rte_pktmbuf_mtod(mbufs[i], uint8_t*);
+        }
+    }
+    
+    return (int)count;
+}
+
+int dpdk_tx_burst_mbufs(int port_id, uint16_t queue_id, struct rte_mbuf** mbufs, uint32_t count) {
+    if (!dpdk_initialized || mbufs == NULL) {
+        return -1;
+    }
+    if (port_id < 0 || port_id >= RTE_MAX_ETHPORTS || queue_id >= dpdk_port_queues[port_id]) {
+        rte_pktmbuf_free_bulk(mbufs, count);
+        return -1;
+    }
+    if (dpdk_tx_backed_up(port_id, queue_id)) {
+        rte_pktmbuf_free_bulk(mbufs, count);
+        return 0;
+    }
+    
+    /* Mbufs the envelope holds back are freed like unsent ones */
+    int admitted = dpdk_safety_admit_mbufs(mbufs, count);
+    if (admitted < 0) {
+        rte_pktmbuf_free_bulk(mbufs, count);
+        return -1;
+    }
+    
+    uint16_t sent = dpdk_tx_burst_hooked(port_id, queue_id, mbufs, (uint32_t)admitted);
+    if (sent < count) {
+        rte_pktmbuf_free_bulk(&mbufs[sent], count - sent);
+    }
+    
+    return sent;
+}
+
+void dpdk_tx_free_bulk(struct rte_mbuf** mbufs, uint32_t count) {
+    if (mbufs && count > 0) {
+        rte_pktmbuf_free_bulk(mbufs, count);
+    }
+}
+
+struct dpdk_template {
+    struct rte_mempool* pool;
+    const uint8_t* packet;  /* only valid during dpdk_template_create() */
+    uint32_t len;
+};
+
+static void dpdk_template_fill(struct rte_mempool* mp, void* opaque, void* obj, unsigned idx) {
+    struct dpdk_template* tmpl = (struct dpdk_template*)opaque;
+    struct rte_mbuf* m = (struct rte_mbuf*)obj;
+    (void)mp;
+    (void)idx;
+    
+    /* Data offset after rte_pktmbuf_init() matches the one restored by
+     * rte_pktmbuf_reset() on every allocation, so the copy persists */
+    memcpy((uint8_t*)m->buf_addr + m->data_off, tmpl->packet, tmpl->len);
+}
+
+dpdk_template_t* dpdk_template_create(const uint8_t* packet, uint32_t len,
+                                      uint32_t num_mbufs, int socket_id) {
+    static uint32_t template_seq = 0;
+    
+    if (!dpdk_initialized || packet == NULL || len == 0 || num_mbufs == 0) {
+        return NULL;
+    }
+    if (len > UINT16_MAX - RTE_PKTMBUF_HEADROOM) {
+        return NULL;
+    }
+    
+    struct dpdk_template* tmpl = (struct dpdk_template*)calloc(1, sizeof(*tmpl));
+    if (tmpl == NULL) {
+        return NULL;
+    }
+    
+    char name[RTE_MEMPOOL_NAMESIZE];
+    snprintf(name, sizeof(name), "TMPL_POOL_%u", __atomic_fetch_add(&template_seq, 1, __ATOMIC_RELAXED));
+    
+    unsigned cache_size = num_mbufs / 2 < 256 ? num_mbufs / 2 : 256;
+    tmpl->pool = rte_pktmbuf_pool_create(name, num_mbufs, cache_size, 0,
+                                         (uint16_t)(len + RTE_PKTMBUF_HEADROOM),
+                                         socket_id < 0 ? SOCKET_ID_ANY : socket_id);
+    if (tmpl->pool == NULL) {
+        free(tmpl);
+        return NULL;
+    }
+    
+    tmpl->packet = packet;
+    tmpl->len = len;
+    rte_mempool_obj_iter(tmpl->pool, dpdk_template_fill, tmpl);
+    tmpl->packet = NULL;
+    
+    return tmpl;
+}
+
+int dpdk_template_alloc(dpdk_template_t* tmpl, struct rte_mbuf** mbufs,
+                        uint8_t** data, uint32_t count) {
+    if (tmpl == NULL || mbufs == NULL) {
+        return -1;
+    }
+    if (rte_pktmbuf_alloc_bulk(tmpl->pool, mbufs, count) != 0) {
+        return 0;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        mbufs[i]->data_len = (uint16_t)tmpl->len;
+        mbufs[i]->pkt_len = tmpl->len;
+        if (data) {
+            data[i] = rte_pktmbuf_mtod(mbufs[i], uint8_t*);
+        }
+    }
+    
+    return (int)count;
+}
+
+int dpdk_template_send_repeat(int port_id, uint16_t queue_id, dpdk_template_t* tmpl, uint32_t count) {
+    if (tmpl == NULL) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (count > DPDK_MAX_BURST) {
+        count = DPDK_MAX_BURST;
+    }
+    
+    struct rte_mbuf* m = rte_pktmbuf_alloc(tmpl->pool);
+    if (m == NULL) {
+        return 0;
+    }
+    m->data_len = (uint16_t)tmpl->len;
+    m->pkt_len = tmpl->len;
+    
+    /* One reference per transmission; the PMD drops one on each completion */
+    rte_mbuf_refcnt_update(m, (int16_t)(count - 1));
+    
+    struct rte_mbuf* mbufs[count];
+    for (uint32_t i = 0; i < count; i++) {
+        mbufs[i] = m;
+    }
+    
+    return dpdk_tx_burst_mbufs(port_id, queue_id, mbufs, count);
+}
+
+void dpdk_template_destroy(dpdk_template_t* tmpl) {
+    if (tmpl == NULL) {
+        return;
+    }
+    rte_mempool_free(tmpl->pool);
+    free(tmpl);
+}
+
+int dpdk_get_stats(int port_id, driver_stats_t* stats) {
+    struct rte_eth_stats eth_stats;
+    int ret = rte_eth_stats_get(port_id, &eth_stats);
+    if (ret != 0) {
+        return ret;
+    }
+    
+    stats->packets_sent = eth_stats.opackets;
+    stats->packets_received = eth_stats.ipackets;
+    stats->bytes_sent = eth_stats.obytes;
+    stats->bytes_received = eth_stats.ibytes;
+    stats->errors = eth_stats.oerrors + eth_stats.ierrors;
+    
+    return 0;
+}
+
+int dpdk_timesync_enable(int port_id) {
+    if (!dpdk_initialized || port_id < 0 || port_id >= RTE_MAX_ETHPORTS) {
+        return -1;
+    }
+    return rte_eth_timesync_enable((uint16_t)port_id);
+}
+
+int dpdk_timesync_read_clock(int port_id, uint64_t* ns) {
+    struct timespec ts;
+    if (ns == NULL || rte_eth_timesync_read_time((uint16_t)port_id, &ts) != 0) {
+        return -1;
+    }
+    *ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    return 0;
+}
+
+int dpdk_timesync_read_rx(int port_id, uint32_t index, uint64_t* ns) {
+    struct timespec ts;
+    if (ns == NULL || rte_eth_timesync_read_rx_timestamp((uint16_t)port_id, &ts, index) != 0) {
+        return -1;
+    }
+    *ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    return 0;
+}
+
+int dpdk_timesync_read_tx(int port_id, uint64_t* ns) {
+    struct timespec ts;
+    if (ns == NULL || rte_eth_timesync_read_tx_timestamp((uint16_t)port_id, &ts) != 0) {
+        return -1;
+    }
+    *ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    return 0;
+}
+
+int cleanup_dpdk(void) {
+    if (dpdk_initialized) {
+        uint16_t port_id;
+        RTE_ETH_FOREACH_DEV(port_id) {
+            if (dpdk_port_queues[port_id] > 0) {
+                rte_eth_dev_stop(port_id);
+                rte_eth_dev_close(port_id);
+                dpdk_free_queue_hooks(port_id);
+                dpdk_port_queues[port_id] = 0;
+                dpdk_port_pools[port_id] = NULL;
+                dpdk_port_offloads[port_id] = 0;
+            }
+        }
+        for (int i = 0; i < RTE_MAX_NUMA_NODES; i++) {
+            if (socket_pools[i] != NULL && socket_pools[i] != mbuf_pool) {
+                rte_mempool_free(socket_pools[i]);
+            }
+            socket_pools[i] = NULL;
+        }
+        rte_mempool_free(mbuf_pool);
+        mbuf_pool = NULL;
+        rte_eal_cleanup();
+        dpdk_initialized = 0;
+    }
+    return 0;
+}
+
+#endif /* HAS_DPDK */
+
+/* ============================================================================
+ * AF_XDP Implementation (when available)
+ * ============================================================================ */
+
+#ifdef HAS_AF_XDP
+
+#include <linux/if_xdp.h>
+#include <linux/if_link.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#ifdef HAS_XSK_TX_METADATA
+/* libxdp: xsk_umem__create_opts() takes tx_metadata_len */
+#include <xdp/xsk.h>
+#else
+#include <bpf/xsk.h>
+#endif
+#include <bpf/libbpf.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+#define FRAME_SIZE XSK_UMEM__DEFAULT_FRAME_SIZE
+#define NUM_FRAMES 4096
+#define XSK_RING_SIZE XSK_RING_PROD__DEFAULT_NUM_DESCS
+#define XSK_BUSY_POLL_BUDGET 64
+
+struct af_xdp_queue {
+    struct xsk_socket* xsk;
+    struct xsk_umem* umem;
+    void* umem_area;
+    size_t umem_size;
+    mem_region_t umem_region;
+    struct xsk_ring_prod tx;
+    struct xsk_ring_cons rx;
+    struct xsk_ring_prod fq;
+    struct xsk_ring_cons cq;
+    
+    /* Free-frame stack for TX; RX frames cycle through fill/rx rings */
+    uint64_t* free_frames;
+    uint32_t free_count;
+    uint32_t num_frames;
+    uint32_t frame_size;
+    uint32_t ring_size;
+    uint32_t outstanding_tx;
+    
+    uint32_t queue_id;
+    int mode;
+    int busy_poll;
+    /* Bytes of xsk_tx_metadata in front of each TX packet (0 = none) */
+    uint32_t tx_meta_len;
+    uint32_t tx_offloads;
+    pacer_t* pacer;
+    latency_probe_t* probe;
+    tap_ring_t* tx_tap;
+    tap_ring_t* rx_tap;
+    driver_stats_block_t* stats;
+};
+
+/* Queue 0 socket behind the legacy single-socket API */
+static af_xdp_queue_t* default_queue = NULL;
+
+int af_xdp_get_queue_count(const char* ifname) {
+    if (ifname == NULL) {
+        return -1;
+    }
+    
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    struct ethtool_channels channels;
+    struct ifreq ifr;
+    memset(&channels, 0, sizeof(channels));
+    memset(&ifr, 0, sizeof(ifr));
+    channels.cmd = ETHTOOL_GCHANNELS;
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    ifr.ifr_data = (char*)&channels;
+    
+    int ret = ioctl(fd, SIOCETHTOOL, &ifr);
+    close(fd);
+    if (ret < 0) {
+        /* Drivers without channel support expose a single queue */
+        return errno == EOPNOTSUPP ? 1 : -1;
+    }
+    
+    uint32_t count = channels.combined_count + channels.tx_count;
+    return count > 0 ? (int)count : 1;
+}
+
+static int xq_create_socket(af_xdp_queue_t* q, const char* ifname,
+                            const af_xdp_config_t* config, int mode) {
+    struct xsk_socket_config xsk_cfg;
+    memset(&xsk_cfg, 0, sizeof(xsk_cfg));
+    xsk_cfg.rx_size = q->ring_size;
+    xsk_cfg.tx_size = q->ring_size;
+    xsk_cfg.libbpf_flags = config->attach_prog ? 0 : XSK_LIBBPF_FLAGS__INHIBIT_PROG_LOAD;
+    xsk_cfg.bind_flags = XDP_USE_NEED_WAKEUP;
+    
+    if (mode == AF_XDP_MODE_DRV) {
+        xsk_cfg.xdp_flags = XDP_FLAGS_DRV_MODE;
+        xsk_cfg.bind_flags |= XDP_ZEROCOPY;
+    } else {
+        xsk_cfg.xdp_flags = XDP_FLAGS_SKB_MODE;
+        xsk_cfg.bind_flags |= XDP_COPY;
+    }
+    
+    return xsk_socket__create(&q->xsk, ifname, q->queue_id, q->umem, &q->rx, &q->tx, &xsk_cfg);
+}
+
+static void xq_enable_busy_poll(af_xdp_queue_t* q, const af_xdp_config_t* config) {
+    int fd = xsk_socket__fd(q->xsk);
+    int one = 1;
+    int timeout_us = 20;
+    int budget = config->busy_poll_budget > 0 ? (int)config->busy_poll_budget : XSK_BUSY_POLL_BUDGET;
+    
+    /* Older kernels reject these; the socket still works in wakeup mode */
+    if (setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one)) == 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &timeout_us, sizeof(timeout_us)) == 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL_BUDGET, &budget, sizeof(budget)) == 0) {
+        q->busy_poll = 1;
+    }
+}
+
+af_xdp_queue_t* af_xdp_queue_create(const char* ifname, uint32_t queue_id,
+                                    const af_xdp_config_t* config) {
+    if (ifname == NULL || if_nametoindex(ifname) == 0) {
+        return NULL;
+    }
+    
+    af_xdp_config_t defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    if (config == NULL) {
+        config = &defaults;
+    }
+    
+    af_xdp_queue_t* q = (af_xdp_queue_t*)calloc(1, sizeof(*q));
+    if (q == NULL) {
+        return NULL;
+    }
+    q->queue_id = queue_id;
+    q->num_frames = config->num_frames > 0 ? config->num_frames : NUM_FRAMES;
+    q->frame_size = config->frame_size > 0 ? config->frame_size : FRAME_SIZE;
+    q->ring_size = config->ring_size > 0 ? config->ring_size : XSK_RING_SIZE;
+    
+    q->free_frames = (uint64_t*)malloc(q->num_frames * sizeof(uint64_t));
+    q->stats = stats_block_create();
+    if (q->free_frames == NULL || q->stats == NULL) {
+        stats_block_destroy(q->stats);
+        free(q->free_frames);
+        free(q);
+        return NULL;
+    }
+    
+    /* Allocate UMEM area on the NIC's NUMA node, on huge pages when asked
+     * so the frames span few TLB entries */
+    mem_region_config_t mem;
+    mem_region_config_init(&mem);
+    mem.pages = config->umem_pages;
+    mem.numa_node = get_netdev_numa_node(ifname);
+    mem.lock = config->umem_lock;
+    q->umem_size = (size_t)q->num_frames * q->frame_size;
+    if (mem_region_alloc(&q->umem_region, q->umem_size, &mem) == 0) {
+        q->umem_area = q->umem_region.addr;
+    }
+    if (q->umem_area == NULL) {
+        stats_block_destroy(q->stats);
+        free(q->free_frames);
+        free(q);
+        return NULL;
+    }
+    
+    /* Create UMEM */
+    struct xsk_umem_config umem_cfg = {
+        .fill_size = q->ring_size,
+        .comp_size = q->ring_size,
+        .frame_size = q->frame_size,
+        .frame_headroom = XSK_UMEM__DEFAULT_FRAME_HEADROOM,
+    };
+    
+#ifdef HAS_XSK_TX_METADATA
+    /* Kernels before 6.8 reject TX metadata; fall back to a plain UMEM */
+    if (config->tx_checksum_offload) {
+        DECLARE_LIBXDP_OPTS(xsk_umem_opts, umem_opts,
+            .size = q->umem_size,
+            .fill_size = q->ring_size,
+            .comp_size = q->ring_size,
+            .frame_size = q->frame_size,
+            .frame_headroom = XSK_UMEM__DEFAULT_FRAME_HEADROOM,
+            .flags = XDP_UMEM_TX_METADATA_LEN,
+            .tx_metadata_len = sizeof(struct xsk_tx_metadata),
+        );
+        q->umem = xsk_umem__create_opts(q->umem_area, &q->fq, &q->cq, &umem_opts);
+        if (q->umem != NULL) {
+            q->tx_meta_len = sizeof(struct xsk_tx_metadata);
+            q->tx_offloads = OFFLOAD_UDP_CKSUM | OFFLOAD_TCP_CKSUM;
+        }
+    }
+    if (q->umem == NULL &&
+        xsk_umem__create(&q->umem, q->umem_area, q->umem_size, &q->fq, &q->cq, &umem_cfg) != 0) {
+#else
+    if (xsk_umem__create(&q->umem, q->umem_area, q->umem_size, &q->fq, &q->cq, &umem_cfg) != 0) {
+#endif
+        q->umem = NULL;
+        af_xdp_queue_destroy(q);
+        return NULL;
+    }
+    
+    /* Create XSK socket, falling back from native to SKB mode */
+    int ret;
+    if (config->mode == AF_XDP_MODE_SKB) {
+        q->mode = AF_XDP_MODE_SKB;
+        ret = xq_create_socket(q, ifname, config, AF_XDP_MODE_SKB);
+    } else {
+        q->mode = AF_XDP_MODE_DRV;
+        ret = xq_create_socket(q, ifname, config, AF_XDP_MODE_DRV);
+        if (ret != 0 && config->mode == AF_XDP_MODE_AUTO) {
+            q->mode = AF_XDP_MODE_SKB;
+            ret = xq_create_socket(q, ifname, config, AF_XDP_MODE_SKB);
+        }
+    }
+    if (ret != 0) {
+        q->xsk = NULL;
+        af_xdp_queue_destroy(q);
+        return NULL;
+    }
+    
+    if (config->busy_poll) {
+        xq_enable_busy_poll(q, config);
+    }
+    
+    /* Split UMEM: up to one ring of frames for RX, the rest for TX */
+    uint32_t rx_frames = q->num_frames / 2;
+    if (rx_frames > q->ring_size) {
+        rx_frames = q->ring_size;
+    }
+    
+    uint32_t idx;
+    if (xsk_ring_prod__reserve(&q->fq, rx_frames, &idx) != rx_frames) {
+        af_xdp_queue_destroy(q);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < rx_frames; i++) {
+        *xsk_ring_prod__fill_addr(&q->fq, idx++) = (uint64_t)i * q->frame_size;
+    }
+    xsk_ring_prod__submit(&q->fq, rx_frames);
+    
+    for (uint32_t i = rx_frames; i < q->num_frames; i++) {
+        q->free_frames[q->free_count++] = (uint64_t)i * q->frame_size;
+    }
+    
+    return q;
+}
+
+static inline void xq_kick_tx(af_xdp_queue_t* q) {
+    if (q->busy_poll || xsk_ring_prod__needs_wakeup(&q->tx)) {
+        sendto(xsk_socket__fd(q->xsk), NULL, 0, MSG_DONTWAIT, NULL, 0);
+    }
+}
+
+static inline uint32_t xq_reclaim(af_xdp_queue_t* q) {
+    uint32_t idx;
+    uint32_t completed = xsk_ring_cons__peek(&q->cq, q->ring_size, &idx);
+    
+    /* Completions return the descriptor address, past any TX metadata */
+    for (uint32_t i = 0; i < completed; i++) {
+        q->free_frames[q->free_count++] = *xsk_ring_cons__comp_addr(&q->cq, idx + i) - q->tx_meta_len;
+    }
+    if (completed > 0) {
+        xsk_ring_cons__release(&q->cq, completed);
+        q->outstanding_tx -= completed;
+        SHIM_PROBE(tx_complete, BACKEND_AF_XDP, q->queue_id, completed);
+    }
+    
+    return completed;
+}
+
+int af_xdp_queue_reclaim(af_xdp_queue_t* queue) {
+    if (queue == NULL || queue->xsk == NULL) {
+        return -1;
+    }
+    return (int)xq_reclaim(queue);
+}
+
+#ifdef HAS_XSK_TX_METADATA
+/* Request L4 checksum: field gets the pseudo-header sum, NIC does the rest */
+static inline void xq_request_csum(af_xdp_queue_t* q, struct xdp_desc* desc) {
+    uint8_t* frame = (uint8_t*)q->umem_area + desc->addr;
+    frame_layout_t layout;
+    if (parse_frame_layout(frame, desc->len, &layout) != 0) {
+        return;
+    }
+    
+    const uint8_t* ip = frame + layout.l2_len;
+    uint32_t l4_off = (uint32_t)layout.l2_len + layout.l3_len;
+    uint16_t csum_off = layout.proto == IPPROTO_UDP ? 6 : 16;
+    uint32_t total_len = load_be16(ip + 2);
+    if (total_len < (uint32_t)layout.l3_len + layout.l4_len || layout.l2_len + total_len > desc->len) {
+        return;
+    }
+    uint32_t l4_bytes = total_len - layout.l3_len;
+    
+    uint32_t sum = load_be16(ip + 12) + load_be16(ip + 14) +
+                   load_be16(ip + 16) + load_be16(ip + 18) +
+                   layout.proto + l4_bytes;
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    store_be16(frame + l4_off + csum_off, (uint16_t)sum);
+    
+    struct xsk_tx_metadata* meta = (struct xsk_tx_metadata*)(frame - q->tx_meta_len);
+    memset(meta, 0, sizeof(*meta));
+    meta->flags = XDP_TXMD_FLAGS_CHECKSUM;
+    meta->request.csum_start = (uint16_t)l4_off;
+    meta->request.csum_offset = csum_off;
+    desc->options |= XDP_TX_METADATA;
+}
+#endif
+
+/* Tap copies come from the UMEM frames, so they include probe stamps */
+static void xq_tap_tx(af_xdp_queue_t* q, uint32_t idx, uint32_t count) {
+    tap_ring_t* ring = q->tx_tap;
+    uint64_t now = get_timestamp_ns();
+    tap_begin(ring);
+    for (uint32_t i = tap_first(ring); i < count; i += ring->sample_every) {
+        const struct xdp_desc* desc = xsk_ring_prod__tx_desc(&q->tx, idx + i);
+        tap_stage(ring, i, (const uint8_t*)q->umem_area + desc->addr, desc->len, desc->len,
+                  TAP_DIR_TX, now);
+    }
+    tap_commit(ring, count);
+}
+
+static inline void xq_pop_frame(af_xdp_queue_t* q, struct xdp_desc* desc, uint32_t len) {
+    desc->addr = q->free_frames[--q->free_count] + q->tx_meta_len;
+    desc->len = len;
+    desc->options = 0;
+}
+
+static int xq_send(af_xdp_queue_t* q, const pkt_src_t* src, uint32_t first,
+                   const uint32_t* lengths, uint32_t count) {
+    STAGE_BEGIN(t, &q->stats->stages);
+    if (q->free_count < count) {
+        xq_reclaim(q);
+        STAGE_END(t, STATS_STAGE_REAP);
+    }
+    if (q->free_count == 0) {
+        /* Completions only advance once the kernel processes TX */
+        xq_kick_tx(q);
+        STAGE_END(t, STATS_STAGE_KICK);
+        return 0;
+    }
+    
+    /* Reserve is all-or-nothing, so ask only for what the TX ring holds */
+    uint32_t n = count < q->free_count ? count : q->free_count;
+    uint32_t ring_free = xsk_prod_nb_free(&q->tx, n);
+    n = n < ring_free ? n : ring_free;
+    for (uint32_t i = 0; i < n; i++) {
+        if (lengths[i] + q->tx_meta_len > q->frame_size) {
+            n = i;
+            break;
+        }
+    }
+    
+    /* Admitted only once ring space is known, so the ceiling is not
+     * charged for frames that could not be queued */
+    int admitted = safety_admit_frames(BACKEND_AF_XDP, src, first, lengths, n);
+    if (admitted < 0) {
+        return -1;
+    }
+    n = (uint32_t)admitted;
+    
+    STAGE_MARK(t);
+    uint32_t idx;
+    uint32_t reserved = n > 0 ? xsk_ring_prod__reserve(&q->tx, n, &idx) : 0;
+    uint64_t bytes = 0;
+    STAGE_END(t, STATS_STAGE_RESERVE);
+    
+#ifdef NETSTRESS_STAGE_CYCLES
+    /* Frames are popped in a pass of their own so the free-list cost
+     * can be told apart from the copy */
+    for (uint32_t i = 0; i < reserved; i++) {
+        xq_pop_frame(q, xsk_ring_prod__tx_desc(&q->tx, idx + i), lengths[i]);
+    }
+    STAGE_END(t, STATS_STAGE_ALLOC);
+#endif
+    
+    for (uint32_t i = 0; i < reserved; i++) {
+        struct xdp_desc* desc = xsk_ring_prod__tx_desc(&q->tx, idx + i);
+#ifndef NETSTRESS_STAGE_CYCLES
+        xq_pop_frame(q, desc, lengths[i]);
+#endif
+        memcpy((uint8_t*)q->umem_area + desc->addr, pkt_src_get(src, first + i), lengths[i]);
+        if (q->probe) {
+            probe_stamp(q->probe, (uint8_t*)q->umem_area + desc->addr, lengths[i], !q->tx_offloads);
+        }
+#ifdef HAS_XSK_TX_METADATA
+        if (q->tx_offloads) {
+            xq_request_csum(q, desc);
+        }
+#endif
+        bytes += lengths[i];
+    }
+    STAGE_END(t, STATS_STAGE_COPY);
+    
+    if (SHIM_UNLIKELY(q->tx_tap != NULL) && reserved > 0) {
+        xq_tap_tx(q, idx, reserved);
+    }
+    if (reserved > 0) {
+        xsk_ring_prod__submit(&q->tx, reserved);
+        q->outstanding_tx += reserved;
+        stats_block_add_tx(q->stats, reserved, bytes);
+        SHIM_PROBE(tx_submit, BACKEND_AF_XDP, q->queue_id, reserved);
+    }
+    
+    STAGE_MARK(t);
+    xq_kick_tx(q);
+    STAGE_END(t, STATS_STAGE_KICK);
+    
+    return reserved;
+}
+
+/* lengths and src are indexed from 0; count packets in total */
+static int xq_send_paced(af_xdp_queue_t* queue, const pkt_src_t* src,
+                         const uint32_t* lengths, uint32_t count) {
+    if (queue->pacer == NULL) {
+        return xq_send(queue, src, 0, lengths, count);
+    }
+    
+    /* One kicked burst per slot */
+    uint32_t burst = pacer_burst(queue->pacer);
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t n = count - done < burst ? count - done : burst;
+        pacer_wait(queue->pacer);
+        
+        int sent = xq_send(queue, src, done, &lengths[done], n);
+        if (sent < 0) {
+            return done > 0 ? (int)done : sent;
+        }
+        uint64_t bytes = 0;
+        for (int i = 0; i < sent; i++) {
+            bytes += lengths[done + i];
+        }
+        pacer_charge(queue->pacer, (uint32_t)sent, bytes);
+        done += (uint32_t)sent;
+        if ((uint32_t)sent < n) {
+            break;
+        }
+    }
+    
+    return (int)done;
+}
+
+int af_xdp_queue_send_batch(af_xdp_queue_t* queue, const uint8_t** packets,
+                            const uint32_t* lengths, uint32_t count) {
+    if (queue == NULL || queue->xsk == NULL) {
+        return -1;
+    }
+    pkt_src_t src = {packets, NULL, NULL};
+    return xq_send_paced(queue, &src, lengths, count);
+}
+
+int af_xdp_queue_send_pkt_batch(af_xdp_queue_t* queue, const pkt_batch_t* batch, uint32_t first) {
+    if (queue == NULL || queue->xsk == NULL || batch == NULL || first > batch->count) {
+        return -1;
+    }
+    pkt_src_t src = pkt_src_from_batch(batch, first);
+    return xq_send_paced(queue, &src, batch->lengths + first, batch->count - first);
+}
+
+#define XQ_TEMPLATE_CHUNK 64
+
+static int xq_send_template(af_xdp_queue_t* q, pkt_template_t* tmpl, uint32_t n) {
+    if (q->free_count < n) {
+        xq_reclaim(q);
+    }
+    if (q->free_count == 0) {
+        xq_kick_tx(q);
+        return 0;
+    }
+    n = n < q->free_count ? n : q->free_count;
+    uint32_t ring_free = xsk_prod_nb_free(&q->tx, n);
+    n = n < ring_free ? n : ring_free;
+    if (n == 0) {
+        xq_kick_tx(q);
+        return 0;
+    }
+    
+    /* Generated straight into the frames the descriptors will take */
+    uint8_t* bufs[XQ_TEMPLATE_CHUNK];
+    const uint8_t* frames[XQ_TEMPLATE_CHUNK];
+    uint32_t lengths[XQ_TEMPLATE_CHUNK];
+    uint32_t len = pkt_template_len(tmpl);
+    for (uint32_t i = 0; i < n; i++) {
+        bufs[i] = (uint8_t*)q->umem_area + q->free_frames[q->free_count - 1 - i] + q->tx_meta_len;
+        frames[i] = bufs[i];
+        lengths[i] = len;
+    }
+    pkt_template_fill(tmpl, bufs, n);
+    
+    pkt_src_t src = {frames, NULL, NULL};
+    int admitted = safety_admit_frames(BACKEND_AF_XDP, &src, 0, lengths, n);
+    uint32_t idx;
+    uint32_t reserved = admitted > 0 ? xsk_ring_prod__reserve(&q->tx, (uint32_t)admitted, &idx) : 0;
+    
+    for (uint32_t i = 0; i < reserved; i++) {
+        struct xdp_desc* desc = xsk_ring_prod__tx_desc(&q->tx, idx + i);
+        desc->addr = q->free_frames[--q->free_count] + q->tx_meta_len;
+        desc->len = len;
+        desc->options = 0;
+        if (q->probe) {
+            probe_stamp(q->probe, bufs[i], len, !q->tx_offloads);
+        }
+#ifdef HAS_XSK_TX_METADATA
+        if (q->tx_offloads) {
+            xq_request_csum(q, desc);
+        }
+#endif
+    }
+    
+    if (SHIM_UNLIKELY(q->tx_tap != NULL) && reserved > 0) {
+        xq_tap_tx(q, idx, reserved);
+    }
+    if (reserved > 0) {
+        xsk_ring_prod__submit(&q->tx, reserved);
+        q->outstanding_tx += reserved;
+        stats_block_add_tx(q->stats, reserved, (uint64_t)reserved * len);
+    }
+    xq_kick_tx(q);
+    
+    pkt_template_seek(tmpl, pkt_template_tell(tmpl) - (n - reserved));
+    return admitted < 0 ? admitted : (int)reserved;
+}
+
+int af_xdp_queue_send_template(af_xdp_queue_t* queue, pkt_template_t* tmpl, uint32_t count) {
+    if (queue == NULL || queue->xsk == NULL || tmpl == NULL ||
+        pkt_template_len(tmpl) + queue->tx_meta_len > queue->frame_size) {
+        return -1;
+    }
+    
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t n = count - done < XQ_TEMPLATE_CHUNK ? count - done : XQ_TEMPLATE_CHUNK;
+        int sent = xq_send_template(queue, tmpl, n);
+        if (sent < 0) {
+            return done > 0 ? (int)done : sent;
+        }
+        done += (uint32_t)sent;
+        if ((uint32_t)sent < n) {
+            break;
+        }
+    }
+    return (int)done;
+}
+
+int af_xdp_queue_set_rate(af_xdp_queue_t* queue, uint64_t rate_pps, uint64_t rate_bps, uint32_t burst) {
+    if (queue == NULL) {
+        return -1;
+    }
+    if (rate_pps == 0 && rate_bps == 0) {
+        pacer_destroy(queue->pacer);
+        queue->pacer = NULL;
+        return 0;
+    }
+    if (queue->pacer != NULL) {
+        return pacer_set_rate(queue->pacer, rate_pps, rate_bps, burst);
+    }
+    queue->pacer = pacer_create(rate_pps, rate_bps, burst);
+    return queue->pacer != NULL ? 0 : -1;
+}
+
+int af_xdp_queue_set_latency_probe(af_xdp_queue_t* queue, latency_probe_t* probe) {
+    if (queue == NULL) {
+        return -1;
+    }
+    queue->probe = probe;
+    return 0;
+}
+
+int af_xdp_queue_set_tap(af_xdp_queue_t* queue, tap_ring_t* tx_ring, tap_ring_t* rx_ring) {
+    if (queue == NULL) {
+        return -1;
+    }
+    queue->tx_tap = tx_ring;
+    queue->rx_tap = rx_ring;
+    return 0;
+}
+
+int af_xdp_queue_rx_borrow(af_xdp_queue_t* queue, rx_desc_t* descs, uint32_t max_count) {
+    if (queue == NULL || queue->xsk == NULL || descs == NULL) {
+        return -1;
+    }
+    af_xdp_queue_t* q = queue;
+    
+    uint32_t idx;
+    uint32_t received = xsk_ring_cons__peek(&q->rx, max_count, &idx);
+    if (received == 0) {
+        if (q->busy_poll || xsk_ring_prod__needs_wakeup(&q->fq)) {
+            recvfrom(xsk_socket__fd(q->xsk), NULL, 0, MSG_DONTWAIT, NULL, NULL);
+        }
+        return 0;
+    }
+    
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < received; i++) {
+        const struct xdp_desc* desc = xsk_ring_cons__rx_desc(&q->rx, idx + i);
+        descs[i].data = (uint8_t*)xsk_umem__get_data(q->umem_area, desc->addr);
+        descs[i].len = desc->len;
+        descs[i].reserved = 0;
+        descs[i].handle = desc->addr;
+        bytes += desc->len;
+    }
+    /* Ring slots are free once read; the frames stay with the caller */
+    xsk_ring_cons__release(&q->rx, received);
+    stats_block_add_rx(q->stats, received, bytes);
+    
+    if (q->probe) {
+        uint64_t now = get_timestamp_ns();
+        for (uint32_t i = 0; i < received; i++) {
+            latency_probe_match(q->probe, descs[i].data, descs[i].len, now);
+        }
+    }
+    if (SHIM_UNLIKELY(q->rx_tap != NULL)) {
+        tap_record_descs(q->rx_tap, descs, received);
+    }
+    
+    return (int)received;
+}
+
+int af_xdp_queue_rx_release(af_xdp_queue_t* queue, const rx_desc_t* descs, uint32_t count) {
+    if (queue == NULL || queue->xsk == NULL || descs == NULL) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    
+    /* The fill ring is sized for every RX frame, so all of them fit */
+    uint32_t idx;
+    uint32_t reserved = xsk_ring_prod__reserve(&queue->fq, count, &idx);
+    for (uint32_t i = 0; i < reserved; i++) {
+        *xsk_ring_prod__fill_addr(&queue->fq, idx + i) = xsk_umem__extract_addr(descs[i].handle);
+    }
+    if (reserved > 0) {
+        xsk_ring_prod__submit(&queue->fq, reserved);
+    }
+    
+    return (int)reserved;
+}
+
+int af_xdp_queue_recv(af_xdp_queue_t* queue, uint8_t* buffer, uint32_t max_len) {
+    if (buffer == NULL) {
+        return -1;
+    }
+    
+    rx_desc_t desc;
+    int received = af_xdp_queue_rx_borrow(queue, &desc, 1);
+    if (received <= 0) {
+        return received;
+    }
+    
+    uint32_t len = desc.len < max_len ? desc.len : max_len;
+    memcpy(buffer, desc.data, len);
+    af_xdp_queue_rx_release(queue, &desc, 1);
+    
+    return len;
+}
+
+int af_xdp_queue_fd(const af_xdp_queue_t* queue) {
+    if (queue == NULL || queue->xsk == NULL) {
+        return -1;
+    }
+    return xsk_socket__fd(queue->xsk);
+}
+
+int af_xdp_queue_mode(const af_xdp_queue_t* queue) {
+    if (queue == NULL || queue->xsk == NULL) {
+        return -1;
+    }
+    return queue->mode;
+}
+
+uint32_t af_xdp_queue_tx_offloads(const af_xdp_queue_t* queue) {
+    if (queue == NULL || queue->xsk == NULL) {
+        return 0;
+    }
+    return queue->tx_offloads;
+}
+
+int af_xdp_queue_get_stats(const af_xdp_queue_t* queue, driver_stats_t* stats) {
+    if (queue == NULL || stats == NULL) {
+        return -1;
+    }
+    stats_block_read(queue->stats, stats);
+    return 0;
+}
+
+int af_xdp_queue_get_stages(const af_xdp_queue_t* queue, stage_stats_t* stages) {
+    if (queue == NULL || stages == NULL) {
+        return -1;
+    }
+    return stats_block_read_stages(queue->stats, stages);
+}
+
+int af_xdp_queue_get_tx_ring(const af_xdp_queue_t* queue, uint32_t* used, uint32_t* size) {
+    if (queue == NULL || used == NULL || size == NULL) {
+        return -1;
+    }
+    /* The frame budget, not the descriptor ring, is what runs out first */
+    *used = queue->outstanding_tx;
+    *size = queue->outstanding_tx + queue->free_count;
+    return 0;
+}
+
+void af_xdp_queue_destroy(af_xdp_queue_t* queue) {
+    if (queue == NULL) {
+        return;
+    }
+    if (queue->xsk) {
+        xsk_socket__delete(queue->xsk);
+    }
+    if (queue->umem) {
+        xsk_umem__delete(queue->umem);
+    }
+    mem_region_free(&queue->umem_region);
+    stats_block_destroy(queue->stats);
+    pacer_destroy(queue->pacer);
+    free(queue->free_frames);
+    free(queue);
+}
+
+int init_af_xdp(const char* ifname) {
+    if (default_queue != NULL) {
+        return -1;
+    }
+    
+    default_queue = af_xdp_queue_create(ifname, 0, NULL);
+    if (default_queue == NULL) {
+        return -1;
+    }
+    
+    return xsk_socket__fd(default_queue->xsk);
+}
+
+int af_xdp_send(const uint8_t* data, uint32_t len) {
+    int ret = af_xdp_queue_send_batch(default_queue, &data, &len, 1);
+    if (ret <= 0) {
+        return -1;
+    }
+    return len;
+}
+
+int af_xdp_send_batch(const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
+    return af_xdp_queue_send_batch(default_queue, packets, lengths, count);
+}
+
+int af_xdp_recv(uint8_t* buffer, uint32_t max_len) {
+    return af_xdp_queue_recv(default_queue, buffer, max_len);
+}
+
+int cleanup_af_xdp(void) {
+    af_xdp_queue_destroy(default_queue);
+    default_queue = NULL;
+    return 0;
+}
+
+#endif /* HAS_AF_XDP */
+
+/* ============================================================================
+ * io_uring Implementation (when available)
+ * ============================================================================ */
+
+#ifdef HAS_IO_URING
+
+#include <liburing.h>
+#include <sys/uio.h>
+
+#define URING_QUEUE_DEPTH 256
+#define URING_BATCH_SIZE 32
+#define URING_BUFFER_SIZE 2048
+#define URING_SQPOLL_IDLE_MS 1000
+
+/* One in-flight send: header, iovec and destination live for the whole
+ * life of the ring, so submission never allocates */
+struct uring_slot {
+    struct msghdr msg;
+    struct iovec iov;
+    struct sockaddr_in addr;
+};
+
+/* Per-worker engine: ring, socket and stats are never shared */
+struct io_uring_ctx {
+    struct io_uring ring;
+    int sockfd;
+    driver_stats_block_t* stats;
+    
+    struct uring_slot* slots;
+    uint8_t* buffers;
+    size_t buffers_size;
+    uint32_t buffer_size;
+    uint32_t* free_slots;
+    uint32_t free_count;
+    uint32_t num_slots;
+    int fixed_file;
+    int fixed_buffers;
+    int send_zc;
+};
+
+/* Context behind the legacy single-ring API */
+static io_uring_ctx_t* default_uring = NULL;
+
+static int uring_probe_send_zc(struct io_uring* ring) {
+#ifdef IORING_OP_SEND_ZC
+    struct io_uring_probe* probe = io_uring_get_probe_ring(ring);
+    if (probe == NULL) {
+        return 0;
+    }
+    int supported = io_uring_opcode_supported(probe, IORING_OP_SEND_ZC);
+    io_uring_free_probe(probe);
+    return supported;
+#else
+    (void)ring;
+    return 0;
+#endif
+}
+
+io_uring_ctx_t* io_uring_ctx_create(const io_uring_config_t* config) {
+    io_uring_config_t defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    defaults.sqpoll_cpu = -1;
+    if (config == NULL) {
+        config = &defaults;
+    }
+    
+    io_uring_ctx_t* ctx = (io_uring_ctx_t*)calloc(1, sizeof(*ctx));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    
+    uint32_t depth = config->queue_depth > 0 ? config->queue_depth : URING_QUEUE_DEPTH;
+    ctx->buffer_size = config->buffer_size > 0 ? config->buffer_size : URING_BUFFER_SIZE;
+    
+    /* Poll thread submits for us; needs CAP_SYS_NICE on kernels before 5.11 */
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ret = -1;
+    if (config->sqpoll) {
+        params.flags = IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = config->sqpoll_idle_ms > 0 ? config->sqpoll_idle_ms : URING_SQPOLL_IDLE_MS;
+        if (config->sqpoll_cpu >= 0) {
+            params.flags |= IORING_SETUP_SQ_AFF;
+            params.sq_thread_cpu = (uint32_t)config->sqpoll_cpu;
+        }
+        ret = io_uring_queue_init_params(depth, &ctx->ring, &params);
+    }
+    if (ret < 0) {
+        memset(&params, 0, sizeof(params));
+        ret = io_uring_queue_init_params(depth, &ctx->ring, &params);
+        if (ret < 0) {
+            free(ctx);
+            return NULL;
+        }
+    }
+    
+    /* Create UDP socket for sending */
+    ctx->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (ctx->sockfd < 0) {
+        io_uring_queue_exit(&ctx->ring);
+        free(ctx);
+        return NULL;
+    }
+    
+    /* Allocate slot slabs and one contiguous buffer region */
+    ctx->num_slots = depth;
+    ctx->buffers_size = (size_t)depth * ctx->buffer_size;
+    ctx->slots = (struct uring_slot*)calloc(depth, sizeof(struct uring_slot));
+    ctx->free_slots = (uint32_t*)malloc(depth * sizeof(uint32_t));
+    ctx->buffers = (uint8_t*)alloc_numa_memory(ctx->buffers_size, -1);
+    ctx->stats = stats_block_create();
+    if (!ctx->slots || !ctx->free_slots || !ctx->buffers || !ctx->stats) {
+        io_uring_ctx_destroy(ctx);
+        return NULL;
+    }
+    
+    for (uint32_t i = 0; i < depth; i++) {
+        struct uring_slot* slot = &ctx->slots[i];
+        slot->iov.iov_base = ctx->buffers + (size_t)i * ctx->buffer_size;
+        slot->msg.msg_name = &slot->addr;
+        slot->msg.msg_namelen = sizeof(struct sockaddr_in);
+        slot->msg.msg_iov = &slot->iov;
+        slot->msg.msg_iovlen = 1;
+        ctx->free_slots[i] = depth - 1 - i;
+    }
+    ctx->free_count = depth;
+    
+    /* Registered file and buffers skip per-op fd lookup and page pinning */
+    ctx->fixed_file = io_uring_register_files(&ctx->ring, &ctx->sockfd, 1) == 0;
+    
+    struct iovec region = { .iov_base = ctx->buffers, .iov_len = ctx->buffers_size };
+    ctx->fixed_buffers = io_uring_register_buffers(&ctx->ring, &region, 1) == 0;
+    ctx->send_zc = config->zero_copy && ctx->fixed_buffers && uring_probe_send_zc(&ctx->ring);
+    
+    return ctx;
+}
+
+static inline void uring_handle_cqe(io_uring_ctx_t* ctx, const struct io_uring_cqe* cqe) {
+    uint32_t slot = (uint32_t)cqe->user_data;
+    
+#ifdef IORING_CQE_F_NOTIF
+    /* Zero-copy notification: the kernel no longer references the buffer */
+    if (cqe->flags & IORING_CQE_F_NOTIF) {
+        ctx->free_slots[ctx->free_count++] = slot;
+        return;
+    }
+#endif
+    
+    if (cqe->res >= 0) {
+        stats_block_add_tx(ctx->stats, 1, (uint64_t)cqe->res);
+    } else {
+        stats_block_add_errors(ctx->stats, 1);
+    }
+    
+#ifdef IORING_CQE_F_MORE
+    if (cqe->flags & IORING_CQE_F_MORE) {
+        return;  /* buffer released by the notification CQE */
+    }
+#endif
+    ctx->free_slots[ctx->free_count++] = slot;
+}
+
+static int uring_reap_completions(io_uring_ctx_t* ctx) {
+    struct io_uring_cqe* cqes[URING_BATCH_SIZE];
+    int total = 0;
+    unsigned n;
+    
+    while ((n = io_uring_peek_batch_cqe(&ctx->ring, cqes, URING_BATCH_SIZE)) > 0) {
+        for (unsigned i = 0; i < n; i++) {
+            uring_handle_cqe(ctx, cqes[i]);
+        }
+        io_uring_cq_advance(&ctx->ring, n);
+        total += (int)n;
+    }
+    if (total > 0) {
+        SHIM_PROBE(tx_complete, BACKEND_IO_URING, ctx->sockfd, total);
+    }
+    
+    return total;
+}
+
+int io_uring_ctx_reap(io_uring_ctx_t* ctx) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    return uring_reap_completions(ctx);
+}
+
+int io_uring_ctx_drain(io_uring_ctx_t* ctx) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    
+    io_uring_submit(&ctx->ring);
+    while (ctx->free_count < ctx->num_slots) {
+        struct io_uring_cqe* cqe;
+        int ret = io_uring_wait_cqe(&ctx->ring, &cqe);
+        if (ret < 0) {
+            return ret;
+        }
+        uring_reap_completions(ctx);
+    }
+    return 0;
+}
+
+static inline void uring_prep_slot(io_uring_ctx_t* ctx, struct io_uring_sqe* sqe,
+                                   uint32_t index, uint32_t len) {
+    struct uring_slot* slot = &ctx->slots[index];
+    int fd = ctx->fixed_file ? 0 : ctx->sockfd;
+    
+#ifdef IORING_OP_SEND_ZC
+    if (ctx->send_zc) {
+        io_uring_prep_send_zc_fixed(sqe, fd, slot->iov.iov_base, len, 0, 0, 0);
+        io_uring_prep_send_set_addr(sqe, (const struct sockaddr*)&slot->addr,
+                                    sizeof(struct sockaddr_in));
+    } else
+#endif
+    {
+        slot->iov.iov_len = len;
+        io_uring_prep_sendmsg(sqe, fd, &slot->msg, 0);
+    }
+    
+    if (ctx->fixed_file) {
+        sqe->flags |= IOSQE_FIXED_FILE;
+    }
+    sqe->user_data = index;
+}
+
+/* Destinations come from dests, or from batch packets [first, first + count) */
+static int uring_send_src(io_uring_ctx_t* ctx, const pkt_src_t* src, const uint32_t* lengths,
+                          const struct sockaddr_in* dests, const pkt_batch_t* batch,
+                          uint32_t first, uint32_t count) {
+    STAGE_BEGIN(t, &ctx->stats->stages);
+    
+    /* Recycle finished slots first; block only when none are free */
+    uring_reap_completions(ctx);
+    if (ctx->free_count == 0) {
+        io_uring_submit_and_wait(&ctx->ring, 1);
+        uring_reap_completions(ctx);
+    }
+    STAGE_END(t, STATS_STAGE_REAP);
+    
+    /* Clamp to free slots and SQ space up front, so admission is not
+     * charged for packets that could not be queued */
+    unsigned sq_space = io_uring_sq_space_left(&ctx->ring);
+    if (count > ctx->free_count) {
+        count = ctx->free_count;
+    }
+    if (count > sq_space) {
+        count = sq_space;
+    }
+    
+    /* Stop at the first packet too large for a slot, so the count returned
+     * still indexes the caller's packets */
+    for (uint32_t i = 0; i < count; i++) {
+        if (lengths[i] > ctx->buffer_size) {
+            if (i == 0) {
+                stats_block_add_errors(ctx->stats, 1);
+                return -1;
+            }
+            count = i;
+            break;
+        }
+    }
+    STAGE_END(t, STATS_STAGE_RESERVE);
+    
+    int admitted = dests ? safety_admit_dests(BACKEND_IO_URING, dests, 0, lengths, count) :
+                           safety_admit_batch(BACKEND_IO_URING, batch, first, count);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    count = (uint32_t)admitted;
+    STAGE_MARK(t);
+    
+    uint32_t queued = 0;
+    for (uint32_t i = 0; i < count && ctx->free_count > 0; i++) {
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&ctx->ring);
+        if (!sqe) {
+            break;
+        }
+        
+        uint32_t index = ctx->free_slots[--ctx->free_count];
+        struct uring_slot* slot = &ctx->slots[index];
+        memcpy(slot->iov.iov_base, pkt_src_get(src, i), lengths[i]);
+        if (dests) {
+            slot->addr = dests[i];
+        } else {
+            pkt_batch_dest(batch, first + i, &slot->addr);
+        }
+        uring_prep_slot(ctx, sqe, index, lengths[i]);
+        queued++;
+    }
+    STAGE_END(t, STATS_STAGE_COPY);
+    
+    /* With SQPOLL this only wakes the poll thread when it went idle */
+    if (queued > 0) {
+        int ret = io_uring_submit(&ctx->ring);
+        STAGE_END(t, STATS_STAGE_KICK);
+        if (ret < 0) {
+            return ret;
+        }
+        SHIM_PROBE(tx_submit, BACKEND_IO_URING, ctx->sockfd, queued);
+    }
+    
+    return (int)queued;
+}
+
+int io_uring_ctx_send_batch(io_uring_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                            const struct sockaddr_in* dests, uint32_t count) {
+    if (ctx == NULL || packets == NULL || lengths == NULL || dests == NULL) {
+        return -1;
+    }
+    pkt_src_t src = {packets, NULL, NULL};
+    return uring_send_src(ctx, &src, lengths, dests, NULL, 0, count);
+}
+
+int io_uring_ctx_send_pkt_batch(io_uring_ctx_t* ctx, const pkt_batch_t* batch, uint32_t first) {
+    if (ctx == NULL || batch == NULL || first > batch->count) {
+        return -1;
+    }
+    pkt_src_t src = pkt_src_from_batch(batch, first);
+    return uring_send_src(ctx, &src, batch->lengths + first, NULL, batch, first, batch->count - first);
+}
+
+int io_uring_ctx_get_stats(const io_uring_ctx_t* ctx, driver_stats_t* stats) {
+    if (ctx == NULL || stats == NULL) {
+        return -1;
+    }
+    return stats_block_read(ctx->stats, stats);
+}
+
+int io_uring_ctx_get_stages(const io_uring_ctx_t* ctx, stage_stats_t* stages) {
+    if (ctx == NULL || stages == NULL) {
+        return -1;
+    }
+    return stats_block_read_stages(ctx->stats, stages);
+}
+
+int io_uring_ctx_get_tx_ring(const io_uring_ctx_t* ctx, uint32_t* used, uint32_t* size) {
+    if (ctx == NULL || used == NULL || size == NULL) {
+        return -1;
+    }
+    *used = ctx->num_slots - ctx->free_count;
+    *size = ctx->num_slots;
+    return 0;
+}
+
+int io_uring_ctx_fd(const io_uring_ctx_t* ctx) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    return ctx->sockfd;
+}
+
+void io_uring_ctx_destroy(io_uring_ctx_t* ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    if (ctx->slots && ctx->free_slots && ctx->buffers && ctx->stats) {
+        io_uring_ctx_drain(ctx);
+    }
+    io_uring_queue_exit(&ctx->ring);
+    if (ctx->sockfd >= 0) {
+        close(ctx->sockfd);
+    }
+    free(ctx->slots);
+    free(ctx->free_slots);
+    free_numa_memory(ctx->buffers, ctx->buffers_size);
+    stats_block_destroy(ctx->stats);
+    free(ctx);
+}
+
+int init_io_uring_config(const io_uring_config_t* config) {
+    if (default_uring != NULL) {
+        return -1;
+    }
+    default_uring = io_uring_ctx_create(config);
+    return default_uring != NULL ? 0 : -1;
+}
+
+int init_io_uring(int queue_depth) {
+    io_uring_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.queue_depth = queue_depth > 0 ? (uint32_t)queue_depth : URING_QUEUE_DEPTH;
+    config.sqpoll_cpu = -1;
+    return init_io_uring_config(&config);
+}
+
+int io_uring_reap(void) {
+    return io_uring_ctx_reap(default_uring);
+}
+
+int io_uring_drain(void) {
+    return io_uring_ctx_drain(default_uring);
+}
+
+int io_uring_send_batch(const uint8_t** packets, const uint32_t* lengths, 
+                        const struct sockaddr_in* dests, uint32_t count) {
+    return io_uring_ctx_send_batch(default_uring, packets, lengths, dests, count);
+}
+
+int io_uring_send_single(const uint8_t* data, uint32_t len, const struct sockaddr_in* dest) {
+    int ret = io_uring_ctx_send_batch(default_uring, &data, &len, dest, 1);
+    if (ret <= 0) {
+        return -1;
+    }
+    return (int)len;
+}
+
+int io_uring_get_stats(driver_stats_t* stats) {
+    return io_uring_ctx_get_stats(default_uring, stats);
+}
+
+int cleanup_io_uring(void) {
+    io_uring_ctx_destroy(default_uring);
+    default_uring = NULL;
+    return 0;
+}
+
+#endif /* HAS_IO_URING */
+
+/* ============================================================================
+ * sendmmsg Batch Sending (Linux)
+ * ============================================================================ */
+
+#define SENDMMSG_STACK_BATCH 256
+#define SENDMMSG_GSO_MAX_SEGS 64        /* UDP_MAX_SEGMENTS on older kernels */
+#define SENDMMSG_GSO_MAX_BYTES 65507    /* largest IPv4 UDP payload */
+
+struct sendmmsg_ctx {
+    int sockfd;
+    uint32_t capacity;
+    int gso_enabled;
+    int txtime_enabled;
+    pacer_t* pacer;
+    struct sockaddr_in dest;
+    stage_stats_t stages;
+#ifdef __linux__
+    struct mmsghdr* msgs;
+    struct iovec* iovs;
+    uint32_t* segs;
+    uint8_t* cmsgs;
+    struct sockaddr_in* names;  /* Per-message destinations for packet batches */
+#endif
+};
+
+static inline void fill_dest(struct sockaddr_in* dest, uint32_t dst_ip, uint16_t dst_port) {
+    memset(dest, 0, sizeof(*dest));
+    dest->sin_family = AF_INET;
+    dest->sin_addr.s_addr = dst_ip;
+    dest->sin_port = htons(dst_port);
+}
+
+#define SENDMMSG_GATHER_BATCH 64
+
+/* Context send after safety admission: dests has one entry per packet, or
+ * is &ctx->dest when same_dest is set */
+static int sendmmsg_ctx_xmit(sendmmsg_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                             const struct sockaddr_in* dests, int same_dest, uint32_t count);
+
+/* Pointer-array path for packets [first, first + count) of a batch, used
+ * where the send needs per-packet pointers anyway (pacing, GSO, the
+ * portable fallback) */
+static int sendmmsg_pkt_batch_gather(sendmmsg_ctx_t* ctx, const pkt_batch_t* batch,
+                                     uint32_t first, uint32_t count) {
+    const uint8_t* packets[SENDMMSG_GATHER_BATCH];
+    struct sockaddr_in dests[SENDMMSG_GATHER_BATCH];
+    int per_packet = batch->dst_ips != NULL || batch->dst_ports != NULL;
+    uint32_t done = 0;
+    
+    if (!per_packet) {
+        fill_dest(&ctx->dest, batch->dst_ip, batch->dst_port);
+    }
+    
+    while (done < count) {
+        uint32_t n = count - done < SENDMMSG_GATHER_BATCH ? count - done : SENDMMSG_GATHER_BATCH;
+        uint32_t base = first + done;
+        for (uint32_t i = 0; i < n; i++) {
+            packets[i] = batch->arena + batch->offsets[base + i];
+            if (per_packet) {
+                pkt_batch_dest(batch, base + i, &dests[i]);
+            }
+        }
+        
+        int sent = per_packet ?
+            sendmmsg_ctx_xmit(ctx, packets, batch->lengths + base, dests, 0, n) :
+            sendmmsg_ctx_xmit(ctx, packets, batch->lengths + base, &ctx->dest, 1, n);
+        if (sent < 0) {
+            return done > 0 ? (int)done : sent;
+        }
+        done += (uint32_t)sent;
+        if ((uint32_t)sent < n) {
+            break;
+        }
+    }
+    
+    return (int)done;
+}
+
+#ifdef __linux__
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+/* Per message: UDP_SEGMENT size when GSO-packing, SCM_TXTIME when pacing */
+#define SENDMMSG_CMSG_SPACE (CMSG_SPACE(sizeof(uint16_t)) + CMSG_SPACE(sizeof(uint64_t)))
+
+/* Send count packets in chunks of capacity using caller-provided arrays.
+ * dests has one entry per packet, or a single entry when same_dest is set;
+ * stages is NULL for the context-free calls. */
+static int sendmmsg_chunked(int sockfd, const uint8_t** packets, const uint32_t* lengths,
+                            const struct sockaddr_in* dests, int same_dest, uint32_t count,
+                            struct mmsghdr* msgs, struct iovec* iovs, uint32_t capacity,
+                            stage_stats_t* stages) {
+    uint32_t done = 0;
+    STAGE_BEGIN(t, stages);
+    
+    while (done < count) {
+        uint32_t n = count - done < capacity ? count - done : capacity;
+        
+        for (uint32_t i = 0; i < n; i++) {
+            iovs[i].iov_base = (void*)packets[done + i];
+            iovs[i].iov_len = lengths[done + i];
+            
+            msgs[i].msg_hdr.msg_name = (void*)(same_dest ? dests : &dests[done + i]);
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = NULL;
+            msgs[i].msg_hdr.msg_controllen = 0;
+            msgs[i].msg_hdr.msg_flags = 0;
+        }
+        STAGE_END(t, STATS_STAGE_COPY);
+        
+        SHIM_PROBE(tx_submit, BACKEND_SENDMMSG, sockfd, n);
+        int sent = sendmmsg(sockfd, msgs, n, 0);
+        STAGE_END(t, STATS_STAGE_KICK);
+        if (sent < 0) {
+            return done > 0 ? (int)done : -1;
+        }
+        SHIM_PROBE(tx_complete, BACKEND_SENDMMSG, sockfd, sent);
+        done += (uint32_t)sent;
+        if ((uint32_t)sent < n) {
+            break;
+        }
+    }
+    
+    return (int)done;
+}
+
+/* Pack runs of equal-length packets into UDP_SEGMENT super-datagrams; the
+ * kernel (or NIC) splits each one back into individual datagrams */
+static int sendmmsg_gso(sendmmsg_ctx_t* ctx, const uint8_t** packets,
+                        const uint32_t* lengths, uint32_t count) {
+    uint32_t done = 0;
+    STAGE_BEGIN(t, &ctx->stages);
+    
+    while (done < count) {
+        uint32_t m = 0;
+        uint32_t v = 0;
+        uint32_t i = done;
+        
+        while (i < count && m < ctx->capacity && v < ctx->capacity) {
+            uint32_t seg = lengths[i];
+            uint32_t start = v;
+            uint32_t bytes = 0;
+            uint32_t nsegs = 0;
+            
+            do {
+                ctx->iovs[v].iov_base = (void*)packets[i];
+                ctx->iovs[v].iov_len = seg;
+                v++;
+                i++;
+                nsegs++;
+                bytes += seg;
+            } while (seg > 0 && i < count && v < ctx->capacity && lengths[i] == seg &&
+                     nsegs < SENDMMSG_GSO_MAX_SEGS && bytes + seg <= SENDMMSG_GSO_MAX_BYTES);
+            
+            struct msghdr* hdr = &ctx->msgs[m].msg_hdr;
+            hdr->msg_name = &ctx->dest;
+            hdr->msg_namelen = sizeof(ctx->dest);
+            hdr->msg_iov = &ctx->iovs[start];
+            hdr->msg_iovlen = nsegs;
+            hdr->msg_flags = 0;
+            
+            if (nsegs > 1) {
+                hdr->msg_control = ctx->cmsgs + (size_t)m * SENDMMSG_CMSG_SPACE;
+                hdr->msg_controllen = SENDMMSG_CMSG_SPACE;
+                struct cmsghdr* cm = CMSG_FIRSTHDR(hdr);
+                cm->cmsg_level = IPPROTO_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t gso_size = (uint16_t)seg;
+                memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+            } else {
+                hdr->msg_control = NULL;
+                hdr->msg_controllen = 0;
+            }
+            ctx->segs[m++] = nsegs;
+        }
+        STAGE_END(t, STATS_STAGE_COPY);
+        
+        SHIM_PROBE(tx_submit, BACKEND_SENDMMSG, ctx->sockfd, i - done);
+        int sent = sendmmsg(ctx->sockfd, ctx->msgs, m, 0);
+        STAGE_END(t, STATS_STAGE_KICK);
+        if (sent < 0) {
+            return done > 0 ? (int)done : -1;
+        }
+        uint32_t datagrams = 0;
+        for (int k = 0; k < sent; k++) {
+            datagrams += ctx->segs[k];
+        }
+        done += datagrams;
+        SHIM_PROBE(tx_complete, BACKEND_SENDMMSG, ctx->sockfd, datagrams);
+        if ((uint32_t)sent < m) {
+            break;
+        }
+    }
+    
+    return (int)done;
+}
+
+/* One sendmmsg() per pacer slot. Launch times are CLOCK_MONOTONIC, which
+ * runs at the same rate as the pacer's clock but from another origin. */
+static int sendmmsg_paced(sendmmsg_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                          const struct sockaddr_in* dests, int same_dest, uint32_t count) {
+    uint32_t burst = pacer_burst(ctx->pacer);
+    if (burst > ctx->capacity) {
+        burst = ctx->capacity;
+    }
+    uint32_t done = 0;
+    STAGE_BEGIN(t, &ctx->stages);
+    
+    while (done < count) {
+        uint32_t n = count - done < burst ? count - done : burst;
+        pacer_wait(ctx->pacer);
+        STAGE_MARK(t);
+        
+        int64_t mono_offset = 0;
+        if (ctx->txtime_enabled) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            mono_offset = (int64_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec) -
+                          (int64_t)get_timestamp_ns();
+        }
+        
+        for (uint32_t i = 0; i < n; i++) {
+            ctx->iovs[i].iov_base = (void*)packets[done + i];
+            ctx->iovs[i].iov_len = lengths[done + i];
+            
+            struct msghdr* hdr = &ctx->msgs[i].msg_hdr;
+            hdr->msg_name = (void*)(same_dest ? dests : &dests[done + i]);
+            hdr->msg_namelen = sizeof(struct sockaddr_in);
+            hdr->msg_iov = &ctx->iovs[i];
+            hdr->msg_iovlen = 1;
+            hdr->msg_flags = 0;
+            
+            /* Charged before sending so each message gets its own slot */
+            uint64_t departure = pacer_charge(ctx->pacer, 1, lengths[done + i]);
+            if (ctx->txtime_enabled) {
+                hdr->msg_control = ctx->cmsgs + (size_t)i * SENDMMSG_CMSG_SPACE;
+                hdr->msg_controllen = CMSG_SPACE(sizeof(uint64_t));
+                struct cmsghdr* cm = CMSG_FIRSTHDR(hdr);
+                cm->cmsg_level = SOL_SOCKET;
+                cm->cmsg_type = SCM_TXTIME;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+                uint64_t txtime = (uint64_t)((int64_t)departure + mono_offset);
+                memcpy(CMSG_DATA(cm), &txtime, sizeof(txtime));
+            } else {
+                hdr->msg_control = NULL;
+                hdr->msg_controllen = 0;
+            }
+        }
+        STAGE_END(t, STATS_STAGE_COPY);
+        
+        SHIM_PROBE(tx_submit, BACKEND_SENDMMSG, ctx->sockfd, n);
+        int sent = sendmmsg(ctx->sockfd, ctx->msgs, n, 0);
+        STAGE_END(t, STATS_STAGE_KICK);
+        if (sent < 0) {
+            return done > 0 ? (int)done : -1;
+        }
+        SHIM_PROBE(tx_complete, BACKEND_SENDMMSG, ctx->sockfd, sent);
+        done += (uint32_t)sent;
+        if ((uint32_t)sent < n) {
+            break;
+        }
+    }
+    
+    return (int)done;
+}
+
+int sendmmsg_batch(int sockfd, const uint8_t** packets, const uint32_t* lengths,
+                   const struct sockaddr_in* dests, uint32_t count) {
+    struct mmsghdr msgs[SENDMMSG_STACK_BATCH];
+    struct iovec iovs[SENDMMSG_STACK_BATCH];
+    
+    int admitted = safety_admit_dests(BACKEND_SENDMMSG, dests, 0, lengths, count);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    return sendmmsg_chunked(sockfd, packets, lengths, dests, 0, (uint32_t)admitted,
+                            msgs, iovs, SENDMMSG_STACK_BATCH, NULL);
+}
+
+int sendmmsg_batch_same_dest(int sockfd, const uint8_t** packets, const uint32_t* lengths,
+                              uint32_t dst_ip, uint16_t dst_port, uint32_t count) {
+    struct mmsghdr msgs[SENDMMSG_STACK_BATCH];
+    struct iovec iovs[SENDMMSG_STACK_BATCH];
+    struct sockaddr_in dest;
+    fill_dest(&dest, dst_ip, dst_port);
+    
+    int admitted = safety_admit_dests(BACKEND_SENDMMSG, &dest, 1, lengths, count);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    return sendmmsg_chunked(sockfd, packets, lengths, &dest, 1, (uint32_t)admitted,
+                            msgs, iovs, SENDMMSG_STACK_BATCH, NULL);
+}
+
+sendmmsg_ctx_t* sendmmsg_ctx_create(int sockfd, uint32_t max_batch) {
+    if (sockfd < 0) {
+        return NULL;
+    }
+    
+    sendmmsg_ctx_t* ctx = (sendmmsg_ctx_t*)calloc(1, sizeof(*ctx));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->sockfd = sockfd;
+    ctx->capacity = max_batch > 0 ? max_batch : SENDMMSG_STACK_BATCH;
+    ctx->msgs = (struct mmsghdr*)calloc(ctx->capacity, sizeof(struct mmsghdr));
+    ctx->iovs = (struct iovec*)calloc(ctx->capacity, sizeof(struct iovec));
+    ctx->segs = (uint32_t*)calloc(ctx->capacity, sizeof(uint32_t));
+    ctx->cmsgs = (uint8_t*)calloc(ctx->capacity, SENDMMSG_CMSG_SPACE);
+    ctx->names = (struct sockaddr_in*)calloc(ctx->capacity, sizeof(struct sockaddr_in));
+    if (!ctx->msgs || !ctx->iovs || !ctx->segs || !ctx->cmsgs || !ctx->names) {
+        sendmmsg_ctx_destroy(ctx);
+        return NULL;
+    }
+    
+    return ctx;
+}
+
+int sendmmsg_ctx_set_gso(sendmmsg_ctx_t* ctx, int enable) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    if (!enable) {
+        ctx->gso_enabled = 0;
+        return 0;
+    }
+    
+    /* Only UDP sockets on 4.18+ kernels know the option */
+    int val = 0;
+    socklen_t len = sizeof(val);
+    if (getsockopt(ctx->sockfd, IPPROTO_UDP, UDP_SEGMENT, &val, &len) != 0) {
+        ctx->gso_enabled = 0;
+        return -1;
+    }
+    ctx->gso_enabled = 1;
+    return 0;
+}
+
+int sendmmsg_ctx_set_pacing(sendmmsg_ctx_t* ctx, uint64_t rate_pps, uint64_t rate_bps, uint32_t burst) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    
+    if (rate_pps == 0 && rate_bps == 0) {
+        pacer_destroy(ctx->pacer);
+        ctx->pacer = NULL;
+        ctx->txtime_enabled = 0;
+        socket_set_pacing_rate(ctx->sockfd, 0);
+        return 0;
+    }
+    
+    if (ctx->pacer != NULL) {
+        pacer_set_rate(ctx->pacer, rate_pps, rate_bps, burst);
+    } else {
+        ctx->pacer = pacer_create(rate_pps, rate_bps, burst);
+        if (ctx->pacer == NULL) {
+            return -1;
+        }
+    }
+    
+    if (rate_bps > 0) {
+        socket_set_pacing_rate(ctx->sockfd, rate_bps / 8);
+    }
+    if (!ctx->txtime_enabled) {
+        ctx->txtime_enabled = socket_enable_txtime(ctx->sockfd) == 0;
+    }
+    return ctx->txtime_enabled;
+}
+
+static int sendmmsg_ctx_xmit(sendmmsg_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                             const struct sockaddr_in* dests, int same_dest, uint32_t count) {
+    if (ctx->pacer != NULL) {
+        return sendmmsg_paced(ctx, packets, lengths, dests, same_dest, count);
+    }
+    
+    if (same_dest && ctx->gso_enabled) {
+        int sent = sendmmsg_gso(ctx, packets, lengths, count);
+        if (sent >= 0 || errno != EINVAL) {
+            return sent;
+        }
+        /* Segment size above the path MTU or unsupported by the device */
+        ctx->gso_enabled = 0;
+    }
+    
+    return sendmmsg_chunked(ctx->sockfd, packets, lengths, dests, same_dest, count,
+                            ctx->msgs, ctx->iovs, ctx->capacity, &ctx->stages);
+}
+
+int sendmmsg_ctx_send(sendmmsg_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                      const struct sockaddr_in* dests, uint32_t count) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    int admitted = safety_admit_dests(BACKEND_SENDMMSG, dests, 0, lengths, count);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    return sendmmsg_ctx_xmit(ctx, packets, lengths, dests, 0, (uint32_t)admitted);
+}
+
+int sendmmsg_ctx_send_same_dest(sendmmsg_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                                uint32_t dst_ip, uint16_t dst_port, uint32_t count) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    
+    if (ctx->dest.sin_family != AF_INET || ctx->dest.sin_addr.s_addr != dst_ip ||
+        ctx->dest.sin_port != htons(dst_port)) {
+        fill_dest(&ctx->dest, dst_ip, dst_port);
+    }
+    
+    int admitted = safety_admit_dests(BACKEND_SENDMMSG, &ctx->dest, 1, lengths, count);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    return sendmmsg_ctx_xmit(ctx, packets, lengths, &ctx->dest, 1, (uint32_t)admitted);
+}
+
+int sendmmsg_ctx_send_pkt_batch(sendmmsg_ctx_t* ctx, const pkt_batch_t* batch, uint32_t first) {
+    if (ctx == NULL || batch == NULL || first > batch->count) {
+        return -1;
+    }
+    
+    int admitted = safety_admit_batch(BACKEND_SENDMMSG, batch, first, batch->count - first);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    uint32_t count = (uint32_t)admitted;
+    
+    if (ctx->pacer != NULL || ctx->gso_enabled) {
+        return sendmmsg_pkt_batch_gather(ctx, batch, first, count);
+    }
+    
+    int per_packet = batch->dst_ips != NULL || batch->dst_ports != NULL;
+    if (!per_packet) {
+        fill_dest(&ctx->dest, batch->dst_ip, batch->dst_port);
+    }
+    
+    /* iovecs point straight into the arena */
+    uint32_t done = 0;
+    STAGE_BEGIN(t, &ctx->stages);
+    while (done < count) {
+        uint32_t n = count - done < ctx->capacity ? count - done : ctx->capacity;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t k = first + done + i;
+            struct msghdr* hdr = &ctx->msgs[i].msg_hdr;
+            ctx->iovs[i].iov_base = batch->arena + batch->offsets[k];
+            ctx->iovs[i].iov_len = batch->lengths[k];
+            if (per_packet) {
+                pkt_batch_dest(batch, k, &ctx->names[i]);
+                hdr->msg_name = &ctx->names[i];
+            } else {
+                hdr->msg_name = &ctx->dest;
+            }
+            hdr->msg_namelen = sizeof(struct sockaddr_in);
+            hdr->msg_iov = &ctx->iovs[i];
+            hdr->msg_iovlen = 1;
+            hdr->msg_control = NULL;
+            hdr->msg_controllen = 0;
+            hdr->msg_flags = 0;
+        }
+        STAGE_END(t, STATS_STAGE_COPY);
+        
+        SHIM_PROBE(tx_submit, BACKEND_SENDMMSG, ctx->sockfd, n);
+        int sent = sendmmsg(ctx->sockfd, ctx->msgs, n, 0);
+        STAGE_END(t, STATS_STAGE_KICK);
+        if (sent < 0) {
+            return done > 0 ? (int)done : -1;
+        }
+        SHIM_PROBE(tx_complete, BACKEND_SENDMMSG, ctx->sockfd, sent);
+        done += (uint32_t)sent;
+        if ((uint32_t)sent < n) {
+            break;
+        }
+    }
+    
+    return (int)done;
+}
+
+int sendmmsg_ctx_get_stages(const sendmmsg_ctx_t* ctx, stage_stats_t* stages) {
+    if (ctx == NULL || stages == NULL) {
+        return -1;
+    }
+    stages_load(&ctx->stages, stages);
+    return 0;
+}
+
+void sendmmsg_ctx_destroy(sendmmsg_ctx_t* ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    free(ctx->msgs);
+    free(ctx->iovs);
+    free(ctx->segs);
+    free(ctx->cmsgs);
+    free(ctx->names);
+    pacer_destroy(ctx->pacer);
+    free(ctx);
+}
+
+#else
+
+/* Fallback for non-Linux systems */
+static int sendto_each(int sockfd, const uint8_t** packets, const uint32_t* lengths,
+                       const struct sockaddr_in* dests, int same_dest, uint32_t count) {
+    int sent = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const struct sockaddr_in* dest = same_dest ? dests : &dests[i];
+        ssize_t ret = sendto(sockfd, packets[i], lengths[i], 0,
+                             (const struct sockaddr*)dest, sizeof(struct sockaddr_in));
+        if (ret > 0) {
+            sent++;
+        }
+    }
+    return sent;
+}
+
+int sendmmsg_batch(int sockfd, const uint8_t** packets, const uint32_t* lengths,
+                   const struct sockaddr_in* dests, uint32_t count) {
+    int admitted = safety_admit_dests(BACKEND_SENDMMSG, dests, 0, lengths, count);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    return sendto_each(sockfd, packets, lengths, dests, 0, (uint32_t)admitted);
+}
+
+int sendmmsg_batch_same_dest(int sockfd, const uint8_t** packets, const uint32_t* lengths,
+                              uint32_t dst_ip, uint16_t dst_port, uint32_t count) {
+    struct sockaddr_in dest;
+    fill_dest(&dest, dst_ip, dst_port);
+    
+    int admitted = safety_admit_dests(BACKEND_SENDMMSG, &dest, 1, lengths, count);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    return sendto_each(sockfd, packets, lengths, &dest, 1, (uint32_t)admitted);
+}
+
+sendmmsg_ctx_t* sendmmsg_ctx_create(int sockfd, uint32_t max_batch) {
+    if (sockfd < 0) {
+        return NULL;
+    }
+    sendmmsg_ctx_t* ctx = (sendmmsg_ctx_t*)calloc(1, sizeof(*ctx));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->sockfd = sockfd;
+    ctx->capacity = max_batch > 0 ? max_batch : SENDMMSG_STACK_BATCH;
+    return ctx;
+}
+
+int sendmmsg_ctx_set_gso(sendmmsg_ctx_t* ctx, int enable) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    return enable ? -1 : 0;  /* UDP GSO is Linux-only */
+}
+
+int sendmmsg_ctx_set_pacing(sendmmsg_ctx_t* ctx, uint64_t rate_pps, uint64_t rate_bps, uint32_t burst) {
+    (void)burst;
+    if (ctx == NULL) {
+        return -1;
+    }
+    return (rate_pps == 0 && rate_bps == 0) ? 0 : -1;
+}
+
+static int sendmmsg_ctx_xmit(sendmmsg_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                             const struct sockaddr_in* dests, int same_dest, uint32_t count) {
+    return sendto_each(ctx->sockfd, packets, lengths, dests, same_dest, count);
+}
+
+int sendmmsg_ctx_send(sendmmsg_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                      const struct sockaddr_in* dests, uint32_t count) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    return sendmmsg_batch(ctx->sockfd, packets, lengths, dests, count);
+}
+
+int sendmmsg_ctx_send_same_dest(sendmmsg_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                                uint32_t dst_ip, uint16_t dst_port, uint32_t count) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    return sendmmsg_batch_same_dest(ctx->sockfd, packets, lengths, dst_ip, dst_port, count);
+}
+
+int sendmmsg_ctx_send_pkt_batch(sendmmsg_ctx_t* ctx, const pkt_batch_t* batch, uint32_t first) {
+    if (ctx == NULL || batch == NULL || first > batch->count) {
+        return -1;
+    }
+    int admitted = safety_admit_batch(BACKEND_SENDMMSG, batch, first, batch->count - first);
+    if (admitted <= 0) {
+        return admitted;
+    }
+    return sendmmsg_pkt_batch_gather(ctx, batch, first, (uint32_t)admitted);
+}
+
+int sendmmsg_ctx_get_stages(const sendmmsg_ctx_t* ctx, stage_stats_t* stages) {
+    if (ctx == NULL || stages == NULL) {
+        return -1;
+    }
+    stages_load(&ctx->stages, stages);
+    return 0;
+}
+
+void sendmmsg_ctx_destroy(sendmmsg_ctx_t* ctx) {
+    free(ctx);
+}
+
+#endif /* __linux__ */
+
+/* ============================================================================
+ * Backend Detection and Selection
+ * ============================================================================ */
+
+int detect_capabilities(system_capabilities_t* caps) {
+    memset(caps, 0, sizeof(system_capabilities_t));
+    
+    /* Always have raw sockets */
+    caps->has_raw_socket = 1;
+    
+    /* CPU count */
+    caps->cpu_count = get_cpu_count();
+    
+#ifdef __linux__
+    /* Check kernel version */
+    struct utsname uts;
+    if (uname(&uts) == 0) {
+        sscanf(uts.release, "%d.%d", &caps->kernel_version_major, &caps->kernel_version_minor);
+    }
+    
+    /* sendmmsg available on Linux 3.0+ */
+    if (caps->kernel_version_major >= 3) {
+        caps->has_sendmmsg = 1;
+    }
+    
+    /* io_uring: set up a ring rather than trusting the version, since
+     * seccomp or kernel.io_uring_disabled can still refuse it */
+#ifdef HAS_IO_URING
+    struct io_uring probe_ring;
+    if (io_uring_queue_init(2, &probe_ring, 0) == 0) {
+        io_uring_queue_exit(&probe_ring);
+        caps->has_io_uring = 1;
+    }
+#endif
+    
+    /* AF_XDP: the address family must exist and be permitted */
+#ifdef HAS_AF_XDP
+    int xsk_fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (xsk_fd >= 0) {
+        close(xsk_fd);
+        caps->has_af_xdp = 1;
+    }
+#endif
+    
+    /* NUMA detection */
+    FILE* f = fopen("/sys/devices/system/node/online", "r");
+    if (f) {
+        char buf[64];
+        if (fgets(buf, sizeof(buf), f)) {
+            /* Parse "0-N" format */
+            int start, end;
+            if (sscanf(buf, "%d-%d", &start, &end) == 2) {
+                caps->numa_nodes = end - start + 1;
+            } else {
+                caps->numa_nodes = 1;
+            }
+        }
+        fclose(f);
+    }
+#endif
+
+#ifdef HAS_DPDK
+    caps->has_dpdk = 1;
+    
+    /* Offloads usable on every started port */
+    int started = 0;
+    caps->dpdk_tx_offloads = OFFLOAD_ALL;
+    for (int port_id = 0; port_id < RTE_MAX_ETHPORTS; port_id++) {
+        if (dpdk_port_queues[port_id] > 0) {
+            caps->dpdk_tx_offloads &= dpdk_port_offloads[port_id];
+            started = 1;
+        }
+    }
+    if (!started) {
+        caps->dpdk_tx_offloads = 0;
+    }
+#endif
+
+#ifdef HAS_AF_XDP
+    caps->af_xdp_tx_offloads = af_xdp_queue_tx_offloads(default_queue);
+#endif
+
+    return 0;
+}
+
+backend_type_t select_best_backend(const system_capabilities_t* caps) {
+    /* Priority: DPDK > AF_XDP > io_uring > sendmmsg > raw_socket */
+    if (caps->has_dpdk) {
+        return BACKEND_DPDK;
+    }
+    if (caps->has_af_xdp) {
+        return BACKEND_AF_XDP;
+    }
+    if (caps->has_io_uring) {
+        return BACKEND_IO_URING;
+    }
+    if (caps->has_sendmmsg) {
+        return BACKEND_SENDMMSG;
+    }
+    return BACKEND_RAW_SOCKET;
+}
+
+const char* backend_name(backend_type_t backend) {
+    switch (backend) {
+        case BACKEND_DPDK: return "DPDK";
+        case BACKEND_AF_XDP: return "AF_XDP";
+        case BACKEND_IO_URING: return "io_uring";
+        case BACKEND_SENDMMSG: return "sendmmsg";
+        case BACKEND_RAW_SOCKET: return "raw_socket";
+        default: return "unknown";
+    }
+}
+
+/* ============================================================================
+ * Measured Backend Selection
+ * ============================================================================ */
+
+#define BACKEND_PROBE_BATCH 32
+#define BACKEND_PROBE_PACKETS 16384
+#define BACKEND_PROBE_TIMEOUT_NS 1000000000ULL  /* Per candidate */
+#define BACKEND_PROBE_HDR_LEN 42                /* Ethernet + IPv4 + UDP */
+#define BACKEND_PROBE_MIN_FRAME 64
+#define BACKEND_PROBE_MAX_FRAME 1514
+#define BACKEND_PROBE_PATH_MAX 512
+
+static const backend_type_t probe_candidates[] = {
+    BACKEND_RAW_SOCKET, BACKEND_SENDMMSG, BACKEND_IO_URING, BACKEND_AF_XDP, BACKEND_DPDK
+};
+
+static backend_type_t backend_from_name(const char* name) {
+    for (size_t i = 0; i < sizeof(probe_candidates) / sizeof(probe_candidates[0]); i++) {
+        if (strcmp(name, backend_name(probe_candidates[i])) == 0) {
+            return probe_candidates[i];
+        }
+    }
+    return BACKEND_NONE;
+}
+
+static uint32_t probe_frame_size(uint32_t packet_size) {
+    if (packet_size == 0) {
+        return BACKEND_PROBE_MIN_FRAME;
+    }
+    if (packet_size < BACKEND_PROBE_MIN_FRAME) {
+        return BACKEND_PROBE_MIN_FRAME;
+    }
+    return packet_size > BACKEND_PROBE_MAX_FRAME ? BACKEND_PROBE_MAX_FRAME : packet_size;
+}
+
+#ifdef __linux__
+
+/* Backends this build can open; part of the cache key so a rebuild re-probes */
+static unsigned probe_build_mask(void) {
+    unsigned mask = (1u << BACKEND_RAW_SOCKET) | (1u << BACKEND_SENDMMSG);
+#ifdef HAS_IO_URING
+    mask |= 1u << BACKEND_IO_URING;
+#endif
+#ifdef HAS_AF_XDP
+    mask |= 1u << BACKEND_AF_XDP;
+#endif
+#ifdef HAS_DPDK
+    mask |= 1u << BACKEND_DPDK;
+#endif
+    return mask;
+}
+
+/* Last path component of a sysfs symlink, "none" if it does not exist */
+static void sysfs_link_name(const char* path, char* out, size_t len) {
+    char target[256];
+    ssize_t n = readlink(path, target, sizeof(target) - 1);
+    if (n <= 0) {
+        snprintf(out, len, "none");
+        return;
+    }
+    target[n] = '\0';
+    const char* base = strrchr(target, '/');
+    snprintf(out, len, "%.*s", (int)len - 1, base ? base + 1 : target);
+}
+
+int backend_probe_cache_key(const char* ifname, uint32_t packet_size, char* key, size_t len) {
+    if (!key || len == 0) {
+        return -1;
+    }
+    if (!ifname || ifname[0] == '\0') {
+        ifname = "lo";
+    }
+    if (strlen(ifname) >= IFNAMSIZ || strchr(ifname, '/') != NULL) {
+        return -1;
+    }
+    
+    struct utsname uts;
+    if (uname(&uts) != 0) {
+        return -1;
+    }
+    
+    char path[128];
+    char device[64];
+    char driver[64];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device", ifname);
+    sysfs_link_name(path, device, sizeof(device));
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device/driver", ifname);
+    sysfs_link_name(path, driver, sizeof(driver));
+    
+    int n = snprintf(key, len, "%s|%s|%s|%s|%u|%x", uts.release, ifname, device, driver,
+                     probe_frame_size(packet_size), probe_build_mask());
+    if (n < 0 || (size_t)n >= len) {
+        return -1;
+    }
+    return n;
+}
+
+static int probe_cache_path(const backend_probe_config_t* config, char* path, size_t len) {
+    int n;
+    const char* base;
+    
+    if (config->cache_path) {
+        if (config->cache_path[0] == '\0') {
+            return -1;
+        }
+        n = snprintf(path, len, "%s", config->cache_path);
+    } else if ((base = getenv("NETSTRESS_BACKEND_CACHE")) && base[0]) {
+        n = snprintf(path, len, "%s", base);
+    } else if ((base = getenv("XDG_CACHE_HOME")) && base[0]) {
+        n = snprintf(path, len, "%s/netstress-backends", base);
+    } else if ((base = getenv("HOME")) && base[0]) {
+        snprintf(path, len, "%s/.cache", base);
+        mkdir(path, 0700);
+        n = snprintf(path, len, "%s/.cache/netstress-backends", base);
+    } else {
+        return -1;
+    }
+    return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+/* Cache lines are "<key> <backend> <pps>" */
+static backend_type_t probe_cache_lookup(const char* path, const char* key) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return BACKEND_NONE;
+    }
+    
+    char line[512];
+    char name[32];
+    size_t key_len = strlen(key);
+    backend_type_t found = BACKEND_NONE;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, key_len) == 0 && line[key_len] == ' ' &&
+            sscanf(line + key_len + 1, "%31s", name) == 1) {
+            found = backend_from_name(name);
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+/* Rewrites the cache with this key's line replaced, via rename so
+ * concurrent readers never see a partial file */
+static int probe_cache_store(const char* path, const char* key, backend_type_t backend, double pps) {
+    char tmp[BACKEND_PROBE_PATH_MAX + 16];
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    
+    FILE* out = fopen(tmp, "w");
+    if (!out) {
+        return -1;
+    }
+    
+    FILE* in = fopen(path, "r");
+    if (in) {
+        char line[512];
+        size_t key_len = strlen(key);
+        while (fgets(line, sizeof(line), in)) {
+            if (strncmp(line, key, key_len) != 0 || line[key_len] != ' ') {
+                fputs(line, out);
+            }
+        }
+        fclose(in);
+    }
+    fprintf(out, "%s %s %.0f\n", key, backend_name(backend), pps);
+    
+    if (fclose(out) != 0 || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/* Ethernet/IPv4/UDP calibration frame sourced from the interface's
+ * MAC and address; socket backends send only the UDP payload */
+static void probe_build_frame(uint8_t* frame, uint32_t len, const backend_probe_config_t* config,
+                              uint32_t dst_ip, uint16_t dst_port) {
+    static const uint8_t zero_mac[6] = {0};
+    memset(frame, 0, len);
+    
+    uint32_t src_ip = 0;
+    if (config->ifname) {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd >= 0) {
+            struct ifreq ifr;
+            memset(&ifr, 0, sizeof(ifr));
+            snprintf(ifr.ifr_name, IFNAMSIZ, "%s", config->ifname);
+            if (ioctl(fd, SIOCGIFHWADDR, &ifr) == 0) {
+                memcpy(frame + 6, ifr.ifr_hwaddr.sa_data, 6);
+            }
+            if (ioctl(fd, SIOCGIFADDR, &ifr) == 0) {
+                src_ip = ((struct sockaddr_in*)&ifr.ifr_addr)->sin_addr.s_addr;
+            }
+            close(fd);
+        }
+    }
+    if (memcmp(config->dst_mac, zero_mac, 6) == 0) {
+        memset(frame, 0xFF, 6);
+    } else {
+        memcpy(frame, config->dst_mac, 6);
+    }
+    frame[12] = 0x08;
+    
+    uint8_t* ip = frame + 14;
+    uint16_t ip_len = (uint16_t)(len - 14);
+    ip[0] = 0x45;
+    ip[2] = (uint8_t)(ip_len >> 8);
+    ip[3] = (uint8_t)ip_len;
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    memcpy(ip + 12, &src_ip, 4);
+    memcpy(ip + 16, &dst_ip, 4);
+    uint16_t csum = calculate_checksum(ip, 20);
+    ip[10] = (uint8_t)(csum >> 8);
+    ip[11] = (uint8_t)csum;
+    
+    uint8_t* udp = ip + 20;
+    uint16_t udp_len = (uint16_t)(ip_len - 20);
+    udp[0] = (uint8_t)(dst_port >> 8);
+    udp[1] = (uint8_t)dst_port;
+    udp[2] = (uint8_t)(dst_port >> 8);
+    udp[3] = (uint8_t)dst_port;
+    udp[4] = (uint8_t)(udp_len >> 8);
+    udp[5] = (uint8_t)udp_len;
+    memset(udp + 8, 0xA5, len - BACKEND_PROBE_HDR_LEN);
+}
+
+/* Socket backends only leave through the probed interface when bound to it */
+static int probe_bind_device(int sockfd, const char* ifname) {
+#ifdef SO_BINDTODEVICE
+    return setsockopt(sockfd, SOL_SOCKET, SO_BINDTODEVICE, ifname, (socklen_t)strlen(ifname)) == 0 ? 0 : -1;
+#else
+    (void)sockfd;
+    (void)ifname;
+    return -1;
+#endif
+}
+
+/* Opens one backend, sends config->packets in fixed batches and times it */
+static void probe_backend(backend_type_t backend, const backend_probe_config_t* config,
+                          const uint8_t* frame, uint32_t frame_len, uint32_t dst_ip,
+                          uint16_t dst_port, int frames_ok, backend_probe_result_t* result) {
+    const uint8_t* packets[BACKEND_PROBE_BATCH];
+    uint32_t lengths[BACKEND_PROBE_BATCH];
+    struct sockaddr_in dests[BACKEND_PROBE_BATCH];
+    int frames = backend == BACKEND_AF_XDP || backend == BACKEND_DPDK;
+    uint64_t target = config->packets ? config->packets : BACKEND_PROBE_PACKETS;
+    
+    for (int i = 0; i < BACKEND_PROBE_BATCH; i++) {
+        packets[i] = frames ? frame : frame + BACKEND_PROBE_HDR_LEN;
+        lengths[i] = frames ? frame_len : frame_len - BACKEND_PROBE_HDR_LEN;
+        memset(&dests[i], 0, sizeof(dests[i]));
+        dests[i].sin_family = AF_INET;
+        dests[i].sin_addr.s_addr = dst_ip;
+        dests[i].sin_port = htons(dst_port);
+    }
+    
+    memset(result, 0, sizeof(*result));
+    result->backend = backend;
+    result->status = -1;
+    
+    int sockfd = -1;
+    sendmmsg_ctx_t* mctx = NULL;
+    io_uring_ctx_t* uctx = NULL;
+    af_xdp_queue_t* xq = NULL;
+    int ready = 0;
+    
+    switch (backend) {
+        case BACKEND_RAW_SOCKET:
+            sockfd = raw_socket_create(IPPROTO_UDP);
+            ready = sockfd >= 0;
+            break;
+        case BACKEND_SENDMMSG:
+            sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+            mctx = sockfd >= 0 ? sendmmsg_ctx_create(sockfd, BACKEND_PROBE_BATCH) : NULL;
+            ready = mctx != NULL;
+            break;
+        case BACKEND_IO_URING: {
+            io_uring_config_t cfg;
+            memset(&cfg, 0, sizeof(cfg));
+            uctx = io_uring_ctx_create(&cfg);
+            ready = uctx != NULL;
+            break;
+        }
+        case BACKEND_AF_XDP:
+            xq = frames_ok ? af_xdp_queue_create(config->ifname, 0, NULL) : NULL;
+            ready = xq != NULL;
+            break;
+        case BACKEND_DPDK:
+            ready = frames_ok && dpdk_get_queue_count(config->dpdk_port) > 0;
+            break;
+        default:
+            break;
+    }
+    
+    /* Frame backends always use the NIC; socket ones only when bound to it */
+    if (ready && frames) {
+        result->nic_bound = 1;
+    } else if (ready && frames_ok) {
+        int fd = uctx ? io_uring_ctx_fd(uctx) : sockfd;
+        result->nic_bound = fd >= 0 && probe_bind_device(fd, config->ifname) == 0;
+    }
+    
+    uint64_t start = get_timestamp_ns();
+    uint64_t now = start;
+    while (ready && result->packets < target) {
+        uint32_t n = (uint32_t)(target - result->packets < BACKEND_PROBE_BATCH ?
+                                target - result->packets : BACKEND_PROBE_BATCH);
+        int ret;
+        switch (backend) {
+            case BACKEND_RAW_SOCKET:
+                /* The kernel adds the IP header */
+                ret = raw_socket_send(sockfd, dst_ip, frame + 34, frame_len - 34) > 0 ? 1 : -1;
+                break;
+            case BACKEND_SENDMMSG:
+                ret = sendmmsg_ctx_send_same_dest(mctx, packets, lengths, dst_ip, dst_port, n);
+                break;
+            case BACKEND_IO_URING:
+                ret = io_uring_ctx_send_batch(uctx, packets, lengths, dests, n);
+                break;
+            case BACKEND_AF_XDP:
+                ret = af_xdp_queue_send_batch(xq, packets, lengths, n);
+                break;
+            default:
+                ret = dpdk_send_burst_queue(config->dpdk_port, 0, packets, lengths, n);
+                break;
+        }
+        if (ret < 0) {
+            ready = 0;
+            break;
+        }
+        result->packets += (uint64_t)ret;
+        now = get_timestamp_ns();
+        if (now - start > BACKEND_PROBE_TIMEOUT_NS) {
+            break;
+        }
+    }
+    if (uctx) {
+        io_uring_ctx_drain(uctx);
+        now = get_timestamp_ns();
+    }
+    
+    if (ready && result->packets > 0) {
+        result->status = 0;
+        result->elapsed_ns = now > start ? now - start : 1;
+        result->pps = (double)result->packets * 1e9 / (double)result->elapsed_ns;
+    }
+    
+    io_uring_ctx_destroy(uctx);
+    af_xdp_queue_destroy(xq);
+    sendmmsg_ctx_destroy(mctx);
+    if (sockfd >= 0) {
+        close(sockfd);
+    }
+}
+
+int backend_probe_run(const backend_probe_config_t* config, backend_probe_result_t* results, int max_results) {
+    if (!config || !results || max_results <= 0) {
+        return -1;
+    }
+    
+    uint32_t dst_ip = config->dst_ip;
+    uint16_t dst_port = config->dst_port;
+    int sink = -1;
+    
+    /* Without a sink address, socket backends send to a bound loopback
+     * socket nobody reads; the kernel drops once its buffer fills */
+    if (dst_ip == 0) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sink = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sink < 0 || bind(sink, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+            getsockname(sink, (struct sockaddr*)&addr, &addr_len) != 0) {
+            if (sink >= 0) {
+                close(sink);
+            }
+            return -1;
+        }
+        dst_ip = addr.sin_addr.s_addr;
+        dst_port = ntohs(addr.sin_port);
+    }
+    
+    uint8_t frame[BACKEND_PROBE_MAX_FRAME];
+    uint32_t frame_len = probe_frame_size(config->packet_size);
+    probe_build_frame(frame, frame_len, config, dst_ip, dst_port);
+    
+    /* Frames leave through the NIC, so never aim them at the private sink */
+    int frames_ok = config->ifname && config->ifname[0] && config->dst_ip != 0;
+    
+    int count = 0;
+    for (size_t i = 0; i < sizeof(probe_candidates) / sizeof(probe_candidates[0]) && count < max_results; i++) {
+        probe_backend(probe_candidates[i], config, frame, frame_len, dst_ip, dst_port, frames_ok,
+                      &results[count++]);
+    }
+    
+    if (sink >= 0) {
+        close(sink);
+    }
+    return count;
+}
+
+backend_type_t select_backend_measured(const backend_probe_config_t* config, const system_capabilities_t* caps) {
+    backend_probe_config_t defaults;
+    if (!config) {
+        memset(&defaults, 0, sizeof(defaults));
+        config = &defaults;
+    }
+    
+    char key[BACKEND_PROBE_PATH_MAX];
+    char path[BACKEND_PROBE_PATH_MAX];
+    int cached = backend_probe_cache_key(config->ifname, config->packet_size, key, sizeof(key)) > 0 &&
+                 probe_cache_path(config, path, sizeof(path)) == 0;
+    
+    if (cached) {
+        backend_type_t backend = probe_cache_lookup(path, key);
+        int usable = backend != BACKEND_NONE;
+        if (caps && backend == BACKEND_IO_URING) {
+            usable = caps->has_io_uring;
+        } else if (caps && backend == BACKEND_AF_XDP) {
+            usable = caps->has_af_xdp;
+        } else if (caps && backend == BACKEND_DPDK) {
+            usable = caps->has_dpdk;
+        }
+        if (usable) {
+            return backend;
+        }
+    }
+    
+    backend_probe_result_t results[sizeof(probe_candidates) / sizeof(probe_candidates[0])];
+    int count = backend_probe_run(config, results, (int)(sizeof(results) / sizeof(results[0])));
+    
+    const backend_probe_result_t* best = NULL;
+    for (int i = 0; i < count; i++) {
+        if (results[i].status == 0 && (!best || results[i].pps > best->pps)) {
+            best = &results[i];
+        }
+    }
+    if (!best) {
+        system_capabilities_t detected;
+        if (!caps) {
+            detect_capabilities(&detected);
+            caps = &detected;
+        }
+        return select_best_backend(caps);
+    }
+    
+    /* A winner measured off the interface says nothing about the NIC */
+    int has_ifname = config->ifname && config->ifname[0];
+    if (cached && (!has_ifname || best->nic_bound)) {
+        probe_cache_store(path, key, best->backend, best->pps);
+    }
+    return best->backend;
+}
+
+#else
+
+int backend_probe_cache_key(const char* ifname, uint32_t packet_size, char* key, size_t len) {
+    (void)ifname;
+    (void)packet_size;
+    (void)key;
+    (void)len;
+    return -1;
+}
+
+int backend_probe_run(const backend_probe_config_t* config, backend_probe_result_t* results, int max_results) {
+    (void)config;
+    (void)results;
+    (void)max_results;
+    return -1;
+}
+
+backend_type_t select_backend_measured(const backend_probe_config_t* config, const system_capabilities_t* caps) {
+    system_capabilities_t detected;
+    (void)config;
+    if (!caps) {
+        detect_capabilities(&detected);
+        caps = &detected;
+    }
+    return select_best_backend(caps);
+}
+
+#endif /* __linux__ */
+
+/* ============================================================================
+ * Backend Instances
+ * ============================================================================ */
+
+#define BACKEND_DEFAULT_BURST 256
+#define BACKEND_RX_SLOTS 64
+#define BACKEND_RX_SLOT_SIZE 2048
+
+struct netstress_backend {
+    const netstress_backend_ops_t* ops;
+    void* state;
+    driver_stats_t counted;     /* Dispatch-level counts for backends without their own */
+    tap_ring_t* tx_tap;
+    tap_ring_t* rx_tap;
+    tx_burst_ctl_t burst;
+};
+
+#define TX_BURST_DEFAULT 32
+#define TX_BURST_MAX 1024
+
+static inline uint32_t tx_burst_clamp(const tx_burst_ctl_t* ctl, uint32_t burst) {
+    if (burst < ctl->min_burst) {
+        return ctl->min_burst;
+    }
+    return burst > ctl->max_burst ? ctl->max_burst : burst;
+}
+
+void tx_burst_ctl_init(tx_burst_ctl_t* ctl, uint32_t burst, uint32_t min_burst, uint32_t max_burst) {
+    if (ctl == NULL) {
+        return;
+    }
+    ctl->min_burst = min_burst > 0 ? min_burst : 1;
+    ctl->max_burst = max_burst > 0 ? max_burst : burst;
+    if (ctl->max_burst < ctl->min_burst) {
+        ctl->max_burst = ctl->min_burst;
+    }
+    ctl->burst = tx_burst_clamp(ctl, burst);
+}
+
+uint32_t tx_burst_ctl_update(tx_burst_ctl_t* ctl, uint32_t offered, const tx_result_t* result) {
+    if (ctl == NULL) {
+        return 0;
+    }
+    if (result == NULL || offered == 0) {
+        return ctl->burst;
+    }
+    
+    /* Held packets were built but refused: they count against the burst */
+    uint32_t delivered = result->accepted > result->held ? result->accepted - result->held : 0;
+    if (result->accepted < offered || result->held > 0) {
+        uint32_t next = delivered < ctl->burst ? delivered : ctl->burst;
+        ctl->burst = tx_burst_clamp(ctl, next > ctl->burst / 2 ? next : ctl->burst / 2);
+        return ctl->burst;
+    }
+    
+    /* Grow only when the caller used the whole burst and the ring can take more */
+    uint32_t headroom = result->ring_size > result->ring_used ? result->ring_size - result->ring_used : 0;
+    if (offered >= ctl->burst && (result->ring_size == 0 || headroom >= ctl->burst)) {
+        uint32_t step = ctl->burst / 8 > 0 ? ctl->burst / 8 : 1;
+        ctl->burst = tx_burst_clamp(ctl, ctl->burst + step);
+    }
+    return ctl->burst;
+}
+
+void netstress_backend_config_init(netstress_backend_config_t* config, const driver_config_t* base) {
+    if (!config) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    if (base) {
+        config->base = *base;
+    }
+}
+
+/* Shared state of the socket backends (raw, sendmmsg, io_uring) */
+typedef struct {
+    int sockfd;
+    int owns_fd;
+    uint32_t dst_ip;
+    uint16_t dst_port;
+    uint32_t max_batch;
+    sendmmsg_ctx_t* mctx;
+    io_uring_ctx_t* uctx;
+    struct sockaddr_in* dests;  /* io_uring: max_batch copies of the destination */
+    uint8_t* rx_buffers;        /* BACKEND_RX_SLOTS x BACKEND_RX_SLOT_SIZE */
+    uint32_t rx_next;           /* First slot not lent out */
+    uint32_t rx_lent;           /* Slots lent and not yet released */
+} sock_backend_t;
+
+static sock_backend_t* sock_backend_alloc(const netstress_backend_config_t* config) {
+    sock_backend_t* s = (sock_backend_t*)calloc(1, sizeof(*s));
+    if (!s) {
+        return NULL;
+    }
+    s->sockfd = -1;
+    s->dst_ip = config->dst_ip;
+    s->dst_port = config->dst_port;
+    s->max_batch = config->base.burst_size ? config->base.burst_size : BACKEND_DEFAULT_BURST;
+    return s;
+}
+
+static int sock_backend_bind(sock_backend_t* s, uint16_t port) {
+    if (port == 0) {
+        return 0;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(s->sockfd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        return -1;
+    }
+    s->rx_buffers = (uint8_t*)malloc((size_t)BACKEND_RX_SLOTS * BACKEND_RX_SLOT_SIZE);
+    return s->rx_buffers ? 0 : -1;
+}
+
+static void sock_backend_close(void* state) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    if (!s) {
+        return;
+    }
+    io_uring_ctx_drain(s->uctx);
+    io_uring_ctx_destroy(s->uctx);
+    sendmmsg_ctx_destroy(s->mctx);
+    if (s->owns_fd && s->sockfd >= 0) {
+        CLOSE_SOCKET(s->sockfd);
+    }
+    free(s->dests);
+    free(s->rx_buffers);
+    free(s);
+}
+
+/* Non-blocking receive into the instance's slots; needs bind_port */
+static int sock_backend_recv(void* state, rx_desc_t* descs, uint32_t max_count) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    if (!s->rx_buffers) {
+        return -1;
+    }
+    uint32_t n = BACKEND_RX_SLOTS - s->rx_next;
+    if (n > max_count) {
+        n = max_count;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    
+#ifdef __linux__
+    struct mmsghdr msgs[BACKEND_RX_SLOTS];
+    struct iovec iovs[BACKEND_RX_SLOTS];
+    memset(msgs, 0, sizeof(struct mmsghdr) * n);
+    for (uint32_t i = 0; i < n; i++) {
+        iovs[i].iov_base = s->rx_buffers + (size_t)(s->rx_next + i) * BACKEND_RX_SLOT_SIZE;
+        iovs[i].iov_len = BACKEND_RX_SLOT_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int got = recvmmsg(s->sockfd, msgs, n, MSG_DONTWAIT, NULL);
+    if (got < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    for (int i = 0; i < got; i++) {
+        descs[i].data = (uint8_t*)iovs[i].iov_base;
+        descs[i].len = msgs[i].msg_len;
+        descs[i].reserved = 0;
+        descs[i].handle = s->rx_next + (uint32_t)i;
+    }
+    s->rx_next += (uint32_t)got;
+    s->rx_lent += (uint32_t)got;
+    return got;
+#else
+    (void)descs;
+    return -1;
+#endif
+}
+
+/* Slots are recycled once every lent descriptor has come back */
+static int sock_backend_release(void* state, const rx_desc_t* descs, uint32_t count) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    (void)descs;
+    if (count > s->rx_lent) {
+        return -1;
+    }
+    s->rx_lent -= count;
+    if (s->rx_lent == 0) {
+        s->rx_next = 0;
+    }
+    return (int)count;
+}
+
+static void* raw_backend_open(const netstress_backend_config_t* config) {
+    sock_backend_t* s = sock_backend_alloc(config);
+    if (!s) {
+        return NULL;
+    }
+    s->sockfd = raw_socket_create(IPPROTO_RAW);
+    if (s->sockfd < 0 || raw_socket_set_hdrincl(s->sockfd) != 0) {
+        if (s->sockfd >= 0) {
+            raw_socket_close(s->sockfd);
+        }
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static int raw_backend_send(void* state, const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    uint32_t sent = 0;
+    int ret = 0;
+    while (sent < count && (ret = raw_socket_send_ip(s->sockfd, packets[sent], lengths[sent])) > 0) {
+        sent++;
+    }
+    return sent > 0 || ret >= 0 ? (int)sent : -1;
+}
+
+static int raw_backend_send_pkt(void* state, const pkt_batch_t* batch, uint32_t first) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    uint32_t sent = first;
+    int ret = 0;
+    while (sent < batch->count &&
+           (ret = raw_socket_send_ip(s->sockfd, batch->arena + batch->offsets[sent], batch->lengths[sent])) > 0) {
+        sent++;
+    }
+    return sent > first || ret >= 0 ? (int)(sent - first) : -1;
+}
+
+static void raw_backend_close(void* state) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    if (s) {
+        raw_socket_close(s->sockfd);
+        free(s);
+    }
+}
+
+static void* sendmmsg_backend_open(const netstress_backend_config_t* config) {
+    sock_backend_t* s = sock_backend_alloc(config);
+    if (!s) {
+        return NULL;
+    }
+    s->sockfd = (int)socket(AF_INET, SOCK_DGRAM, 0);
+    s->owns_fd = 1;
+    if (s->sockfd >= 0) {
+        s->mctx = sendmmsg_ctx_create(s->sockfd, s->max_batch);
+    }
+    if (!s->mctx || sock_backend_bind(s, config->bind_port) != 0) {
+        sock_backend_close(s);
+        return NULL;
+    }
+    return s;
+}
+
+static int sendmmsg_backend_send(void* state, const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    return sendmmsg_ctx_send_same_dest(s->mctx, packets, lengths, s->dst_ip, s->dst_port, count);
+}
+
+static int sendmmsg_backend_send_to(void* state, const uint8_t** packets, const uint32_t* lengths,
+                                    const struct sockaddr_in* dests, uint32_t count) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    return sendmmsg_ctx_send(s->mctx, packets, lengths, dests, count);
+}
+
+/* Batches without any destination go to the instance's */
+static const pkt_batch_t* sock_backend_batch_dest(const sock_backend_t* s, const pkt_batch_t* batch,
+                                                  pkt_batch_t* scratch) {
+    if (batch->dst_ips || batch->dst_ports || batch->dst_ip != 0) {
+        return batch;
+    }
+    *scratch = *batch;
+    scratch->dst_ip = s->dst_ip;
+    scratch->dst_port = s->dst_port;
+    return scratch;
+}
+
+static int sendmmsg_backend_send_pkt(void* state, const pkt_batch_t* batch, uint32_t first) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    pkt_batch_t scratch;
+    return sendmmsg_ctx_send_pkt_batch(s->mctx, sock_backend_batch_dest(s, batch, &scratch), first);
+}
+
+static const netstress_backend_ops_t raw_backend_ops = {
+    BACKEND_RAW_SOCKET, BACKEND_LAYER_L3,
+    raw_backend_open, raw_backend_send, raw_backend_send_pkt, NULL, NULL, NULL, NULL, raw_backend_close, NULL
+};
+
+static const netstress_backend_ops_t sendmmsg_backend_ops = {
+    BACKEND_SENDMMSG, BACKEND_LAYER_PAYLOAD,
+    sendmmsg_backend_open, sendmmsg_backend_send, sendmmsg_backend_send_pkt,
+    sock_backend_recv, sock_backend_release,
+    NULL, NULL, sock_backend_close, sendmmsg_backend_send_to
+};
+
+#ifdef HAS_IO_URING
+
+static void* uring_backend_open(const netstress_backend_config_t* config) {
+    sock_backend_t* s = sock_backend_alloc(config);
+    if (!s) {
+        return NULL;
+    }
+    s->uctx = io_uring_ctx_create(config->io_uring);
+    s->dests = (struct sockaddr_in*)calloc(s->max_batch, sizeof(struct sockaddr_in));
+    if (!s->uctx || !s->dests) {
+        sock_backend_close(s);
+        return NULL;
+    }
+    s->sockfd = s->uctx->sockfd;
+    for (uint32_t i = 0; i < s->max_batch; i++) {
+        s->dests[i].sin_family = AF_INET;
+        s->dests[i].sin_addr.s_addr = s->dst_ip;
+        s->dests[i].sin_port = htons(s->dst_port);
+    }
+    if (sock_backend_bind(s, config->bind_port) != 0) {
+        sock_backend_close(s);
+        return NULL;
+    }
+    return s;
+}
+
+static int uring_backend_send(void* state, const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    uint32_t n = count < s->max_batch ? count : s->max_batch;
+    return io_uring_ctx_send_batch(s->uctx, packets, lengths, s->dests, n);
+}
+
+static int uring_backend_send_to(void* state, const uint8_t** packets, const uint32_t* lengths,
+                                 const struct sockaddr_in* dests, uint32_t count) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    return io_uring_ctx_send_batch(s->uctx, packets, lengths, dests, count);
+}
+
+static int uring_backend_send_pkt(void* state, const pkt_batch_t* batch, uint32_t first) {
+    sock_backend_t* s = (sock_backend_t*)state;
+    pkt_batch_t scratch;
+    return io_uring_ctx_send_pkt_batch(s->uctx, sock_backend_batch_dest(s, batch, &scratch), first);
+}
+
+static int uring_backend_stats(const void* state, driver_stats_t* stats) {
+    return io_uring_ctx_get_stats(((const sock_backend_t*)state)->uctx, stats);
+}
+
+static int uring_backend_tx_ring(const void* state, tx_result_t* result) {
+    return io_uring_ctx_get_tx_ring(((const sock_backend_t*)state)->uctx, &result->ring_used, &result->ring_size);
+}
+
+static const netstress_backend_ops_t uring_backend_ops = {
+    BACKEND_IO_URING, BACKEND_LAYER_PAYLOAD,
+    uring_backend_open, uring_backend_send, uring_backend_send_pkt,
+    sock_backend_recv, sock_backend_release,
+    uring_backend_stats, uring_backend_tx_ring, sock_backend_close, uring_backend_send_to
+};
+
+#endif /* HAS_IO_URING */
+
+#ifdef HAS_AF_XDP
+
+static void* xdp_backend_open(const netstress_backend_config_t* config) {
+    if (!config->base.interface) {
+        return NULL;
+    }
+    return af_xdp_queue_create(config->base.interface, config->queue_id, config->af_xdp);
+}
+
+static int xdp_backend_send(void* state, const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
+    return af_xdp_queue_send_batch((af_xdp_queue_t*)state, packets, lengths, count);
+}
+
+static int xdp_backend_send_pkt(void* state, const pkt_batch_t* batch, uint32_t first) {
+    return af_xdp_queue_send_pkt_batch((af_xdp_queue_t*)state, batch, first);
+}
+
+static int xdp_backend_recv(void* state, rx_desc_t* descs, uint32_t max_count) {
+    return af_xdp_queue_rx_borrow((af_xdp_queue_t*)state, descs, max_count);
+}
+
+static int xdp_backend_release(void* state, const rx_desc_t* descs, uint32_t count) {
+    return af_xdp_queue_rx_release((af_xdp_queue_t*)state, descs, count);
+}
+
+static int xdp_backend_stats(const void* state, driver_stats_t* stats) {
+    return af_xdp_queue_get_stats((const af_xdp_queue_t*)state, stats);
+}
+
+static int xdp_backend_tx_ring(const void* state, tx_result_t* result) {
+    return af_xdp_queue_get_tx_ring((const af_xdp_queue_t*)state, &result->ring_used, &result->ring_size);
+}
+
+static void xdp_backend_close(void* state) {
+    af_xdp_queue_destroy((af_xdp_queue_t*)state);
+}
+
+static const netstress_backend_ops_t xdp_backend_ops = {
+    BACKEND_AF_XDP, BACKEND_LAYER_L2,
+    xdp_backend_open, xdp_backend_send, xdp_backend_send_pkt,
+    xdp_backend_recv, xdp_backend_release,
+    xdp_backend_stats, xdp_backend_tx_ring, xdp_backend_close, NULL
+};
+
+#endif /* HAS_AF_XDP */
+
+#ifdef HAS_DPDK
+
+typedef struct {
+    int port_id;
+    uint16_t queue_id;
+} dpdk_backend_t;
+
+/* The port must already be initialized; the instance owns one queue and
+ * holds refused mbufs for retry */
+static void* dpdk_backend_open(const netstress_backend_config_t* config) {
+    if ((int)config->queue_id >= dpdk_get_queue_count(config->base.port_id)) {
+        return NULL;
+    }
+    dpdk_backend_t* d = (dpdk_backend_t*)calloc(1, sizeof(*d));
+    if (!d) {
+        return NULL;
+    }
+    d->port_id = config->base.port_id;
+    d->queue_id = (uint16_t)config->queue_id;
+    if (dpdk_set_queue_tx_hold(d->port_id, d->queue_id, 1) != 0) {
+        free(d);
+        return NULL;
+    }
+    return d;
+}
+
+static int dpdk_backend_send(void* state, const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
+    dpdk_backend_t* d = (dpdk_backend_t*)state;
+    return dpdk_send_burst_queue(d->port_id, d->queue_id, packets, lengths, count);
+}
+
+static int dpdk_backend_send_pkt(void* state, const pkt_batch_t* batch, uint32_t first) {
+    dpdk_backend_t* d = (dpdk_backend_t*)state;
+    return dpdk_send_pkt_batch(d->port_id, d->queue_id, batch, first);
+}
+
+static int dpdk_backend_recv(void* state, rx_desc_t* descs, uint32_t max_count) {
+    dpdk_backend_t* d = (dpdk_backend_t*)state;
+    return dpdk_rx_burst_borrow(d->port_id, d->queue_id, descs, max_count);
+}
+
+static int dpdk_backend_release(void* state, const rx_desc_t* descs, uint32_t count) {
+    (void)state;
+    dpdk_rx_release((rx_desc_t*)descs, count);
+    return (int)count;
+}
+
+/* Ring occupancy is not observable without experimental ethdev calls */
+static int dpdk_backend_tx_ring(const void* state, tx_result_t* result) {
+    const dpdk_backend_t* d = (const dpdk_backend_t*)state;
+    int held = dpdk_get_queue_tx_held(d->port_id, d->queue_id);
+    if (held < 0) {
+        return -1;
+    }
+    result->held = (uint32_t)held;
+    return 0;
+}
+
+static void dpdk_backend_close(void* state) {
+    dpdk_backend_t* d = (dpdk_backend_t*)state;
+    dpdk_set_queue_tx_hold(d->port_id, d->queue_id, 0);
+    free(d);
+}
+
+static const netstress_backend_ops_t dpdk_backend_ops = {
+    BACKEND_DPDK, BACKEND_LAYER_L2,
+    dpdk_backend_open, dpdk_backend_send, dpdk_backend_send_pkt,
+    dpdk_backend_recv, dpdk_backend_release,
+    NULL, dpdk_backend_tx_ring, dpdk_backend_close, NULL
+};
+
+#endif /* HAS_DPDK */
+
+const netstress_backend_ops_t* netstress_backend_ops(backend_type_t type) {
+    switch (type) {
+        case BACKEND_RAW_SOCKET: return &raw_backend_ops;
+        case BACKEND_SENDMMSG: return &sendmmsg_backend_ops;
+#ifdef HAS_IO_URING
+        case BACKEND_IO_URING: return &uring_backend_ops;
+#endif
+#ifdef HAS_AF_XDP
+        case BACKEND_AF_XDP: return &xdp_backend_ops;
+#endif
+#ifdef HAS_DPDK
+        case BACKEND_DPDK: return &dpdk_backend_ops;
+#endif
+        default: return NULL;
+    }
+}
+
+netstress_backend_t* netstress_backend_open(backend_type_t type, const netstress_backend_config_t* config) {
+    const netstress_backend_ops_t* ops = netstress_backend_ops(type);
+    if (!ops || !config) {
+        return NULL;
+    }
+    
+    netstress_backend_t* backend = (netstress_backend_t*)calloc(1, sizeof(*backend));
+    if (!backend) {
+        return NULL;
+    }
+    backend->ops = ops;
+    backend->state = ops->open(config);
+    if (!backend->state) {
+        free(backend);
+        return NULL;
+    }
+    uint32_t burst = config->base.burst_size > 0 ? config->base.burst_size : TX_BURST_DEFAULT;
+    tx_burst_ctl_init(&backend->burst, burst, 1, burst > TX_BURST_MAX ? burst : TX_BURST_MAX);
+    return backend;
+}
+
+/* Count a send of packets[0..sent) and tap it */
+static int backend_count_tx(netstress_backend_t* backend, const uint8_t** packets,
+                            const uint32_t* lengths, int sent) {
+    if (sent < 0) {
+        backend->counted.errors++;
+        return sent;
+    }
+    backend->counted.packets_sent += (uint64_t)sent;
+    for (int i = 0; i < sent; i++) {
+        backend->counted.bytes_sent += lengths[i];
+    }
+    if (SHIM_UNLIKELY(backend->tx_tap != NULL)) {
+        pkt_src_t src = {packets, NULL, NULL};
+        tap_record_src(backend->tx_tap, &src, lengths, (uint32_t)sent, TAP_DIR_TX);
+    }
+    return sent;
+}
+
+int netstress_backend_send_batch(netstress_backend_t* backend, const uint8_t** packets,
+                                 const uint32_t* lengths, uint32_t count) {
+    if (!backend || !packets || !lengths) {
+        return -1;
+    }
+    return backend_count_tx(backend, packets, lengths,
+                            backend->ops->send_batch(backend->state, packets, lengths, count));
+}
+
+int netstress_backend_send_batch_to(netstress_backend_t* backend, const uint8_t** packets,
+                                    const uint32_t* lengths, const struct sockaddr_in* dests,
+                                    uint32_t count) {
+    if (!backend || !packets || !lengths || !dests || !backend->ops->send_to) {
+        return -1;
+    }
+    return backend_count_tx(backend, packets, lengths,
+                            backend->ops->send_to(backend->state, packets, lengths, dests, count));
+}
+
+int netstress_backend_send_pkt_batch(netstress_backend_t* backend, const pkt_batch_t* batch, uint32_t first) {
+    if (!backend || !batch || first > batch->count) {
+        return -1;
+    }
+    
+    int sent = backend->ops->send_pkt_batch(backend->state, batch, first);
+    if (sent < 0) {
+        backend->counted.errors++;
+        return sent;
+    }
+    backend->counted.packets_sent += (uint64_t)sent;
+    for (int i = 0; i < sent; i++) {
+        backend->counted.bytes_sent += batch->lengths[first + (uint32_t)i];
+    }
+    if (SHIM_UNLIKELY(backend->tx_tap != NULL)) {
+        pkt_src_t src = pkt_src_from_batch(batch, first);
+        tap_record_src(backend->tx_tap, &src, batch->lengths + first, (uint32_t)sent, TAP_DIR_TX);
+    }
+    return sent;
+}
+
+/* Fill the outcome of a send of offered packets and feed the controller */
+static void backend_tx_result(netstress_backend_t* backend, uint32_t offered, int accepted,
+                              tx_result_t* result) {
+    tx_result_t r;
+    memset(&r, 0, sizeof(r));
+    r.accepted = accepted > 0 ? (uint32_t)accepted : 0;
+    if (backend->ops->tx_ring) {
+        backend->ops->tx_ring(backend->state, &r);
+    }
+    r.next_burst = tx_burst_ctl_update(&backend->burst, offered, &r);
+    if (result) {
+        *result = r;
+    }
+}
+
+int netstress_backend_send_batch_ex(netstress_backend_t* backend, const uint8_t** packets,
+                                    const uint32_t* lengths, uint32_t count, tx_result_t* result) {
+    int accepted = netstress_backend_send_batch(backend, packets, lengths, count);
+    if (backend) {
+        backend_tx_result(backend, count, accepted, result);
+    }
+    return accepted;
+}
+
+int netstress_backend_send_pkt_batch_ex(netstress_backend_t* backend, const pkt_batch_t* batch,
+                                        uint32_t first, tx_result_t* result) {
+    int accepted = netstress_backend_send_pkt_batch(backend, batch, first);
+    if (backend && batch && first <= batch->count) {
+        backend_tx_result(backend, batch->count - first, accepted, result);
+    }
+    return accepted;
+}
+
+uint32_t netstress_backend_burst(const netstress_backend_t* backend) {
+    return backend ? backend->burst.burst : 0;
+}
+
+int netstress_backend_set_burst_limits(netstress_backend_t* backend, uint32_t min_burst, uint32_t max_burst) {
+    if (!backend) {
+        return -1;
+    }
+    tx_burst_ctl_init(&backend->burst, backend->burst.burst, min_burst,
+                      max_burst > 0 ? max_burst : backend->burst.max_burst);
+    return 0;
+}
+
+int netstress_backend_recv_batch(netstress_backend_t* backend, rx_desc_t* descs, uint32_t max_count) {
+    if (!backend || !descs || !backend->ops->recv_batch) {
+        return -1;
+    }
+    
+    int got = backend->ops->recv_batch(backend->state, descs, max_count);
+    if (got < 0) {
+        backend->counted.errors++;
+        return got;
+    }
+    backend->counted.packets_received += (uint64_t)got;
+    for (int i = 0; i < got; i++) {
+        backend->counted.bytes_received += descs[i].len;
+    }
+    if (SHIM_UNLIKELY(backend->rx_tap != NULL)) {
+        tap_record_descs(backend->rx_tap, descs, (uint32_t)got);
+    }
+    return got;
+}
+
+int netstress_backend_release(netstress_backend_t* backend, const rx_desc_t* descs, uint32_t count) {
+    if (!backend || !descs || !backend->ops->release) {
+        return -1;
+    }
+    return backend->ops->release(backend->state, descs, count);
+}
+
+int netstress_backend_get_stats(const netstress_backend_t* backend, driver_stats_t* stats) {
+    if (!backend || !stats) {
+        return -1;
+    }
+    if (backend->ops->stats) {
+        return backend->ops->stats(backend->state, stats);
+    }
+    *stats = backend->counted;
+    return 0;
+}
+
+int netstress_backend_set_tap(netstress_backend_t* backend, tap_ring_t* tx_ring, tap_ring_t* rx_ring) {
+    if (!backend) {
+        return -1;
+    }
+    backend->tx_tap = tx_ring;
+    backend->rx_tap = rx_ring;
+    return 0;
+}
+
+backend_type_t netstress_backend_type(const netstress_backend_t* backend) {
+    return backend ? backend->ops->type : BACKEND_NONE;
+}
+
+int netstress_backend_layer(const netstress_backend_t* backend) {
+    return backend ? (int)backend->ops->layer : -1;
+}
+
+void netstress_backend_close(netstress_backend_t* backend) {
+    if (!backend) {
+        return;
+    }
+    backend->ops->close(backend->state);
+    free(backend);
+}
+
+/* ============================================================================
+ * Capture Replay
+ * ============================================================================ */
+
+#define REPLAY_DEFAULT_BATCH 64
+#define REPLAY_SEND_SPINS 1024          /* Empty sends before a packet is dropped */
+
+void pcap_replay_config_init(pcap_replay_config_t* config) {
+    if (config == NULL) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->layer = BACKEND_LAYER_L2;
+    config->mode = REPLAY_MAX_RATE;
+    config->speed = 1.0;
+    config->loops = 1;
+    config->batch_size = REPLAY_DEFAULT_BATCH;
+    config->shard_count = 1;
+}
+
+#ifndef _WIN32
+
+/*
+ * Each cursor parses the records in file order with its own walker, so
+ * nothing is indexed up front and a capture of any size streams through
+ * the page cache. pcapng state (byte order, interfaces) is per section.
+ */
+#define PCAP_MAGIC_US 0xA1B2C3D4u
+#define PCAP_MAGIC_NS 0xA1B23C4Du
+#define PCAPNG_SHB 0x0A0D0D0Au
+#define PCAPNG_IDB 1u
+#define PCAPNG_PB 2u
+#define PCAPNG_SPB 3u
+#define PCAPNG_EPB 6u
+#define PCAPNG_BYTE_ORDER 0x1A2B3C4Du
+#define PCAPNG_OPT_TSRESOL 9
+#define PCAPNG_MAX_IFACES 64
+
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_IPV4 228
+
+struct pcap_replay {
+    uint8_t* base;
+    size_t size;
+    int format;
+};
+
+typedef struct {
+    size_t pos;
+    int swapped;
+    int nsec;                   /* Classic pcap with nanosecond timestamps */
+    uint16_t linktype;          /* Classic pcap */
+    uint32_t iface_count;
+    uint16_t iface_linktype[PCAPNG_MAX_IFACES];
+    uint8_t iface_tsresol[PCAPNG_MAX_IFACES];
+    uint64_t last_ns;           /* For simple packet blocks, which carry no time */
+} pcap_walk_t;
+
+typedef struct {
+    uint8_t* data;
+    uint32_t caplen;
+    uint32_t origlen;
+    uint64_t ts_ns;
+    uint16_t linktype;
+} pcap_record_t;
+
+struct pcap_cursor {
+    pcap_replay_t* replay;
+    pcap_replay_config_t config;
+    pcap_walk_t walk;
+    pcap_record_t pending;
+    int have_pending;
+    int started;
+    int finished;
+    uint64_t index;             /* Record index within the pass */
+    uint64_t first_ns;          /* Capture time of the first record */
+    uint64_t last_ns;           /* Capture time of the latest record */
+    uint64_t origin_ns;         /* When first_ns is due in this pass */
+    uint64_t pass_packets;
+    uint32_t rewrite_net;       /* Host order */
+    uint32_t rewrite_mask;
+    pcap_cursor_stats_t stats;
+    const uint8_t** packets;
+    uint32_t* lengths;
+    struct sockaddr_in* dests;
+};
+
+static inline uint32_t pcap_u32(const pcap_walk_t* w, const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return w->swapped ? __builtin_bswap32(v) : v;
+}
+
+static inline uint16_t pcap_u16(const pcap_walk_t* w, const uint8_t* p) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return w->swapped ? __builtin_bswap16(v) : v;
+}
+
+/* if_tsresol: bit 7 set means 2^-n seconds per unit, otherwise 10^-n */
+static uint64_t pcapng_ts_ns(uint64_t units, uint8_t tsresol) {
+    uint32_t exp = tsresol & 0x7F;
+    if (tsresol & 0x80) {
+        if (exp > 32) {
+            exp = 32;
+        }
+        uint64_t frac = units & ((1ULL << exp) - 1);
+        return (units >> exp) * 1000000000ULL + ((frac * 1000000000ULL) >> exp);
+    }
+    uint64_t scale = 1;
+    if (exp <= 9) {
+        for (uint32_t i = exp; i < 9; i++) {
+            scale *= 10;
+        }
+        return units * scale;
+    }
+    for (uint32_t i = 9; i < exp && i < 28; i++) {
+        scale *= 10;
+    }
+    return units / scale;
+}
+
+static void pcap_walk_init(const pcap_replay_t* replay, pcap_walk_t* w) {
+    memset(w, 0, sizeof(*w));
+    if (replay->format != PCAP_FORMAT_PCAP) {
+        return;
+    }
+    uint32_t magic;
+    memcpy(&magic, replay->base, 4);
+    w->swapped = magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS;
+    w->nsec = pcap_u32(w, replay->base) == PCAP_MAGIC_NS;
+    w->linktype = (uint16_t)pcap_u32(w, replay->base + 20);
+    w->pos = 24;
+}
+
+static void pcapng_read_idb(pcap_walk_t* w, const uint8_t* b, uint32_t len) {
+    if (len < 20 || w->iface_count >= PCAPNG_MAX_IFACES) {
+        return;
+    }
+    uint8_t tsresol = 6;
+    uint32_t off = 16;
+    while (off + 4 <= len - 4) {
+        uint16_t code = pcap_u16(w, b + off);
+        uint16_t olen = pcap_u16(w, b + off + 2);
+        if (code == 0 || off + 4 + olen > len - 4) {
+            break;
+        }
+        if (code == PCAPNG_OPT_TSRESOL && olen >= 1) {
+            tsresol = b[off + 4];
+        }
+        off += 4 + (((uint32_t)olen + 3) & ~3u);
+    }
+    w->iface_linktype[w->iface_count] = pcap_u16(w, b + 8);
+    w->iface_tsresol[w->iface_count] = tsresol;
+    w->iface_count++;
+}
+
+/* 1 with the next packet record, 0 at the end or at a malformed record */
+static int pcap_walk_next(const pcap_replay_t* replay, pcap_walk_t* w, pcap_record_t* rec) {
+    uint8_t* base = replay->base;
+    size_t size = replay->size;
+    
+    if (replay->format == PCAP_FORMAT_PCAP) {
+        if (size - w->pos < 16) {
+            return 0;
+        }
+        const uint8_t* h = base + w->pos;
+        uint32_t caplen = pcap_u32(w, h + 8);
+        if (caplen > size - w->pos - 16) {
+            return 0;
+        }
+        uint64_t frac = pcap_u32(w, h + 4);
+        rec->ts_ns = (uint64_t)pcap_u32(w, h) * 1000000000ULL + (w->nsec ? frac : frac * 1000ULL);
+        rec->data = base + w->pos + 16;
+        rec->caplen = caplen;
+        rec->origlen = pcap_u32(w, h + 12);
+        rec->linktype = w->linktype;
+        w->pos += 16 + (size_t)caplen;
+        return 1;
+    }
+    
+    while (size - w->pos >= 12) {
+        uint8_t* b = base + w->pos;
+        uint32_t type;
+        memcpy(&type, b, 4);
+        if (type == PCAPNG_SHB) {
+            uint32_t bom;
+            memcpy(&bom, b + 8, 4);
+            if (bom == PCAPNG_BYTE_ORDER) {
+                w->swapped = 0;
+            } else if (bom == __builtin_bswap32(PCAPNG_BYTE_ORDER)) {
+                w->swapped = 1;
+            } else {
+                return 0;
+            }
+            w->iface_count = 0;
+        } else {
+            type = pcap_u32(w, b);
+        }
+    
+        uint32_t len = pcap_u32(w, b + 4);
+        if (len < 12 || (len & 3) != 0 || len > size - w->pos) {
+            return 0;
+        }
+        w->pos += len;
+    
+        uint32_t iface;
+        uint64_t units;
+        switch (type) {
+        case PCAPNG_IDB:
+            pcapng_read_idb(w, b, len);
+            continue;
+        case PCAPNG_EPB:
+        case PCAPNG_PB:
+            if (len < 32) {
+                continue;
+            }
+            iface = type == PCAPNG_EPB ? pcap_u32(w, b + 8) : pcap_u16(w, b + 8);
+            rec->caplen = pcap_u32(w, b + 20);
+            rec->origlen = pcap_u32(w, b + 24);
+            if (iface >= w->iface_count || rec->caplen > len - 32) {
+                continue;
+            }
+            units = ((uint64_t)pcap_u32(w, b + 12) << 32) | pcap_u32(w, b + 16);
+            w->last_ns = pcapng_ts_ns(units, w->iface_tsresol[iface]);
+            rec->data = b + 28;
+            break;
+        case PCAPNG_SPB:
+            if (len < 16 || w->iface_count == 0) {
+                continue;
+            }
+            iface = 0;
+            rec->origlen = pcap_u32(w, b + 8);
+            rec->caplen = rec->origlen < len - 16 ? rec->origlen : len - 16;
+            rec->data = b + 12;
+            break;
+        default:
+            continue;
+        }
+        rec->ts_ns = w->last_ns;
+        rec->linktype = w->iface_linktype[iface];
+        return 1;
+    }
+    return 0;
+}
+
+pcap_replay_t* pcap_replay_open(const char* path) {
+    if (path == NULL) {
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 24) {
+        close(fd);
+        return NULL;
+    }
+    
+    /* Private and writable: rewrites touch copy-on-write pages only */
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    
+    uint32_t magic;
+    memcpy(&magic, map, 4);
+    int format = 0;
+    if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS ||
+        magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS)) {
+        format = PCAP_FORMAT_PCAP;
+    } else if (magic == PCAPNG_SHB) {
+        format = PCAP_FORMAT_PCAPNG;
+    }
+    
+    pcap_replay_t* replay = format ? (pcap_replay_t*)calloc(1, sizeof(*replay)) : NULL;
+    if (replay == NULL) {
+        munmap(map, size);
+        return NULL;
+    }
+    replay->base = (uint8_t*)map;
+    replay->size = size;
+    replay->format = format;
+    return replay;
+}
+
+int pcap_replay_get_info(const pcap_replay_t* replay, pcap_replay_info_t* info) {
+    if (replay == NULL || info == NULL) {
+        return -1;
+    }
+    memset(info, 0, sizeof(*info));
+    info->format = replay->format;
+    
+    pcap_walk_t walk;
+    pcap_record_t rec;
+    pcap_walk_init(replay, &walk);
+    while (pcap_walk_next(replay, &walk, &rec)) {
+        if (info->packets == 0) {
+            info->first_ns = rec.ts_ns;
+        }
+        info->last_ns = rec.ts_ns;
+        info->packets++;
+        info->bytes += rec.caplen;
+    }
+    return 0;
+}
+
+void pcap_replay_close(pcap_replay_t* replay) {
+    if (replay == NULL) {
+        return;
+    }
+    munmap(replay->base, replay->size);
+    free(replay);
+}
+
+pcap_cursor_t* pcap_cursor_create(pcap_replay_t* replay, const pcap_replay_config_t* config) {
+    if (replay == NULL || config == NULL || config->rewrite_prefix > 32 ||
+        (config->shard_count > 1 && config->shard_index >= config->shard_count) ||
+        (config->mode == REPLAY_SCALED && !(config->speed > 0.0)) ||
+        (config->layer != BACKEND_LAYER_L2 && config->layer != BACKEND_LAYER_L3 &&
+         config->layer != BACKEND_LAYER_PAYLOAD)) {
+        return NULL;
+    }
+    
+    pcap_cursor_t* cursor = (pcap_cursor_t*)calloc(1, sizeof(*cursor));
+    if (cursor == NULL) {
+        return NULL;
+    }
+    cursor->replay = replay;
+    cursor->config = *config;
+    if (cursor->config.batch_size == 0) {
+        cursor->config.batch_size = REPLAY_DEFAULT_BATCH;
+    }
+    if (cursor->config.mode != REPLAY_SCALED) {
+        cursor->config.speed = 1.0;
+    }
+    if (config->rewrite_prefix > 0) {
+        cursor->rewrite_mask = 0xFFFFFFFFu << (32 - config->rewrite_prefix);
+        cursor->rewrite_net = ntohl(config->rewrite_ip) & cursor->rewrite_mask;
+    }
+    
+    uint32_t n = cursor->config.batch_size;
+    cursor->packets = (const uint8_t**)calloc(n, sizeof(*cursor->packets));
+    cursor->lengths = (uint32_t*)calloc(n, sizeof(*cursor->lengths));
+    if (config->layer == BACKEND_LAYER_PAYLOAD) {
+        cursor->dests = (struct sockaddr_in*)calloc(n, sizeof(*cursor->dests));
+    }
+    if (!cursor->packets || !cursor->lengths || (config->layer == BACKEND_LAYER_PAYLOAD && !cursor->dests)) {
+        pcap_cursor_destroy(cursor);
+        return NULL;
+    }
+    
+    pcap_walk_init(replay, &cursor->walk);
+    return cursor;
+}
+
+/* Offset of the record's IPv4 header, -1 if it has none */
+static int replay_l3_offset(const pcap_record_t* rec) {
+    const uint8_t* p = rec->data;
+    uint32_t off;
+    
+    switch (rec->linktype) {
+    case LINKTYPE_ETHERNET:
+        if (rec->caplen < 18) {
+            return -1;
+        }
+        off = 14;
+        if (load_be16(p + 12) == 0x8100) {
+            off = 18;
+        }
+        if (load_be16(p + off - 2) != 0x0800) {
+            return -1;
+        }
+        break;
+    case LINKTYPE_LINUX_SLL:
+        if (rec->caplen < 16 || load_be16(p + 14) != 0x0800) {
+            return -1;
+        }
+        off = 16;
+        break;
+    case LINKTYPE_RAW:
+    case LINKTYPE_IPV4:
+        off = 0;
+        break;
+    default:
+        return -1;
+    }
+    
+    if (rec->caplen < off + 20 || (p[off] >> 4) != 4 || (p[off] & 0x0F) < 5 ||
+        rec->caplen < off + (uint32_t)(p[off] & 0x0F) * 4) {
+        return -1;
+    }
+    return (int)off;
+}
+
+/* Shards split by flow; records without IPv4 go round-robin */
+static int replay_owns(const pcap_cursor_t* cursor, const pcap_record_t* rec, int l3) {
+    uint32_t shards = cursor->config.shard_count;
+    if (shards <= 1) {
+        return 1;
+    }
+    
+    uint32_t h = (uint32_t)cursor->index;
+    if (l3 >= 0) {
+        const uint8_t* ip = rec->data + l3;
+        uint32_t ihl = (uint32_t)(ip[0] & 0x0F) * 4;
+        memcpy(&h, ip + 12, 4);
+        h ^= (uint32_t)ip[9] << 24;
+        /* Unfragmented TCP/UDP also hash their ports; the destination is
+         * left out because rewrites change it */
+        if ((ip[9] == IPPROTO_TCP || ip[9] == IPPROTO_UDP) && (load_be16(ip + 6) & 0x3FFF) == 0 &&
+            rec->caplen >= (uint32_t)l3 + ihl + 4) {
+            uint32_t ports;
+            memcpy(&ports, ip + ihl, 4);
+            h ^= ports;
+        }
+    }
+    h *= 0x9E3779B1u;
+    h ^= h >> 16;
+    return h % shards == cursor->config.shard_index;
+}
+
+/* Where the record's packet sits for the cursor's layer; 0 if unusable */
+static int replay_slice(const pcap_cursor_t* cursor, const pcap_record_t* rec, int l3,
+                        const uint8_t** packet, uint32_t* len) {
+    if (rec->caplen < rec->origlen) {
+        return 0;  /* Cut short by the snaplen */
+    }
+    if (cursor->config.layer == BACKEND_LAYER_L2) {
+        if (rec->linktype != LINKTYPE_ETHERNET) {
+            return 0;
+        }
+        *packet = rec->data;
+        *len = rec->caplen;
+        return 1;
+    }
+    if (l3 < 0) {
+        return 0;
+    }
+    
+    const uint8_t* ip = rec->data + l3;
+    uint32_t avail = rec->caplen - (uint32_t)l3;
+    uint32_t total = load_be16(ip + 2);
+    uint32_t ihl = (uint32_t)(ip[0] & 0x0F) * 4;
+    if (total < ihl || total > avail) {
+        return 0;
+    }
+    if (cursor->config.layer == BACKEND_LAYER_L3) {
+        *packet = ip;
+        *len = total;  /* Drops Ethernet padding */
+        return 1;
+    }
+    
+    if (ip[9] != IPPROTO_UDP || (load_be16(ip + 6) & 0x3FFF) != 0 || total < ihl + 8) {
+        return 0;
+    }
+    uint32_t udp_len = load_be16(ip + ihl + 4);
+    if (udp_len < 8 || udp_len > total - ihl) {
+        return 0;
+    }
+    *packet = ip + ihl + 8;
+    *len = udp_len - 8;
+    return 1;
+}
+
+/* Move the destination into the rewrite range, patching IPv4 and L4 checksums */
+static void replay_rewrite(const pcap_cursor_t* cursor, uint8_t* ip, uint32_t avail) {
+    uint32_t old_value = ((uint32_t)load_be16(ip + 16) << 16) | load_be16(ip + 18);
+    uint32_t host = old_value + (cursor->stats.passes > 0 ? 1 : 0);
+    uint32_t value = cursor->rewrite_net | (host & ~cursor->rewrite_mask);
+    if (value == old_value) {
+        return;
+    }
+    rewrite32(ip, 16, 10, value);
+    
+    /* Later fragments carry no L4 header */
+    uint32_t ihl = (uint32_t)(ip[0] & 0x0F) * 4;
+    if ((load_be16(ip + 6) & 0x1FFF) != 0) {
+        return;
+    }
+    uint8_t* l4 = ip + ihl;
+    if (ip[9] == IPPROTO_UDP && avail >= ihl + 8) {
+        uint16_t checksum = load_be16(l4 + 6);
+        if (checksum != 0) {
+            checksum = checksum_update32(checksum, old_value, value);
+            store_be16(l4 + 6, checksum ? checksum : 0xFFFF);
+        }
+    } else if (ip[9] == IPPROTO_TCP && avail >= ihl + 18) {
+        store_be16(l4 + 16, checksum_update32(load_be16(l4 + 16), old_value, value));
+    }
+}
+
+static inline uint64_t replay_deadline(const pcap_cursor_t* cursor, uint64_t ts_ns) {
+    uint64_t offset = ts_ns > cursor->first_ns ? ts_ns - cursor->first_ns : 0;
+    return cursor->origin_ns + (uint64_t)((double)offset / cursor->config.speed);
+}
+
+/* Starts the next pass, or finishes (also when a pass had nothing to send) */
+static void replay_end_pass(pcap_cursor_t* cursor) {
+    cursor->stats.passes++;
+    if ((cursor->config.loops > 0 && cursor->stats.passes >= cursor->config.loops) ||
+        cursor->pass_packets == 0) {
+        cursor->finished = 1;
+        return;
+    }
+    cursor->pass_packets = 0;
+    cursor->index = 0;
+    cursor->origin_ns = replay_deadline(cursor, cursor->last_ns);
+    pcap_walk_init(cursor->replay, &cursor->walk);
+}
+
+int pcap_cursor_next(pcap_cursor_t* cursor, pcap_view_t* view) {
+    if (cursor == NULL || view == NULL) {
+        return -1;
+    }
+    view->packets = cursor->packets;
+    view->lengths = cursor->lengths;
+    view->dests = cursor->dests;
+    view->count = 0;
+    
+    int timed = cursor->config.mode != REPLAY_MAX_RATE;
+    uint32_t count = 0;
+    while (count < cursor->config.batch_size && !cursor->finished) {
+        if (!cursor->have_pending) {
+            if (!pcap_walk_next(cursor->replay, &cursor->walk, &cursor->pending)) {
+                replay_end_pass(cursor);
+                continue;
+            }
+            if (!cursor->started) {
+                cursor->started = 1;
+                cursor->first_ns = cursor->pending.ts_ns;
+                cursor->origin_ns = get_timestamp_ns();
+            }
+            cursor->last_ns = cursor->pending.ts_ns;
+            cursor->have_pending = 1;
+        }
+    
+        pcap_record_t* rec = &cursor->pending;
+        int l3 = replay_l3_offset(rec);
+        const uint8_t* packet;
+        uint32_t len;
+        if (!replay_owns(cursor, rec, l3)) {
+            cursor->have_pending = 0;
+            cursor->index++;
+            continue;
+        }
+        if (!replay_slice(cursor, rec, l3, &packet, &len)) {
+            cursor->stats.skipped++;
+            cursor->have_pending = 0;
+            cursor->index++;
+            continue;
+        }
+    
+        /* Wait for the batch's first packet; later ones join if already due */
+        if (timed) {
+            uint64_t deadline = replay_deadline(cursor, rec->ts_ns);
+            if (count == 0) {
+                pacer_sleep_until(deadline);
+            } else if (deadline > get_timestamp_ns()) {
+                break;
+            }
+        }
+    
+        if (l3 >= 0 && cursor->config.rewrite_prefix > 0) {
+            replay_rewrite(cursor, rec->data + l3, rec->caplen - (uint32_t)l3);
+        }
+        if (cursor->dests != NULL) {
+            const uint8_t* ip = rec->data + l3;
+            struct sockaddr_in* dest = &cursor->dests[count];
+            memset(dest, 0, sizeof(*dest));
+            dest->sin_family = AF_INET;
+            memcpy(&dest->sin_addr.s_addr, ip + 16, 4);
+            memcpy(&dest->sin_port, packet - 6, 2);
+        }
+        cursor->packets[count] = packet;
+        cursor->lengths[count] = len;
+        cursor->stats.packets++;
+        cursor->stats.bytes += len;
+        cursor->pass_packets++;
+        cursor->have_pending = 0;
+        cursor->index++;
+        count++;
+    }
+    
+    view->count = count;
+    return (int)count;
+}
+
+int pcap_cursor_send(pcap_cursor_t* cursor, netstress_backend_t* backend) {
+    if (cursor == NULL || netstress_backend_layer(backend) != (int)cursor->config.layer) {
+        return -1;
+    }
+    
+    pcap_view_t view;
+    uint32_t sent_total = 0;
+    int count = 0;
+    
+    /* A batch dropped whole is not the end of the capture, so move on */
+    while (sent_total == 0 && (count = pcap_cursor_next(cursor, &view)) > 0) {
+        uint32_t done = 0;
+        uint32_t spins = 0;
+        while (done < (uint32_t)count) {
+            /* Offer what the backend's burst controller expects it to take */
+            uint32_t n = (uint32_t)count - done;
+            uint32_t burst = netstress_backend_burst(backend);
+            n = n < burst ? n : burst;
+            int sent = view.dests != NULL ?
+                       netstress_backend_send_batch_to(backend, view.packets + done, view.lengths + done,
+                                                       view.dests + done, n) :
+                       netstress_backend_send_batch(backend, view.packets + done, view.lengths + done, n);
+            backend_tx_result(backend, n, sent, NULL);
+            if (sent < 0) {
+                return sent_total > 0 ? (int)sent_total : sent;
+            }
+            
+            /* Some frames never fit a backend; skip past them instead of spinning */
+            if (sent == 0) {
+                if (++spins > REPLAY_SEND_SPINS) {
+                    cursor->stats.dropped++;
+                    done++;
+                    spins = 0;
+                }
+                cpu_relax();
+                continue;
+            }
+            spins = 0;
+            done += (uint32_t)sent;
+            sent_total += (uint32_t)sent;
+        }
+    }
+    return sent_total > 0 ? (int)sent_total : count;
+}
+
+int pcap_cursor_get_stats(const pcap_cursor_t* cursor, pcap_cursor_stats_t* stats) {
+    if (cursor == NULL || stats == NULL) {
+        return -1;
+    }
+    *stats = cursor->stats;
+    return 0;
+}
+
+void pcap_cursor_destroy(pcap_cursor_t* cursor) {
+    if (cursor == NULL) {
+        return;
+    }
+    free(cursor->packets);
+    free(cursor->lengths);
+    free(cursor->dests);
+    free(cursor);
+}
+
+#else
+
+/* Capture replay needs mmap() */
+pcap_replay_t* pcap_replay_open(const char* path) {
+    (void)path;
+    return NULL;
+}
+
+int pcap_replay_get_info(const pcap_replay_t* replay, pcap_replay_info_t* info) {
+    (void)replay;
+    (void)info;
+    return -1;
+}
+
+void pcap_replay_close(pcap_replay_t* replay) {
+    (void)replay;
+}
+
+pcap_cursor_t* pcap_cursor_create(pcap_replay_t* replay, const pcap_replay_config_t* config) {
+    (void)replay;
+    (void)config;
+    return NULL;
+}
+
+int pcap_cursor_next(pcap_cursor_t* cursor, pcap_view_t* view) {
+    (void)cursor;
+    (void)view;
+    return -1;
+}
+
+int pcap_cursor_send(pcap_cursor_t* cursor, netstress_backend_t* backend) {
+    (void)cursor;
+    (void)backend;
+    return -1;
+}
+
+int pcap_cursor_get_stats(const pcap_cursor_t* cursor, pcap_cursor_stats_t* stats) {
+    (void)cursor;
+    (void)stats;
+    return -1;
+}
+
+void pcap_cursor_destroy(pcap_cursor_t* cursor) {
+    (void)cursor;
+}
+
+#endif
+
+/* ============================================================================
+ * TCP Connection Emulation
+ * ============================================================================ */
+
+#define TCP_SEG_FIN 0x01
+#define TCP_SEG_SYN 0x02
+#define TCP_SEG_RST 0x04
+#define TCP_SEG_PSH 0x08
+#define TCP_SEG_ACK 0x10
+
+#define TCP_ENGINE_MSS_OPT 4            /* MSS option on SYN and SYN-ACK */
+#define TCP_ENGINE_DEFAULT_MSS 536      /* Peers that send no MSS option */
+#define TCP_ENGINE_OPEN_BUDGET 256      /* Connections opened per poll */
+#define TCP_ENGINE_TX_FRAMES 4096
+#define TCP_ENGINE_RX_BURST 64
+#define TCP_ENGINE_SEND_SPINS 1024      /* Empty sends before the rest are dropped */
+
+#define TCP_FLOW_FIN_RCVD 0x01
+
+typedef enum {
+    TCP_FLOW_FREE = 0,
+    TCP_FLOW_SYN_SENT,          /* Client: SYN out */
+    TCP_FLOW_SYN_RCVD,          /* Server: SYN-ACK out */
+    TCP_FLOW_ESTABLISHED,       /* Request and response under way */
+    TCP_FLOW_FIN_WAIT,          /* Client: FIN out, waiting for the server's */
+    TCP_FLOW_LAST_ACK           /* Server: FIN out, waiting for the last ACK */
+} tcp_flow_state_t;
+
+/* One cache line; addresses network order, ports host order */
+typedef struct {
+    uint32_t remote_ip;
+    uint32_t local_ip;
+    uint16_t remote_port;
+    uint16_t local_port;
+    uint32_t hash;
+    uint8_t state;
+    uint8_t retries;
+    uint8_t flags;
+    uint8_t reserved;
+    uint16_t peer_mss;
+    uint16_t peer_window;
+    uint32_t iss;               /* Our initial sequence number */
+    uint32_t irs;               /* The peer's */
+    uint32_t snd_una;           /* Oldest unacknowledged */
+    uint32_t snd_nxt;           /* Next to send, rewound on timeout */
+    uint32_t snd_max;           /* Highest sent */
+    uint32_t rcv_nxt;
+    uint32_t rcv_acked;         /* rcv_nxt as of our last ACK */
+    uint32_t timer_tag;         /* Tag of the flow's live timer entry */
+    uint64_t start_ns;          /* SYN sent or received */
+} tcp_flow_t;
+
+/* Timer entries name flows by tuple since flows move on deletion */
+typedef struct {
+    uint32_t remote_ip;
+    uint32_t local_ip;
+    uint16_t remote_port;
+    uint16_t local_port;
+    uint32_t tag;
+    uint64_t deadline_ns;
+} tcp_timer_t;
 
-int init_af_xdp(const char* ifname) {
-    int ifindex = if_nametoindex(ifname);
-    if (ifindex == 0) {
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LAT_HIST_BUCKETS];
+} tcp_latency_hist_t;
+
+struct tcp_engine {
+    tcp_engine_config_t config;
+    uint32_t tx_len;            /* Bytes we send per connection */
+    uint32_t rx_len;            /* Bytes we expect */
+    uint8_t* payload;           /* tx_len bytes of pattern */
+    
+    mem_region_t table_region;
+    tcp_flow_t* flows;
+    uint32_t mask;
+    uint32_t active;
+    
+    /*
+     * The RTO is constant, so timers armed in time order expire in that
+     * order and a FIFO does the job of a wheel. Every arm pushes an entry;
+     * entries whose tag no longer matches their flow are skipped.
+     */
+    tcp_timer_t* timers;
+    uint32_t timer_mask;
+    uint32_t timer_head;
+    uint32_t timer_tail;
+    uint32_t timer_seq;
+    
+    pkt_batch_t* tx;
+    uint16_t ip_id;
+    uint64_t rng;
+    uint32_t next_ip;           /* Client tuple cursor */
+    uint32_t next_port;
+    int started;
+    int paused;                 /* No new connections, open ones carry on */
+    uint64_t start_ns;          /* First poll */
+    uint64_t last_ns;
+    uint64_t rate_ns;           /* target_cps counts from here... */
+    uint64_t rate_base;         /* ...and this many attempts */
+    
+    tcp_engine_stats_t stats;   /* Counters only */
+    tcp_latency_hist_t connect;
+    tcp_latency_hist_t lifetime;
+};
+
+static inline int tcp_seq_lt(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+static inline uint32_t tcp_flow_hash(uint32_t remote_ip, uint32_t local_ip,
+                                     uint16_t remote_port, uint16_t local_port) {
+    uint64_t k = (((uint64_t)remote_ip << 32) | local_ip) ^
+                 ((((uint64_t)remote_port << 16) | local_port) * 0x9E3779B97F4A7C15ULL);
+    k ^= k >> 31;
+    k *= 0xBF58476D1CE4E5B9ULL;
+    k ^= k >> 29;
+    return (uint32_t)k;
+}
+
+static tcp_flow_t* tcp_flow_find(tcp_engine_t* e, uint32_t remote_ip, uint32_t local_ip,
+                                 uint16_t remote_port, uint16_t local_port) {
+    uint32_t hash = tcp_flow_hash(remote_ip, local_ip, remote_port, local_port);
+    /* The table is never more than half full, so every probe ends */
+    for (uint32_t i = hash & e->mask;; i = (i + 1) & e->mask) {
+        tcp_flow_t* f = &e->flows[i];
+        if (f->state == TCP_FLOW_FREE) {
+            return NULL;
+        }
+        if (f->hash == hash && f->remote_ip == remote_ip && f->local_ip == local_ip &&
+            f->remote_port == remote_port && f->local_port == local_port) {
+            return f;
+        }
+    }
+}
+
+/* Insert a tuple known to be absent */
+static tcp_flow_t* tcp_flow_insert(tcp_engine_t* e, uint32_t remote_ip, uint32_t local_ip,
+                                   uint16_t remote_port, uint16_t local_port) {
+    if (e->active >= e->config.max_concurrent) {
+        return NULL;
+    }
+    
+    uint32_t hash = tcp_flow_hash(remote_ip, local_ip, remote_port, local_port);
+    uint32_t i = hash & e->mask;
+    while (e->flows[i].state != TCP_FLOW_FREE) {
+        i = (i + 1) & e->mask;
+    }
+    
+    tcp_flow_t* f = &e->flows[i];
+    memset(f, 0, sizeof(*f));
+    f->remote_ip = remote_ip;
+    f->local_ip = local_ip;
+    f->remote_port = remote_port;
+    f->local_port = local_port;
+    f->hash = hash;
+    e->active++;
+    return f;
+}
+
+/*
+ * Backward-shift deletion: later entries of the probe run move into the
+ * hole unless their home slot lies cyclically after it, so lookups never
+ * need tombstones.
+ */
+static void tcp_flow_remove(tcp_engine_t* e, tcp_flow_t* f) {
+    uint32_t hole = (uint32_t)(f - e->flows);
+    for (uint32_t j = (hole + 1) & e->mask; e->flows[j].state != TCP_FLOW_FREE;
+         j = (j + 1) & e->mask) {
+        uint32_t home = e->flows[j].hash & e->mask;
+        if (((j - home) & e->mask) >= ((j - hole) & e->mask)) {
+            e->flows[hole] = e->flows[j];
+            hole = j;
+        }
+    }
+    e->flows[hole].state = TCP_FLOW_FREE;
+    e->active--;
+}
+
+static int tcp_timer_grow(tcp_engine_t* e) {
+    uint32_t size = (e->timer_mask + 1) * 2;
+    if (size == 0) {
+        return -1;
+    }
+    tcp_timer_t* timers = (tcp_timer_t*)malloc((size_t)size * sizeof(*timers));
+    if (timers == NULL) {
         return -1;
     }
     
-    /* Allocate UMEM area */
-    size_t umem_size = NUM_FRAMES * FRAME_SIZE;
-    umem_area = aligned_alloc(getpagesize(), umem_size);
-    if (umem_area == NULL) {
+    uint32_t count = e->timer_tail - e->timer_head;
+    for (uint32_t i = 0; i < count; i++) {
+        timers[i] = e->timers[(e->timer_head + i) & e->timer_mask];
+    }
+    free(e->timers);
+    e->timers = timers;
+    e->timer_mask = size - 1;
+    e->timer_head = 0;
+    e->timer_tail = count;
+    return 0;
+}
+
+static void tcp_timer_arm(tcp_engine_t* e, tcp_flow_t* f, uint64_t now_ns) {
+    /* Without memory for a timer the flow waits on its peer */
+    if (e->timer_tail - e->timer_head > e->timer_mask && tcp_timer_grow(e) != 0) {
+        return;
+    }
+    
+    f->timer_tag = ++e->timer_seq;
+    tcp_timer_t* t = &e->timers[e->timer_tail++ & e->timer_mask];
+    t->remote_ip = f->remote_ip;
+    t->local_ip = f->local_ip;
+    t->remote_port = f->remote_port;
+    t->local_port = f->local_port;
+    t->tag = f->timer_tag;
+    t->deadline_ns = now_ns + e->config.rto_ns;
+}
+
+static void tcp_hist_record(tcp_latency_hist_t* h, uint64_t ns) {
+    h->count++;
+    h->sum_ns += ns;
+    if (ns < h->min_ns) {
+        h->min_ns = ns;
+    }
+    if (ns > h->max_ns) {
+        h->max_ns = ns;
+    }
+    h->buckets[lat_hist_index(ns)]++;
+}
+
+static void tcp_hist_report(const tcp_latency_hist_t* h, latency_report_t* report) {
+    memset(report, 0, sizeof(*report));
+    report->received = h->count;
+    if (h->count == 0) {
+        return;
+    }
+    report->min_ns = h->min_ns;
+    report->max_ns = h->max_ns;
+    report->mean_ns = h->sum_ns / h->count;
+    report->p50_ns = lat_hist_percentile(h->buckets, h->max_ns, 50.0);
+    report->p99_ns = lat_hist_percentile(h->buckets, h->max_ns, 99.0);
+    report->p999_ns = lat_hist_percentile(h->buckets, h->max_ns, 99.9);
+}
+
+static uint32_t tcp_engine_rand(tcp_engine_t* e) {
+    e->rng ^= e->rng << 13;
+    e->rng ^= e->rng >> 7;
+    e->rng ^= e->rng << 17;
+    return (uint32_t)(e->rng >> 32);
+}
+
+static uint16_t tcp_parse_mss(const uint8_t* tcp, uint32_t tcp_len) {
+    uint32_t i = 20;
+    while (i < tcp_len) {
+        uint8_t kind = tcp[i];
+        if (kind == 0) {
+            break;
+        }
+        if (kind == 1) {
+            i++;
+            continue;
+        }
+        if (i + 1 >= tcp_len || tcp[i + 1] < 2 || i + tcp[i + 1] > tcp_len) {
+            break;
+        }
+        if (kind == 2 && tcp[i + 1] == 4) {
+            uint16_t mss = load_be16(tcp + i + 2);
+            return mss != 0 ? mss : TCP_ENGINE_DEFAULT_MSS;
+        }
+        i += tcp[i + 1];
+    }
+    return TCP_ENGINE_DEFAULT_MSS;
+}
+
+static int tcp_emit_raw(tcp_engine_t* e, uint32_t local_ip, uint32_t remote_ip,
+                        uint16_t local_port, uint16_t remote_port, uint8_t flags,
+                        uint32_t seq, uint32_t ack, const uint8_t* data, uint32_t len) {
+    uint32_t tcp_len = 20 + ((flags & TCP_SEG_SYN) ? TCP_ENGINE_MSS_OPT : 0);
+    uint8_t* frame = pkt_batch_reserve(e->tx, 34 + tcp_len + len, 0, 0);
+    if (frame == NULL) {
+        e->stats.tx_dropped++;
         return -1;
     }
     
-    /* Create UMEM */
-    struct xsk_umem_config umem_cfg = {
-        .fill_size = NUM_FRAMES,
-        .comp_size = NUM_FRAMES,
-        .frame_size = FRAME_SIZE,
-        .frame_headroom = XSK_UMEM__DEFAULT_FRAME_HEADROOM,
-    };
+    memcpy(frame, e->config.dst_mac, 6);
+    memcpy(frame + 6, e->config.src_mac, 6);
+    store_be16(frame + 12, 0x0800);
     
-    int ret = xsk_umem__create(&umem, umem_area, umem_size, &fq, &cq, &umem_cfg);
-    if (ret) {
-        free(umem_area);
-        return ret;
+    uint8_t* ip = frame + 14;
+    ip[0] = 0x45;
+    ip[1] = 0;
+    store_be16(ip + 2, (uint16_t)(20 + tcp_len + len));
+    store_be16(ip + 4, e->ip_id++);
+    store_be16(ip + 6, 0x4000);         /* DF */
+    ip[8] = 64;
+    ip[9] = IPPROTO_TCP;
+    store_be16(ip + 10, 0);
+    memcpy(ip + 12, &local_ip, 4);
+    memcpy(ip + 16, &remote_ip, 4);
+    store_be16(ip + 10, calculate_checksum(ip, 20));
+    
+    uint8_t* tcp = ip + 20;
+    store_be16(tcp, local_port);
+    store_be16(tcp + 2, remote_port);
+    store_be32(tcp + 4, seq);
+    store_be32(tcp + 8, (flags & TCP_SEG_ACK) ? ack : 0);
+    tcp[12] = (uint8_t)((tcp_len / 4) << 4);
+    tcp[13] = flags;
+    store_be16(tcp + 14, e->config.window);
+    store_be16(tcp + 16, 0);
+    store_be16(tcp + 18, 0);
+    if (flags & TCP_SEG_SYN) {
+        tcp[20] = 2;
+        tcp[21] = 4;
+        store_be16(tcp + 22, e->config.mss);
     }
+    if (len > 0) {
+        memcpy(tcp + tcp_len, data, len);
+    }
+    store_be16(tcp + 16, calculate_transport_checksum(ntohl(local_ip), ntohl(remote_ip),
+                                                      IPPROTO_TCP, tcp, tcp_len + len));
+    e->stats.tx_frames++;
+    return 0;
+}
+
+static int tcp_emit(tcp_engine_t* e, tcp_flow_t* f, uint8_t flags, uint32_t seq,
+                    const uint8_t* data, uint32_t len) {
+    if (flags & TCP_SEG_ACK) {
+        f->rcv_acked = f->rcv_nxt;
+    }
+    return tcp_emit_raw(e, f->local_ip, f->remote_ip, f->local_port, f->remote_port,
+                        flags, seq, f->rcv_nxt, data, len);
+}
+
+/* Send what the peer's window allows from snd_nxt */
+static int tcp_flow_send_data(tcp_engine_t* e, tcp_flow_t* f) {
+    uint32_t end = f->iss + 1 + e->tx_len;
+    uint32_t window_end = f->snd_una + f->peer_window;
+    uint32_t mss = f->peer_mss < e->config.mss ? f->peer_mss : e->config.mss;
+    int sent = 0;
     
-    /* Create XSK socket */
-    struct xsk_socket_config xsk_cfg = {
-        .rx_size = NUM_FRAMES,
-        .tx_size = NUM_FRAMES,
-        .libbpf_flags = XSK_LIBBPF_FLAGS__INHIBIT_PROG_LOAD,
-        .xdp_flags = XDP_FLAGS_DRV_MODE,
-        .bind_flags = XDP_USE_NEED_WAKEUP,
-    };
+    while (tcp_seq_lt(f->snd_nxt, end) && tcp_seq_lt(f->snd_nxt, window_end)) {
+        uint32_t n = end - f->snd_nxt;
+        if (n > mss) {
+            n = mss;
+        }
+        if (n > window_end - f->snd_nxt) {
+            n = window_end - f->snd_nxt;
+        }
+        uint8_t flags = TCP_SEG_ACK | (f->snd_nxt + n == end ? TCP_SEG_PSH : 0);
+        if (tcp_emit(e, f, flags, f->snd_nxt, e->payload + (f->snd_nxt - f->iss - 1), n) != 0) {
+            break;
+        }
+        f->snd_nxt += n;
+        if (tcp_seq_lt(f->snd_max, f->snd_nxt)) {
+            f->snd_max = f->snd_nxt;
+        }
+        sent++;
+    }
+    return sent;
+}
+
+static void tcp_flow_complete(tcp_engine_t* e, tcp_flow_t* f, uint64_t now_ns) {
+    e->stats.completed++;
+    tcp_hist_record(&e->lifetime, now_ns - f->start_ns);
+    tcp_flow_remove(e, f);
+}
+
+static void tcp_flow_established(tcp_engine_t* e, tcp_flow_t* f, uint64_t now_ns) {
+    f->state = TCP_FLOW_ESTABLISHED;
+    f->retries = 0;
+    e->stats.established++;
+    tcp_hist_record(&e->connect, now_ns - f->start_ns);
+}
+
+/*
+ * Move an open flow along after a segment: the client sends its request
+ * and closes once the response is in, the server answers once the request
+ * is in and closes after the client's FIN.
+ */
+static void tcp_flow_advance(tcp_engine_t* e, tcp_flow_t* f, int need_ack, int progress,
+                             uint64_t now_ns) {
+    int client = e->config.role == TCP_ENGINE_CLIENT;
+    uint32_t fin = (f->flags & TCP_FLOW_FIN_RCVD) ? 1 : 0;
+    uint32_t received = f->rcv_nxt - f->irs - 1 - fin;
+    uint32_t data_end = f->iss + 1 + e->tx_len;
+    int sent = 0;
     
-    ret = xsk_socket__create(&xsk, ifname, 0, umem, &rx_ring, &tx_ring, &xsk_cfg);
-    if (ret) {
-        xsk_umem__delete(umem);
-        free(umem_area);
-        return ret;
+    switch (f->state) {
+        case TCP_FLOW_ESTABLISHED:
+            if (client || received >= e->rx_len) {
+                sent = tcp_flow_send_data(e, f);
+            }
+            if (f->snd_una == data_end && (client ? received >= e->rx_len : fin)) {
+                tcp_emit(e, f, TCP_SEG_FIN | TCP_SEG_ACK, data_end, NULL, 0);
+                f->snd_nxt = f->snd_max = data_end + 1;
+                f->state = client ? TCP_FLOW_FIN_WAIT : TCP_FLOW_LAST_ACK;
+                sent = 1;
+            }
+            break;
+        case TCP_FLOW_FIN_WAIT:
+            if (f->snd_una == f->snd_max && fin) {
+                tcp_emit(e, f, TCP_SEG_ACK, f->snd_max, NULL, 0);
+                tcp_flow_complete(e, f, now_ns);
+                return;
+            }
+            break;
+        case TCP_FLOW_LAST_ACK:
+            if (f->snd_una == f->snd_max) {
+                tcp_flow_complete(e, f, now_ns);
+                return;
+            }
+            /* A repeated FIN means ours was lost */
+            if (need_ack) {
+                tcp_emit(e, f, TCP_SEG_FIN | TCP_SEG_ACK, data_end, NULL, 0);
+                sent = 1;
+            }
+            break;
+        default:
+            break;
     }
     
-    /* Populate fill ring */
-    uint32_t idx;
-    ret = xsk_ring_prod__reserve(&fq, NUM_FRAMES, &idx);
-    for (uint32_t i = 0; i < NUM_FRAMES; i++) {
-        *xsk_ring_prod__fill_addr(&fq, idx++) = i * FRAME_SIZE;
+    /* Data is acknowledged every second full segment or when out of order */
+    if (!sent && (need_ack || f->rcv_nxt - f->rcv_acked >= 2u * e->config.mss)) {
+        tcp_emit(e, f, TCP_SEG_ACK, f->snd_nxt, NULL, 0);
+        sent = 1;
+    }
+    if (sent || progress) {
+        tcp_timer_arm(e, f, now_ns);
     }
-    xsk_ring_prod__submit(&fq, NUM_FRAMES);
+}
+
+static void tcp_flow_timeout(tcp_engine_t* e, tcp_flow_t* f, uint64_t now_ns) {
+    if (f->retries >= e->config.max_retries) {
+        tcp_emit(e, f, TCP_SEG_RST, f->snd_nxt, NULL, 0);
+        e->stats.failed++;
+        tcp_flow_remove(e, f);
+        return;
+    }
+    f->retries++;
+    e->stats.retransmits++;
     
-    return xsk_socket__fd(xsk);
+    uint32_t data_end = f->iss + 1 + e->tx_len;
+    switch (f->state) {
+        case TCP_FLOW_SYN_SENT:
+            tcp_emit(e, f, TCP_SEG_SYN, f->iss, NULL, 0);
+            break;
+        case TCP_FLOW_SYN_RCVD:
+            tcp_emit(e, f, TCP_SEG_SYN | TCP_SEG_ACK, f->iss, NULL, 0);
+            break;
+        default: {
+            /* Go-back-N from the oldest unacknowledged byte */
+            int sent = 0;
+            f->snd_nxt = f->snd_una;
+            if (tcp_seq_lt(f->snd_una, f->snd_max) && tcp_seq_lt(f->snd_una, data_end)) {
+                sent = tcp_flow_send_data(e, f);
+            }
+            if (f->state != TCP_FLOW_ESTABLISHED && f->snd_una != f->snd_max) {
+                tcp_emit(e, f, TCP_SEG_FIN | TCP_SEG_ACK, data_end, NULL, 0);
+                f->snd_nxt = data_end + 1;
+                sent = 1;
+            }
+            if (!sent) {
+                tcp_emit(e, f, TCP_SEG_ACK, f->snd_nxt, NULL, 0);
+            }
+            break;
+        }
+    }
+    tcp_timer_arm(e, f, now_ns);
 }
 
-int af_xdp_send(const uint8_t* data, uint32_t len) {
-    if (xsk == NULL) {
-        return -1;
+static int tcp_engine_is_local(const tcp_engine_t* e, uint32_t ip, uint16_t port) {
+    const tcp_engine_config_t* c = &e->config;
+    if (c->role == TCP_ENGINE_SERVER) {
+        return port == c->server_port && (c->server_ip == 0 || ip == c->server_ip);
+    }
+    return ntohl(ip) - ntohl(c->client_ip) < c->client_ip_count &&
+           port >= c->client_port_min && port <= c->client_port_max;
+}
+
+/* A segment for no flow: servers accept SYNs, anything else is reset */
+static void tcp_engine_no_flow(tcp_engine_t* e, uint32_t remote_ip, uint32_t local_ip,
+                               uint16_t remote_port, uint16_t local_port, uint8_t flags,
+                               uint32_t seq, uint32_t ack, uint16_t window, uint32_t len,
+                               const uint8_t* tcp, uint32_t tcp_len, uint64_t now_ns) {
+    if (flags & TCP_SEG_RST) {
+        return;
     }
     
-    uint32_t idx;
-    if (xsk_ring_prod__reserve(&tx_ring, 1, &idx) != 1) {
-        return -1;
+    if (e->config.role == TCP_ENGINE_SERVER && (flags & (TCP_SEG_SYN | TCP_SEG_ACK)) == TCP_SEG_SYN) {
+        tcp_flow_t* f = tcp_flow_insert(e, remote_ip, local_ip, remote_port, local_port);
+        if (f == NULL) {
+            e->stats.refused++;
+            return;
+        }
+        f->state = TCP_FLOW_SYN_RCVD;
+        f->irs = seq;
+        f->rcv_nxt = seq + 1;
+        f->iss = (f->hash * 2654435761U) ^ tcp_engine_rand(e);
+        f->snd_una = f->iss;
+        f->snd_nxt = f->snd_max = f->iss + 1;
+        f->peer_mss = tcp_parse_mss(tcp, tcp_len);
+        f->peer_window = window;
+        f->start_ns = now_ns;
+        e->stats.attempted++;
+        tcp_emit(e, f, TCP_SEG_SYN | TCP_SEG_ACK, f->iss, NULL, 0);
+        tcp_timer_arm(e, f, now_ns);
+        return;
     }
     
-    struct xdp_desc* desc = xsk_ring_prod__tx_desc(&tx_ring, idx);
-    desc->addr = idx * FRAME_SIZE;
-    desc->len = len;
+    if (flags & TCP_SEG_ACK) {
+        tcp_emit_raw(e, local_ip, remote_ip, local_port, remote_port, TCP_SEG_RST, ack, 0, NULL, 0);
+    } else {
+        uint32_t end = seq + len + ((flags & TCP_SEG_SYN) ? 1 : 0) + ((flags & TCP_SEG_FIN) ? 1 : 0);
+        tcp_emit_raw(e, local_ip, remote_ip, local_port, remote_port, TCP_SEG_RST | TCP_SEG_ACK,
+                     0, end, NULL, 0);
+    }
+}
+
+static void tcp_flow_input(tcp_engine_t* e, tcp_flow_t* f, uint8_t flags, uint32_t seq,
+                           uint32_t ack, uint16_t window, uint32_t len,
+                           const uint8_t* tcp, uint32_t tcp_len, uint64_t now_ns) {
+    if (flags & TCP_SEG_RST) {
+        /* A client that resets instead of sending the last ACK did finish */
+        if (f->state == TCP_FLOW_LAST_ACK) {
+            tcp_flow_complete(e, f, now_ns);
+        } else {
+            e->stats.failed++;
+            tcp_flow_remove(e, f);
+        }
+        return;
+    }
+    
+    /*
+     * Clients skip TIME_WAIT, so a new SYN can reach a flow the server still
+     * holds for the tuple's last connection. It ends that connection;
+     * one in LAST_ACK had finished and only lost its last ACK.
+     */
+    if ((flags & (TCP_SEG_SYN | TCP_SEG_ACK)) == TCP_SEG_SYN && e->config.role == TCP_ENGINE_SERVER &&
+        (f->state != TCP_FLOW_SYN_RCVD || seq != f->irs)) {
+        uint32_t remote_ip = f->remote_ip, local_ip = f->local_ip;
+        uint16_t remote_port = f->remote_port, local_port = f->local_port;
+        if (f->state == TCP_FLOW_LAST_ACK) {
+            tcp_flow_complete(e, f, now_ns);
+        } else {
+            e->stats.failed++;
+            tcp_flow_remove(e, f);
+        }
+        tcp_engine_no_flow(e, remote_ip, local_ip, remote_port, local_port, flags, seq, ack,
+                           window, len, tcp, tcp_len, now_ns);
+        return;
+    }
+    
+    switch (f->state) {
+        case TCP_FLOW_SYN_SENT:
+            if ((flags & (TCP_SEG_SYN | TCP_SEG_ACK)) != (TCP_SEG_SYN | TCP_SEG_ACK) ||
+                ack != f->iss + 1) {
+                return;
+            }
+            f->irs = seq;
+            f->rcv_nxt = seq + 1;
+            f->snd_una = ack;
+            f->peer_mss = tcp_parse_mss(tcp, tcp_len);
+            f->peer_window = window;
+            tcp_flow_established(e, f, now_ns);
+            tcp_flow_advance(e, f, 1, 1, now_ns);
+            return;
+        case TCP_FLOW_SYN_RCVD:
+            if (flags & TCP_SEG_SYN) {
+                /* The client resent its SYN: our SYN-ACK was lost */
+                tcp_emit(e, f, TCP_SEG_SYN | TCP_SEG_ACK, f->iss, NULL, 0);
+                return;
+            }
+            if (!(flags & TCP_SEG_ACK) || ack != f->iss + 1) {
+                return;
+            }
+            tcp_flow_established(e, f, now_ns);
+            break;          /* The ACK may carry the request */
+        default:
+            if (flags & TCP_SEG_SYN) {
+                /* A resent SYN-ACK: our handshake ACK was lost */
+                tcp_emit(e, f, TCP_SEG_ACK, f->snd_nxt, NULL, 0);
+                return;
+            }
+            break;
+    }
+    
+    int progress = 0;
+    int need_ack = 0;
+    if ((flags & TCP_SEG_ACK) && tcp_seq_lt(f->snd_una, ack) && !tcp_seq_lt(f->snd_max, ack)) {
+        f->snd_una = ack;
+        if (tcp_seq_lt(f->snd_nxt, ack)) {
+            f->snd_nxt = ack;
+        }
+        progress = 1;
+    }
+    f->peer_window = window;
     
-    memcpy((uint8_t*)umem_area + desc->addr, data, len);
+    /* In-order data only; anything else is dropped and re-acknowledged */
+    if (len > 0 || (flags & TCP_SEG_FIN)) {
+        if (seq == f->rcv_nxt && !(f->flags & TCP_FLOW_FIN_RCVD)) {
+            f->rcv_nxt += len;
+            progress |= len > 0;
+            if (flags & TCP_SEG_FIN) {
+                f->rcv_nxt++;
+                f->flags |= TCP_FLOW_FIN_RCVD;
+                progress = 1;
+                need_ack = 1;
+            }
+        } else {
+            need_ack = 1;
+        }
+    }
+    if (progress) {
+        f->retries = 0;
+    }
+    tcp_flow_advance(e, f, need_ack, progress, now_ns);
+}
+
+/* Returns 1 if the frame was ours */
+static int tcp_engine_segment(tcp_engine_t* e, const uint8_t* frame, uint32_t len, uint64_t now_ns) {
+    frame_layout_t layout;
+    if (parse_frame_layout(frame, len, &layout) != 0 || layout.proto != IPPROTO_TCP) {
+        return 0;
+    }
     
-    xsk_ring_prod__submit(&tx_ring, 1);
+    const uint8_t* ip = frame + layout.l2_len;
+    const uint8_t* tcp = ip + layout.l3_len;
+    uint32_t ip_len = load_be16(ip + 2);
+    if (ip_len < (uint32_t)layout.l3_len + layout.l4_len || layout.l2_len + ip_len > len) {
+        return 0;
+    }
     
-    /* Kick TX */
-    if (xsk_ring_prod__needs_wakeup(&tx_ring)) {
-        sendto(xsk_socket__fd(xsk), NULL, 0, MSG_DONTWAIT, NULL, 0);
+    uint32_t remote_ip;
+    uint32_t local_ip;
+    memcpy(&remote_ip, ip + 12, 4);
+    memcpy(&local_ip, ip + 16, 4);
+    uint16_t remote_port = load_be16(tcp);
+    uint16_t local_port = load_be16(tcp + 2);
+    if (!tcp_engine_is_local(e, local_ip, local_port)) {
+        return 0;
     }
     
-    return len;
+    uint8_t flags = tcp[13];
+    uint32_t seq = load_be32(tcp + 4);
+    uint32_t ack = load_be32(tcp + 8);
+    uint16_t window = load_be16(tcp + 14);
+    uint32_t data_len = ip_len - layout.l3_len - layout.l4_len;
+    
+    tcp_flow_t* f = tcp_flow_find(e, remote_ip, local_ip, remote_port, local_port);
+    if (f == NULL) {
+        tcp_engine_no_flow(e, remote_ip, local_ip, remote_port, local_port, flags, seq, ack,
+                           window, data_len, tcp, layout.l4_len, now_ns);
+    } else {
+        tcp_flow_input(e, f, flags, seq, ack, window, data_len, tcp, layout.l4_len, now_ns);
+    }
+    return 1;
 }
 
-int af_xdp_send_batch(const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
-    if (xsk == NULL) {
-        return -1;
+/* Open the next free client tuple; 0 if none is free */
+static int tcp_engine_open(tcp_engine_t* e, uint64_t now_ns) {
+    const tcp_engine_config_t* c = &e->config;
+    uint32_t ports = (uint32_t)c->client_port_max - c->client_port_min + 1;
+    
+    for (uint32_t tries = 0; tries < 16; tries++) {
+        uint32_t local_ip = htonl(ntohl(c->client_ip) + e->next_ip);
+        uint16_t local_port = (uint16_t)(c->client_port_min + e->next_port);
+        if (++e->next_port == ports) {
+            e->next_port = 0;
+            if (++e->next_ip == c->client_ip_count) {
+                e->next_ip = 0;
+            }
+        }
+        if (tcp_flow_find(e, c->server_ip, local_ip, c->server_port, local_port) != NULL) {
+            continue;
+        }
+        
+        tcp_flow_t* f = tcp_flow_insert(e, c->server_ip, local_ip, c->server_port, local_port);
+        if (f == NULL) {
+            return 0;
+        }
+        f->state = TCP_FLOW_SYN_SENT;
+        f->iss = tcp_engine_rand(e);
+        f->snd_una = f->iss;
+        f->snd_nxt = f->snd_max = f->iss + 1;
+        f->peer_mss = TCP_ENGINE_DEFAULT_MSS;
+        f->start_ns = now_ns;
+        e->stats.attempted++;
+        tcp_emit(e, f, TCP_SEG_SYN, f->iss, NULL, 0);
+        tcp_timer_arm(e, f, now_ns);
+        return 1;
+    }
+    return 0;
+}
+
+void tcp_engine_config_init(tcp_engine_config_t* config) {
+    if (config == NULL) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->role = TCP_ENGINE_CLIENT;
+    config->server_port = 80;
+    config->client_ip_count = 1;
+    config->client_port_min = 1024;
+    config->client_port_max = 65535;
+    config->request_len = 64;
+    config->response_len = 64;
+    config->max_concurrent = 65536;
+    config->numa_node = -1;
+}
+
+tcp_engine_t* tcp_engine_create(const tcp_engine_config_t* config) {
+    if (config == NULL || config->server_port == 0) {
+        return NULL;
+    }
+    if (config->role == TCP_ENGINE_CLIENT &&
+        (config->server_ip == 0 || config->client_ip == 0 || config->client_port_min == 0 ||
+         config->client_port_min > config->client_port_max)) {
+        return NULL;
     }
     
-    uint32_t idx;
-    uint32_t reserved = xsk_ring_prod__reserve(&tx_ring, count, &idx);
+    tcp_engine_t* e = (tcp_engine_t*)calloc(1, sizeof(*e));
+    if (e == NULL) {
+        return NULL;
+    }
+    e->config = *config;
+    tcp_engine_config_t* c = &e->config;
+    if (c->client_ip_count == 0) {
+        c->client_ip_count = 1;
+    }
+    if (c->max_concurrent == 0) {
+        c->max_concurrent = 65536;
+    }
+    if (c->mss == 0) {
+        c->mss = 1460;
+    } else if (c->mss > 9000) {
+        c->mss = 9000;      /* Jumbo frames at most */
+    }
+    if (c->window == 0) {
+        c->window = 65535;
+    }
+    if (c->rto_ns == 0) {
+        c->rto_ns = 200000000ULL;
+    }
+    if (c->max_retries == 0) {
+        c->max_retries = 3;
+    }
     
-    for (uint32_t i = 0; i < reserved; i++) {
-        struct xdp_desc* desc = xsk_ring_prod__tx_desc(&tx_ring, idx + i);
-        desc->addr = (idx + i) * FRAME_SIZE;
-        desc->len = lengths[i];
-        memcpy((uint8_t*)umem_area + desc->addr, packets[i], lengths[i]);
+    int client = c->role == TCP_ENGINE_CLIENT;
+    e->tx_len = client ? c->request_len : c->response_len;
+    e->rx_len = client ? c->response_len : c->request_len;
+    e->rng = get_timestamp_ns() | 1;
+    e->connect.min_ns = UINT64_MAX;
+    e->lifetime.min_ns = UINT64_MAX;
+    
+    /* At most half full keeps probe runs short */
+    uint32_t slots = 16;
+    while (slots < 2ULL * c->max_concurrent && slots < (1U << 31)) {
+        slots <<= 1;
     }
+    if (c->max_concurrent > slots / 2) {
+        c->max_concurrent = slots / 2;
+    }
+    e->mask = slots - 1;
+    e->timer_mask = slots - 1;
     
-    xsk_ring_prod__submit(&tx_ring, reserved);
+    size_t table_size = (size_t)slots * sizeof(tcp_flow_t);
+    mem_region_config_t mem;
+    mem_region_config_init(&mem);
+    mem.numa_node = c->numa_node;
+    if (table_size >= (2U << 20)) {
+        mem.pages = MEM_PAGES_2M;
+    }
+    uint32_t frame_max = 34 + 20 + TCP_ENGINE_MSS_OPT + c->mss;
     
-    if (xsk_ring_prod__needs_wakeup(&tx_ring)) {
-        sendto(xsk_socket__fd(xsk), NULL, 0, MSG_DONTWAIT, NULL, 0);
+    e->payload = (uint8_t*)malloc(e->tx_len > 0 ? e->tx_len : 1);
+    e->timers = (tcp_timer_t*)malloc((size_t)slots * sizeof(tcp_timer_t));
+    e->tx = pkt_batch_create(TCP_ENGINE_TX_FRAMES, TCP_ENGINE_TX_FRAMES * pkt_align(frame_max),
+                             0, c->numa_node);
+    if (e->payload == NULL || e->timers == NULL || e->tx == NULL ||
+        mem_region_alloc(&e->table_region, table_size, &mem) != 0) {
+        tcp_engine_destroy(e);
+        return NULL;
+    }
+    e->flows = (tcp_flow_t*)e->table_region.addr;
+    memset(e->flows, 0, table_size);
+    for (uint32_t i = 0; i < e->tx_len; i++) {
+        e->payload[i] = (uint8_t)('a' + i % 26);
+    }
+    return e;
+}
+
+int tcp_engine_input(tcp_engine_t* engine, const uint8_t** frames, const uint32_t* lengths,
+                     uint32_t count, uint64_t now_ns) {
+    if (engine == NULL || (count > 0 && (frames == NULL || lengths == NULL))) {
+        return -1;
     }
     
-    return reserved;
+    int matched = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        engine->stats.rx_frames++;
+        if (tcp_engine_segment(engine, frames[i], lengths[i], now_ns)) {
+            matched++;
+        } else {
+            engine->stats.rx_ignored++;
+        }
+    }
+    if (now_ns > engine->last_ns) {
+        engine->last_ns = now_ns;
+    }
+    return matched;
 }
 
-int af_xdp_recv(uint8_t* buffer, uint32_t max_len) {
-    if (xsk == NULL) {
+int tcp_engine_poll(tcp_engine_t* engine, uint64_t now_ns) {
+    if (engine == NULL) {
         return -1;
     }
+    tcp_engine_t* e = engine;
+    uint64_t queued = e->stats.tx_frames;
+    if (!e->started) {
+        e->started = 1;
+        e->start_ns = now_ns;
+        e->rate_ns = now_ns;
+    }
+    if (now_ns > e->last_ns) {
+        e->last_ns = now_ns;
+    }
     
-    uint32_t idx;
-    if (xsk_ring_cons__peek(&rx_ring, 1, &idx) != 1) {
-        return 0;
+    while (e->timer_head != e->timer_tail) {
+        tcp_timer_t t = e->timers[e->timer_head & e->timer_mask];
+        if (t.deadline_ns > now_ns) {
+            break;
+        }
+        e->timer_head++;
+        tcp_flow_t* f = tcp_flow_find(e, t.remote_ip, t.local_ip, t.remote_port, t.local_port);
+        if (f != NULL && f->timer_tag == t.tag) {
+            tcp_flow_timeout(e, f, now_ns);
+        }
     }
     
-    const struct xdp_desc* desc = xsk_ring_cons__rx_desc(&rx_ring, idx);
-    uint32_t len = desc->len < max_len ? desc->len : max_len;
+    /* Connections held back by max_concurrent open later, so the average
+     * rate still reaches target_cps when flows finish in time */
+    if (e->config.role == TCP_ENGINE_CLIENT && !e->paused) {
+        uint64_t due = UINT64_MAX;
+        if (e->config.target_cps > 0) {
+            due = e->rate_base + (uint64_t)((double)(now_ns - e->rate_ns) * (double)e->config.target_cps / 1e9) + 1;
+        }
+        if (e->config.max_connections > 0 && due > e->config.max_connections) {
+            due = e->config.max_connections;
+        }
+        for (uint32_t n = 0; n < TCP_ENGINE_OPEN_BUDGET && e->stats.attempted < due; n++) {
+            if (!tcp_engine_open(e, now_ns)) {
+                break;
+            }
+        }
+    }
+    return (int)(e->stats.tx_frames - queued);
+}
+
+pkt_batch_t* tcp_engine_tx_batch(tcp_engine_t* engine) {
+    return engine != NULL ? engine->tx : NULL;
+}
+
+int tcp_engine_done(const tcp_engine_t* engine) {
+    return engine != NULL && engine->config.role == TCP_ENGINE_CLIENT &&
+           engine->config.max_connections > 0 &&
+           engine->stats.attempted >= engine->config.max_connections && engine->active == 0;
+}
+
+/* Send the TX batch, retrying short sends; what cannot go out is dropped */
+static int tcp_engine_flush(tcp_engine_t* e, netstress_backend_t* backend) {
+    pkt_batch_t* tx = e->tx;
+    uint32_t done = 0;
+    uint32_t spins = 0;
+    int rc = 0;
     
-    memcpy(buffer, (uint8_t*)umem_area + desc->addr, len);
+    while (done < tx->count) {
+        int sent = netstress_backend_send_pkt_batch(backend, tx, done);
+        if (sent < 0) {
+            rc = sent;
+            break;
+        }
+        if (sent == 0) {
+            if (++spins > TCP_ENGINE_SEND_SPINS) {
+                break;
+            }
+            cpu_relax();
+        }
+        done += (uint32_t)sent;
+    }
+    e->stats.tx_dropped += tx->count - done;
+    pkt_batch_reset(tx);
+    return rc;
+}
+
+int tcp_engine_run(tcp_engine_t* engine, netstress_backend_t* backend, uint64_t duration_ns,
+                   worker_ctrl_t* ctrl) {
+    if (engine == NULL || netstress_backend_layer(backend) != (int)BACKEND_LAYER_L2) {
+        return -1;
+    }
     
-    xsk_ring_cons__release(&rx_ring, 1);
+    rx_desc_t descs[TCP_ENGINE_RX_BURST];
+    const uint8_t* frames[TCP_ENGINE_RX_BURST];
+    uint32_t lengths[TCP_ENGINE_RX_BURST];
+    worker_params_t params;
+    memset(&params, 0, sizeof(params));
+    params.supported = WORKER_CHANGED_RATE | WORKER_CHANGED_PAUSE | WORKER_CHANGED_STOP;
+    uint64_t now = get_timestamp_ns();
+    uint64_t end = duration_ns > 0 ? now + duration_ns : UINT64_MAX;
     
-    /* Refill fill ring */
-    uint32_t fq_idx;
-    if (xsk_ring_prod__reserve(&fq, 1, &fq_idx) == 1) {
-        *xsk_ring_prod__fill_addr(&fq, fq_idx) = desc->addr;
-        xsk_ring_prod__submit(&fq, 1);
+    while (now < end && !tcp_engine_done(engine)) {
+        uint32_t changed = ctrl != NULL ? worker_ctrl_poll(ctrl, &params) : 0;
+        if (changed != 0) {
+            if (params.stopped) {
+                break;
+            }
+            engine->paused = params.paused;
+            if (changed & WORKER_CHANGED_RATE) {
+                engine->config.target_cps = params.rate_pps;
+            }
+            
+            /* The new rate, or the resumed one, counts from now without catching up */
+            engine->rate_ns = now;
+            engine->rate_base = engine->stats.attempted;
+        }
+        
+        int got = netstress_backend_recv_batch(backend, descs, TCP_ENGINE_RX_BURST);
+        if (got < 0) {
+            return got;
+        }
+        now = get_timestamp_ns();
+        if (got > 0) {
+            for (int i = 0; i < got; i++) {
+                frames[i] = descs[i].data;
+                lengths[i] = descs[i].len;
+            }
+            tcp_engine_input(engine, frames, lengths, (uint32_t)got, now);
+            netstress_backend_release(backend, descs, (uint32_t)got);
+        }
+        tcp_engine_poll(engine, now);
+        
+        int idle = got == 0 && engine->tx->count == 0;
+        int rc = tcp_engine_flush(engine, backend);
+        if (rc < 0) {
+            return rc;
+        }
+        if (idle) {
+            cpu_relax();
+        }
+    }
+    return 0;
+}
+
+int tcp_engine_get_stats(const tcp_engine_t* engine, tcp_engine_stats_t* stats) {
+    if (engine == NULL || stats == NULL) {
+        return -1;
     }
     
-    return len;
+    *stats = engine->stats;
+    stats->active = engine->active;
+    uint64_t elapsed = engine->last_ns - engine->start_ns;
+    stats->cps = engine->started && elapsed > 0 ?
+                 (double)engine->stats.completed * 1e9 / (double)elapsed : 0.0;
+    tcp_hist_report(&engine->connect, &stats->connect);
+    tcp_hist_report(&engine->lifetime, &stats->lifetime);
+    return 0;
 }
 
-int cleanup_af_xdp(void) {
-    if (xsk) {
-        xsk_socket__delete(xsk);
-        xsk = NULL;
+void tcp_engine_destroy(tcp_engine_t* engine) {
+    if (engine == NULL) {
+        return;
+    }
+    mem_region_free(&engine->table_region);
+    pkt_batch_destroy(engine->tx);
+    free(engine->timers);
+    free(engine->payload);
+    free(engine);
+}
+
+/* ============================================================================
+ * Traffic Sink and Reflector
+ * ============================================================================ */
+
+#define SINK_DEFAULT_BURST 64
+#define SINK_MAX_BURST 1024
+#define SINK_WINDOW_WORDS (SINK_SEQ_WINDOW / 64)
+#define SINK_REFLECT_SPINS 64           /* Empty sends before the rest of a burst is dropped */
+
+/* Bit (seq % SINK_SEQ_WINDOW) of seen is set once seq has arrived */
+typedef struct {
+    uint32_t probe_id;
+    uint64_t first;
+    uint64_t highest;
+    uint64_t lost;
+    uint64_t seen[SINK_WINDOW_WORDS];
+} sink_stream_t;
+
+struct sink {
+    sink_config_t config;
+    uint32_t stream_count;
+    uint32_t last_stream;
+    int started;
+    uint64_t first_ns;
+    uint64_t last_ns;
+    sink_stats_t stats;
+    rx_desc_t* descs;
+    uint8_t** frames;
+    uint32_t* lengths;
+    sink_stream_t streams[SINK_MAX_STREAMS];
+};
+
+void sink_config_init(sink_config_t* config) {
+    if (config == NULL) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->probe_offset = LATENCY_PROBE_AUTO;
+    config->burst = SINK_DEFAULT_BURST;
+}
+
+sink_t* sink_create(const sink_config_t* config) {
+    sink_config_t defaults;
+    if (config == NULL) {
+        sink_config_init(&defaults);
+        config = &defaults;
+    }
+    
+    sink_t* sink = (sink_t*)calloc(1, sizeof(*sink));
+    if (sink == NULL) {
+        return NULL;
     }
-    if (umem) {
-        xsk_umem__delete(umem);
-        umem = NULL;
+    sink->config = *config;
+    if (sink->config.burst == 0) {
+        sink->config.burst = SINK_DEFAULT_BURST;
+    } else if (sink->config.burst > SINK_MAX_BURST) {
+        sink->config.burst = SINK_MAX_BURST;
     }
-    if (umem_area) {
-        free(umem_area);
-        umem_area = NULL;
+    
+    sink->descs = (rx_desc_t*)malloc(sink->config.burst * sizeof(rx_desc_t));
+    sink->frames = (uint8_t**)malloc(sink->config.burst * sizeof(uint8_t*));
+    sink->lengths = (uint32_t*)malloc(sink->config.burst * sizeof(uint32_t));
+    if (!sink->descs || !sink->frames || !sink->lengths) {
+        sink_destroy(sink);
+        return NULL;
     }
-    return 0;
+    return sink;
 }
 
-#endif /* HAS_AF_XDP */
-
-/* ============================================================================
- * io_uring Implementation (when available)
- * ============================================================================ */
-
-#ifdef HAS_IO_URING
-
-#include <liburing.h>
-#include <sys/uio.h>
+static inline void sink_seen_clear(sink_stream_t* st, uint64_t seq) {
+    st->seen[(seq / 64) % SINK_WINDOW_WORDS] &= ~(1ULL << (seq % 64));
+}
 
-static struct io_uring ring;
-static int io_uring_initialized = 0;
-static int io_uring_sockfd = -1;
-static driver_stats_t io_uring_stats = {0};
+/* Mark seq seen; returns whether it already was */
+static inline int sink_seen_set(sink_stream_t* st, uint64_t seq) {
+    uint64_t* word = &st->seen[(seq / 64) % SINK_WINDOW_WORDS];
+    uint64_t bit = 1ULL << (seq % 64);
+    int was = (*word & bit) != 0;
+    *word |= bit;
+    return was;
+}
 
-#define URING_QUEUE_DEPTH 256
-#define URING_BATCH_SIZE 32
+/* Stream of a probe id, claimed on first sight (*fresh set); NULL once all are taken */
+static sink_stream_t* sink_stream(sink_t* sink, uint32_t probe_id, uint64_t seq, int* fresh) {
+    *fresh = 0;
+    if (sink->stream_count > 0 && sink->streams[sink->last_stream].probe_id == probe_id) {
+        return &sink->streams[sink->last_stream];
+    }
+    for (uint32_t i = 0; i < sink->stream_count; i++) {
+        if (sink->streams[i].probe_id == probe_id) {
+            sink->last_stream = i;
+            return &sink->streams[i];
+        }
+    }
+    if (sink->stream_count == SINK_MAX_STREAMS) {
+        return NULL;
+    }
+    
+    /* A sink started mid-run counts from the first sequence it sees */
+    sink_stream_t* st = &sink->streams[sink->stream_count];
+    memset(st, 0, sizeof(*st));
+    st->probe_id = probe_id;
+    st->first = seq;
+    st->highest = seq;
+    sink_seen_set(st, seq);
+    *fresh = 1;
+    sink->last_stream = sink->stream_count++;
+    STATS_STORE(&sink->stats.streams, sink->stream_count);
+    return st;
+}
 
-int init_io_uring(int queue_depth) {
-    int ret = io_uring_queue_init(queue_depth > 0 ? queue_depth : URING_QUEUE_DEPTH, &ring, 0);
-    if (ret < 0) {
-        return ret;
+static void sink_track(sink_t* sink, sink_stream_t* st, uint64_t seq) {
+    if (seq > st->highest) {
+        uint64_t gap = seq - st->highest - 1;
+        if (gap >= SINK_SEQ_WINDOW) {
+            memset(st->seen, 0, sizeof(st->seen));
+        } else {
+            for (uint64_t s = st->highest + 1; s < seq; s++) {
+                sink_seen_clear(st, s);
+            }
+        }
+        sink_seen_clear(st, seq);
+        sink_seen_set(st, seq);
+        st->highest = seq;
+        if (gap > 0) {
+            st->lost += gap;
+            STATS_ADD(&sink->stats.lost, gap);
+        }
+        return;
     }
     
-    /* Create UDP socket for sending */
-    io_uring_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (io_uring_sockfd < 0) {
-        io_uring_queue_exit(&ring);
-        return -1;
+    /* Duplicates can only be told apart within the window */
+    int in_window = st->highest - seq < SINK_SEQ_WINDOW;
+    if (in_window && sink_seen_set(st, seq)) {
+        STATS_ADD(&sink->stats.duplicates, 1);
+        return;
     }
+    STATS_ADD(&sink->stats.reordered, 1);
     
-    io_uring_initialized = 1;
-    return 0;
+    /* Only a gap of this stream, still inside the window, was charged */
+    if (in_window && seq > st->first && st->lost > 0) {
+        st->lost--;
+        STATS_STORE(&sink->stats.lost, sink->stats.lost - 1);
+    }
 }
 
-int io_uring_send_batch(const uint8_t** packets, const uint32_t* lengths, 
-                        const struct sockaddr_in* dests, uint32_t count) {
-    if (!io_uring_initialized) {
-        return -1;
-    }
+/* Swapping source and destination keeps every checksum valid */
+static void sink_reflect_frame(uint8_t* frame, const frame_layout_t* layout) {
+    uint8_t mac[6];
+    memcpy(mac, frame, 6);
+    memcpy(frame, frame + 6, 6);
+    memcpy(frame + 6, mac, 6);
     
-    struct io_uring_sqe* sqe;
-    struct msghdr* msgs;
-    struct iovec* iovs;
-    uint32_t i;
+    uint8_t* ip = frame + layout->l2_len;
+    uint32_t addr;
+    memcpy(&addr, ip + 12, 4);
+    memcpy(ip + 12, ip + 16, 4);
+    memcpy(ip + 16, &addr, 4);
     
-    /* Allocate message structures */
-    msgs = (struct msghdr*)calloc(count, sizeof(struct msghdr));
-    iovs = (struct iovec*)calloc(count, sizeof(struct iovec));
-    if (!msgs || !iovs) {
-        free(msgs);
-        free(iovs);
+    uint8_t* l4 = ip + layout->l3_len;
+    uint16_t port;
+    memcpy(&port, l4, 2);
+    memcpy(l4, l4 + 2, 2);
+    memcpy(l4 + 2, &port, 2);
+}
+
+int sink_input(sink_t* sink, uint8_t** frames, uint32_t* lengths, uint32_t count, uint64_t now_ns) {
+    if (sink == NULL || (count > 0 && (frames == NULL || lengths == NULL))) {
         return -1;
     }
+    if (count == 0) {
+        return 0;
+    }
+    if (!sink->started) {
+        sink->started = 1;
+        STATS_STORE(&sink->first_ns, now_ns);
+    }
+    STATS_STORE(&sink->last_ns, now_ns);
     
-    /* Prepare submission queue entries */
-    for (i = 0; i < count; i++) {
-        sqe = io_uring_get_sqe(&ring);
-        if (!sqe) {
-            break;
-        }
+    int reflect = sink->config.reflect;
+    int auto_offset = sink->config.probe_offset == LATENCY_PROBE_AUTO;
+    uint64_t bytes = 0;
+    uint64_t sequenced = 0;
+    uint32_t reflected = 0;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t* frame = frames[i];
+        uint32_t len = lengths[i];
+        bytes += len;
         
-        iovs[i].iov_base = (void*)packets[i];
-        iovs[i].iov_len = lengths[i];
+        frame_layout_t layout;
+        int parsed = (reflect || auto_offset) && parse_frame_layout(frame, len, &layout) == 0;
+        uint32_t offset = sink->config.probe_offset;
+        if (auto_offset) {
+            offset = parsed ? (uint32_t)layout.l2_len + layout.l3_len + layout.l4_len : UINT32_MAX;
+        }
         
-        msgs[i].msg_name = (void*)&dests[i];
-        msgs[i].msg_namelen = sizeof(struct sockaddr_in);
-        msgs[i].msg_iov = &iovs[i];
-        msgs[i].msg_iovlen = 1;
-        msgs[i].msg_control = NULL;
-        msgs[i].msg_controllen = 0;
-        msgs[i].msg_flags = 0;
+        if (offset != UINT32_MAX && (uint64_t)offset + LATENCY_PROBE_HDR_LEN <= len) {
+            latency_probe_hdr_t hdr;
+            memcpy(&hdr, frame + offset, sizeof(hdr));
+            int fresh = 0;
+            sink_stream_t* st = hdr.magic == LATENCY_PROBE_MAGIC ? sink_stream(sink, hdr.probe_id, hdr.seq, &fresh) : NULL;
+            if (st != NULL) {
+                if (!fresh) {
+                    sink_track(sink, st, hdr.seq);
+                }
+                sequenced++;
+            }
+        }
         
-        io_uring_prep_sendmsg(sqe, io_uring_sockfd, &msgs[i], 0);
-        sqe->user_data = i;
+        /* Reflected frames are compacted to the front for the caller;
+         * broadcast and multicast ones would have no sender to go back to */
+        if (reflect && parsed && !(frame[0] & 1)) {
+            sink_reflect_frame(frame, &layout);
+            frames[reflected] = frame;
+            lengths[reflected] = len;
+            reflected++;
+        }
     }
     
-    /* Submit all at once */
-    int submitted = io_uring_submit(&ring);
-    
-    /* Wait for completions */
-    struct io_uring_cqe* cqe;
-    int completed = 0;
+    STATS_ADD(&sink->stats.rx_frames, count);
+    STATS_ADD(&sink->stats.rx_bytes, bytes);
+    STATS_ADD(&sink->stats.sequenced, sequenced);
+    if (reflect) {
+        STATS_ADD(&sink->stats.reflect_skipped, count - reflected);
+    }
+    return (int)reflected;
+}
+
+static int sink_reflect_send(sink_t* sink, netstress_backend_t* backend, uint32_t count) {
+    uint32_t done = 0;
+    uint32_t spins = 0;
     
-    for (int j = 0; j < submitted; j++) {
-        int ret = io_uring_wait_cqe(&ring, &cqe);
-        if (ret < 0) {
+    while (done < count) {
+        int sent = netstress_backend_send_batch(backend, (const uint8_t**)sink->frames + done,
+                                                sink->lengths + done, count - done);
+        if (sent < 0) {
             break;
         }
-        if (cqe->res >= 0) {
-            completed++;
-            io_uring_stats.packets_sent++;
-            io_uring_stats.bytes_sent += cqe->res;
-        } else {
-            io_uring_stats.errors++;
+        if (sent == 0) {
+            if (++spins > SINK_REFLECT_SPINS) {
+                break;
+            }
+            cpu_relax();
         }
-        io_uring_cqe_seen(&ring, cqe);
+        done += (uint32_t)sent;
     }
-    
-    free(msgs);
-    free(iovs);
-    
-    return completed;
+    STATS_ADD(&sink->stats.reflected, done);
+    STATS_ADD(&sink->stats.reflect_dropped, count - done);
+    return (int)done;
 }
 
-int io_uring_send_single(const uint8_t* data, uint32_t len, const struct sockaddr_in* dest) {
-    if (!io_uring_initialized) {
+int sink_poll(sink_t* sink, netstress_backend_t* backend) {
+    if (sink == NULL || backend == NULL) {
         return -1;
     }
-    
-    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
-    if (!sqe) {
+    if (sink->config.reflect && netstress_backend_layer(backend) != (int)BACKEND_LAYER_L2) {
         return -1;
     }
     
-    struct msghdr msg = {0};
-    struct iovec iov = {
-        .iov_base = (void*)data,
-        .iov_len = len
-    };
-    
-    msg.msg_name = (void*)dest;
-    msg.msg_namelen = sizeof(struct sockaddr_in);
-    msg.msg_iov = &iov;
-    msg.msg_iovlen = 1;
-    
-    io_uring_prep_sendmsg(sqe, io_uring_sockfd, &msg, 0);
-    
-    int ret = io_uring_submit(&ring);
-    if (ret < 0) {
-        return ret;
+    int got = netstress_backend_recv_batch(backend, sink->descs, sink->config.burst);
+    if (got <= 0) {
+        return got;
     }
-    
-    struct io_uring_cqe* cqe;
-    ret = io_uring_wait_cqe(&ring, &cqe);
-    if (ret < 0) {
-        return ret;
+    for (int i = 0; i < got; i++) {
+        sink->frames[i] = sink->descs[i].data;
+        sink->lengths[i] = sink->descs[i].len;
     }
     
-    int result = cqe->res;
-    io_uring_cqe_seen(&ring, cqe);
-    
-    return result;
+    /* Reflections are copied out before the RX buffers go back */
+    int reflect = sink_input(sink, sink->frames, sink->lengths, (uint32_t)got, get_timestamp_ns());
+    if (reflect > 0) {
+        sink_reflect_send(sink, backend, (uint32_t)reflect);
+    }
+    netstress_backend_release(backend, sink->descs, (uint32_t)got);
+    return got;
 }
 
-int io_uring_get_stats(driver_stats_t* stats) {
-    if (!io_uring_initialized || !stats) {
+int sink_run(sink_t* sink, netstress_backend_t* backend, uint64_t duration_ns, worker_ctrl_t* ctrl) {
+    if (sink == NULL || backend == NULL) {
         return -1;
     }
     
-    *stats = io_uring_stats;
+    worker_params_t params;
+    memset(&params, 0, sizeof(params));
+    params.supported = WORKER_CHANGED_PAUSE | WORKER_CHANGED_STOP;
+    uint64_t end = duration_ns > 0 ? get_timestamp_ns() + duration_ns : UINT64_MAX;
+    while (get_timestamp_ns() < end) {
+        if (ctrl != NULL) {
+            worker_ctrl_poll(ctrl, &params);
+            if (params.stopped) {
+                break;
+            }
+            if (params.paused) {
+                cpu_relax();
+                continue;
+            }
+        }
+        
+        int got = sink_poll(sink, backend);
+        if (got < 0) {
+            return got;
+        }
+        if (got == 0) {
+            cpu_relax();
+        }
+    }
     return 0;
 }
 
-int cleanup_io_uring(void) {
-    if (io_uring_initialized) {
-        if (io_uring_sockfd >= 0) {
-            close(io_uring_sockfd);
-            io_uring_sockfd = -1;
-        }
-        io_uring_queue_exit(&ring);
-        io_uring_initialized = 0;
-        memset(&io_uring_stats, 0, sizeof(io_uring_stats));
+int sink_get_stats(const sink_t* sink, sink_stats_t* stats) {
+    if (sink == NULL || stats == NULL) {
+        return -1;
     }
+    
+    stats->rx_frames = STATS_LOAD(&sink->stats.rx_frames);
+    stats->rx_bytes = STATS_LOAD(&sink->stats.rx_bytes);
+    stats->sequenced = STATS_LOAD(&sink->stats.sequenced);
+    stats->lost = STATS_LOAD(&sink->stats.lost);
+    stats->reordered = STATS_LOAD(&sink->stats.reordered);
+    stats->duplicates = STATS_LOAD(&sink->stats.duplicates);
+    stats->streams = STATS_LOAD(&sink->stats.streams);
+    stats->reflected = STATS_LOAD(&sink->stats.reflected);
+    stats->reflect_dropped = STATS_LOAD(&sink->stats.reflect_dropped);
+    stats->reflect_skipped = STATS_LOAD(&sink->stats.reflect_skipped);
+    
+    uint64_t elapsed = STATS_LOAD(&sink->last_ns) - STATS_LOAD(&sink->first_ns);
+    stats->pps = elapsed > 0 ? (double)stats->rx_frames * 1e9 / (double)elapsed : 0.0;
+    stats->gbps = elapsed > 0 ? (double)stats->rx_bytes * 8.0 / (double)elapsed : 0.0;
     return 0;
 }
 
-#endif /* HAS_IO_URING */
+void sink_destroy(sink_t* sink) {
+    if (sink == NULL) {
+        return;
+    }
+    free(sink->descs);
+    free(sink->frames);
+    free(sink->lengths);
+    free(sink);
+}
 
 /* ============================================================================
- * sendmmsg Batch Sending (Linux)
+ * Worker Control
  * ============================================================================ */
 
-#ifdef __linux__
+#define WORKER_CTRL_MAX_SLOTS (1u << 16)
 
-int sendmmsg_batch(int sockfd, const uint8_t** packets, const uint32_t* lengths,
-                   const struct sockaddr_in* dests, uint32_t count) {
-    struct mmsghdr* msgs;
-    struct iovec* iovs;
-    uint32_t i;
-    int sent;
-    
-    msgs = (struct mmsghdr*)calloc(count, sizeof(struct mmsghdr));
-    iovs = (struct iovec*)calloc(count, sizeof(struct iovec));
-    if (!msgs || !iovs) {
-        free(msgs);
-        free(iovs);
-        return -1;
+#if defined(_MSC_VER)
+    #define CTRL_LOAD(p) (*(volatile const uint64_t*)(p))
+    #define CTRL_STORE(p, v) (*(volatile uint64_t*)(p) = (v))
+#else
+    #define CTRL_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+    #define CTRL_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+/* Producer, consumer and acknowledgement state each get their own line */
+struct worker_ctrl {
+    SHIM_CACHE_ALIGNED uint64_t head;
+    uint64_t tail_cache;
+    SHIM_CACHE_ALIGNED uint64_t tail;
+    uint64_t head_cache;
+    uint64_t pending_ack;
+    SHIM_CACHE_ALIGNED uint64_t ack;
+    SHIM_CACHE_ALIGNED worker_cmd_t* slots;
+    uint8_t* refused;           /* Per slot: the worker did not apply it */
+    size_t size;
+    uint32_t mask;
+};
+
+worker_ctrl_t* worker_ctrl_create(uint32_t slots, int numa_node) {
+    if (slots == 0) {
+        slots = WORKER_CTRL_DEFAULT_SLOTS;
     }
-    
-    for (i = 0; i < count; i++) {
-        iovs[i].iov_base = (void*)packets[i];
-        iovs[i].iov_len = lengths[i];
-        
-        msgs[i].msg_hdr.msg_name = (void*)&dests[i];
-        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
-        msgs[i].msg_hdr.msg_iov = &iovs[i];
-        msgs[i].msg_hdr.msg_iovlen = 1;
-        msgs[i].msg_hdr.msg_control = NULL;
-        msgs[i].msg_hdr.msg_controllen = 0;
-        msgs[i].msg_hdr.msg_flags = 0;
+    if (slots > WORKER_CTRL_MAX_SLOTS) {
+        return NULL;
     }
-    
-    sent = sendmmsg(sockfd, msgs, count, 0);
-    
-    free(msgs);
-    free(iovs);
-    
-    return sent;
-}
-
-int sendmmsg_batch_same_dest(int sockfd, const uint8_t** packets, const uint32_t* lengths,
-                              uint32_t dst_ip, uint16_t dst_port, uint32_t count) {
-    struct sockaddr_in dest;
-    memset(&dest, 0, sizeof(dest));
-    dest.sin_family = AF_INET;
-    dest.sin_addr.s_addr = dst_ip;
-    dest.sin_port = htons(dst_port);
-    
-    struct mmsghdr* msgs;
-    struct iovec* iovs;
-    uint32_t i;
-    int sent;
-    
-    msgs = (struct mmsghdr*)calloc(count, sizeof(struct mmsghdr));
-    iovs = (struct iovec*)calloc(count, sizeof(struct iovec));
-    if (!msgs || !iovs) {
-        free(msgs);
-        free(iovs);
-        return -1;
+    uint32_t count = 1;
+    while (count < slots) {
+        count <<= 1;
     }
     
-    for (i = 0; i < count; i++) {
-        iovs[i].iov_base = (void*)packets[i];
-        iovs[i].iov_len = lengths[i];
-        
-        msgs[i].msg_hdr.msg_name = &dest;
-        msgs[i].msg_hdr.msg_namelen = sizeof(dest);
-        msgs[i].msg_hdr.msg_iov = &iovs[i];
-        msgs[i].msg_hdr.msg_iovlen = 1;
-        msgs[i].msg_hdr.msg_control = NULL;
-        msgs[i].msg_hdr.msg_controllen = 0;
-        msgs[i].msg_hdr.msg_flags = 0;
+    size_t header = (sizeof(worker_ctrl_t) + 63) & ~(size_t)63;
+    size_t size = header + (size_t)count * (sizeof(worker_cmd_t) + 1);
+    worker_ctrl_t* ctrl = (worker_ctrl_t*)alloc_numa_memory(size, numa_node);
+    if (ctrl == NULL) {
+        return NULL;
     }
-    
-    sent = sendmmsg(sockfd, msgs, count, 0);
-    
-    free(msgs);
-    free(iovs);
-    
-    return sent;
+    memset(ctrl, 0, header);
+    ctrl->slots = (worker_cmd_t*)((uint8_t*)ctrl + header);
+    ctrl->refused = (uint8_t*)(ctrl->slots + count);
+    ctrl->size = size;
+    ctrl->mask = count - 1;
+    return ctrl;
 }
 
-#else
-
-/* Fallback for non-Linux systems */
-int sendmmsg_batch(int sockfd, const uint8_t** packets, const uint32_t* lengths,
-                   const struct sockaddr_in* dests, uint32_t count) {
-    int sent = 0;
-    for (uint32_t i = 0; i < count; i++) {
-        ssize_t ret = sendto(sockfd, packets[i], lengths[i], 0,
-                             (struct sockaddr*)&dests[i], sizeof(struct sockaddr_in));
-        if (ret > 0) {
-            sent++;
-        }
+uint64_t worker_ctrl_post(worker_ctrl_t* ctrl, const worker_cmd_t* cmd) {
+    if (ctrl == NULL || cmd == NULL || (unsigned)cmd->type > (unsigned)WORKER_CMD_STOP) {
+        return 0;
     }
-    return sent;
-}
-
-int sendmmsg_batch_same_dest(int sockfd, const uint8_t** packets, const uint32_t* lengths,
-                              uint32_t dst_ip, uint16_t dst_port, uint32_t count) {
-    struct sockaddr_in dest;
-    memset(&dest, 0, sizeof(dest));
-    dest.sin_family = AF_INET;
-    dest.sin_addr.s_addr = dst_ip;
-#ifdef _WIN32
-    dest.sin_port = htons(dst_port);
-#else
-    dest.sin_port = htons(dst_port);
-#endif
     
-    int sent = 0;
-    for (uint32_t i = 0; i < count; i++) {
-        ssize_t ret = sendto(sockfd, packets[i], lengths[i], 0,
-                             (struct sockaddr*)&dest, sizeof(dest));
-        if (ret > 0) {
-            sent++;
+    uint64_t head = ctrl->head;
+    if (head - ctrl->tail_cache > ctrl->mask) {
+        ctrl->tail_cache = CTRL_LOAD(&ctrl->tail);
+        if (head - ctrl->tail_cache > ctrl->mask) {
+            return 0;
         }
     }
-    return sent;
+    ctrl->slots[head & ctrl->mask] = *cmd;
+    CTRL_STORE(&ctrl->head, head + 1);
+    return head + 1;
 }
 
-#endif /* __linux__ */
-
-/* ============================================================================
- * Backend Detection and Selection
- * ============================================================================ */
-
-typedef enum {
-    BACKEND_NONE = 0,
-    BACKEND_RAW_SOCKET = 1,
-    BACKEND_SENDMMSG = 2,
-    BACKEND_IO_URING = 3,
-    BACKEND_AF_XDP = 4,
-    BACKEND_DPDK = 5
-} backend_type_t;
-
-typedef struct {
-    int has_dpdk;
-    int has_af_xdp;
-    int has_io_uring;
-    int has_sendmmsg;
-    int has_raw_socket;
-    int kernel_version_major;
-    int kernel_version_minor;
-    int cpu_count;
-    int numa_nodes;
-} system_capabilities_t;
+uint64_t worker_ctrl_acked(const worker_ctrl_t* ctrl) {
+    return ctrl != NULL ? CTRL_LOAD(&ctrl->ack) : 0;
+}
 
-int detect_capabilities(system_capabilities_t* caps) {
-    memset(caps, 0, sizeof(system_capabilities_t));
-    
-    /* Always have raw sockets */
-    caps->has_raw_socket = 1;
-    
-    /* CPU count */
-    caps->cpu_count = get_cpu_count();
-    
-#ifdef __linux__
-    /* Check kernel version */
-    struct utsname uts;
-    if (uname(&uts) == 0) {
-        sscanf(uts.release, "%d.%d", &caps->kernel_version_major, &caps->kernel_version_minor);
+int worker_ctrl_wait(const worker_ctrl_t* ctrl, uint64_t seq, uint64_t timeout_ns) {
+    if (ctrl == NULL || seq == 0) {
+        return -1;
     }
     
-    /* sendmmsg available on Linux 3.0+ */
-    if (caps->kernel_version_major >= 3) {
-        caps->has_sendmmsg = 1;
+    uint64_t deadline = get_timestamp_ns() + timeout_ns;
+    while (CTRL_LOAD(&ctrl->ack) < seq) {
+        if (get_timestamp_ns() >= deadline) {
+            return -1;
+        }
+        cpu_relax();
     }
     
-    /* io_uring available on Linux 5.1+ */
-    if (caps->kernel_version_major > 5 || 
-        (caps->kernel_version_major == 5 && caps->kernel_version_minor >= 1)) {
-#ifdef HAS_IO_URING
-        caps->has_io_uring = 1;
-#endif
+    /* Written before the ack, and kept until the slot is posted to again */
+    if (ctrl->refused[(seq - 1) & ctrl->mask]) {
+        errno = ENOTSUP;
+        return -1;
     }
-    
-    /* AF_XDP available on Linux 4.18+ */
-    if (caps->kernel_version_major > 4 ||
-        (caps->kernel_version_major == 4 && caps->kernel_version_minor >= 18)) {
-#ifdef HAS_AF_XDP
-        caps->has_af_xdp = 1;
-#endif
+    return 0;
+}
+
+static uint32_t worker_cmd_flag(worker_cmd_type_t type) {
+    switch (type) {
+        case WORKER_CMD_RATE: return WORKER_CHANGED_RATE;
+        case WORKER_CMD_PACKET_SIZE: return WORKER_CHANGED_PACKET_SIZE;
+        case WORKER_CMD_TEMPLATE: return WORKER_CHANGED_TEMPLATE;
+        case WORKER_CMD_PAUSE:
+        case WORKER_CMD_RESUME: return WORKER_CHANGED_PAUSE;
+        case WORKER_CMD_STOP: return WORKER_CHANGED_STOP;
     }
-    
-    /* NUMA detection */
-    FILE* f = fopen("/sys/devices/system/node/online", "r");
-    if (f) {
-        char buf[64];
-        if (fgets(buf, sizeof(buf), f)) {
-            /* Parse "0-N" format */
-            int start, end;
-            if (sscanf(buf, "%d-%d", &start, &end) == 2) {
-                caps->numa_nodes = end - start + 1;
-            } else {
-                caps->numa_nodes = 1;
+    return 0;
+}
+
+static uint32_t worker_ctrl_apply(worker_params_t* params, const worker_cmd_t* cmd) {
+    switch (cmd->type) {
+        case WORKER_CMD_RATE:
+            params->rate_pps = cmd->rate_pps;
+            params->rate_bps = cmd->rate_bps;
+            params->burst = cmd->burst;
+            return WORKER_CHANGED_RATE;
+        case WORKER_CMD_PACKET_SIZE:
+            params->packet_size = cmd->packet_size;
+            return WORKER_CHANGED_PACKET_SIZE;
+        case WORKER_CMD_TEMPLATE:
+            params->tmpl = cmd->tmpl;
+            return WORKER_CHANGED_TEMPLATE;
+        case WORKER_CMD_PAUSE:
+        case WORKER_CMD_RESUME: {
+            int paused = cmd->type == WORKER_CMD_PAUSE;
+            if (params->paused == paused) {
+                return 0;
             }
+            params->paused = paused;
+            return WORKER_CHANGED_PAUSE;
         }
-        fclose(f);
+        case WORKER_CMD_STOP:
+            params->stopped = 1;
+            return WORKER_CHANGED_STOP;
     }
-#endif
-
-#ifdef HAS_DPDK
-    caps->has_dpdk = 1;
-#endif
-
     return 0;
 }
 
-backend_type_t select_best_backend(const system_capabilities_t* caps) {
-    /* Priority: DPDK > AF_XDP > io_uring > sendmmsg > raw_socket */
-    if (caps->has_dpdk) {
-        return BACKEND_DPDK;
+uint32_t worker_ctrl_poll(worker_ctrl_t* ctrl, worker_params_t* params) {
+    if (ctrl == NULL || params == NULL) {
+        return 0;
     }
-    if (caps->has_af_xdp) {
-        return BACKEND_AF_XDP;
+    
+    /* Whatever the previous poll returned has now run for a batch */
+    if (ctrl->pending_ack != 0) {
+        CTRL_STORE(&ctrl->ack, ctrl->pending_ack);
+        ctrl->pending_ack = 0;
     }
-    if (caps->has_io_uring) {
-        return BACKEND_IO_URING;
+    
+    uint64_t tail = ctrl->tail;
+    if (tail == ctrl->head_cache) {
+        ctrl->head_cache = CTRL_LOAD(&ctrl->head);
+        if (tail == ctrl->head_cache) {
+            return 0;
+        }
     }
-    if (caps->has_sendmmsg) {
-        return BACKEND_SENDMMSG;
+    
+    uint32_t changed = 0;
+    while (tail != ctrl->head_cache) {
+        worker_cmd_t cmd = ctrl->slots[tail & ctrl->mask];
+        int refused = params->supported != 0 && !(params->supported & worker_cmd_flag(cmd.type));
+        ctrl->refused[tail & ctrl->mask] = (uint8_t)refused;
+        if (!refused) {
+            changed |= worker_ctrl_apply(params, &cmd);
+        }
+        tail++;
     }
-    return BACKEND_RAW_SOCKET;
+    params->applied = tail;
+    CTRL_STORE(&ctrl->tail, tail);
+    
+    /* No batch follows a pause or stop, so there is nothing to wait for */
+    if (params->paused || params->stopped) {
+        CTRL_STORE(&ctrl->ack, tail);
+    } else {
+        ctrl->pending_ack = tail;
+    }
+    return changed;
 }
 
-const char* backend_name(backend_type_t backend) {
-    switch (backend) {
-        case BACKEND_DPDK: return "DPDK";
-        case BACKEND_AF_XDP: return "AF_XDP";
-        case BACKEND_IO_URING: return "io_uring";
-        case BACKEND_SENDMMSG: return "sendmmsg";
-        case BACKEND_RAW_SOCKET: return "raw_socket";
-        default: return "unknown";
+void worker_ctrl_destroy(worker_ctrl_t* ctrl) {
+    if (ctrl == NULL) {
+        return;
     }
+    free_numa_memory(ctrl, ctrl->size);
 }
@@ -13,16 +13,18 @@
 extern "C" {
 #endif
 
+struct sockaddr_in;
+
 /* ============================================================================
  * Common Types
  * ============================================================================ */
 
 typedef struct {
-    uint32_t packets_sent;
-    uint32_t packets_received;
-    uint32_t bytes_sent;
-    uint32_t bytes_received;
-    uint32_t errors;
+    uint64_t packets_sent;
+    uint64_t packets_received;
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    uint64_t errors;
 } driver_stats_t;
 
 typedef struct {
@@ -32,12 +34,110 @@ typedef struct {
     uint32_t ring_size;
     uint32_t burst_size;
     int promiscuous;
+    uint32_t tx_offloads;   /* Requested OFFLOAD_* flags (0 = all the NIC supports) */
 } driver_config_t;
 
+/* Hardware TX offloads, negotiated per DPDK port / AF_XDP queue */
+typedef enum {
+    OFFLOAD_IPV4_CKSUM = 1 << 0,
+    OFFLOAD_UDP_CKSUM = 1 << 1,
+    OFFLOAD_TCP_CKSUM = 1 << 2,
+    OFFLOAD_TCP_TSO = 1 << 3
+} offload_flags_t;
+
+#define OFFLOAD_ALL (OFFLOAD_IPV4_CKSUM | OFFLOAD_UDP_CKSUM | OFFLOAD_TCP_CKSUM | OFFLOAD_TCP_TSO)
+
+/*
+ * Borrowed RX packet for zero-copy receive. data points into the mbuf or
+ * UMEM frame and stays valid until the descriptor is released; handle is
+ * the backend's reference and must not be modified.
+ */
+typedef struct {
+    uint8_t* data;
+    uint32_t len;
+    uint32_t reserved;
+    uint64_t handle;
+} rx_desc_t;
+
+/* Page size for large shared regions (see mem_region_alloc) */
+typedef enum {
+    MEM_PAGES_DEFAULT = 0,      /* Base pages */
+    MEM_PAGES_2M = 1,           /* 2 MB huge pages */
+    MEM_PAGES_1G = 2            /* 1 GB huge pages */
+} mem_page_size_t;
+
+/* Opaque round-trip latency probe (see Latency Probing) */
+typedef struct latency_probe latency_probe_t;
+
+/* Opaque single-producer capture ring (see Capture Tap) */
+typedef struct tap_ring tap_ring_t;
+
+/* Opaque packet template with a field program (see Packet Templates) */
+typedef struct pkt_template pkt_template_t;
+
+/* Opaque worker command ring (see Worker Control) */
+typedef struct worker_ctrl worker_ctrl_t;
+
+/* Send-path stages charged by NETSTRESS_STAGE_CYCLES builds (see Per-Worker Statistics) */
+typedef enum {
+    STATS_STAGE_ALLOC = 0,      /* mbuf / UMEM frame allocation */
+    STATS_STAGE_COPY = 1,       /* Payload copy and descriptor fill */
+    STATS_STAGE_RESERVE = 2,    /* TX ring / SQ slot reservation */
+    STATS_STAGE_KICK = 3,       /* Doorbell: tx_burst, sendto wakeup, io_uring_submit, sendmmsg */
+    STATS_STAGE_REAP = 4,       /* Completion ring / CQE reaping */
+    STATS_STAGE_COUNT = 5
+} stats_stage_t;
+
+/* Per-queue stage totals; cycles are TSC ticks where available (see clock_tsc_hz), else ns */
+typedef struct {
+    uint64_t cycles[STATS_STAGE_COUNT];
+    uint64_t calls[STATS_STAGE_COUNT];
+} stage_stats_t;
+
+/*
+ * Outcome of a backpressure-aware send (see netstress_backend_send_batch_ex).
+ * accepted packets are the backend's responsibility, on the ring or held
+ * for retry; the caller resumes at first + accepted and must not resend them.
+ */
+typedef struct {
+    uint32_t accepted;      /* Packets taken from the caller */
+    uint32_t held;          /* Built packets the backend keeps for its next send */
+    uint32_t ring_used;     /* TX slots in flight after the call */
+    uint32_t ring_size;     /* TX slots in total (0 = occupancy not observable) */
+    uint32_t next_burst;    /* Burst the adaptive controller suggests next */
+} tx_result_t;
+
+/*
+ * Contiguous packet batch in structure-of-arrays layout. Packet i is
+ * lengths[i] bytes at arena + offsets[i]. dst_ips and dst_ports are
+ * optional per-packet destinations for the socket backends; when NULL,
+ * dst_ip and dst_port apply to the whole batch. Layout is shared with
+ * PacketBatch in the Rust engine's pool.rs.
+ */
+typedef struct {
+    uint8_t* arena;
+    uint32_t* offsets;
+    uint32_t* lengths;
+    uint32_t* dst_ips;          /* Network order */
+    uint16_t* dst_ports;        /* Host order */
+    uint32_t count;
+    uint32_t capacity;          /* Descriptor slots */
+    uint32_t arena_used;
+    uint32_t arena_size;
+    uint32_t dst_ip;            /* Network order */
+    uint16_t dst_port;          /* Host order */
+    uint16_t reserved;
+} pkt_batch_t;
+
 /* ============================================================================
  * DPDK Functions (when HAS_DPDK is defined)
  * ============================================================================ */
 
+struct rte_mbuf;
+
+/* Opaque per-lcore TX template (mempool of mbufs prefilled with one packet) */
+typedef struct dpdk_template dpdk_template_t;
+
 #ifdef HAS_DPDK
 
 /**
@@ -56,7 +156,24 @@ int dpdk_init(int argc, char** argv);
 int init_dpdk_port(int port_id);
 
 /**
- * Send a burst of packets via DPDK
+ * Initialize a DPDK port with config->num_queues RX/TX queue pairs
+ * Queue count is clamped to what the device supports; RSS is enabled
+ * when more than one RX queue is configured.
+ * @param config Port configuration (port_id, num_queues, ring_size, promiscuous)
+ * @return Number of queue pairs configured, negative on error (including
+ *         num_queues or ring_size above UINT16_MAX)
+ */
+int init_dpdk_port_config(const driver_config_t* config);
+
+/**
+ * Get number of queue pairs configured on a DPDK port
+ * @param port_id Port identifier
+ * @return Queue count, 0 if the port is not initialized
+ */
+int dpdk_get_queue_count(int port_id);
+
+/**
+ * Send a burst of packets via DPDK (queue 0)
  * @param port_id Port identifier
  * @param packets Array of packet data pointers
  * @param lengths Array of packet lengths
@@ -66,7 +183,68 @@ int init_dpdk_port(int port_id);
 int dpdk_send_burst(int port_id, const uint8_t** packets, const uint32_t* lengths, uint32_t count);
 
 /**
- * Receive a burst of packets via DPDK
+ * Send a burst of packets on a specific TX queue
+ * Each queue must be owned by a single thread; no locking is done. Packets
+ * go out in order, stopping at the first one too large for an mbuf; at
+ * most 1024 are taken per call.
+ * @param port_id Port identifier
+ * @param queue_id TX queue identifier
+ * @param packets Array of packet data pointers
+ * @param lengths Array of packet lengths
+ * @param count Number of packets
+ * @return Number of packets sent (or held, see dpdk_set_queue_tx_hold), negative on error
+ */
+int dpdk_send_burst_queue(int port_id, uint16_t queue_id, const uint8_t** packets,
+                          const uint32_t* lengths, uint32_t count);
+
+/**
+ * Keep built mbufs that rte_eth_tx_burst() refuses instead of freeing them
+ * Held mbufs (up to one burst) go out first on the queue's next send of
+ * any kind; while any remain no new packets are allocated, copied or
+ * passed to the NIC (mbufs given to dpdk_tx_burst_mbufs() are freed), and
+ * dpdk_send_burst_queue() and dpdk_send_pkt_batch() return packets
+ * accepted (sent or held) rather than sent. The kill switch drops them.
+ * Backend instances enable this.
+ * @param port_id Port identifier
+ * @param queue_id TX queue identifier
+ * @param enable 1 to hold, 0 to free held mbufs and drop refused ones again
+ * @return 0 on success, negative on error
+ */
+int dpdk_set_queue_tx_hold(int port_id, uint16_t queue_id, int enable);
+
+/**
+ * Get the number of mbufs a TX queue holds for retry
+ * @param port_id Port identifier
+ * @param queue_id TX queue identifier
+ * @return Held mbufs, negative on error
+ */
+int dpdk_get_queue_tx_held(int port_id, uint16_t queue_id);
+
+/**
+ * Send packets [first, count) of a batch on a specific TX queue
+ * At most 1024 are taken per call; resume from first plus the result.
+ * @param port_id Port identifier
+ * @param queue_id TX queue (one per worker lcore)
+ * @param batch Packet batch
+ * @param first Index of the first packet to send
+ * @return Number of packets sent, negative on error
+ */
+int dpdk_send_pkt_batch(int port_id, uint16_t queue_id, const pkt_batch_t* batch, uint32_t first);
+
+/**
+ * Generate count packets from a template straight into mbufs and send them
+ * The template is rewound past packets that were not sent, so its
+ * sequence continues with them next call. At most 1024 per call.
+ * @param port_id Port identifier
+ * @param queue_id TX queue (one per worker lcore)
+ * @param tmpl Packet template
+ * @param count Number of packets
+ * @return Number of packets sent, negative on error
+ */
+int dpdk_send_template(int port_id, uint16_t queue_id, pkt_template_t* tmpl, uint32_t count);
+
+/**
+ * Receive a burst of packets via DPDK (queue 0)
  * @param port_id Port identifier
  * @param packets Output array for packet data
  * @param max_count Maximum packets to receive
@@ -74,6 +252,192 @@ int dpdk_send_burst(int port_id, const uint8_t** packets, const uint32_t* length
  */
 int dpdk_recv_burst(int port_id, uint8_t** packets, uint32_t max_count);
 
+/**
+ * Borrow a burst of received packets without copying
+ * Descriptors must be handed back with dpdk_rx_release(), in any grouping.
+ * Each queue must be owned by a single thread; no locking is done. Both
+ * receive paths count into a per-queue block in driver_stats_snapshot().
+ * @param port_id Port identifier
+ * @param queue_id RX queue identifier
+ * @param descs Output descriptor array
+ * @param max_count Maximum packets to receive (capped at 1024)
+ * @return Number of descriptors filled, negative on error
+ */
+int dpdk_rx_burst_borrow(int port_id, uint16_t queue_id, rx_desc_t* descs, uint32_t max_count);
+
+/**
+ * Return borrowed RX descriptors, freeing their mbufs in bulk
+ * @param descs Descriptors from dpdk_rx_burst_borrow()
+ * @param count Number of descriptors
+ */
+void dpdk_rx_release(rx_desc_t* descs, uint32_t count);
+
+/**
+ * Receive a burst of packets from a specific RX queue
+ * Pointers stay valid until the next receive call on the same queue,
+ * which frees the previous burst.
+ * Each queue must be owned by a single thread; no locking is done.
+ * @param port_id Port identifier
+ * @param queue_id RX queue identifier
+ * @param packets Output array for packet data
+ * @param max_count Maximum packets to receive
+ * @return Number of packets received, negative on error
+ */
+int dpdk_recv_burst_queue(int port_id, uint16_t queue_id, uint8_t** packets, uint32_t max_count);
+
+/**
+ * Bulk-allocate TX mbufs for zero-copy sending
+ * Each mbuf is sized to len bytes; the caller writes packet data directly
+ * through the returned data pointers and hands the mbufs to dpdk_tx_burst_mbufs().
+ * Mbufs come from the pool on the port's NUMA node.
+ * @param port_id Port identifier
+ * @param mbufs Output array of mbufs
+ * @param data Output array of writable data pointers (may be NULL)
+ * @param len Packet length for every mbuf
+ * @param count Number of mbufs to allocate
+ * @return Number of mbufs allocated (count or 0), negative on error
+ */
+int dpdk_tx_alloc_bulk(int port_id, struct rte_mbuf** mbufs, uint8_t** data,
+                       uint32_t len, uint32_t count);
+
+/**
+ * Transmit caller-filled mbufs on a TX queue without copying
+ * Ownership of all mbufs passes to the shim; unsent mbufs are freed.
+ * @param port_id Port identifier
+ * @param queue_id TX queue identifier
+ * @param mbufs Array of mbufs from dpdk_tx_alloc_bulk() or dpdk_template_alloc()
+ * @param count Number of mbufs
+ * @return Number of packets sent, negative on error
+ */
+int dpdk_tx_burst_mbufs(int port_id, uint16_t queue_id, struct rte_mbuf** mbufs, uint32_t count);
+
+/**
+ * Return unused mbufs to their pool
+ * @param mbufs Array of mbufs
+ * @param count Number of mbufs
+ */
+void dpdk_tx_free_bulk(struct rte_mbuf** mbufs, uint32_t count);
+
+/**
+ * Create a TX template: a dedicated mempool whose mbufs are prefilled with
+ * one packet at creation time, so the hot path only rewrites the header
+ * fields that change per packet. Create one per lcore/worker.
+ * @param packet Template packet data
+ * @param len Template packet length
+ * @param num_mbufs Number of mbufs in the template pool
+ * @param socket_id NUMA socket for the pool (negative for SOCKET_ID_ANY)
+ * @return Template handle or NULL on error
+ */
+dpdk_template_t* dpdk_template_create(const uint8_t* packet, uint32_t len,
+                                      uint32_t num_mbufs, int socket_id);
+
+/**
+ * Bulk-allocate mbufs already holding the template packet
+ * @param tmpl Template handle
+ * @param mbufs Output array of mbufs
+ * @param data Output array of data pointers for per-packet header patches (may be NULL)
+ * @param count Number of mbufs to allocate
+ * @return Number of mbufs allocated (count or 0), negative on error
+ */
+int dpdk_template_alloc(dpdk_template_t* tmpl, struct rte_mbuf** mbufs,
+                        uint8_t** data, uint32_t count);
+
+/**
+ * Send the unmodified template packet count times from a single
+ * refcounted mbuf (identical payloads, no per-packet allocation)
+ * @param port_id Port identifier
+ * @param queue_id TX queue identifier
+ * @param tmpl Template handle
+ * @param count Number of copies to send (capped at 1024)
+ * @return Number of packets sent, negative on error
+ */
+int dpdk_template_send_repeat(int port_id, uint16_t queue_id, dpdk_template_t* tmpl, uint32_t count);
+
+/**
+ * Destroy a TX template and its mempool
+ * All mbufs from the template must have been sent or freed.
+ * @param tmpl Template handle
+ */
+void dpdk_template_destroy(dpdk_template_t* tmpl);
+
+/**
+ * Get NUMA socket of the mbuf pool used by a DPDK port
+ * @param port_id Port identifier
+ * @return NUMA socket, negative if unknown
+ */
+int dpdk_get_port_numa_node(int port_id);
+
+/**
+ * Get TX offloads enabled on a DPDK port
+ * dpdk_send_burst() applies checksum offloads automatically, so callers
+ * may leave IPv4/UDP/TCP checksums unset for the flags reported here.
+ * @param port_id Port identifier
+ * @return Bitmask of OFFLOAD_* flags (0 if none or port not started)
+ */
+uint32_t dpdk_get_tx_offloads(int port_id);
+
+/**
+ * Pace a TX queue inside the shim
+ * Applies to dpdk_send_burst_queue(), dpdk_tx_burst_mbufs() and
+ * dpdk_template_send_repeat(), which then block between bursts.
+ * @param port_id Port identifier
+ * @param queue_id TX queue identifier
+ * @param rate_pps Packets per second (0 with rate_bps 0 = unpaced)
+ * @param rate_bps Bits per second on the wire, excluding preamble and IFG
+ * @param burst Packets per slot (0 = 1)
+ * @return 0 on success, negative on error
+ */
+int dpdk_set_queue_rate(int port_id, uint16_t queue_id, uint64_t rate_pps,
+                        uint64_t rate_bps, uint32_t burst);
+
+/**
+ * Get the send-path stage counters of a TX queue
+ * All zero unless built with NETSTRESS_STAGE_CYCLES.
+ * @param port_id Port identifier
+ * @param queue_id TX queue identifier
+ * @param stages Output stage totals
+ * @return 0 on success, negative on error
+ */
+int dpdk_get_queue_stages(int port_id, uint16_t queue_id, stage_stats_t* stages);
+
+/**
+ * Attach a latency probe to a queue pair
+ * Packets sent on the TX queue are stamped right before transmission
+ * (shared template mbufs excepted) and replies on the RX queue are matched.
+ * @param port_id Port identifier
+ * @param queue_id Queue pair identifier
+ * @param probe Probe handle, NULL to detach (the caller keeps ownership)
+ * @return 0 on success, negative on error
+ */
+int dpdk_set_queue_latency_probe(int port_id, uint16_t queue_id, latency_probe_t* probe);
+
+/**
+ * Attach capture tap rings to a queue pair
+ * TX copies are taken just before each burst and published only for the
+ * mbufs the NIC accepted; RX copies as packets are received.
+ * @param port_id Port identifier
+ * @param queue_id Queue pair identifier
+ * @param tx_ring Ring for sent packets, NULL to detach
+ * @param rx_ring Ring for received packets, NULL to detach (may equal
+ *                tx_ring only if one thread drives both queues)
+ * @return 0 on success, negative on error
+ */
+int dpdk_set_queue_tap(int port_id, uint16_t queue_id, tap_ring_t* tx_ring, tap_ring_t* rx_ring);
+
+/**
+ * Mark mbufs for the port's negotiated checksum/TSO offloads
+ * Sets ol_flags and header lengths for IPv4 TCP/UDP frames (others are left
+ * untouched) and runs rte_eth_tx_prepare() to fill pseudo-header sums.
+ * @param port_id Port identifier
+ * @param queue_id TX queue the mbufs will be sent on
+ * @param mbufs Array of mbufs
+ * @param count Number of mbufs
+ * @param tso_segsz TCP segment size for TSO (0 = no segmentation)
+ * @return Number of leading mbufs ready to send, negative on error
+ */
+int dpdk_tx_offload_prepare(int port_id, uint16_t queue_id, struct rte_mbuf** mbufs,
+                            uint32_t count, uint16_t tso_segsz);
+
 /**
  * Get DPDK port statistics
  * @param port_id Port identifier
@@ -82,6 +446,40 @@ int dpdk_recv_burst(int port_id, uint8_t** packets, uint32_t max_count);
  */
 int dpdk_get_stats(int port_id, driver_stats_t* stats);
 
+/**
+ * Enable IEEE 1588 timesync on a port for hardware timestamps
+ * @param port_id Port identifier
+ * @return 0 on success, negative if the NIC lacks timesync
+ */
+int dpdk_timesync_enable(int port_id);
+
+/**
+ * Read the NIC clock
+ * @param port_id Port identifier
+ * @param ns Output time in nanoseconds
+ * @return 0 on success, negative on error
+ */
+int dpdk_timesync_read_clock(int port_id, uint64_t* ns);
+
+/**
+ * Read the latched RX hardware timestamp
+ * Only packets flagged RTE_MBUF_F_RX_IEEE1588_TMST latch one.
+ * @param port_id Port identifier
+ * @param index Timesync register index (mbuf->timesync)
+ * @param ns Output time in nanoseconds
+ * @return 0 on success, negative if none is available
+ */
+int dpdk_timesync_read_rx(int port_id, uint32_t index, uint64_t* ns);
+
+/**
+ * Read the latched TX hardware timestamp
+ * Only packets sent with RTE_MBUF_F_TX_IEEE1588_TMST latch one.
+ * @param port_id Port identifier
+ * @param ns Output time in nanoseconds
+ * @return 0 on success, negative if none is available
+ */
+int dpdk_timesync_read_tx(int port_id, uint64_t* ns);
+
 /**
  * Cleanup DPDK resources
  * @return 0 on success
@@ -93,13 +491,83 @@ int cleanup_dpdk(void);
 /* Stub implementations when DPDK is not available */
 static inline int dpdk_init(int argc, char** argv) { (void)argc; (void)argv; return -1; }
 static inline int init_dpdk_port(int port_id) { (void)port_id; return -1; }
+static inline int init_dpdk_port_config(const driver_config_t* config) { (void)config; return -1; }
+static inline int dpdk_get_queue_count(int port_id) { (void)port_id; return 0; }
 static inline int dpdk_send_burst(int port_id, const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
     (void)port_id; (void)packets; (void)lengths; (void)count; return -1;
 }
+static inline int dpdk_send_burst_queue(int port_id, uint16_t queue_id, const uint8_t** packets,
+                                        const uint32_t* lengths, uint32_t count) {
+    (void)port_id; (void)queue_id; (void)packets; (void)lengths; (void)count; return -1;
+}
+static inline int dpdk_set_queue_tx_hold(int port_id, uint16_t queue_id, int enable) {
+    (void)port_id; (void)queue_id; (void)enable; return -1;
+}
+static inline int dpdk_get_queue_tx_held(int port_id, uint16_t queue_id) {
+    (void)port_id; (void)queue_id; return -1;
+}
+static inline int dpdk_send_pkt_batch(int port_id, uint16_t queue_id, const pkt_batch_t* batch, uint32_t first) {
+    (void)port_id; (void)queue_id; (void)batch; (void)first; return -1;
+}
+static inline int dpdk_send_template(int port_id, uint16_t queue_id, pkt_template_t* tmpl, uint32_t count) {
+    (void)port_id; (void)queue_id; (void)tmpl; (void)count; return -1;
+}
 static inline int dpdk_recv_burst(int port_id, uint8_t** packets, uint32_t max_count) {
     (void)port_id; (void)packets; (void)max_count; return -1;
 }
+static inline int dpdk_recv_burst_queue(int port_id, uint16_t queue_id, uint8_t** packets, uint32_t max_count) {
+    (void)port_id; (void)queue_id; (void)packets; (void)max_count; return -1;
+}
+static inline int dpdk_rx_burst_borrow(int port_id, uint16_t queue_id, rx_desc_t* descs, uint32_t max_count) {
+    (void)port_id; (void)queue_id; (void)descs; (void)max_count; return -1;
+}
+static inline void dpdk_rx_release(rx_desc_t* descs, uint32_t count) { (void)descs; (void)count; }
+static inline int dpdk_tx_alloc_bulk(int port_id, struct rte_mbuf** mbufs, uint8_t** data,
+                                     uint32_t len, uint32_t count) {
+    (void)port_id; (void)mbufs; (void)data; (void)len; (void)count; return -1;
+}
+static inline int dpdk_tx_burst_mbufs(int port_id, uint16_t queue_id, struct rte_mbuf** mbufs, uint32_t count) {
+    (void)port_id; (void)queue_id; (void)mbufs; (void)count; return -1;
+}
+static inline void dpdk_tx_free_bulk(struct rte_mbuf** mbufs, uint32_t count) { (void)mbufs; (void)count; }
+static inline dpdk_template_t* dpdk_template_create(const uint8_t* packet, uint32_t len,
+                                                    uint32_t num_mbufs, int socket_id) {
+    (void)packet; (void)len; (void)num_mbufs; (void)socket_id; return NULL;
+}
+static inline int dpdk_template_alloc(dpdk_template_t* tmpl, struct rte_mbuf** mbufs,
+                                      uint8_t** data, uint32_t count) {
+    (void)tmpl; (void)mbufs; (void)data; (void)count; return -1;
+}
+static inline int dpdk_template_send_repeat(int port_id, uint16_t queue_id, dpdk_template_t* tmpl, uint32_t count) {
+    (void)port_id; (void)queue_id; (void)tmpl; (void)count; return -1;
+}
+static inline void dpdk_template_destroy(dpdk_template_t* tmpl) { (void)tmpl; }
+static inline int dpdk_get_port_numa_node(int port_id) { (void)port_id; return -1; }
+static inline uint32_t dpdk_get_tx_offloads(int port_id) { (void)port_id; return 0; }
+static inline int dpdk_set_queue_rate(int port_id, uint16_t queue_id, uint64_t rate_pps,
+                                      uint64_t rate_bps, uint32_t burst) {
+    (void)port_id; (void)queue_id; (void)rate_pps; (void)rate_bps; (void)burst; return -1;
+}
+static inline int dpdk_get_queue_stages(int port_id, uint16_t queue_id, stage_stats_t* stages) {
+    (void)port_id; (void)queue_id; (void)stages; return -1;
+}
+static inline int dpdk_set_queue_latency_probe(int port_id, uint16_t queue_id, latency_probe_t* probe) {
+    (void)port_id; (void)queue_id; (void)probe; return -1;
+}
+static inline int dpdk_set_queue_tap(int port_id, uint16_t queue_id, tap_ring_t* tx_ring, tap_ring_t* rx_ring) {
+    (void)port_id; (void)queue_id; (void)tx_ring; (void)rx_ring; return -1;
+}
+static inline int dpdk_tx_offload_prepare(int port_id, uint16_t queue_id, struct rte_mbuf** mbufs,
+                                          uint32_t count, uint16_t tso_segsz) {
+    (void)port_id; (void)queue_id; (void)mbufs; (void)count; (void)tso_segsz; return -1;
+}
 static inline int dpdk_get_stats(int port_id, driver_stats_t* stats) { (void)port_id; (void)stats; return -1; }
+static inline int dpdk_timesync_enable(int port_id) { (void)port_id; return -1; }
+static inline int dpdk_timesync_read_clock(int port_id, uint64_t* ns) { (void)port_id; (void)ns; return -1; }
+static inline int dpdk_timesync_read_rx(int port_id, uint32_t index, uint64_t* ns) {
+    (void)port_id; (void)index; (void)ns; return -1;
+}
+static inline int dpdk_timesync_read_tx(int port_id, uint64_t* ns) { (void)port_id; (void)ns; return -1; }
 static inline int cleanup_dpdk(void) { return 0; }
 
 #endif /* HAS_DPDK */
@@ -108,8 +576,203 @@ static inline int cleanup_dpdk(void) { return 0; }
  * AF_XDP Functions (when HAS_AF_XDP is defined)
  * ============================================================================ */
 
+typedef enum {
+    AF_XDP_MODE_AUTO = 0,   /* Native driver mode, falling back to SKB mode */
+    AF_XDP_MODE_DRV = 1,    /* Native driver mode only (zero-copy) */
+    AF_XDP_MODE_SKB = 2     /* Generic SKB mode (copy) */
+} af_xdp_mode_t;
+
+typedef struct {
+    uint32_t num_frames;        /* UMEM frames per socket (0 = 4096) */
+    uint32_t frame_size;        /* Frame size in bytes (0 = 4096) */
+    uint32_t ring_size;         /* RX/TX/fill/completion ring size (0 = 2048) */
+    af_xdp_mode_t mode;         /* XDP attach/bind mode */
+    int attach_prog;            /* Load libbpf's default redirect program */
+    int busy_poll;              /* Enable SO_PREFER_BUSY_POLL and always kick */
+    uint32_t busy_poll_budget;  /* Packets per busy-poll (0 = 64) */
+    int tx_checksum_offload;    /* Request L4 checksum via TX metadata (needs HAS_XSK_TX_METADATA) */
+    mem_page_size_t umem_pages; /* UMEM page size, falling back to base pages */
+    int umem_lock;              /* Pre-fault and mlock the UMEM at creation */
+} af_xdp_config_t;
+
+/* Opaque per-queue AF_XDP socket, owned by a single worker thread */
+typedef struct af_xdp_queue af_xdp_queue_t;
+
 #ifdef HAS_AF_XDP
 
+/**
+ * Get number of NIC queues (channels) available for AF_XDP sockets
+ * @param ifname Interface name
+ * @return Queue count, negative on error
+ */
+int af_xdp_get_queue_count(const char* ifname);
+
+/**
+ * Create an AF_XDP socket bound to one NIC queue with its own UMEM
+ * The UMEM is placed on the netdev's NUMA node.
+ * @param ifname Interface name
+ * @param queue_id NIC queue to bind
+ * @param config Socket configuration (NULL for defaults)
+ * @return Queue handle or NULL on error
+ */
+af_xdp_queue_t* af_xdp_queue_create(const char* ifname, uint32_t queue_id,
+                                    const af_xdp_config_t* config);
+
+/**
+ * Send batch of packets on an AF_XDP queue
+ * Completed frames are reclaimed from the completion ring first; the
+ * batch is truncated to the frames and TX descriptors available.
+ * @param queue Queue handle
+ * @param packets Array of packet data
+ * @param lengths Array of lengths
+ * @param count Number of packets
+ * @return Number of packets queued, negative on error
+ */
+int af_xdp_queue_send_batch(af_xdp_queue_t* queue, const uint8_t** packets,
+                            const uint32_t* lengths, uint32_t count);
+
+/**
+ * Send packets [first, count) of a batch on an AF_XDP queue
+ * Truncated like af_xdp_queue_send_batch.
+ * @param queue Queue handle
+ * @param batch Packet batch
+ * @param first Index of the first packet to send
+ * @return Number of packets queued, negative on error
+ */
+int af_xdp_queue_send_pkt_batch(af_xdp_queue_t* queue, const pkt_batch_t* batch, uint32_t first);
+
+/**
+ * Generate count packets from a template straight into UMEM frames and queue them
+ * Unsent packets are rewound as in dpdk_send_template(). The queue's pacer
+ * is not applied.
+ * @param queue Queue handle
+ * @param tmpl Packet template
+ * @param count Number of packets
+ * @return Number of packets queued, negative on error
+ */
+int af_xdp_queue_send_template(af_xdp_queue_t* queue, pkt_template_t* tmpl, uint32_t count);
+
+/**
+ * Reclaim completed TX frames without sending
+ * @param queue Queue handle
+ * @return Number of frames reclaimed, negative on error
+ */
+int af_xdp_queue_reclaim(af_xdp_queue_t* queue);
+
+/**
+ * Receive one packet from an AF_XDP queue
+ * @param queue Queue handle
+ * @param buffer Output buffer
+ * @param max_len Maximum buffer size
+ * @return Bytes received, 0 if none, negative on error
+ */
+int af_xdp_queue_recv(af_xdp_queue_t* queue, uint8_t* buffer, uint32_t max_len);
+
+/**
+ * Borrow a burst of received frames in place in the UMEM
+ * Frames are owned by the caller until af_xdp_queue_rx_release(); hold
+ * only as many as the workload needs, since the NIC cannot refill them.
+ * @param queue Queue handle
+ * @param descs Output descriptor array
+ * @param max_count Maximum frames to receive
+ * @return Number of descriptors filled, 0 if none, negative on error
+ */
+int af_xdp_queue_rx_borrow(af_xdp_queue_t* queue, rx_desc_t* descs, uint32_t max_count);
+
+/**
+ * Return borrowed frames to the fill ring in one batch
+ * @param queue Queue the frames were borrowed from
+ * @param descs Descriptors from af_xdp_queue_rx_borrow()
+ * @param count Number of descriptors
+ * @return Number of frames refilled, negative on error
+ */
+int af_xdp_queue_rx_release(af_xdp_queue_t* queue, const rx_desc_t* descs, uint32_t count);
+
+/**
+ * Get AF_XDP socket descriptor of a queue (for poll())
+ * @param queue Queue handle
+ * @return Socket descriptor or negative on error
+ */
+int af_xdp_queue_fd(const af_xdp_queue_t* queue);
+
+/**
+ * Get XDP mode the queue ended up using
+ * @param queue Queue handle
+ * @return AF_XDP_MODE_DRV or AF_XDP_MODE_SKB, negative on error
+ */
+int af_xdp_queue_mode(const af_xdp_queue_t* queue);
+
+/**
+ * Get TX offloads enabled on the queue
+ * With TX metadata (Linux 6.8+), UDP/TCP checksums over IPv4 are left to
+ * the NIC; the IPv4 header checksum is always the caller's.
+ * @param queue Queue handle
+ * @return Bitmask of OFFLOAD_* flags (0 if none)
+ */
+uint32_t af_xdp_queue_tx_offloads(const af_xdp_queue_t* queue);
+
+/**
+ * Pace an AF_XDP queue inside the shim
+ * af_xdp_queue_send_batch() then blocks between bursts.
+ * @param queue Queue handle
+ * @param rate_pps Packets per second (0 with rate_bps 0 = unpaced)
+ * @param rate_bps Bits per second
+ * @param burst Packets per slot (0 = 1)
+ * @return 0 on success, negative on error
+ */
+int af_xdp_queue_set_rate(af_xdp_queue_t* queue, uint64_t rate_pps, uint64_t rate_bps, uint32_t burst);
+
+/**
+ * Attach a latency probe to an AF_XDP queue
+ * Sent packets are stamped as they are copied into the UMEM and received
+ * packets are matched.
+ * @param queue Queue handle
+ * @param probe Probe handle, NULL to detach (the caller keeps ownership)
+ * @return 0 on success, negative on error
+ */
+int af_xdp_queue_set_latency_probe(af_xdp_queue_t* queue, latency_probe_t* probe);
+
+/**
+ * Attach capture tap rings to an AF_XDP queue
+ * TX copies are taken from the UMEM frames as they are queued.
+ * @param queue Queue handle
+ * @param tx_ring Ring for sent packets, NULL to detach
+ * @param rx_ring Ring for received packets, NULL to detach
+ * @return 0 on success, negative on error
+ */
+int af_xdp_queue_set_tap(af_xdp_queue_t* queue, tap_ring_t* tx_ring, tap_ring_t* rx_ring);
+
+/**
+ * Get per-queue statistics
+ * @param queue Queue handle
+ * @param stats Output statistics structure
+ * @return 0 on success
+ */
+int af_xdp_queue_get_stats(const af_xdp_queue_t* queue, driver_stats_t* stats);
+
+/**
+ * Get per-queue send-path stage counters (zero unless built with NETSTRESS_STAGE_CYCLES)
+ * @param queue Queue handle
+ * @param stages Output stage totals
+ * @return 0 on success
+ */
+int af_xdp_queue_get_stages(const af_xdp_queue_t* queue, stage_stats_t* stages);
+
+/**
+ * Get TX occupancy: frames submitted and not yet reclaimed, out of the TX frame budget
+ * @param queue Queue handle
+ * @param used Output frames in flight
+ * @param size Output TX frames in total
+ * @return 0 on success, -1 on error
+ */
+int af_xdp_queue_get_tx_ring(const af_xdp_queue_t* queue, uint32_t* used, uint32_t* size);
+
+/**
+ * Destroy an AF_XDP queue and release its UMEM
+ * @param queue Queue handle
+ */
+void af_xdp_queue_destroy(af_xdp_queue_t* queue);
+
 /**
  * Initialize AF_XDP socket on interface
  * @param ifname Interface name (e.g., "eth0")
@@ -151,6 +814,54 @@ int cleanup_af_xdp(void);
 #else
 
 /* Stub implementations when AF_XDP is not available */
+static inline int af_xdp_get_queue_count(const char* ifname) { (void)ifname; return -1; }
+static inline af_xdp_queue_t* af_xdp_queue_create(const char* ifname, uint32_t queue_id,
+                                                  const af_xdp_config_t* config) {
+    (void)ifname; (void)queue_id; (void)config; return NULL;
+}
+static inline int af_xdp_queue_send_batch(af_xdp_queue_t* queue, const uint8_t** packets,
+                                          const uint32_t* lengths, uint32_t count) {
+    (void)queue; (void)packets; (void)lengths; (void)count; return -1;
+}
+static inline int af_xdp_queue_send_pkt_batch(af_xdp_queue_t* queue, const pkt_batch_t* batch, uint32_t first) {
+    (void)queue; (void)batch; (void)first; return -1;
+}
+static inline int af_xdp_queue_send_template(af_xdp_queue_t* queue, pkt_template_t* tmpl, uint32_t count) {
+    (void)queue; (void)tmpl; (void)count; return -1;
+}
+static inline int af_xdp_queue_reclaim(af_xdp_queue_t* queue) { (void)queue; return -1; }
+static inline int af_xdp_queue_recv(af_xdp_queue_t* queue, uint8_t* buffer, uint32_t max_len) {
+    (void)queue; (void)buffer; (void)max_len; return -1;
+}
+static inline int af_xdp_queue_rx_borrow(af_xdp_queue_t* queue, rx_desc_t* descs, uint32_t max_count) {
+    (void)queue; (void)descs; (void)max_count; return -1;
+}
+static inline int af_xdp_queue_rx_release(af_xdp_queue_t* queue, const rx_desc_t* descs, uint32_t count) {
+    (void)queue; (void)descs; (void)count; return -1;
+}
+static inline int af_xdp_queue_fd(const af_xdp_queue_t* queue) { (void)queue; return -1; }
+static inline int af_xdp_queue_mode(const af_xdp_queue_t* queue) { (void)queue; return -1; }
+static inline uint32_t af_xdp_queue_tx_offloads(const af_xdp_queue_t* queue) { (void)queue; return 0; }
+static inline int af_xdp_queue_set_rate(af_xdp_queue_t* queue, uint64_t rate_pps,
+                                        uint64_t rate_bps, uint32_t burst) {
+    (void)queue; (void)rate_pps; (void)rate_bps; (void)burst; return -1;
+}
+static inline int af_xdp_queue_set_latency_probe(af_xdp_queue_t* queue, latency_probe_t* probe) {
+    (void)queue; (void)probe; return -1;
+}
+static inline int af_xdp_queue_set_tap(af_xdp_queue_t* queue, tap_ring_t* tx_ring, tap_ring_t* rx_ring) {
+    (void)queue; (void)tx_ring; (void)rx_ring; return -1;
+}
+static inline int af_xdp_queue_get_stats(const af_xdp_queue_t* queue, driver_stats_t* stats) {
+    (void)queue; (void)stats; return -1;
+}
+static inline int af_xdp_queue_get_stages(const af_xdp_queue_t* queue, stage_stats_t* stages) {
+    (void)queue; (void)stages; return -1;
+}
+static inline int af_xdp_queue_get_tx_ring(const af_xdp_queue_t* queue, uint32_t* used, uint32_t* size) {
+    (void)queue; (void)used; (void)size; return -1;
+}
+static inline void af_xdp_queue_destroy(af_xdp_queue_t* queue) { (void)queue; }
 static inline int init_af_xdp(const char* ifname) { (void)ifname; return -1; }
 static inline int af_xdp_send(const uint8_t* data, uint32_t len) { (void)data; (void)len; return -1; }
 static inline int af_xdp_send_batch(const uint8_t** packets, const uint32_t* lengths, uint32_t count) {
@@ -178,7 +889,7 @@ int raw_socket_create(int protocol);
  * @param dst_ip Destination IP (network byte order)
  * @param data Packet data
  * @param len Packet length
- * @return Bytes sent or negative on error
+ * @return Bytes sent, 0 if held back by the safety ceiling, negative on error
  */
 int raw_socket_send(int sockfd, uint32_t dst_ip, const uint8_t* data, uint32_t len);
 
@@ -187,7 +898,7 @@ int raw_socket_send(int sockfd, uint32_t dst_ip, const uint8_t* data, uint32_t l
  * @param sockfd Socket descriptor
  * @param data Full packet including IP header
  * @param len Packet length
- * @return Bytes sent or negative on error
+ * @return Bytes sent, 0 if held back by the safety ceiling, negative on error
  */
 int raw_socket_send_ip(int sockfd, const uint8_t* data, uint32_t len);
 
@@ -208,13 +919,43 @@ int raw_socket_set_hdrincl(int sockfd);
  * Utility Functions
  * ============================================================================ */
 
+/* Checksum kernel used by calculate_checksum/calculate_transport_checksum */
+typedef enum {
+    CHECKSUM_IMPL_AUTO = 0,      /* Fastest kernel the CPU supports */
+    CHECKSUM_IMPL_PORTABLE = 1,  /* 64-bit accumulator, any CPU */
+    CHECKSUM_IMPL_AVX2 = 2,
+    CHECKSUM_IMPL_AVX512 = 3,
+    CHECKSUM_IMPL_NEON = 4
+} checksum_impl_t;
+
 /**
- * Calculate IP checksum
- * @param data Data buffer
- * @param len Data length
- * @return Checksum value
+ * Select the checksum kernel (AUTO is chosen on first use otherwise)
+ * All kernels produce identical results.
+ * @param impl Kernel to use, or CHECKSUM_IMPL_AUTO for runtime detection
+ * @return 0 on success, -1 if the kernel is not available on this CPU/build
  */
-uint16_t calculate_checksum(const uint8_t* data, size_t len);
+int checksum_set_impl(checksum_impl_t impl);
+
+/**
+ * Get the checksum kernel currently in use
+ * @return Active kernel (never CHECKSUM_IMPL_AUTO)
+ */
+checksum_impl_t checksum_get_impl(void);
+
+/**
+ * Get checksum kernel name
+ * @param impl Kernel
+ * @return Kernel name string
+ */
+const char* checksum_impl_name(checksum_impl_t impl);
+
+/**
+ * Calculate IP checksum
+ * @param data Data buffer
+ * @param len Data length
+ * @return Checksum value
+ */
+uint16_t calculate_checksum(const uint8_t* data, size_t len);
 
 /**
  * Calculate TCP/UDP checksum with pseudo-header
@@ -229,11 +970,116 @@ uint16_t calculate_transport_checksum(uint32_t src_ip, uint32_t dst_ip,
                                        uint8_t protocol, const uint8_t* data, size_t len);
 
 /**
- * Get current timestamp in microseconds
+ * Incrementally update a checksum for a changed 16-bit word (RFC 1624)
+ * @param checksum Current checksum (host byte order)
+ * @param old_value Previous field value (host byte order)
+ * @param new_value New field value (host byte order)
+ * @return Updated checksum
+ */
+uint16_t checksum_update16(uint16_t checksum, uint16_t old_value, uint16_t new_value);
+
+/**
+ * Incrementally update a checksum for a changed 32-bit field (RFC 1624)
+ * @param checksum Current checksum (host byte order)
+ * @param old_value Previous field value (host byte order)
+ * @param new_value New field value (host byte order)
+ * @return Updated checksum
+ */
+uint16_t checksum_update32(uint16_t checksum, uint32_t old_value, uint32_t new_value);
+
+/**
+ * Rewrite a 16-bit big-endian field in place and patch its checksum
+ * Offsets are from the packet start; the checksummed region is assumed to
+ * start at an even offset (as IP/TCP/UDP headers do). Rewriting a UDP
+ * checksum of 0 (checksum disabled) is the caller's responsibility.
+ * @param packet Packet buffer
+ * @param len Packet length
+ * @param field_offset Offset of the field
+ * @param csum_offset Offset of the checksum covering the field
+ * @param value New field value (host byte order)
+ * @return 0 on success, -1 if the offsets do not fit or overlap
+ */
+int packet_rewrite16(uint8_t* packet, uint32_t len, uint32_t field_offset,
+                     uint32_t csum_offset, uint16_t value);
+
+/**
+ * Rewrite a 32-bit big-endian field in place and patch its checksum
+ * @param packet Packet buffer
+ * @param len Packet length
+ * @param field_offset Offset of the field
+ * @param csum_offset Offset of the checksum covering the field
+ * @param value New field value (host byte order)
+ * @return 0 on success, -1 if the offsets do not fit or overlap
+ */
+int packet_rewrite32(uint8_t* packet, uint32_t len, uint32_t field_offset,
+                     uint32_t csum_offset, uint32_t value);
+
+/**
+ * Rewrite the same 16-bit field across a batch of packets
+ * @param packets Array of packet buffers
+ * @param lengths Array of packet lengths
+ * @param count Number of packets
+ * @param field_offset Offset of the field
+ * @param csum_offset Offset of the checksum covering the field
+ * @param values Per-packet new values (host byte order)
+ * @return Number of packets rewritten, negative on error
+ */
+int packet_rewrite16_batch(uint8_t** packets, const uint32_t* lengths, uint32_t count,
+                           uint32_t field_offset, uint32_t csum_offset, const uint16_t* values);
+
+/**
+ * Rewrite the same 32-bit field across a batch of packets
+ * @param packets Array of packet buffers
+ * @param lengths Array of packet lengths
+ * @param count Number of packets
+ * @param field_offset Offset of the field
+ * @param csum_offset Offset of the checksum covering the field
+ * @param values Per-packet new values (host byte order)
+ * @return Number of packets rewritten, negative on error
+ */
+int packet_rewrite32_batch(uint8_t** packets, const uint32_t* lengths, uint32_t count,
+                           uint32_t field_offset, uint32_t csum_offset, const uint32_t* values);
+
+/* Time source behind get_timestamp_ns() */
+typedef enum {
+    CLOCK_SOURCE_MONOTONIC_RAW = 0,  /* clock_gettime(CLOCK_MONOTONIC_RAW) */
+    CLOCK_SOURCE_TSC = 1,            /* Calibrated invariant TSC, no syscall or vDSO */
+    CLOCK_SOURCE_QPC = 2             /* Windows QueryPerformanceCounter */
+} clock_source_t;
+
+/**
+ * Get monotonic timestamp in nanoseconds
+ * Uses the invariant TSC when the CPU and kernel clocksource allow it
+ * (calibrated on first use), otherwise CLOCK_MONOTONIC_RAW. Not wall time.
+ * @return Timestamp
+ */
+uint64_t get_timestamp_ns(void);
+
+/**
+ * Get monotonic timestamp in microseconds (get_timestamp_ns() / 1000)
  * @return Timestamp
  */
 uint64_t get_timestamp_us(void);
 
+/**
+ * Get the time source used by get_timestamp_ns()
+ * @return Clock source
+ */
+clock_source_t clock_get_source(void);
+
+/**
+ * Get calibrated TSC frequency
+ * @return Ticks per second, 0 if the TSC is not in use
+ */
+uint64_t clock_tsc_hz(void);
+
+/**
+ * Get clock source name
+ * @param source Clock source
+ * @return Name string
+ */
+const char* clock_source_name(clock_source_t source);
+
 /**
  * Get number of CPU cores
  * @return CPU count
@@ -247,142 +1093,2050 @@ int get_cpu_count(void);
  */
 int pin_to_cpu(int cpu_id);
 
-/* ============================================================================
- * io_uring Functions (when HAS_IO_URING is defined)
- * ============================================================================ */
+/**
+ * Get NUMA node a CPU core belongs to
+ * @param cpu_id CPU core ID
+ * @return NUMA node, or -1 if unknown
+ */
+int get_cpu_numa_node(int cpu_id);
 
-#ifdef HAS_IO_URING
+/**
+ * List CPU cores local to a NUMA node
+ * @param numa_node NUMA node
+ * @param cpus Output array of CPU IDs
+ * @param max_cpus Size of output array
+ * @return Number of CPUs written, negative on error
+ */
+int get_numa_node_cpus(int numa_node, int* cpus, int max_cpus);
 
 /**
- * Initialize io_uring for async I/O
- * @param queue_depth Size of submission/completion queues
- * @return 0 on success, negative on error
+ * Get NUMA node a network interface is attached to
+ * @param ifname Interface name (e.g., "eth0")
+ * @return NUMA node, or -1 if unknown (virtual devices, single-node systems)
  */
-int init_io_uring(int queue_depth);
+int get_netdev_numa_node(const char* ifname);
 
 /**
- * Send batch of packets via io_uring
- * @param packets Array of packet data
- * @param lengths Array of lengths
- * @param dests Array of destination addresses
- * @param count Number of packets
- * @return Number of packets sent
+ * Pin current thread to a CPU core local to a NUMA node
+ * Workers are spread round-robin over the node's cores by index. Falls
+ * back to pin_to_cpu(worker_index) when the node is unknown.
+ * @param numa_node NUMA node (negative for unknown)
+ * @param worker_index Worker index used to pick a core
+ * @return CPU core pinned to, negative on error
  */
-int io_uring_send_batch(const uint8_t** packets, const uint32_t* lengths,
-                        const struct sockaddr_in* dests, uint32_t count);
+int pin_to_numa_cpu(int numa_node, int worker_index);
 
 /**
- * Send single packet via io_uring
- * @param data Packet data
- * @param len Packet length
- * @param dest Destination address
- * @return Bytes sent or negative on error
+ * Allocate page-aligned memory preferring a NUMA node
+ * Packet arenas and AF_XDP UMEM go through mem_region_alloc(), which adds
+ * huge pages and prefaulting. Release with free_numa_memory().
+ * @param size Allocation size in bytes
+ * @param numa_node Preferred NUMA node (negative for no preference)
+ * @return Memory region or NULL on error
  */
-int io_uring_send_single(const uint8_t* data, uint32_t len, const struct sockaddr_in* dest);
+void* alloc_numa_memory(size_t size, int numa_node);
 
 /**
- * Cleanup io_uring resources
- * @return 0 on success
+ * Release memory from alloc_numa_memory()
+ * @param addr Memory region
+ * @param size Allocation size in bytes
  */
-int cleanup_io_uring(void);
+void free_numa_memory(void* addr, size_t size);
+
+typedef struct {
+    mem_page_size_t pages;      /* Requested page size */
+    int numa_node;              /* Preferred NUMA node (negative for no preference) */
+    int prefault;               /* Fault every page in at allocation */
+    int lock;                   /* mlock the region (implies prefault) */
+    int require_huge;           /* Fail rather than fall back to base pages */
+    const char* hugetlbfs_dir;  /* Back huge pages with a file on this hugetlbfs mount
+                                   (NULL = anonymous MAP_HUGETLB) */
+} mem_region_config_t;
+
+typedef struct {
+    void* addr;
+    size_t size;                /* Mapped bytes, a multiple of the page size */
+    mem_page_size_t pages;      /* Page size actually used */
+    int locked;                 /* 1 if mlock succeeded */
+} mem_region_t;
 
 /**
- * Get io_uring statistics
- * @param stats Output statistics structure
- * @return 0 on success
+ * Initialize a region config: base pages, no NUMA preference, lazy faults
+ * @param config Config to fill
  */
-int io_uring_get_stats(driver_stats_t* stats);
+void mem_region_config_init(mem_region_config_t* config);
 
-#else
+/**
+ * Map a region, preferably on huge pages
+ * The size is rounded up to the page size. Huge pages fall back to base
+ * pages unless require_huge is set; a failed mlock (RLIMIT_MEMLOCK) leaves
+ * the region usable with locked = 0.
+ * @param region Output region
+ * @param size Minimum size in bytes
+ * @param config Options (NULL = defaults)
+ * @return 0 on success, -1 on error
+ */
+int mem_region_alloc(mem_region_t* region, size_t size, const mem_region_config_t* config);
 
-/* Stub implementations when io_uring is not available */
-static inline int init_io_uring(int queue_depth) { (void)queue_depth; return -1; }
-static inline int io_uring_send_batch(const uint8_t** packets, const uint32_t* lengths,
-                                      const struct sockaddr_in* dests, uint32_t count) {
-    (void)packets; (void)lengths; (void)dests; (void)count; return -1;
-}
-static inline int io_uring_send_single(const uint8_t* data, uint32_t len, const struct sockaddr_in* dest) {
-    (void)data; (void)len; (void)dest; return -1;
-}
-static inline int io_uring_get_stats(driver_stats_t* stats) { (void)stats; return -1; }
-static inline int cleanup_io_uring(void) { return 0; }
+/**
+ * Unmap a region from mem_region_alloc()
+ * @param region Region (cleared on return)
+ */
+void mem_region_free(mem_region_t* region);
 
-#endif /* HAS_IO_URING */
+/* ============================================================================
+ * Hardware Timestamping (SO_TIMESTAMPING, Linux)
+ * ============================================================================ */
+
+/* Timestamp kinds for socket_enable_timestamps() */
+typedef enum {
+    TIMESTAMP_SOFTWARE = 1 << 0,  /* Kernel stack timestamps */
+    TIMESTAMP_HARDWARE = 1 << 1   /* NIC timestamps (needs net_enable_hw_timestamps) */
+} timestamp_flags_t;
+
+/**
+ * Turn on NIC hardware timestamping for all TX and RX packets (SIOCSHWTSTAMP)
+ * @param ifname Interface name
+ * @return 0 on success, -1 if unsupported or not permitted (CAP_NET_ADMIN)
+ */
+int net_enable_hw_timestamps(const char* ifname);
+
+/**
+ * Request RX and TX timestamps on a socket via SO_TIMESTAMPING
+ * TX timestamps are tagged with a per-socket counter (SOF_TIMESTAMPING_OPT_ID).
+ * @param sockfd Socket descriptor
+ * @param flags TIMESTAMP_* kinds to request
+ * @return 0 on success, -1 on error
+ */
+int socket_enable_timestamps(int sockfd, int flags);
+
+/**
+ * Receive one packet with its timestamps (non-blocking)
+ * @param sockfd Socket descriptor
+ * @param buffer Receive buffer
+ * @param max_len Buffer size
+ * @param sw_ns Output software timestamp (0 if none, may be NULL)
+ * @param hw_ns Output hardware timestamp (0 if none, may be NULL)
+ * @return Bytes received, 0 if nothing pending, -1 on error
+ */
+int socket_recv_timestamped(int sockfd, uint8_t* buffer, uint32_t max_len,
+                            uint64_t* sw_ns, uint64_t* hw_ns);
+
+/**
+ * Read one TX timestamp from the socket error queue (non-blocking)
+ * @param sockfd Socket descriptor
+ * @param id Output counter of the timestamped send (may be NULL)
+ * @param sw_ns Output software timestamp (0 if none, may be NULL)
+ * @param hw_ns Output hardware timestamp (0 if none, may be NULL)
+ * @return 1 if a timestamp was read, 0 if none pending, -1 on error
+ */
+int socket_read_tx_timestamp(int sockfd, uint32_t* id, uint64_t* sw_ns, uint64_t* hw_ns);
 
 /* ============================================================================
- * sendmmsg Batch Sending Functions
+ * Pacing
  * ============================================================================ */
 
+/*
+ * Token-bucket pacer driven by get_timestamp_ns(). A backend waits for the
+ * next slot, sends at most pacer_burst() packets and charges what it sent.
+ * Waits longer than a timer tick sleep instead of spinning, so low rates do
+ * not burn a core. A pacer belongs to a single sending thread.
+ */
+typedef struct pacer pacer_t;
+
 /**
- * Send batch of packets using sendmmsg (Linux) or fallback loop
+ * Create a pacer
+ * @param rate_pps Packets per second (0 = no packet limit)
+ * @param rate_bps Bits per second (0 = no bit limit)
+ * @param burst Packets sent back-to-back per slot (0 = 1)
+ * @return Pacer handle or NULL on error
+ */
+pacer_t* pacer_create(uint64_t rate_pps, uint64_t rate_bps, uint32_t burst);
+
+/**
+ * Change pacer rates; accumulated credit is dropped
+ * @param pacer Pacer handle
+ * @param rate_pps Packets per second (0 = no packet limit)
+ * @param rate_bps Bits per second (0 = no bit limit)
+ * @param burst Packets sent back-to-back per slot (0 = 1)
+ * @return 0 on success, -1 on error
+ */
+int pacer_set_rate(pacer_t* pacer, uint64_t rate_pps, uint64_t rate_bps, uint32_t burst);
+
+/**
+ * Get packets allowed per slot
+ * @param pacer Pacer handle
+ * @return Burst size
+ */
+uint32_t pacer_burst(const pacer_t* pacer);
+
+/**
+ * Block until the next send slot
+ * @param pacer Pacer handle
+ */
+void pacer_wait(pacer_t* pacer);
+
+/**
+ * Consume credit for packets that were sent
+ * Credit left unused while idle is capped at one burst.
+ * @param pacer Pacer handle
+ * @param packets Packets sent
+ * @param bytes Bytes sent
+ * @return Scheduled departure time of these packets (get_timestamp_ns() clock)
+ */
+uint64_t pacer_charge(pacer_t* pacer, uint32_t packets, uint64_t bytes);
+
+/**
+ * Destroy a pacer
+ * @param pacer Pacer handle
+ */
+void pacer_destroy(pacer_t* pacer);
+
+/**
+ * Cap a socket's kernel pacing rate (SO_MAX_PACING_RATE, enforced by fq)
  * @param sockfd Socket descriptor
- * @param packets Array of packet data
- * @param lengths Array of lengths
- * @param dests Array of destination addresses
- * @param count Number of packets
- * @return Number of packets sent
+ * @param bytes_per_sec Rate in bytes per second (0 = unlimited)
+ * @return 0 on success, -1 on error
  */
-int sendmmsg_batch(int sockfd, const uint8_t** packets, const uint32_t* lengths,
-                   const struct sockaddr_in* dests, uint32_t count);
+int socket_set_pacing_rate(int sockfd, uint64_t bytes_per_sec);
 
 /**
- * Send batch of packets to same destination
+ * Enable per-packet launch times (SO_TXTIME, CLOCK_MONOTONIC)
+ * The fq or etf qdisc must be installed on the egress device to honor them.
  * @param sockfd Socket descriptor
- * @param packets Array of packet data
- * @param lengths Array of lengths
- * @param dst_ip Destination IP (network byte order)
- * @param dst_port Destination port (host byte order)
- * @param count Number of packets
- * @return Number of packets sent
+ * @return 0 on success, -1 on error
  */
-int sendmmsg_batch_same_dest(int sockfd, const uint8_t** packets, const uint32_t* lengths,
-                              uint32_t dst_ip, uint16_t dst_port, uint32_t count);
+int socket_enable_txtime(int sockfd);
 
 /* ============================================================================
- * Backend Detection and Selection
+ * Per-Worker Statistics
  * ============================================================================ */
 
-typedef enum {
-    BACKEND_NONE = 0,
-    BACKEND_RAW_SOCKET = 1,
-    BACKEND_SENDMMSG = 2,
-    BACKEND_IO_URING = 3,
-    BACKEND_AF_XDP = 4,
-    BACKEND_DPDK = 5
-} backend_type_t;
+/* Maximum live stats blocks (AF_XDP queues, io_uring contexts, workers) */
+#define DRIVER_STATS_MAX_BLOCKS 256
+
+/* Log2 latency buckets: bucket i counts samples in [2^i, 2^(i+1)) ns */
+#define STATS_LATENCY_BUCKETS 32
+
+/* Opaque cache-line-aligned counter block written by exactly one thread */
+typedef struct driver_stats_block driver_stats_block_t;
+
+/**
+ * Claim a stats block for a worker or queue
+ * Each block occupies its own cache line, so workers never false-share.
+ * @return Zeroed block, or NULL if all DRIVER_STATS_MAX_BLOCKS are in use
+ */
+driver_stats_block_t* stats_block_create(void);
+
+/**
+ * Record sent packets (owning thread only)
+ * @param block Stats block
+ * @param packets Packets sent
+ * @param bytes Bytes sent
+ */
+void stats_block_add_tx(driver_stats_block_t* block, uint64_t packets, uint64_t bytes);
+
+/**
+ * Record received packets (owning thread only)
+ * @param block Stats block
+ * @param packets Packets received
+ * @param bytes Bytes received
+ */
+void stats_block_add_rx(driver_stats_block_t* block, uint64_t packets, uint64_t bytes);
+
+/**
+ * Record errors (owning thread only)
+ * @param block Stats block
+ * @param errors Error count
+ */
+void stats_block_add_errors(driver_stats_block_t* block, uint64_t errors);
+
+/**
+ * Record one latency sample into the block's log2 histogram (owning thread only)
+ * @param block Stats block
+ * @param latency_ns Latency in nanoseconds
+ */
+void stats_block_record_latency(driver_stats_block_t* block, uint64_t latency_ns);
+
+/**
+ * Read one block's counters (safe from any thread)
+ * @param block Stats block
+ * @param stats Output statistics
+ * @return 0 on success, -1 on error
+ */
+int stats_block_read(const driver_stats_block_t* block, driver_stats_t* stats);
+
+/**
+ * Release a stats block; its counts stay in the aggregate snapshot
+ * @param block Stats block
+ */
+void stats_block_destroy(driver_stats_block_t* block);
+
+/**
+ * Sum all live and released blocks without pausing writers
+ * Counters are read individually, so a snapshot taken mid-batch may lag
+ * by the packets in flight, but totals never go backwards.
+ * @param stats Output aggregate statistics
+ * @return Number of live blocks, -1 on error
+ */
+int driver_stats_snapshot(driver_stats_t* stats);
+
+/*
+ * Hot-path stage accounting
+ *
+ * Built with -DNETSTRESS_STAGE_CYCLES, every backend charges the time
+ * between stage boundaries of a send to its queue's stage_stats_t; without
+ * the flag the counters stay zero and the send paths carry no timing code.
+ * Wherever <sys/sdt.h> exists (unless built with -DNETSTRESS_NO_USDT),
+ * the shim also places static tracepoints, each
+ * taking (backend_type_t, queue id or socket fd, packets):
+ *   netstress:tx_submit    packets handed to the ring, NIC or kernel
+ *   netstress:tx_complete  packets the backend reports done
+ * so perf or bpftrace can attach without a rebuild.
+ */
+
+/**
+ * Check whether stage counters are compiled in
+ * @return 1 if built with NETSTRESS_STAGE_CYCLES, 0 otherwise
+ */
+int stats_stages_enabled(void);
+
+/**
+ * Get the short name of a stage ("alloc", "copy", ...)
+ * @param stage Stage
+ * @return Static string, "unknown" for out-of-range values
+ */
+const char* stats_stage_name(stats_stage_t stage);
+
+/**
+ * Read one block's stage counters (safe from any thread)
+ * @param block Stats block
+ * @param stages Output stage totals
+ * @return 0 on success, -1 on error
+ */
+int stats_block_read_stages(const driver_stats_block_t* block, stage_stats_t* stages);
+
+/**
+ * Sum the stage counters of all live and released blocks
+ * Covers AF_XDP queues and io_uring contexts; DPDK queues and sendmmsg
+ * contexts keep their own (see dpdk_get_queue_stages, sendmmsg_ctx_get_stages).
+ * @param stages Output aggregate stage totals
+ * @return Number of live blocks, -1 on error
+ */
+int driver_stages_snapshot(stage_stats_t* stages);
+
+/*
+ * Shared-memory telemetry region
+ *
+ * A file (typically under /dev/shm) holding a header, an aggregate slot and
+ * one slot per stats block. A publisher thread copies the blocks into it;
+ * readers in other processes mmap the file and need no syscalls or FFI.
+ * Each slot is a seqlock: seq is odd while being written, so a reader
+ * copies the slot and retries unless seq was even and unchanged.
+ */
+#define STATS_SHM_MAGIC 0x5354534EU  /* "NSTS" little-endian */
+#define STATS_SHM_VERSION 1
 
 typedef struct {
-    int has_dpdk;
-    int has_af_xdp;
-    int has_io_uring;
-    int has_sendmmsg;
-    int has_raw_socket;
-    int kernel_version_major;
-    int kernel_version_minor;
-    int cpu_count;
-    int numa_nodes;
-} system_capabilities_t;
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_slots;         /* Per-block slots after the aggregate */
+    uint32_t slot_size;         /* sizeof(stats_shm_slot_t) */
+    uint64_t interval_us;       /* Publisher period (0 = manual publish) */
+    uint64_t publish_count;     /* Completed publish passes */
+    uint8_t reserved[32];
+} stats_shm_header_t;
+
+typedef struct {
+    uint64_t seq;
+    uint64_t timestamp_us;      /* get_timestamp_us() at publish */
+    uint32_t active;            /* Block currently claimed */
+    uint32_t reserved;
+    driver_stats_t counters;
+    uint64_t latency[STATS_LATENCY_BUCKETS];
+} stats_shm_slot_t;
+
+/* Opaque publisher handle */
+typedef struct stats_shm stats_shm_t;
 
 /**
- * Detect system capabilities for backend selection
- * @param caps Output capabilities structure
- * @return 0 on success
+ * Create the telemetry region and optionally start its publisher thread
+ * @param path File to create (truncated if present)
+ * @param interval_us Publish period in microseconds (0 = call stats_shm_publish)
+ * @return Handle or NULL on error
  */
-int detect_capabilities(system_capabilities_t* caps);
+stats_shm_t* stats_shm_create(const char* path, uint32_t interval_us);
 
 /**
- * Select best available backend based on capabilities
- * @param caps System capabilities
- * @return Best available backend type
+ * Copy all stats blocks into the region once
+ * @param shm Handle
+ * @return Number of live blocks published, negative on error
  */
-backend_type_t select_best_backend(const system_capabilities_t* caps);
+int stats_shm_publish(stats_shm_t* shm);
 
 /**
- * Get human-readable backend name
- * @param backend Backend type
- * @return Backend name string
+ * Get the mapped region (header first)
+ * @param shm Handle
+ * @return Region base or NULL
  */
-const char* backend_name(backend_type_t backend);
+const void* stats_shm_region(const stats_shm_t* shm);
+
+/**
+ * Read one slot of any mapping of the region, retrying torn reads
+ * @param region Region base (from stats_shm_region() or an own mmap)
+ * @param slot Block slot, or -1 for the aggregate
+ * @param out Output slot copy
+ * @return 0 on success, -1 on error, -EAGAIN if the slot stays mid-update
+ *         (its writer died or stalled)
+ */
+int stats_shm_read(const void* region, int slot, stats_shm_slot_t* out);
+
+/**
+ * Stop the publisher, unmap and unlink the region
+ * @param shm Handle
+ */
+void stats_shm_destroy(stats_shm_t* shm);
+
+/* ============================================================================
+ * Latency Probing
+ * ============================================================================ */
+
+/*
+ * A probe writes a 24-byte header {magic, probe_id, seq, tx_ns} into each
+ * sent packet and matches it in replies, so the RTT needs no per-packet
+ * state. Samples go into a log-linear (HDR) histogram with 1/32 relative
+ * precision. Stamping and matching may run on two different threads, but
+ * each of them on only one.
+ */
+#define LATENCY_PROBE_MAGIC 0x4E534C50U    /* "NSLP" */
+#define LATENCY_PROBE_HDR_LEN 24
+/* Offset meaning: right after the L4 header of an Ethernet/IPv4 TCP/UDP frame */
+#define LATENCY_PROBE_AUTO 0xFFFFFFFFU
+
+typedef struct {
+    uint64_t sent;          /* Packets stamped */
+    uint64_t received;      /* Replies matched */
+    uint64_t reordered;     /* Replies older than one already seen */
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+} latency_report_t;
+
+/**
+ * Create a latency probe
+ * @param probe_id Identifier carried in the header; replies for other ids are ignored
+ * @param offset Header offset in the packet, or LATENCY_PROBE_AUTO for frames
+ * @param stats Optional stats block that also receives every sample (may be NULL)
+ * @return Probe handle or NULL on error
+ */
+latency_probe_t* latency_probe_create(uint32_t probe_id, uint32_t offset, driver_stats_block_t* stats);
+
+/**
+ * Stamp a packet with the next sequence number and the current time
+ * In LATENCY_PROBE_AUTO mode a non-zero L4 checksum is updated to match.
+ * @param probe Probe handle
+ * @param packet Packet data
+ * @param len Packet length
+ * @return 0 on success, -1 if the header does not fit
+ */
+int latency_probe_stamp(latency_probe_t* probe, uint8_t* packet, uint32_t len);
+
+/**
+ * Match a received packet and record its round-trip time
+ * @param probe Probe handle
+ * @param packet Packet data
+ * @param len Packet length
+ * @param rx_ns Receive time from get_timestamp_ns()
+ * @return 1 if a sample was recorded, 0 if the packet is not one of ours
+ */
+int latency_probe_match(latency_probe_t* probe, const uint8_t* packet, uint32_t len, uint64_t rx_ns);
+
+/**
+ * Record a latency measured outside the probe (no sequence tracking)
+ * @param probe Probe handle
+ * @param latency_ns Sample in nanoseconds
+ */
+void latency_probe_record(latency_probe_t* probe, uint64_t latency_ns);
+
+/**
+ * Get a latency percentile
+ * @param probe Probe handle
+ * @param percentile Percentile in [0, 100]
+ * @return Latency in nanoseconds (within 1/32), 0 if no samples
+ */
+uint64_t latency_probe_percentile(const latency_probe_t* probe, double percentile);
+
+/**
+ * Get counters and p50/p99/p99.9 from a probe
+ * @param probe Probe handle
+ * @param report Output report
+ * @return 0 on success, -1 on error
+ */
+int latency_probe_report(const latency_probe_t* probe, latency_report_t* report);
+
+/**
+ * Destroy a probe (detach it from any queue first)
+ * @param probe Probe handle
+ */
+void latency_probe_destroy(latency_probe_t* probe);
+
+/* ============================================================================
+ * Packet Batches
+ * ============================================================================ */
+
+/* Packets start on a cache line within the arena */
+#define PKT_BATCH_ALIGN 64
+
+/**
+ * Allocate a batch with its descriptors and arena in one NUMA-local block
+ * @param capacity Maximum packets
+ * @param arena_size Arena bytes (packets are PKT_BATCH_ALIGN-aligned)
+ * @param per_packet_dests Also allocate dst_ips/dst_ports
+ * @param numa_node Preferred NUMA node (negative for no preference)
+ * @return Batch or NULL on error
+ */
+pkt_batch_t* pkt_batch_create(uint32_t capacity, uint32_t arena_size, int per_packet_dests, int numa_node);
+
+/**
+ * Allocate a batch in a region with explicit page size, prefault and mlock
+ * Release with pkt_batch_destroy().
+ * @param capacity Maximum packets
+ * @param arena_size Arena bytes (packets are PKT_BATCH_ALIGN-aligned)
+ * @param per_packet_dests Also allocate dst_ips/dst_ports
+ * @param mem Region options (NULL = base pages, no NUMA preference)
+ * @return Batch or NULL on error
+ */
+pkt_batch_t* pkt_batch_create_in(uint32_t capacity, uint32_t arena_size, int per_packet_dests,
+                                 const mem_region_config_t* mem);
+
+/**
+ * Append a packet slot and return its arena space for the caller to fill
+ * @param batch Batch
+ * @param len Packet length
+ * @param dst_ip Destination, network order (ignored without per-packet dests)
+ * @param dst_port Destination port, host order (ignored without per-packet dests)
+ * @return Writable packet bytes, NULL when the batch or arena is full
+ */
+uint8_t* pkt_batch_reserve(pkt_batch_t* batch, uint32_t len, uint32_t dst_ip, uint16_t dst_port);
+
+/**
+ * Copy a packet into the batch
+ * @param batch Batch
+ * @param data Packet data
+ * @param len Packet length
+ * @param dst_ip Destination, network order (ignored without per-packet dests)
+ * @param dst_port Destination port, host order (ignored without per-packet dests)
+ * @return Packet index, negative when full
+ */
+int pkt_batch_append(pkt_batch_t* batch, const uint8_t* data, uint32_t len,
+                     uint32_t dst_ip, uint16_t dst_port);
+
+/**
+ * Empty a batch, keeping its allocation
+ * @param batch Batch
+ */
+void pkt_batch_reset(pkt_batch_t* batch);
+
+/**
+ * Free a batch from pkt_batch_create() (not caller-assembled ones)
+ * @param batch Batch (NULL is ignored)
+ */
+void pkt_batch_destroy(pkt_batch_t* batch);
+
+/* ============================================================================
+ * Packet Templates
+ * ============================================================================ */
+
+/*
+ * A template is one packet plus a program of field mutations, handed to
+ * the shim once. Generating packet n copies the template and writes each
+ * field's n-th value, then patches the checksums that cover the fields
+ * incrementally from precomputed bases, so nothing is summed over the
+ * payload. Values are computed a chunk at a time in structure-of-arrays
+ * form, and the checksum arithmetic runs on the SIMD kernel that
+ * checksum_get_impl() reports.
+ *
+ * Every value is a function of the packet index, so a template can be
+ * rewound or split between threads with pkt_template_seek(). Templates are
+ * not thread-safe; give each worker its own.
+ */
+
+#define PKT_TEMPLATE_MAX_FIELDS 8
+#define PKT_TEMPLATE_MAX_CSUMS 4       /* Distinct checksums the fields cover */
+#define PKT_FIELD_NO_CSUM 0xFFFFFFFFU
+
+typedef enum {
+    PKT_FIELD_COUNTER = 0,      /* start + n * step, wrapping at the field width */
+    PKT_FIELD_RANGE = 1,        /* start + (n * step) % (max - start + 1) */
+    PKT_FIELD_LIST = 2          /* values[(n * step) % count] */
+} pkt_field_kind_t;
+
+typedef struct {
+    pkt_field_kind_t kind;
+    uint32_t offset;            /* Field offset from the packet start */
+    uint32_t size;              /* 2 or 4 bytes, written big-endian */
+    uint32_t csum_offsets[2];   /* Checksums covering the field (PKT_FIELD_NO_CSUM = none) */
+    uint32_t start;             /* COUNTER first value, RANGE minimum (host order) */
+    uint32_t max;               /* RANGE maximum */
+    uint32_t step;              /* Advance per packet */
+    const uint32_t* values;     /* LIST table (host order), copied at creation */
+    uint32_t count;             /* LIST entries */
+} pkt_field_t;
+
+/**
+ * Initialize a field: step 1, no checksums
+ * An IPv4 address field usually lists the IP header checksum and the
+ * TCP/UDP checksum (pseudo-header); a port only the TCP/UDP one.
+ * @param field Field to fill
+ * @param kind Mutation kind
+ * @param offset Field offset from the packet start
+ * @param size 2 or 4
+ */
+void pkt_field_init(pkt_field_t* field, pkt_field_kind_t kind, uint32_t offset, uint32_t size);
+
+/**
+ * Create a template
+ * Checksums must be correct in the template and start their covered
+ * region at an even offset, as with packet_rewrite16(). Fields may not
+ * overlap each other or any checksum.
+ * @param packet Template packet (copied)
+ * @param len Packet length
+ * @param fields Field program
+ * @param field_count Number of fields (at most PKT_TEMPLATE_MAX_FIELDS)
+ * @return Template or NULL on error
+ */
+pkt_template_t* pkt_template_create(const uint8_t* packet, uint32_t len,
+                                    const pkt_field_t* fields, uint32_t field_count);
+
+/**
+ * Get the length of every generated packet
+ * @param tmpl Template
+ * @return Packet length, 0 for NULL
+ */
+uint32_t pkt_template_len(const pkt_template_t* tmpl);
+
+/**
+ * Generate the next count packets into caller buffers (TX frames, mbufs)
+ * @param tmpl Template
+ * @param bufs Buffers of at least pkt_template_len() bytes
+ * @param count Number of packets
+ * @return count, -1 on error
+ */
+int pkt_template_fill(pkt_template_t* tmpl, uint8_t* const* bufs, uint32_t count);
+
+/**
+ * Append the next count packets to a batch, for any backend's send_pkt_batch
+ * @param tmpl Template
+ * @param batch Batch
+ * @param count Number of packets
+ * @return Packets appended (fewer when the batch fills), -1 on error
+ */
+int pkt_template_fill_batch(pkt_template_t* tmpl, pkt_batch_t* batch, uint32_t count);
+
+/**
+ * Set the index of the next packet to generate
+ * @param tmpl Template
+ * @param index Packet index (0 restarts the program)
+ */
+void pkt_template_seek(pkt_template_t* tmpl, uint64_t index);
+
+/**
+ * Get the index of the next packet to generate
+ * @param tmpl Template
+ * @return Packet index
+ */
+uint64_t pkt_template_tell(const pkt_template_t* tmpl);
+
+/**
+ * Destroy a template
+ * @param tmpl Template (NULL is ignored)
+ */
+void pkt_template_destroy(pkt_template_t* tmpl);
+
+/* ============================================================================
+ * io_uring Functions (when HAS_IO_URING is defined)
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t queue_depth;       /* SQ entries and in-flight send slots (0 = 256) */
+    uint32_t buffer_size;       /* Registered buffer per slot (0 = 2048) */
+    int sqpoll;                 /* IORING_SETUP_SQPOLL; falls back if not permitted */
+    uint32_t sqpoll_idle_ms;    /* SQPOLL thread idle timeout (0 = 1000) */
+    int sqpoll_cpu;             /* CPU for the SQPOLL thread (negative = any) */
+    int zero_copy;              /* Use IORING_OP_SEND_ZC when the kernel supports it */
+} io_uring_config_t;
+
+/* Opaque per-worker io_uring engine with its own ring, socket and stats */
+typedef struct io_uring_ctx io_uring_ctx_t;
+
+#ifdef HAS_IO_URING
+
+/**
+ * Create an io_uring send engine for one worker thread
+ * Each context owns its ring, UDP socket, send slots and statistics, so
+ * workers scale without sharing state. A context must only be used by
+ * one thread at a time.
+ * @param config Engine configuration (NULL for defaults)
+ * @return Context handle or NULL on error
+ */
+io_uring_ctx_t* io_uring_ctx_create(const io_uring_config_t* config);
+
+/**
+ * Queue a batch of packets on a context (see io_uring_send_batch())
+ * Packets are queued in order, stopping at the first one larger than a
+ * slot buffer; a batch that starts with one fails.
+ * @param ctx Context handle
+ * @param packets Array of packet data
+ * @param lengths Array of lengths
+ * @param dests Array of destination addresses
+ * @param count Number of packets
+ * @return Number of packets queued, negative on error
+ */
+int io_uring_ctx_send_batch(io_uring_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                            const struct sockaddr_in* dests, uint32_t count);
+
+/**
+ * Queue packets [first, count) of a batch on a context
+ * @param ctx Context handle
+ * @param batch Packet batch with per-packet or batch-wide destinations
+ * @param first Index of the first packet to queue
+ * @return Number of packets queued, negative on error
+ */
+int io_uring_ctx_send_pkt_batch(io_uring_ctx_t* ctx, const pkt_batch_t* batch, uint32_t first);
+
+/**
+ * Reap completed sends on a context without blocking
+ * @param ctx Context handle
+ * @return Number of completions processed, negative on error
+ */
+int io_uring_ctx_reap(io_uring_ctx_t* ctx);
+
+/**
+ * Wait until every queued send on a context has completed
+ * @param ctx Context handle
+ * @return 0 on success, negative on error
+ */
+int io_uring_ctx_drain(io_uring_ctx_t* ctx);
+
+/**
+ * Get statistics of a context
+ * @param ctx Context handle
+ * @param stats Output statistics structure
+ * @return 0 on success
+ */
+int io_uring_ctx_get_stats(const io_uring_ctx_t* ctx, driver_stats_t* stats);
+
+/**
+ * Get send-path stage counters of a context (zero unless built with NETSTRESS_STAGE_CYCLES)
+ * @param ctx Context handle
+ * @param stages Output stage totals
+ * @return 0 on success
+ */
+int io_uring_ctx_get_stages(const io_uring_ctx_t* ctx, stage_stats_t* stages);
+
+/**
+ * Get TX occupancy: send slots awaiting completion, out of all slots
+ * @param ctx Context handle
+ * @param used Output slots in flight
+ * @param size Output slots in total
+ * @return 0 on success, -1 on error
+ */
+int io_uring_ctx_get_tx_ring(const io_uring_ctx_t* ctx, uint32_t* used, uint32_t* size);
+
+/**
+ * Get the UDP socket of a context (for socket options such as SO_SNDBUF)
+ * @param ctx Context handle
+ * @return Socket descriptor or negative on error
+ */
+int io_uring_ctx_fd(const io_uring_ctx_t* ctx);
+
+/**
+ * Drain and destroy a context
+ * @param ctx Context handle
+ */
+void io_uring_ctx_destroy(io_uring_ctx_t* ctx);
+
+/**
+ * Initialize io_uring for async I/O
+ * @param queue_depth Size of submission/completion queues
+ * @return 0 on success, negative on error
+ */
+int init_io_uring(int queue_depth);
+
+/**
+ * Initialize a persistent io_uring send engine
+ * Message headers and per-slot send buffers are allocated and registered
+ * once; the hot path only copies packet data into free slots.
+ * @param config Engine configuration (NULL for defaults)
+ * @return 0 on success, negative on error
+ */
+int init_io_uring_config(const io_uring_config_t* config);
+
+/**
+ * Reap completed sends without blocking
+ * @return Number of completions processed, negative on error
+ */
+int io_uring_reap(void);
+
+/**
+ * Wait until every queued send has completed
+ * @return 0 on success, negative on error
+ */
+int io_uring_drain(void);
+
+/**
+ * Send batch of packets via io_uring
+ * Packets are copied into registered slots and submitted without waiting
+ * for completions; results are accounted as completions are reaped.
+ * @param packets Array of packet data
+ * @param lengths Array of lengths
+ * @param dests Array of destination addresses
+ * @param count Number of packets
+ * @return Number of packets queued
+ */
+int io_uring_send_batch(const uint8_t** packets, const uint32_t* lengths,
+                        const struct sockaddr_in* dests, uint32_t count);
+
+/**
+ * Send single packet via io_uring
+ * @param data Packet data
+ * @param len Packet length
+ * @param dest Destination address
+ * @return Bytes queued or negative on error
+ */
+int io_uring_send_single(const uint8_t* data, uint32_t len, const struct sockaddr_in* dest);
+
+/**
+ * Cleanup io_uring resources
+ * @return 0 on success
+ */
+int cleanup_io_uring(void);
+
+/**
+ * Get io_uring statistics
+ * @param stats Output statistics structure
+ * @return 0 on success
+ */
+int io_uring_get_stats(driver_stats_t* stats);
+
+#else
+
+/* Stub implementations when io_uring is not available */
+static inline int init_io_uring(int queue_depth) { (void)queue_depth; return -1; }
+static inline io_uring_ctx_t* io_uring_ctx_create(const io_uring_config_t* config) { (void)config; return NULL; }
+static inline int io_uring_ctx_send_batch(io_uring_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                                          const struct sockaddr_in* dests, uint32_t count) {
+    (void)ctx; (void)packets; (void)lengths; (void)dests; (void)count; return -1;
+}
+static inline int io_uring_ctx_send_pkt_batch(io_uring_ctx_t* ctx, const pkt_batch_t* batch, uint32_t first) {
+    (void)ctx; (void)batch; (void)first; return -1;
+}
+static inline int io_uring_ctx_reap(io_uring_ctx_t* ctx) { (void)ctx; return -1; }
+static inline int io_uring_ctx_drain(io_uring_ctx_t* ctx) { (void)ctx; return -1; }
+static inline int io_uring_ctx_get_stats(const io_uring_ctx_t* ctx, driver_stats_t* stats) {
+    (void)ctx; (void)stats; return -1;
+}
+static inline int io_uring_ctx_get_stages(const io_uring_ctx_t* ctx, stage_stats_t* stages) {
+    (void)ctx; (void)stages; return -1;
+}
+static inline int io_uring_ctx_get_tx_ring(const io_uring_ctx_t* ctx, uint32_t* used, uint32_t* size) {
+    (void)ctx; (void)used; (void)size; return -1;
+}
+static inline int io_uring_ctx_fd(const io_uring_ctx_t* ctx) { (void)ctx; return -1; }
+static inline void io_uring_ctx_destroy(io_uring_ctx_t* ctx) { (void)ctx; }
+static inline int init_io_uring_config(const io_uring_config_t* config) { (void)config; return -1; }
+static inline int io_uring_reap(void) { return -1; }
+static inline int io_uring_drain(void) { return -1; }
+static inline int io_uring_send_batch(const uint8_t** packets, const uint32_t* lengths,
+                                      const struct sockaddr_in* dests, uint32_t count) {
+    (void)packets; (void)lengths; (void)dests; (void)count; return -1;
+}
+static inline int io_uring_send_single(const uint8_t* data, uint32_t len, const struct sockaddr_in* dest) {
+    (void)data; (void)len; (void)dest; return -1;
+}
+static inline int io_uring_get_stats(driver_stats_t* stats) { (void)stats; return -1; }
+static inline int cleanup_io_uring(void) { return 0; }
+
+#endif /* HAS_IO_URING */
+
+/* ============================================================================
+ * sendmmsg Batch Sending Functions
+ * ============================================================================ */
+
+/**
+ * Send batch of packets using sendmmsg (Linux) or fallback loop
+ * @param sockfd Socket descriptor
+ * @param packets Array of packet data
+ * @param lengths Array of lengths
+ * @param dests Array of destination addresses
+ * @param count Number of packets
+ * @return Number of packets sent
+ */
+int sendmmsg_batch(int sockfd, const uint8_t** packets, const uint32_t* lengths,
+                   const struct sockaddr_in* dests, uint32_t count);
+
+/**
+ * Send batch of packets to same destination
+ * @param sockfd Socket descriptor
+ * @param packets Array of packet data
+ * @param lengths Array of lengths
+ * @param dst_ip Destination IP (network byte order)
+ * @param dst_port Destination port (host byte order)
+ * @param count Number of packets
+ * @return Number of packets sent
+ */
+int sendmmsg_batch_same_dest(int sockfd, const uint8_t** packets, const uint32_t* lengths,
+                              uint32_t dst_ip, uint16_t dst_port, uint32_t count);
+
+/* Opaque reusable sendmmsg state: header/iovec arrays allocated once */
+typedef struct sendmmsg_ctx sendmmsg_ctx_t;
+
+/**
+ * Create a persistent sendmmsg context for one worker thread
+ * @param sockfd Socket descriptor (not owned by the context)
+ * @param max_batch Messages per sendmmsg() call (0 = 256)
+ * @return Context handle or NULL on error
+ */
+sendmmsg_ctx_t* sendmmsg_ctx_create(int sockfd, uint32_t max_batch);
+
+/**
+ * Enable or disable UDP GSO (UDP_SEGMENT) for same-destination sends
+ * Runs of equal-length packets are then sent as one super-datagram per
+ * message. GSO is turned off again automatically if the kernel rejects
+ * a segment size (e.g. larger than the path MTU).
+ * @param ctx Context handle
+ * @param enable Non-zero to enable
+ * @return 0 on success, -1 if GSO is not supported on this socket
+ */
+int sendmmsg_ctx_set_gso(sendmmsg_ctx_t* ctx, int enable);
+
+/**
+ * Pace sends from the context
+ * Each group of burst messages waits for its slot. When SO_TXTIME is
+ * accepted, every message also carries its own launch time so an fq qdisc
+ * spreads the group out; rate_bps is additionally set as SO_MAX_PACING_RATE.
+ * GSO is bypassed while pacing since a super-datagram leaves as one burst.
+ * @param ctx Context handle
+ * @param rate_pps Packets per second (0 with rate_bps 0 = unpaced)
+ * @param rate_bps Bits per second
+ * @param burst Messages per slot (0 = 1)
+ * @return 1 if launch times are in use, 0 if paced by waiting only, -1 on error
+ */
+int sendmmsg_ctx_set_pacing(sendmmsg_ctx_t* ctx, uint64_t rate_pps, uint64_t rate_bps, uint32_t burst);
+
+/**
+ * Send batch of packets using the context's preallocated arrays
+ * @param ctx Context handle
+ * @param packets Array of packet data
+ * @param lengths Array of lengths
+ * @param dests Array of destination addresses
+ * @param count Number of packets
+ * @return Number of packets sent, negative on error
+ */
+int sendmmsg_ctx_send(sendmmsg_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                      const struct sockaddr_in* dests, uint32_t count);
+
+/**
+ * Send batch of packets to one destination, using GSO when enabled
+ * @param ctx Context handle
+ * @param packets Array of packet data
+ * @param lengths Array of lengths
+ * @param dst_ip Destination IP (network byte order)
+ * @param dst_port Destination port (host byte order)
+ * @param count Number of packets
+ * @return Number of packets sent, negative on error
+ */
+int sendmmsg_ctx_send_same_dest(sendmmsg_ctx_t* ctx, const uint8_t** packets, const uint32_t* lengths,
+                                uint32_t dst_ip, uint16_t dst_port, uint32_t count);
+
+/**
+ * Send packets [first, count) of a batch, building iovecs straight from
+ * the arena; paced or GSO contexts take the pointer-array path
+ * @param ctx Context handle
+ * @param batch Packet batch with per-packet or batch-wide destinations
+ * @param first Index of the first packet to send
+ * @return Number of packets sent, negative on error
+ */
+int sendmmsg_ctx_send_pkt_batch(sendmmsg_ctx_t* ctx, const pkt_batch_t* batch, uint32_t first);
+
+/**
+ * Get send-path stage counters of a context (safe from any thread)
+ * Only COPY (msghdr fill) and KICK (the syscall) apply; all zero unless
+ * built with NETSTRESS_STAGE_CYCLES.
+ * @param ctx Context handle
+ * @param stages Output stage totals
+ * @return 0 on success, -1 on error
+ */
+int sendmmsg_ctx_get_stages(const sendmmsg_ctx_t* ctx, stage_stats_t* stages);
+
+/**
+ * Destroy a sendmmsg context (the socket is left open)
+ * @param ctx Context handle
+ */
+void sendmmsg_ctx_destroy(sendmmsg_ctx_t* ctx);
+
+/* ============================================================================
+ * Backend Detection and Selection
+ * ============================================================================ */
+
+typedef enum {
+    BACKEND_NONE = 0,
+    BACKEND_RAW_SOCKET = 1,
+    BACKEND_SENDMMSG = 2,
+    BACKEND_IO_URING = 3,
+    BACKEND_AF_XDP = 4,
+    BACKEND_DPDK = 5
+} backend_type_t;
+
+typedef struct {
+    int has_dpdk;
+    int has_af_xdp;
+    int has_io_uring;
+    int has_sendmmsg;
+    int has_raw_socket;
+    int kernel_version_major;
+    int kernel_version_minor;
+    int cpu_count;
+    int numa_nodes;
+    uint32_t dpdk_tx_offloads;    /* OFFLOAD_* enabled on every started DPDK port */
+    uint32_t af_xdp_tx_offloads;  /* OFFLOAD_* enabled on the default AF_XDP queue */
+} system_capabilities_t;
+
+/**
+ * Detect system capabilities for backend selection
+ * @param caps Output capabilities structure
+ * @return 0 on success
+ */
+int detect_capabilities(system_capabilities_t* caps);
+
+/**
+ * Select best available backend based on capabilities
+ * @param caps System capabilities
+ * @return Best available backend type
+ */
+backend_type_t select_best_backend(const system_capabilities_t* caps);
+
+/**
+ * Get human-readable backend name
+ * @param backend Backend type
+ * @return Backend name string
+ */
+const char* backend_name(backend_type_t backend);
+
+/* ============================================================================
+ * Safety Envelope
+ * ============================================================================ */
+
+/*
+ * Hard limits enforced inside every send path, so they also bind callers
+ * that bypass the engine's own checks. An envelope installed for a backend
+ * type admits only destinations in its CIDR allowlist, at no more than its
+ * pps/bps ceiling summed over every thread sending on that backend. The
+ * kill switch stops every backend whether or not an envelope is installed.
+ *
+ * Sends admit a prefix of each batch. A denied destination ends the prefix;
+ * if it is the first packet the send fails with errno EACCES. Packets held
+ * back by the ceiling are reported like a full TX ring (0, or a short
+ * count). While killed, sends fail with errno ECANCELED.
+ *
+ * Socket backends check the sockaddr destination, raw sockets the IPv4
+ * header, and AF_XDP/DPDK the IPv4 header inside the Ethernet frame
+ * (untagged or one 802.1Q tag). Frames without an IPv4 header are denied.
+ */
+
+typedef struct safety_envelope safety_envelope_t;
+
+typedef struct {
+    uint64_t admitted;          /* Packets let through */
+    uint64_t denied;            /* Sends refused by the allowlist */
+    uint64_t throttled;         /* Sends cut short by the ceiling */
+} safety_stats_t;
+
+/**
+ * Create an envelope with an empty allowlist (denies everything) and no ceiling
+ * @return Envelope or NULL on error
+ */
+safety_envelope_t* safety_envelope_create(void);
+
+/**
+ * Allow a destination prefix
+ * Configure envelopes before installing them; installed ones are read-only.
+ * @param env Envelope handle
+ * @param network Network address in network byte order (host bits ignored)
+ * @param prefix_len Prefix length, 0-32
+ * @return 0 on success, -1 on error
+ */
+int safety_envelope_allow(safety_envelope_t* env, uint32_t network, uint32_t prefix_len);
+
+/**
+ * Allow a destination prefix given as "a.b.c.d/len" or a bare address
+ * @param env Envelope handle
+ * @param cidr Prefix string
+ * @return 0 on success, -1 on a malformed prefix
+ */
+int safety_envelope_allow_cidr(safety_envelope_t* env, const char* cidr);
+
+/**
+ * Set the rate ceiling (0 leaves that dimension unlimited)
+ * The ceiling allows bursts of about 1 ms at the configured rate.
+ * @param env Envelope handle
+ * @param max_pps Packets per second
+ * @param max_bps Bits per second (at least 8000 when set)
+ * @return 0 on success, -1 on error
+ */
+int safety_envelope_set_ceiling(safety_envelope_t* env, uint64_t max_pps, uint64_t max_bps);
+
+/**
+ * Check one destination against the allowlist
+ * @param env Envelope handle
+ * @param dst_ip IPv4 address in network byte order
+ * @return 1 if allowed, 0 if not
+ */
+int safety_envelope_permits(const safety_envelope_t* env, uint32_t dst_ip);
+
+/**
+ * Get admission counters
+ * @param env Envelope handle
+ * @param stats Output counters
+ * @return 0 on success, -1 on error
+ */
+int safety_envelope_get_stats(const safety_envelope_t* env, safety_stats_t* stats);
+
+/**
+ * Destroy an envelope (uninstall it and quiesce its senders first)
+ * @param env Envelope handle
+ */
+void safety_envelope_destroy(safety_envelope_t* env);
+
+/**
+ * Install the envelope enforced on every send of a backend type
+ * @param backend Backend type
+ * @param env Envelope, or NULL to lift the restriction
+ * @return 0 on success, -1 on an invalid backend
+ */
+int safety_install(backend_type_t backend, safety_envelope_t* env);
+
+/**
+ * Admit a batch for a send path outside the shim
+ * @param backend Backend type whose envelope applies
+ * @param dst_ips Destinations in network byte order
+ * @param ndst Entries in dst_ips: count, or 1 for a single destination
+ * @param lengths Packet lengths
+ * @param nlen Entries in lengths: count, or 1 for a single length
+ * @param count Number of packets
+ * @return Packets that may be sent now (a prefix), -1 if none may be sent
+ */
+int safety_admit(backend_type_t backend, const uint32_t* dst_ips, uint32_t ndst,
+                 const uint32_t* lengths, uint32_t nlen, uint32_t count);
+
+/**
+ * Stop all sends on every backend until safety_rearm()
+ * Only sets a flag, so it is safe to call from a signal handler.
+ */
+void safety_kill(void);
+
+/**
+ * Clear the kill switch
+ */
+void safety_rearm(void);
+
+/**
+ * Check the kill switch
+ * @return 1 if killed, 0 otherwise
+ */
+int safety_is_killed(void);
+
+/* ============================================================================
+ * Measured Backend Selection
+ * ============================================================================ */
+
+typedef struct {
+    const char* ifname;         /* Interface to probe (NULL = loopback, socket backends only) */
+    uint32_t dst_ip;            /* Sink IPv4 address, network order (0 = private loopback sink) */
+    uint16_t dst_port;          /* Sink UDP port, host order (ignored with the loopback sink) */
+    uint8_t dst_mac[6];         /* Next-hop MAC for AF_XDP/DPDK frames (all zero = broadcast) */
+    uint32_t packet_size;       /* On-wire frame size incl. Ethernet header (0 = 64, max 1514) */
+    uint32_t packets;           /* Calibration burst per candidate (0 = 16384) */
+    int dpdk_port;              /* DPDK port, probed only if already initialized */
+    const char* cache_path;     /* Result cache (NULL = default location, "" = no cache) */
+} backend_probe_config_t;
+
+typedef struct {
+    backend_type_t backend;
+    int status;                 /* 0 = measured, negative = could not open or send */
+    uint64_t packets;           /* Packets accepted by the backend */
+    uint64_t elapsed_ns;        /* Time to send (and for io_uring, complete) them */
+    double pps;
+    int nic_bound;              /* 1 if the burst went out through ifname */
+} backend_probe_result_t;
+
+/**
+ * Build the cache key for an interface: kernel release, interface, PCI
+ * device, driver, frame size and the compiled-in backend set
+ * @param ifname Interface name (NULL = loopback)
+ * @param packet_size Frame size as in backend_probe_config_t
+ * @param key Output buffer
+ * @param len Output buffer size
+ * @return Key length, negative on error
+ */
+int backend_probe_cache_key(const char* ifname, uint32_t packet_size, char* key, size_t len);
+
+/**
+ * Open every compiled-in backend and time a calibration burst to the sink
+ * AF_XDP and DPDK are only measured with an interface and explicit dst_ip;
+ * AF_XDP binds queue 0 and DPDK sends on queue 0 of dpdk_port. With both,
+ * socket backends are bound to the interface with SO_BINDTODEVICE (which
+ * needs CAP_NET_RAW); otherwise they measure the default route.
+ * @param config Probe configuration
+ * @param results Output, one entry per candidate backend
+ * @param max_results Capacity of results
+ * @return Number of results written, negative on error
+ */
+int backend_probe_run(const backend_probe_config_t* config, backend_probe_result_t* results, int max_results);
+
+/**
+ * Select the fastest measured backend, consulting the on-disk cache first
+ * The default cache is $NETSTRESS_BACKEND_CACHE, else netstress-backends
+ * under $XDG_CACHE_HOME or ~/.cache. Falls back to select_best_backend()
+ * when nothing can be measured. A winner that did not go out through
+ * ifname is returned but not cached under the interface's key.
+ * @param config Probe configuration
+ * @param caps Detected capabilities; cached backends no longer available are re-probed
+ * @return Selected backend type
+ */
+backend_type_t select_backend_measured(const backend_probe_config_t* config, const system_capabilities_t* caps);
+
+/* ============================================================================
+ * Backend Instances
+ * ============================================================================ */
+
+/* What a backend expects in each packet buffer */
+typedef enum {
+    BACKEND_LAYER_L2 = 2,       /* Ethernet frame (AF_XDP, DPDK) */
+    BACKEND_LAYER_L3 = 3,       /* IPv4 packet incl. header (raw socket, IP_HDRINCL) */
+    BACKEND_LAYER_PAYLOAD = 4   /* UDP payload sent to the configured destination */
+} backend_layer_t;
+
+typedef struct {
+    driver_config_t base;               /* interface, port_id, burst_size, tx_offloads */
+    uint32_t queue_id;                  /* NIC queue for AF_XDP and DPDK */
+    uint32_t dst_ip;                    /* Payload destination, network order */
+    uint16_t dst_port;                  /* Payload destination port, host order */
+    uint16_t bind_port;                 /* Local UDP port to receive on (0 = none) */
+    const af_xdp_config_t* af_xdp;      /* AF_XDP socket options (NULL = defaults) */
+    const io_uring_config_t* io_uring;  /* io_uring options (NULL = defaults) */
+} netstress_backend_config_t;
+
+/*
+ * Per-backend function table. open returns the backend's own state, which
+ * every other entry receives; instances share nothing, so one thread can
+ * own each. recv_batch lends descriptors that stay valid until release.
+ */
+typedef struct {
+    backend_type_t type;
+    backend_layer_t layer;
+    void* (*open)(const netstress_backend_config_t* config);
+    int (*send_batch)(void* state, const uint8_t** packets, const uint32_t* lengths, uint32_t count);
+    int (*send_pkt_batch)(void* state, const pkt_batch_t* batch, uint32_t first);
+    int (*recv_batch)(void* state, rx_desc_t* descs, uint32_t max_count);
+    int (*release)(void* state, const rx_desc_t* descs, uint32_t count);
+    int (*stats)(const void* state, driver_stats_t* stats);
+    int (*tx_ring)(const void* state, tx_result_t* result);  /* ring_* and held; NULL if unobservable */
+    void (*close)(void* state);
+    int (*send_to)(void* state, const uint8_t** packets, const uint32_t* lengths,
+                   const struct sockaddr_in* dests, uint32_t count);  /* Payload layer only, else NULL */
+} netstress_backend_ops_t;
+
+/*
+ * Adaptive TX burst: additive increase while sends are fully accepted and
+ * the ring has a burst of headroom, multiplicative decrease (down to what
+ * was delivered, at most halving) on any shortfall. The caller builds only
+ * the suggested burst, so it stops spending cycles on packets a full ring
+ * would refuse.
+ */
+typedef struct {
+    uint32_t burst;
+    uint32_t min_burst;
+    uint32_t max_burst;
+} tx_burst_ctl_t;
+
+/**
+ * Initialize a burst controller
+ * @param ctl Controller
+ * @param burst Starting burst (clamped to the limits)
+ * @param min_burst Smallest burst (0 = 1)
+ * @param max_burst Largest burst (0 = burst)
+ */
+void tx_burst_ctl_init(tx_burst_ctl_t* ctl, uint32_t burst, uint32_t min_burst, uint32_t max_burst);
+
+/**
+ * Feed one send's outcome and get the next burst
+ * @param ctl Controller
+ * @param offered Packets offered to the send
+ * @param result Send outcome
+ * @return Next burst
+ */
+uint32_t tx_burst_ctl_update(tx_burst_ctl_t* ctl, uint32_t offered, const tx_result_t* result);
+
+/* Opaque backend instance */
+typedef struct netstress_backend netstress_backend_t;
+
+/**
+ * Fill an instance config from a driver config
+ * @param config Output instance config
+ * @param base Driver config to copy (NULL for defaults)
+ */
+void netstress_backend_config_init(netstress_backend_config_t* config, const driver_config_t* base);
+
+/**
+ * Get the function table for a backend
+ * @param type Backend type
+ * @return Function table, NULL if the backend is not compiled in
+ */
+const netstress_backend_ops_t* netstress_backend_ops(backend_type_t type);
+
+/**
+ * Open a backend instance
+ * @param type Backend type
+ * @param config Instance configuration
+ * @return Instance handle or NULL on error
+ */
+netstress_backend_t* netstress_backend_open(backend_type_t type, const netstress_backend_config_t* config);
+
+/**
+ * Send a batch in the backend's layer (see netstress_backend_layer)
+ * @param backend Instance handle
+ * @param packets Array of packet data
+ * @param lengths Array of lengths
+ * @param count Number of packets
+ * @return Number of packets sent or queued, negative on error
+ */
+int netstress_backend_send_batch(netstress_backend_t* backend, const uint8_t** packets,
+                                 const uint32_t* lengths, uint32_t count);
+
+/**
+ * Send payloads each to its own destination instead of the configured one
+ * @param backend Instance handle (BACKEND_LAYER_PAYLOAD)
+ * @param packets Array of payload data
+ * @param lengths Array of lengths
+ * @param dests Array of destination addresses
+ * @param count Number of packets
+ * @return Number of packets sent or queued, negative on error (or other layers)
+ */
+int netstress_backend_send_batch_to(netstress_backend_t* backend, const uint8_t** packets,
+                                    const uint32_t* lengths, const struct sockaddr_in* dests,
+                                    uint32_t count);
+
+/**
+ * Send packets [first, count) of a contiguous batch
+ * @param backend Instance handle
+ * @param batch Packet batch in the backend's layer
+ * @param first Index of the first packet to send
+ * @return Number of packets sent or queued, negative on error
+ */
+int netstress_backend_send_pkt_batch(netstress_backend_t* backend, const pkt_batch_t* batch, uint32_t first);
+
+/**
+ * Send a batch and report accepted packets, ring occupancy and the next burst
+ * Packets past result->accepted were not built into the ring and must be
+ * offered again; each call updates the instance's burst controller.
+ * @param backend Instance handle
+ * @param packets Array of packet data
+ * @param lengths Array of lengths
+ * @param count Number of packets
+ * @param result Output outcome (NULL to only update the controller)
+ * @return Number of packets accepted, negative on error
+ */
+int netstress_backend_send_batch_ex(netstress_backend_t* backend, const uint8_t** packets,
+                                    const uint32_t* lengths, uint32_t count, tx_result_t* result);
+
+/**
+ * Send packets [first, count) of a batch, reporting as netstress_backend_send_batch_ex()
+ * @param backend Instance handle
+ * @param batch Packet batch in the backend's layer
+ * @param first Index of the first packet to send
+ * @param result Output outcome (NULL to only update the controller)
+ * @return Number of packets accepted, negative on error
+ */
+int netstress_backend_send_pkt_batch_ex(netstress_backend_t* backend, const pkt_batch_t* batch,
+                                        uint32_t first, tx_result_t* result);
+
+/**
+ * Get the burst the instance's controller currently suggests
+ * Starts at the config's burst_size (32 if unset) and adapts between 1
+ * and 1024 unless narrowed by netstress_backend_set_burst_limits().
+ * @param backend Instance handle
+ * @return Suggested burst, 0 for NULL
+ */
+uint32_t netstress_backend_burst(const netstress_backend_t* backend);
+
+/**
+ * Narrow the range the instance's burst may adapt in
+ * @param backend Instance handle
+ * @param min_burst Smallest burst (0 = 1)
+ * @param max_burst Largest burst (0 = keep the current maximum)
+ * @return 0 on success, -1 on error
+ */
+int netstress_backend_set_burst_limits(netstress_backend_t* backend, uint32_t min_burst, uint32_t max_burst);
+
+/**
+ * Borrow received packets without blocking
+ * @param backend Instance handle
+ * @param descs Output descriptors
+ * @param max_count Maximum packets
+ * @return Number of packets borrowed, negative on error
+ */
+int netstress_backend_recv_batch(netstress_backend_t* backend, rx_desc_t* descs, uint32_t max_count);
+
+/**
+ * Return borrowed packets to the backend
+ * @param backend Instance handle
+ * @param descs Descriptors from netstress_backend_recv_batch
+ * @param count Number of descriptors
+ * @return Number released, negative on error
+ */
+int netstress_backend_release(netstress_backend_t* backend, const rx_desc_t* descs, uint32_t count);
+
+/**
+ * Get instance statistics
+ * @param backend Instance handle
+ * @param stats Output statistics
+ * @return 0 on success, negative on error
+ */
+int netstress_backend_get_stats(const netstress_backend_t* backend, driver_stats_t* stats);
+
+/**
+ * Get an instance's backend type
+ * @param backend Instance handle
+ * @return Backend type, BACKEND_NONE for NULL
+ */
+backend_type_t netstress_backend_type(const netstress_backend_t* backend);
+
+/**
+ * Get the packet layer an instance sends and receives
+ * @param backend Instance handle
+ * @return Packet layer, negative for NULL
+ */
+int netstress_backend_layer(const netstress_backend_t* backend);
+
+/**
+ * Close an instance and release its resources
+ * @param backend Instance handle (NULL is ignored)
+ */
+void netstress_backend_close(netstress_backend_t* backend);
+
+/* ============================================================================
+ * Capture Tap
+ * ============================================================================ */
+
+/*
+ * Sampled capture from inside the send and receive paths, for rates that
+ * tcpdump cannot follow. Every producer (one direction of a DPDK or AF_XDP
+ * queue, or a backend instance) owns a single-producer ring; 1 in
+ * sample_every packets is copied into it, cut to snaplen bytes, and a
+ * background thread writes the rings to a pcapng file with one interface
+ * per ring and the direction in epb_flags. A full ring drops copies rather
+ * than slowing the sender, and a detached producer pays one branch per
+ * burst.
+ *
+ * TX copies are of packets the NIC or socket accepted. L2 rings are
+ * written as Ethernet, L3 rings as raw IPv4, payload rings as LINKTYPE_USER0.
+ */
+
+typedef enum {
+    TAP_DIR_TX = 0,
+    TAP_DIR_RX = 1
+} tap_direction_t;
+
+typedef struct capture_tap capture_tap_t;
+
+typedef struct {
+    uint32_t sample_every;      /* Copy 1 in N packets (0 = every packet) */
+    uint32_t snaplen;           /* Bytes kept per packet (0 = 128, at most 65535) */
+    uint32_t ring_slots;        /* Copies buffered per ring, rounded up to a power of two (0 = 4096) */
+    uint32_t drain_interval_us; /* Writer sleep while every ring is empty (0 = 1000) */
+} capture_tap_config_t;
+
+typedef struct {
+    uint64_t seen;              /* Packets that passed a ring */
+    uint64_t captured;          /* Copies queued for the writer */
+    uint64_t dropped;           /* Sampled packets lost to a full ring */
+    uint64_t written;           /* Packets written to the file */
+    uint64_t bytes_written;     /* File bytes written */
+} capture_tap_stats_t;
+
+/**
+ * Initialize a tap config with defaults
+ * @param config Config to fill
+ */
+void capture_tap_config_init(capture_tap_config_t* config);
+
+/**
+ * Create a tap writing to a pcapng file and start its writer thread
+ * @param path Output file (truncated)
+ * @param config Tap options (NULL = defaults)
+ * @return Tap or NULL on error (always NULL on Windows)
+ */
+capture_tap_t* capture_tap_create(const char* path, const capture_tap_config_t* config);
+
+/**
+ * Add a ring for one producer thread
+ * Rings live until the tap is destroyed.
+ * @param tap Tap handle
+ * @param layer What the producer sends, which sets the file's link type
+ * @param name Interface name recorded in the file (NULL = none)
+ * @param numa_node Preferred NUMA node for the ring (negative for no preference)
+ * @return Ring or NULL on error (at most 64 rings per tap)
+ */
+tap_ring_t* capture_tap_add_ring(capture_tap_t* tap, backend_layer_t layer, const char* name,
+                                 int numa_node);
+
+/**
+ * Offer packets from a send path outside the shim
+ * Must only be called from the ring's producer thread.
+ * @param ring Ring handle
+ * @param packets Packet pointers
+ * @param lengths Packet lengths
+ * @param count Number of packets
+ * @param dir Direction recorded in the file
+ * @return Copies queued, or -1 on error
+ */
+int tap_ring_record(tap_ring_t* ring, const uint8_t** packets, const uint32_t* lengths,
+                    uint32_t count, tap_direction_t dir);
+
+/**
+ * Tap a backend instance's send and receive calls
+ * Works for every backend type; do not also attach the instance's queue
+ * with dpdk_set_queue_tap() or af_xdp_queue_set_tap().
+ * @param backend Backend instance
+ * @param tx_ring Ring for sent packets, NULL to detach
+ * @param rx_ring Ring for received packets, NULL to detach
+ * @return 0 on success, -1 on error
+ */
+int netstress_backend_set_tap(netstress_backend_t* backend, tap_ring_t* tx_ring, tap_ring_t* rx_ring);
+
+/**
+ * Write everything queued so far and flush the file
+ * @param tap Tap handle
+ * @return 0 on success, -1 on a write error
+ */
+int capture_tap_flush(capture_tap_t* tap);
+
+/**
+ * Get tap counters summed over its rings
+ * @param tap Tap handle
+ * @param stats Output counters
+ * @return 0 on success, -1 on error
+ */
+int capture_tap_get_stats(capture_tap_t* tap, capture_tap_stats_t* stats);
+
+/**
+ * Stop the writer, write what is left and close the file
+ * Detach every ring from its producer first.
+ * @param tap Tap handle
+ */
+void capture_tap_destroy(capture_tap_t* tap);
+
+/* ============================================================================
+ * Capture Replay
+ * ============================================================================ */
+
+/*
+ * pcap and pcapng captures are mapped privately and streamed by cursors
+ * that hand out batches pointing into the mapping, ready for
+ * sendmmsg_batch(), af_xdp_queue_send_batch(), dpdk_send_burst_queue() or a
+ * backend instance. Destination rewrites are made in place on
+ * copy-on-write pages and never reach the file.
+ *
+ * Several cursors can share one capture, one per thread. Set shard_count
+ * to split the packets between them by flow (source address and ports),
+ * which keeps each flow's order. Cursors that rewrite must shard.
+ */
+
+typedef struct pcap_replay pcap_replay_t;
+typedef struct pcap_cursor pcap_cursor_t;
+
+#define PCAP_FORMAT_PCAP 1
+#define PCAP_FORMAT_PCAPNG 2
+
+typedef enum {
+    REPLAY_MAX_RATE = 0,        /* No waits between batches */
+    REPLAY_ORIGINAL = 1,        /* Capture timing */
+    REPLAY_SCALED = 2           /* Capture timing divided by speed */
+} replay_mode_t;
+
+typedef struct {
+    backend_layer_t layer;      /* What each packet holds, see Backend Instances */
+    replay_mode_t mode;
+    double speed;               /* REPLAY_SCALED multiplier (2.0 = twice as fast) */
+    uint32_t loops;             /* Passes over the capture (0 = until stopped) */
+    uint32_t batch_size;        /* Packets per batch (0 = 64) */
+    uint32_t rewrite_ip;        /* Destination range, network order */
+    uint32_t rewrite_prefix;    /* Range prefix length (0 = no rewrite) */
+    uint32_t shard_count;       /* Cursors sharing the capture (0 or 1 = all packets) */
+    uint32_t shard_index;       /* This cursor's shard */
+} pcap_replay_config_t;
+
+typedef struct {
+    int format;                 /* PCAP_FORMAT_* */
+    uint64_t packets;
+    uint64_t bytes;             /* Captured bytes */
+    uint64_t first_ns;          /* Capture timestamps */
+    uint64_t last_ns;
+} pcap_replay_info_t;
+
+/* One batch; the arrays stay valid until the cursor's next call */
+typedef struct {
+    const uint8_t** packets;
+    const uint32_t* lengths;
+    const struct sockaddr_in* dests;    /* BACKEND_LAYER_PAYLOAD only, else NULL */
+    uint32_t count;
+} pcap_view_t;
+
+typedef struct {
+    uint64_t packets;           /* Packets handed out */
+    uint64_t bytes;
+    uint64_t skipped;           /* Own-shard records unusable at the layer */
+    uint64_t dropped;           /* Packets pcap_cursor_send() gave up on */
+    uint32_t passes;            /* Completed passes */
+} pcap_cursor_stats_t;
+
+/**
+ * Initialize a replay config: L2, max rate, one pass, no rewrite or sharding
+ * @param config Config to fill
+ */
+void pcap_replay_config_init(pcap_replay_config_t* config);
+
+/**
+ * Map a pcap or pcapng capture
+ * @param path Capture file
+ * @return Replay handle or NULL on error (unknown format, non-POSIX)
+ */
+pcap_replay_t* pcap_replay_open(const char* path);
+
+/**
+ * Count a capture's packets (walks the whole file)
+ * @param replay Replay handle
+ * @param info Output summary
+ * @return 0 on success, -1 on error
+ */
+int pcap_replay_get_info(const pcap_replay_t* replay, pcap_replay_info_t* info);
+
+/**
+ * Unmap a capture (destroy its cursors first)
+ * @param replay Replay handle
+ */
+void pcap_replay_close(pcap_replay_t* replay);
+
+/**
+ * Create a cursor over a capture
+ * Records the layer cannot use are skipped: L2 needs Ethernet, L3 IPv4,
+ * PAYLOAD IPv4 UDP. Truncated records are always skipped. Rewriting keeps
+ * the host bits on the first pass and advances them by one on each later
+ * pass, fixing IPv4 and TCP/UDP checksums.
+ * @param replay Replay handle
+ * @param config Cursor configuration
+ * @return Cursor or NULL on error
+ */
+pcap_cursor_t* pcap_cursor_create(pcap_replay_t* replay, const pcap_replay_config_t* config);
+
+/**
+ * Get the next batch, waiting until its first packet is due
+ * A batch holds the packets already due when it is cut, up to batch_size.
+ * @param cursor Cursor handle
+ * @param view Output batch
+ * @return Packets in the batch, 0 once every pass is done, -1 on error
+ */
+int pcap_cursor_next(pcap_cursor_t* cursor, pcap_view_t* view);
+
+/**
+ * Send the next batch on a backend instance, retrying short sends
+ * Payload instances send each packet to its record's destination, after
+ * any rewrite. A packet the instance keeps refusing (one larger than its
+ * frames, say) is dropped after 1024 empty sends and counted.
+ * @param cursor Cursor handle (its layer must match the instance's)
+ * @param backend Backend instance
+ * @return Packets sent, 0 once every pass is done, negative on error
+ */
+int pcap_cursor_send(pcap_cursor_t* cursor, netstress_backend_t* backend);
+
+/**
+ * Get cursor counters
+ * @param cursor Cursor handle
+ * @param stats Output counters
+ * @return 0 on success, -1 on error
+ */
+int pcap_cursor_get_stats(const pcap_cursor_t* cursor, pcap_cursor_stats_t* stats);
+
+/**
+ * Destroy a cursor
+ * @param cursor Cursor handle (NULL is ignored)
+ */
+void pcap_cursor_destroy(pcap_cursor_t* cursor);
+
+/* ============================================================================
+ * TCP Connection Emulation
+ * ============================================================================ */
+
+/*
+ * A userspace TCP endpoint for connection-rate testing of load balancers and
+ * proxies. Every connection does a real 3-way handshake, the client sends
+ * request_len bytes, the server answers with response_len bytes, and the
+ * client closes (FIN, FIN+ACK, ACK). The client side skips TIME_WAIT so a
+ * tuple can be reused at once; lost segments are resent go-back-N after a
+ * fixed RTO.
+ *
+ * Flows live in an open-addressed, linearly probed table of one cache line
+ * per flow, sized to twice max_concurrent and backed by huge pages when the
+ * host has them. Engines are single-threaded: run one per queue, with the
+ * client port range or address range split between them.
+ *
+ * Frames are Ethernet + IPv4 + TCP with software checksums, for L2
+ * instances (DPDK, AF_XDP). Drive an engine with tcp_engine_run(), or feed
+ * it with tcp_engine_input(), call tcp_engine_poll() and send what
+ * tcp_engine_tx_batch() holds.
+ */
+
+typedef struct tcp_engine tcp_engine_t;
+
+typedef enum {
+    TCP_ENGINE_CLIENT = 0,      /* Opens connections to server_ip:server_port */
+    TCP_ENGINE_SERVER = 1       /* Accepts connections on server_ip:server_port */
+} tcp_engine_role_t;
+
+typedef struct {
+    tcp_engine_role_t role;
+    uint8_t src_mac[6];         /* Our MAC */
+    uint8_t dst_mac[6];         /* Next hop for every frame we send */
+    uint32_t server_ip;         /* Network order (server: 0 = any address) */
+    uint16_t server_port;       /* Host order */
+    uint32_t client_ip;         /* First client address, network order */
+    uint32_t client_ip_count;   /* Client addresses from client_ip (0 = 1) */
+    uint16_t client_port_min;   /* Client source ports, host order */
+    uint16_t client_port_max;
+    uint32_t request_len;       /* Bytes the client sends after the handshake */
+    uint32_t response_len;      /* Bytes the server answers with */
+    uint64_t target_cps;        /* Client: new connections per second (0 = as fast as possible) */
+    uint64_t max_connections;   /* Client: connections to open in total (0 = unlimited) */
+    uint32_t max_concurrent;    /* Flows in flight (0 = 65536) */
+    uint16_t mss;               /* Our MSS (0 = 1460) */
+    uint16_t window;            /* Advertised receive window (0 = 65535) */
+    uint64_t rto_ns;            /* Retransmission timeout (0 = 200 ms) */
+    uint32_t max_retries;       /* Timeouts before a connection is reset (0 = 3) */
+    int numa_node;              /* Node for the flow table and TX batch (-1 = any) */
+} tcp_engine_config_t;
+
+typedef struct {
+    uint64_t attempted;         /* Client: SYNs sent; server: SYNs accepted */
+    uint64_t established;       /* Handshakes completed */
+    uint64_t completed;         /* Request, response and close done */
+    uint64_t failed;            /* Reset or out of retries */
+    uint64_t refused;           /* Server: SYNs dropped with the table full */
+    uint64_t retransmits;       /* Timeouts that resent a segment */
+    uint64_t rx_frames;
+    uint64_t rx_ignored;        /* Frames that were not TCP for one of our addresses */
+    uint64_t tx_frames;         /* Frames queued */
+    uint64_t tx_dropped;        /* Frames lost to a full TX batch or a failed send */
+    uint64_t active;            /* Flows in the table */
+    double cps;                 /* Completed connections per second since the first poll */
+    latency_report_t connect;   /* SYN to handshake done; received holds the sample count */
+    latency_report_t lifetime;  /* SYN to close done; received holds the sample count */
+} tcp_engine_stats_t;
+
+/**
+ * Initialize an engine config: client, port 80 at the server, client ports
+ * 1024-65535, 64-byte request and response, 65536 concurrent flows
+ * @param config Config to fill (addresses and MACs are left zero)
+ */
+void tcp_engine_config_init(tcp_engine_config_t* config);
+
+/**
+ * Create an engine and its flow table
+ * @param config Engine configuration
+ * @return Engine or NULL on error (missing addresses, bad port range)
+ */
+tcp_engine_t* tcp_engine_create(const tcp_engine_config_t* config);
+
+/**
+ * Process received frames; replies are queued on the TX batch
+ * @param engine Engine handle
+ * @param frames Ethernet frames
+ * @param lengths Frame lengths
+ * @param count Number of frames
+ * @param now_ns Receive time (get_timestamp_ns() clock)
+ * @return Frames that matched a flow or opened one, -1 on error
+ */
+int tcp_engine_input(tcp_engine_t* engine, const uint8_t** frames, const uint32_t* lengths,
+                     uint32_t count, uint64_t now_ns);
+
+/**
+ * Fire due retransmission timers and, on a client, open the connections
+ * due at target_cps (at most 256 per call)
+ * @param engine Engine handle
+ * @param now_ns Current time (get_timestamp_ns() clock)
+ * @return Frames queued, -1 on error
+ */
+int tcp_engine_poll(tcp_engine_t* engine, uint64_t now_ns);
+
+/**
+ * Get the batch of frames waiting to be sent
+ * The caller sends them and calls pkt_batch_reset(); frames that do not fit
+ * are counted in tx_dropped and recovered by retransmission.
+ * @param engine Engine handle
+ * @return Batch or NULL on error
+ */
+pkt_batch_t* tcp_engine_tx_batch(tcp_engine_t* engine);
+
+/**
+ * Check whether a client has opened max_connections and all have finished
+ * @param engine Engine handle
+ * @return 1 if done, 0 otherwise (always 0 for servers and unlimited clients)
+ */
+int tcp_engine_done(const tcp_engine_t* engine);
+
+/**
+ * Run the engine on an L2 backend instance: receive, poll and send until
+ * the duration passes, a client is done or ctrl posts a stop. While ctrl
+ * has it paused a client opens no new connections; open ones carry on.
+ * WORKER_CMD_RATE sets target_cps from rate_pps; packet size and template
+ * commands are refused.
+ * @param engine Engine handle
+ * @param backend L2 backend instance
+ * @param duration_ns Run time (0 = until done)
+ * @param ctrl Command ring polled once per burst (NULL = none)
+ * @return 0 on success, negative on error
+ */
+int tcp_engine_run(tcp_engine_t* engine, netstress_backend_t* backend, uint64_t duration_ns,
+                   worker_ctrl_t* ctrl);
+
+/**
+ * Get engine counters and latency percentiles
+ * @param engine Engine handle
+ * @param stats Output statistics
+ * @return 0 on success, -1 on error
+ */
+int tcp_engine_get_stats(const tcp_engine_t* engine, tcp_engine_stats_t* stats);
+
+/**
+ * Destroy an engine
+ * @param engine Engine handle (NULL is ignored)
+ */
+void tcp_engine_destroy(tcp_engine_t* engine);
+
+/* ============================================================================
+ * Traffic Sink and Reflector
+ * ============================================================================ */
+
+/*
+ * The receiving end of a two-box test. A sink counts every frame a backend
+ * instance receives and, for frames carrying a latency probe header, checks
+ * the sequence numbers of up to SINK_MAX_STREAMS probe ids for loss,
+ * reordering and duplicates over a SINK_SEQ_WINDOW-packet window. A gap
+ * counts as lost until its packets arrive late within the window; later
+ * than that they only count as reordered.
+ *
+ * With reflect set, the sink swaps Ethernet, IPv4 and UDP/TCP source and
+ * destination of unicast frames in place (no checksum changes) and sends
+ * each one back, so
+ * the generator's latency probe sees the round trip. Reflection needs an L2
+ * instance and is meant for a dedicated point-to-point lab link.
+ *
+ * Sinks are single-threaded: run one per queue and read each one's stats.
+ */
+#define SINK_MAX_STREAMS 16
+#define SINK_SEQ_WINDOW 1024
+
+typedef struct sink sink_t;
+
+typedef struct {
+    uint32_t probe_offset;      /* Probe header offset (LATENCY_PROBE_AUTO = after the L4 header) */
+    int reflect;                /* Bounce frames back to the sender */
+    uint32_t burst;             /* Frames per receive (0 = 64) */
+} sink_config_t;
+
+typedef struct {
+    uint64_t rx_frames;
+    uint64_t rx_bytes;
+    uint64_t sequenced;         /* Frames with a probe header of a tracked stream */
+    uint64_t lost;              /* Sequence numbers skipped and not seen since */
+    uint64_t reordered;         /* Frames older than the highest seen, first time */
+    uint64_t duplicates;        /* Frames already seen within the window */
+    uint64_t streams;           /* Probe ids being tracked */
+    uint64_t reflected;         /* Frames sent back */
+    uint64_t reflect_dropped;   /* Frames the backend did not take back */
+    uint64_t reflect_skipped;   /* Frames that were not unicast Ethernet + IPv4 UDP/TCP */
+    double pps;                 /* Frames per second since the first one */
+    double gbps;                /* Received bits per second since the first frame */
+} sink_stats_t;
+
+/**
+ * Initialize a sink config: probe header after L4, no reflection, bursts of 64
+ * @param config Config to fill
+ */
+void sink_config_init(sink_config_t* config);
+
+/**
+ * Create a sink
+ * @param config Sink configuration (NULL for defaults)
+ * @return Sink or NULL on error
+ */
+sink_t* sink_create(const sink_config_t* config);
+
+/**
+ * Account received frames; with reflect set, they are rewritten in place
+ * to go back where they came from and the reflectable ones are moved to the
+ * front of frames and lengths for the caller to send
+ * @param sink Sink handle
+ * @param frames Frames (writable when reflecting)
+ * @param lengths Frame lengths (reordered when reflecting)
+ * @param count Number of frames
+ * @param now_ns Receive time (get_timestamp_ns() clock)
+ * @return Frames rewritten for reflection (0 without reflect), -1 on error
+ */
+int sink_input(sink_t* sink, uint8_t** frames, uint32_t* lengths, uint32_t count, uint64_t now_ns);
+
+/**
+ * Receive one burst from a backend instance, account it and reflect it
+ * @param sink Sink handle
+ * @param backend Backend instance (L2 when reflecting)
+ * @return Frames received, negative on error
+ */
+int sink_poll(sink_t* sink, netstress_backend_t* backend);
+
+/**
+ * Poll a backend instance until the duration passes or ctrl posts a stop
+ * While ctrl has it paused the sink receives nothing; rate, packet size
+ * and template commands are refused.
+ * @param sink Sink handle
+ * @param backend Backend instance (L2 when reflecting)
+ * @param duration_ns Run time (0 = until stopped)
+ * @param ctrl Command ring polled once per burst (NULL = none)
+ * @return 0 on success, negative on error
+ */
+int sink_run(sink_t* sink, netstress_backend_t* backend, uint64_t duration_ns, worker_ctrl_t* ctrl);
+
+/**
+ * Get sink counters (safe from any thread while the sink runs)
+ * @param sink Sink handle
+ * @param stats Output statistics
+ * @return 0 on success, -1 on error
+ */
+int sink_get_stats(const sink_t* sink, sink_stats_t* stats);
+
+/**
+ * Destroy a sink
+ * @param sink Sink handle (NULL is ignored)
+ */
+void sink_destroy(sink_t* sink);
+
+/* ============================================================================
+ * Worker Control
+ * ============================================================================ */
+
+/*
+ * Parameter changes for a running worker go through a single-producer,
+ * single-consumer command ring: one control thread posts, the worker polls
+ * once per batch. Neither side takes a lock or makes a syscall, and polling
+ * an empty ring costs a load of a cache line the worker already holds, so
+ * a change lands within one batch of being posted.
+ *
+ * Commands are numbered from 1 in posting order. The worker acknowledges a
+ * command at its next poll, once a batch has gone out with it applied, or
+ * at once when the command leaves the worker paused or stopped.
+ * A worker that sets params->supported refuses the other commands: they
+ * are acknowledged without being applied, and worker_ctrl_wait() says so.
+ * sink_run() and tcp_engine_run() take a ring to be paused and stopped.
+ */
+#define WORKER_CTRL_DEFAULT_SLOTS 64
+
+typedef enum {
+    WORKER_CMD_RATE = 0,        /* rate_pps, rate_bps, burst (0 = unlimited) */
+    WORKER_CMD_PACKET_SIZE = 1, /* packet_size */
+    WORKER_CMD_TEMPLATE = 2,    /* tmpl; free the old one once this is acknowledged */
+    WORKER_CMD_PAUSE = 3,
+    WORKER_CMD_RESUME = 4,
+    WORKER_CMD_STOP = 5
+} worker_cmd_type_t;
+
+typedef struct {
+    worker_cmd_type_t type;
+    uint32_t burst;
+    uint32_t packet_size;
+    uint64_t rate_pps;
+    uint64_t rate_bps;
+    pkt_template_t* tmpl;
+} worker_cmd_t;
+
+/* worker_ctrl_poll() flags for what changed */
+#define WORKER_CHANGED_RATE 0x01u
+#define WORKER_CHANGED_PACKET_SIZE 0x02u
+#define WORKER_CHANGED_TEMPLATE 0x04u
+#define WORKER_CHANGED_PAUSE 0x08u       /* paused flipped */
+#define WORKER_CHANGED_STOP 0x10u
+
+/* Settings a worker runs with; owned by the worker, updated by its polls */
+typedef struct {
+    uint64_t rate_pps;
+    uint64_t rate_bps;
+    uint32_t burst;
+    uint32_t packet_size;
+    pkt_template_t* tmpl;
+    int paused;
+    int stopped;
+    uint64_t applied;           /* Last command applied */
+    uint32_t supported;         /* WORKER_CHANGED_* the worker acts on (0 = all); set by the worker */
+} worker_params_t;
+
+/**
+ * Create a command ring for one worker
+ * @param slots Commands that can be pending, rounded up to a power of two (0 = 64)
+ * @param numa_node Worker's NUMA node (negative for no preference)
+ * @return Ring or NULL on error
+ */
+worker_ctrl_t* worker_ctrl_create(uint32_t slots, int numa_node);
+
+/**
+ * Post a command (control thread only)
+ * @param ctrl Ring handle
+ * @param cmd Command, copied into the ring
+ * @return Command sequence number, 0 if the ring is full or on error
+ */
+uint64_t worker_ctrl_post(worker_ctrl_t* ctrl, const worker_cmd_t* cmd);
+
+/**
+ * Get the last command the worker acknowledged (any thread)
+ * @param ctrl Ring handle
+ * @return Sequence number, 0 before the first acknowledgement
+ */
+uint64_t worker_ctrl_acked(const worker_ctrl_t* ctrl);
+
+/**
+ * Spin until the worker acknowledges a command
+ * @param ctrl Ring handle
+ * @param seq Sequence number from worker_ctrl_post()
+ * @param timeout_ns Longest wait
+ * @return 0 once acknowledged, -1 on timeout or error, or with errno
+ *         ENOTSUP when the worker does not support the command
+ */
+int worker_ctrl_wait(const worker_ctrl_t* ctrl, uint64_t seq, uint64_t timeout_ns);
+
+/**
+ * Apply pending commands to the worker's settings (worker thread only)
+ * Call once per batch; a paused worker should keep polling between idles.
+ * @param ctrl Ring handle
+ * @param params Worker settings, updated in place
+ * @return WORKER_CHANGED_* flags, 0 when nothing changed
+ */
+uint32_t worker_ctrl_poll(worker_ctrl_t* ctrl, worker_params_t* params);
+
+/**
+ * Destroy a command ring (after the worker has stopped polling it)
+ * @param ctrl Ring handle (NULL is ignored)
+ */
+void worker_ctrl_destroy(worker_ctrl_t* ctrl);
 
 #ifdef __cplusplus
 }
@@ -3,11 +3,25 @@
  * Comprehensive tests for driver_shim.c functions
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "test_framework.h"
 #include "driver_shim.h"
 #include <assert.h>
+#include <errno.h>
 #include <time.h>
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 /* Mock data for testing */
 static uint8_t test_packet_udp[] = {
     /* IP Header */
@@ -66,6 +80,153 @@ void test_checksum_calculation(void) {
     TEST_ASSERT_NEQ(odd_result, 0, "Odd length checksum should work");
 }
 
+/* Reference word-at-a-time checksum the optimized kernels must match */
+static uint16_t reference_checksum(const uint8_t* data, size_t len, uint32_t sum) {
+    size_t i;
+    for (i = 0; i + 1 < len; i += 2) {
+        sum += ((uint16_t)data[i] << 8) | data[i + 1];
+    }
+    if (i < len) {
+        sum += (uint16_t)data[i] << 8;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)(~sum);
+}
+
+/* Test every available checksum kernel against the reference */
+void test_checksum_kernels(void) {
+    static uint8_t buffer[9000 + 64];
+    const checksum_impl_t impls[] = {
+        CHECKSUM_IMPL_PORTABLE, CHECKSUM_IMPL_AVX2, CHECKSUM_IMPL_AVX512, CHECKSUM_IMPL_NEON
+    };
+    const size_t lengths[] = { 1, 2, 3, 7, 20, 31, 33, 63, 64, 65, 127, 129, 1499, 1500, 4097, 9000 };
+    
+    srand(12345);
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)rand();
+    }
+    
+    TEST_ASSERT_EQ(checksum_set_impl(CHECKSUM_IMPL_PORTABLE), 0, "Portable kernel always available");
+    TEST_ASSERT_EQ(checksum_set_impl((checksum_impl_t)99), -1, "Unknown kernel should be rejected");
+    TEST_ASSERT_EQ(checksum_get_impl(), CHECKSUM_IMPL_PORTABLE, "Rejected kernel should not change selection");
+    
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        if (checksum_set_impl(impls[k]) != 0) {
+            printf("    %s kernel not available, skipping\n", checksum_impl_name(impls[k]));
+            continue;
+        }
+        
+        int mismatches = 0;
+        for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+            /* Misaligned starts exercise unaligned vector loads */
+            for (size_t off = 0; off < 4; off++) {
+                const uint8_t* p = buffer + off;
+                size_t len = lengths[l];
+                if (calculate_checksum(p, len) != reference_checksum(p, len, 0)) {
+                    mismatches++;
+                }
+                uint32_t pseudo = 0xC0A8 + 0x0101 + 0xC0A8 + 0x0102 + 17 + (uint32_t)len;
+                if (calculate_transport_checksum(0xC0A80101, 0xC0A80102, 17, p, len) !=
+                    reference_checksum(p, len, pseudo)) {
+                    mismatches++;
+                }
+            }
+        }
+        TEST_ASSERT_EQ(mismatches, 0, "Kernel should match reference checksum");
+    }
+    
+    /* All-0xFF data stresses carry propagation */
+    memset(buffer, 0xFF, sizeof(buffer));
+    TEST_ASSERT_EQ(checksum_set_impl(CHECKSUM_IMPL_AUTO), 0, "Auto selection should succeed");
+    TEST_ASSERT_EQ(calculate_checksum(buffer, 9000), reference_checksum(buffer, 9000, 0),
+                   "Carry-heavy buffer should match reference");
+    TEST_ASSERT_NEQ(checksum_get_impl(), CHECKSUM_IMPL_AUTO, "Auto should resolve to a concrete kernel");
+    printf("    Active checksum kernel: %s\n", checksum_impl_name(checksum_get_impl()));
+}
+
+/* Recompute the IP header checksum from scratch for comparison */
+static uint16_t full_ip_checksum(uint8_t* ip) {
+    uint8_t copy[20];
+    memcpy(copy, ip, 20);
+    copy[10] = copy[11] = 0;
+    return calculate_checksum(copy, 20);
+}
+
+/* Test RFC 1624 incremental checksum updates */
+void test_incremental_checksum(void) {
+    uint8_t ip[20];
+    memcpy(ip, test_packet_tcp, 20);
+    uint16_t csum = full_ip_checksum(ip);
+    ip[10] = (uint8_t)(csum >> 8);
+    ip[11] = (uint8_t)csum;
+    
+    /* Value-level helpers */
+    uint16_t updated = checksum_update16(csum, 0x5678, 0x9ABC);
+    ip[4] = 0x9A;
+    ip[5] = 0xBC;
+    TEST_ASSERT_EQ(updated, full_ip_checksum(ip), "16-bit update should match full recompute");
+    ip[10] = (uint8_t)(updated >> 8);
+    ip[11] = (uint8_t)updated;
+    
+    /* Rewrite ID (even offset), TOS/length straddling (odd offset), source IP */
+    TEST_ASSERT_EQ(packet_rewrite16(ip, 20, 4, 10, 0x1357), 0, "ID rewrite should succeed");
+    TEST_ASSERT_EQ(((ip[10] << 8) | ip[11]), full_ip_checksum(ip), "ID rewrite checksum");
+    TEST_ASSERT_EQ(packet_rewrite16(ip, 20, 1, 10, 0xB800), 0, "Odd-offset rewrite should succeed");
+    TEST_ASSERT_EQ(((ip[10] << 8) | ip[11]), full_ip_checksum(ip), "Odd-offset rewrite checksum");
+    TEST_ASSERT_EQ(packet_rewrite32(ip, 20, 12, 10, 0xC0A80A0B), 0, "Source IP rewrite should succeed");
+    TEST_ASSERT_EQ(((ip[10] << 8) | ip[11]), full_ip_checksum(ip), "32-bit rewrite checksum");
+    TEST_ASSERT_EQ(ip[12], 0xC0, "Field should be stored big-endian");
+    TEST_ASSERT_EQ(ip[15], 0x0B, "Field should be stored big-endian");
+    
+    /* Bounds and overlap */
+    TEST_ASSERT_EQ(packet_rewrite16(ip, 20, 19, 10, 1), -1, "Field past end should fail");
+    TEST_ASSERT_EQ(packet_rewrite32(ip, 20, 8, 10, 1), -1, "Field overlapping checksum should fail");
+    TEST_ASSERT_EQ(packet_rewrite16(NULL, 20, 4, 10, 1), -1, "NULL packet should fail");
+    
+    /* TCP sequence number across a batch, checked against the pseudo-header sum */
+    enum { BATCH = 8 };
+    uint8_t tcp[BATCH][20];
+    uint8_t* packets[BATCH];
+    uint32_t lengths[BATCH];
+    uint32_t seqs[BATCH];
+    uint32_t src_ip = 0x0A000001, dst_ip = 0x0A000002;
+    uint16_t base = calculate_transport_checksum(src_ip, dst_ip, 6, test_packet_tcp + 20, 20);
+    for (int i = 0; i < BATCH; i++) {
+        memcpy(tcp[i], test_packet_tcp + 20, 20);
+        tcp[i][16] = (uint8_t)(base >> 8);
+        tcp[i][17] = (uint8_t)base;
+        packets[i] = tcp[i];
+        lengths[i] = 20;
+        seqs[i] = 0xFFFF0000u + (uint32_t)i * 0x10001u;
+    }
+    lengths[BATCH - 1] = 10;  /* Too short: skipped */
+    
+    int rewritten = packet_rewrite32_batch(packets, lengths, BATCH, 4, 16, seqs);
+    TEST_ASSERT_EQ(rewritten, BATCH - 1, "Batch should rewrite every packet that fits");
+    
+    int mismatches = 0;
+    for (int i = 0; i < BATCH - 1; i++) {
+        uint16_t got = (uint16_t)((tcp[i][16] << 8) | tcp[i][17]);
+        tcp[i][16] = tcp[i][17] = 0;
+        if (got != calculate_transport_checksum(src_ip, dst_ip, 6, tcp[i], 20)) {
+            mismatches++;
+        }
+    }
+    TEST_ASSERT_EQ(mismatches, 0, "Batch checksums should match full recompute");
+    TEST_ASSERT_EQ(tcp[BATCH - 1][4], test_packet_tcp[24], "Skipped packet should be untouched");
+    
+    uint16_t ports[BATCH];
+    for (int i = 0; i < BATCH; i++) {
+        ports[i] = (uint16_t)(1024 + i);
+    }
+    TEST_ASSERT_EQ(packet_rewrite16_batch(packets, lengths, BATCH, 0, 16, ports), BATCH - 1,
+                   "16-bit batch should rewrite every packet that fits");
+    TEST_ASSERT_EQ(packet_rewrite16_batch(NULL, lengths, BATCH, 0, 16, ports), -1,
+                   "NULL batch should fail");
+}
+
 /* Test transport checksum calculation */
 void test_transport_checksum(void) {
     uint32_t src_ip = htonl_test(0xC0A80101); /* 192.168.1.1 */
@@ -139,6 +300,277 @@ void test_utility_functions(void) {
     TEST_ASSERT(pin_result == 0 || pin_result == -1, "CPU pinning returned valid result");
 }
 
+/* Test monotonic nanosecond clock */
+void test_clock_source(void) {
+    clock_source_t source = clock_get_source();
+    TEST_ASSERT(strcmp(clock_source_name(source), "unknown") != 0, "Clock source should be named");
+    if (source == CLOCK_SOURCE_TSC) {
+        TEST_ASSERT(clock_tsc_hz() > 1000000ULL, "Calibrated TSC frequency should be set");
+    } else {
+        TEST_ASSERT_EQ(clock_tsc_hz(), 0, "TSC frequency should be 0 when unused");
+    }
+    
+    uint64_t prev = get_timestamp_ns();
+    int monotonic = 1;
+    for (int i = 0; i < 100000; i++) {
+        uint64_t now = get_timestamp_ns();
+        if (now < prev) {
+            monotonic = 0;
+        }
+        prev = now;
+    }
+    TEST_ASSERT(monotonic, "Nanosecond clock should never go backwards");
+    
+    uint64_t t0 = get_timestamp_ns();
+    struct timespec delay = { 0, 5000000 };
+    nanosleep(&delay, NULL);
+    uint64_t elapsed = get_timestamp_ns() - t0;
+    TEST_ASSERT(elapsed >= 4500000ULL, "5ms sleep should measure at least ~5ms");
+    TEST_ASSERT(elapsed < 500000000ULL, "5ms sleep should measure well under 500ms");
+}
+
+/* Test token-bucket pacer */
+void test_pacer(void) {
+    TEST_ASSERT_EQ(pacer_set_rate(NULL, 1, 0, 1), -1, "NULL pacer should fail");
+    TEST_ASSERT_EQ(pacer_burst(NULL), 0, "NULL pacer has no burst");
+    
+    /* 100 kpps in bursts of 10: 2000 packets take ~20ms */
+    pacer_t* pacer = pacer_create(100000, 0, 10);
+    TEST_ASSERT_NOT_NULL(pacer, "Pacer should be created");
+    if (!pacer) {
+        return;
+    }
+    TEST_ASSERT_EQ(pacer_burst(pacer), 10, "Pacer should keep burst size");
+    
+    uint64_t t0 = get_timestamp_ns();
+    uint64_t prev = 0;
+    int ordered = 1;
+    for (int i = 0; i < 200; i++) {
+        pacer_wait(pacer);
+        uint64_t departure = pacer_charge(pacer, 10, 640);
+        if (departure < prev) {
+            ordered = 0;
+        }
+        prev = departure;
+    }
+    uint64_t elapsed = get_timestamp_ns() - t0;
+    TEST_ASSERT(ordered, "Departure times should be non-decreasing");
+    TEST_ASSERT(elapsed >= 19000000ULL, "2000 packets at 100kpps should take at least ~20ms");
+    TEST_ASSERT(elapsed < 200000000ULL, "Pacing should not fall far behind the rate");
+    
+    /* Bit limit dominates: 8 Mbit/s with 1000-byte packets is 1000 pps */
+    pacer_set_rate(pacer, 1000000, 8000000, 1);
+    uint64_t first = pacer_charge(pacer, 1, 1000);
+    uint64_t second = pacer_charge(pacer, 1, 1000);
+    TEST_ASSERT(second - first >= 999000ULL && second - first <= 1001000ULL,
+                "Byte rate should space 1000-byte packets 1ms apart");
+    
+#ifndef _WIN32
+    /* Low rates must sleep rather than spin */
+    pacer_set_rate(pacer, 500, 0, 1);
+    struct timespec c0, c1;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+    t0 = get_timestamp_ns();
+    for (int i = 0; i < 10; i++) {
+        pacer_wait(pacer);
+        pacer_charge(pacer, 1, 64);
+    }
+    elapsed = get_timestamp_ns() - t0;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+    uint64_t cpu = (uint64_t)(c1.tv_sec - c0.tv_sec) * 1000000000ULL + (uint64_t)c1.tv_nsec - (uint64_t)c0.tv_nsec;
+    TEST_ASSERT(elapsed >= 17000000ULL, "10 packets at 500pps should take ~18ms");
+    TEST_ASSERT(cpu < elapsed / 2, "Low-rate pacing should sleep, not spin");
+#endif
+    
+    pacer_destroy(pacer);
+}
+
+/* Test round-trip latency probes and their HDR histogram */
+void test_latency_probe(void) {
+    /* Ethernet/IPv4/UDP frame with 40 bytes of payload and a valid checksum */
+    uint8_t frame[82];
+    memset(frame, 0, sizeof(frame));
+    frame[12] = 0x08;
+    uint8_t* ip = frame + 14;
+    uint8_t* udp = ip + 20;
+    ip[0] = 0x45;
+    ip[9] = 17;
+    uint32_t src_ip = 0xC0A80101, dst_ip = 0xC0A80102;
+    for (int i = 0; i < 4; i++) {
+        ip[12 + i] = (uint8_t)(src_ip >> (24 - 8 * i));
+        ip[16 + i] = (uint8_t)(dst_ip >> (24 - 8 * i));
+    }
+    udp[5] = 48;
+    for (int i = 8; i < 48; i++) {
+        udp[i] = (uint8_t)(i * 7);
+    }
+    uint16_t csum = calculate_transport_checksum(src_ip, dst_ip, 17, udp, 48);
+    udp[6] = (uint8_t)(csum >> 8);
+    udp[7] = (uint8_t)csum;
+    
+    driver_stats_block_t* block = stats_block_create();
+    latency_probe_t* probe = latency_probe_create(7, LATENCY_PROBE_AUTO, block);
+    TEST_ASSERT_NOT_NULL(probe, "Latency probe should be created");
+    if (!probe) {
+        stats_block_destroy(block);
+        return;
+    }
+    
+    TEST_ASSERT_EQ(latency_probe_stamp(probe, frame, sizeof(frame)), 0, "Frame should be stamped");
+    uint32_t magic;
+    memcpy(&magic, udp + 8, sizeof(magic));
+    TEST_ASSERT_EQ(magic, LATENCY_PROBE_MAGIC, "Header should follow the UDP header");
+    uint16_t stored = (uint16_t)((udp[6] << 8) | udp[7]);
+    udp[6] = udp[7] = 0;
+    TEST_ASSERT_EQ(stored, calculate_transport_checksum(src_ip, dst_ip, 17, udp, 48),
+                   "UDP checksum should be updated for the stamp");
+    udp[6] = (uint8_t)(stored >> 8);
+    udp[7] = (uint8_t)stored;
+    TEST_ASSERT_EQ(latency_probe_stamp(probe, frame, 60), -1, "Header past the end should fail");
+    
+    uint64_t before = get_timestamp_ns();
+    TEST_ASSERT_EQ(latency_probe_match(probe, frame, sizeof(frame), before + 1000), 1, "Reply should match");
+    ip[9] = 1;
+    TEST_ASSERT_EQ(latency_probe_match(probe, frame, sizeof(frame), before), 0, "ICMP frame should not match");
+    ip[9] = 17;
+    latency_probe_t* other = latency_probe_create(8, LATENCY_PROBE_AUTO, NULL);
+    TEST_ASSERT_EQ(latency_probe_match(other, frame, sizeof(frame), before), 0, "Other probe id should not match");
+    latency_probe_destroy(other);
+    
+    latency_report_t report;
+    TEST_ASSERT_EQ(latency_probe_report(probe, &report), 0, "Report should succeed");
+    TEST_ASSERT_EQ(report.sent, 1, "One packet should be stamped");
+    TEST_ASSERT_EQ(report.received, 1, "One reply should be matched");
+    TEST_ASSERT(report.min_ns >= 1000 && report.min_ns < 1000000000ULL, "RTT should cover the stamp-to-match gap");
+    latency_probe_destroy(probe);
+    stats_block_destroy(block);
+    
+    /* Fixed-offset probe fed with synthetic replies: RTTs of 1..10000 us */
+    probe = latency_probe_create(1, 0, NULL);
+    uint8_t payload[LATENCY_PROBE_HDR_LEN];
+    int stamped = 0;
+    for (uint64_t i = 0; i < 10000; i++) {
+        stamped += latency_probe_stamp(probe, payload, sizeof(payload)) == 0;
+        uint64_t seq = i == 5000 ? 4000 : i;  /* one stale reply */
+        uint64_t tx_ns = 0;
+        memcpy(payload + 8, &seq, sizeof(seq));
+        memcpy(payload + 16, &tx_ns, sizeof(tx_ns));
+        latency_probe_match(probe, payload, sizeof(payload), (i + 1) * 1000);
+    }
+    latency_probe_report(probe, &report);
+    TEST_ASSERT_EQ(stamped, 10000, "Every payload should be stamped");
+    TEST_ASSERT_EQ(report.sent, 10000, "Every stamp should be counted");
+    TEST_ASSERT_EQ(report.received, 10000, "Every reply should be matched");
+    TEST_ASSERT_EQ(report.reordered, 1, "Stale sequence should count as reordered");
+    TEST_ASSERT_EQ(report.min_ns, 1000, "Minimum RTT");
+    TEST_ASSERT_EQ(report.max_ns, 10000000, "Maximum RTT");
+    TEST_ASSERT(report.p50_ns >= 5000000 && report.p50_ns <= 5000000 + 5000000 / 32, "p50 within 1/32");
+    TEST_ASSERT(report.p99_ns >= 9900000 && report.p99_ns <= 9900000 + 9900000 / 32, "p99 within 1/32");
+    TEST_ASSERT(report.p999_ns >= 9990000 && report.p999_ns <= 10000000, "p99.9 within 1/32");
+    TEST_ASSERT_EQ(latency_probe_percentile(probe, 100.0), 10000000, "p100 should be the maximum");
+    latency_probe_destroy(probe);
+    
+    /* Durations timed by the caller go straight into the histogram */
+    probe = latency_probe_create(2, 0, NULL);
+    latency_probe_record(probe, 300);
+    latency_probe_record(probe, 700);
+    latency_probe_record(NULL, 1);
+    latency_probe_report(probe, &report);
+    TEST_ASSERT(report.sent == 0 && report.received == 2, "Recorded samples should not count as sends");
+    TEST_ASSERT(report.min_ns == 300 && report.max_ns == 700, "Recorded samples should set the range");
+    latency_probe_destroy(probe);
+    
+    TEST_ASSERT_EQ(latency_probe_percentile(NULL, 50.0), 0, "NULL probe has no percentile");
+    TEST_ASSERT_EQ(latency_probe_report(NULL, &report), -1, "NULL probe report should fail");
+}
+
+/* Test SO_TIMESTAMPING software timestamps on loopback */
+void test_socket_timestamps(void) {
+#ifdef __linux__
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rx < 0 || tx < 0) {
+        TEST_ASSERT(0, "Failed to create UDP sockets for testing");
+        return;
+    }
+    
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl_test(0x7F000001);
+    bind(rx, (struct sockaddr*)&addr, sizeof(addr));
+    getsockname(rx, (struct sockaddr*)&addr, &addr_len);
+    
+    TEST_ASSERT_EQ(socket_enable_timestamps(rx, 0), -1, "Empty timestamp flags should fail");
+    TEST_ASSERT_EQ(socket_enable_timestamps(rx, TIMESTAMP_SOFTWARE), 0, "RX software timestamps should enable");
+    TEST_ASSERT_EQ(socket_enable_timestamps(tx, TIMESTAMP_SOFTWARE), 0, "TX software timestamps should enable");
+    TEST_ASSERT_EQ(net_enable_hw_timestamps(NULL), -1, "NULL interface should fail");
+    
+    /* The kernel turns on RX stamping from a workqueue; give it a moment */
+    struct timespec settle = { 0, 10000000 };
+    nanosleep(&settle, NULL);
+    
+    uint64_t sw = 0, hw = 0;
+    uint8_t buf[64];
+    TEST_ASSERT_EQ(socket_recv_timestamped(rx, buf, sizeof(buf), &sw, &hw), 0, "Empty socket should return 0");
+    
+    const char payload[] = "timestamp";
+    for (int i = 0; i < 2; i++) {
+        sendto(tx, payload, sizeof(payload), 0, (struct sockaddr*)&addr, sizeof(addr));
+    }
+    
+    int n = socket_recv_timestamped(rx, buf, sizeof(buf), &sw, &hw);
+    TEST_ASSERT_EQ(n, (int)sizeof(payload), "Timestamped receive should return the datagram");
+    TEST_ASSERT(sw > 0, "RX software timestamp should be present");
+    
+    uint32_t id = 99;
+    uint64_t tx_sw = 0;
+    TEST_ASSERT_EQ(socket_read_tx_timestamp(tx, &id, &tx_sw, NULL), 1, "First TX timestamp should be queued");
+    TEST_ASSERT_EQ(id, 0, "First TX timestamp should have id 0");
+    TEST_ASSERT(tx_sw > 0 && tx_sw <= sw, "TX timestamp should precede RX timestamp");
+    TEST_ASSERT_EQ(socket_read_tx_timestamp(tx, &id, &tx_sw, NULL), 1, "Second TX timestamp should be queued");
+    TEST_ASSERT_EQ(id, 1, "Second TX timestamp should have id 1");
+    
+    close(rx);
+    close(tx);
+#else
+    TEST_ASSERT_EQ(socket_enable_timestamps(0, TIMESTAMP_SOFTWARE), -1, "Timestamping stub should return -1");
+#endif
+}
+
+/* Test NUMA topology and placement helpers */
+void test_numa_functions(void) {
+    int cpus[1024];
+    int count = get_numa_node_cpus(0, cpus, 1024);
+    TEST_ASSERT(count == -1 || count > 0, "NUMA node 0 CPU list returned valid result");
+    
+    if (count > 0) {
+        TEST_ASSERT_EQ(get_cpu_numa_node(cpus[0]), 0, "First CPU of node 0 should map to node 0");
+    }
+    TEST_ASSERT_EQ(get_cpu_numa_node(-1), -1, "Invalid CPU should have unknown node");
+    TEST_ASSERT_EQ(get_numa_node_cpus(-1, cpus, 1024), -1, "Invalid node should fail");
+    TEST_ASSERT_EQ(get_netdev_numa_node("lo"), -1, "Loopback should have no NUMA affinity");
+    TEST_ASSERT_EQ(get_netdev_numa_node("../../x"), -1, "Path-like interface names should be rejected");
+    
+    int pinned = pin_to_numa_cpu(0, 0);
+    TEST_ASSERT(pinned >= -1, "NUMA-local pinning returned valid result");
+    if (count > 0 && pinned >= 0) {
+        TEST_ASSERT_EQ(get_cpu_numa_node(pinned), 0, "Pinned CPU should be local to node 0");
+    }
+    
+    size_t size = 1 << 20;
+    uint8_t* mem = (uint8_t*)alloc_numa_memory(size, 0);
+    TEST_ASSERT_NOT_NULL(mem, "NUMA memory allocation should succeed");
+    if (mem) {
+        mem[0] = 0xAA;
+        mem[size - 1] = 0x55;
+        TEST_ASSERT(mem[0] == 0xAA && mem[size - 1] == 0x55, "NUMA memory should be writable");
+        free_numa_memory(mem, size);
+    }
+    TEST_ASSERT_NULL(alloc_numa_memory(0, 0), "Zero-size allocation should fail");
+}
+
 /* Test backend detection */
 void test_backend_detection(void) {
     system_capabilities_t caps;
@@ -147,6 +579,11 @@ void test_backend_detection(void) {
     TEST_ASSERT_EQ(result, 0, "Capability detection should succeed");
     TEST_ASSERT(caps.has_raw_socket, "Should always have raw socket capability");
     TEST_ASSERT(caps.cpu_count > 0, "Should detect positive CPU count");
+    TEST_ASSERT_EQ(caps.dpdk_tx_offloads & ~(uint32_t)OFFLOAD_ALL, 0, "DPDK offloads should be known flags");
+    TEST_ASSERT_EQ(caps.af_xdp_tx_offloads & ~(uint32_t)OFFLOAD_ALL, 0, "AF_XDP offloads should be known flags");
+#if !defined(HAS_DPDK) && !defined(HAS_AF_XDP)
+    TEST_ASSERT_EQ(caps.dpdk_tx_offloads | caps.af_xdp_tx_offloads, 0, "No offloads without kernel-bypass backends");
+#endif
     
     /* Test backend selection */
     backend_type_t backend = select_best_backend(&caps);
@@ -167,6 +604,238 @@ void test_backend_detection(void) {
     TEST_ASSERT_STR_EQ(backend_name((backend_type_t)999), "unknown", "Unknown backend name");
 }
 
+/* Test measured backend selection and its on-disk cache */
+void test_backend_probe(void) {
+    backend_probe_result_t results[8];
+    backend_probe_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.packets = 256;
+    config.cache_path = "";
+    
+    TEST_ASSERT(backend_probe_run(NULL, results, 8) < 0, "Probe should reject NULL config");
+    
+#ifdef __linux__
+    int count = backend_probe_run(&config, results, 8);
+    TEST_ASSERT(count >= 2, "Probe should report every candidate");
+    int sendmmsg_ok = 0;
+    int frames_skipped = 1;
+    for (int i = 0; i < count; i++) {
+        if (results[i].backend == BACKEND_SENDMMSG) {
+            sendmmsg_ok = results[i].status == 0 && results[i].packets == 256 && results[i].pps > 0;
+        } else if (results[i].backend == BACKEND_AF_XDP || results[i].backend == BACKEND_DPDK) {
+            frames_skipped &= results[i].status < 0;
+        }
+    }
+    TEST_ASSERT(sendmmsg_ok, "sendmmsg should be measured against the loopback sink");
+    TEST_ASSERT(frames_skipped, "Frame backends need an interface and sink address");
+    
+    char key[512];
+    TEST_ASSERT(backend_probe_cache_key(NULL, 0, key, sizeof(key)) > 0, "Loopback cache key should build");
+    TEST_ASSERT(strstr(key, "|lo|") != NULL, "Key should name the interface");
+    TEST_ASSERT(backend_probe_cache_key("../lo", 0, key + 256, 256) < 0, "Path-like interface names should fail");
+    
+    /* A cached answer is used without probing */
+    char path[64];
+    char line[600];
+    snprintf(path, sizeof(path), "/tmp/netstress-probe-test-%d", (int)getpid());
+    FILE* f = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(f, "Cache file should be writable");
+    if (!f) {
+        return;
+    }
+    fprintf(f, "other|key sendmmsg 1\n%s raw_socket 1\n", key);
+    fclose(f);
+    config.cache_path = path;
+    TEST_ASSERT_EQ(select_backend_measured(&config, NULL), BACKEND_RAW_SOCKET, "Cached backend should win");
+    
+    /* A miss probes, records the winner and keeps other entries */
+    f = fopen(path, "w");
+    fprintf(f, "other|key sendmmsg 1\n");
+    fclose(f);
+    backend_type_t chosen = select_backend_measured(&config, NULL);
+    TEST_ASSERT(chosen == BACKEND_RAW_SOCKET || chosen == BACKEND_SENDMMSG || chosen == BACKEND_IO_URING,
+                "Probe should pick a socket backend on loopback");
+    
+    int have_other = 0;
+    int have_chosen = 0;
+    size_t key_len = strlen(key);
+    f = fopen(path, "r");
+    while (f && fgets(line, sizeof(line), f)) {
+        have_other |= strncmp(line, "other|key ", 10) == 0;
+        have_chosen |= strncmp(line, key, key_len) == 0 &&
+                       strncmp(line + key_len + 1, backend_name(chosen), strlen(backend_name(chosen))) == 0;
+    }
+    if (f) {
+        fclose(f);
+    }
+    TEST_ASSERT(have_other, "Unrelated cache entries should survive");
+    TEST_ASSERT(have_chosen, "Probe result should be cached");
+    TEST_ASSERT_EQ(select_backend_measured(&config, NULL), chosen, "Second selection should hit the cache");
+    
+    /* Naming an interface without a sink address measures the loopback sink,
+     * which must not be cached as that interface's answer */
+    f = fopen(path, "w");
+    fclose(f);
+    config.ifname = "lo";
+    select_backend_measured(&config, NULL);
+    f = fopen(path, "r");
+    have_chosen = 0;
+    while (f && fgets(line, sizeof(line), f)) {
+        have_chosen |= strncmp(line, key, key_len) == 0;
+    }
+    if (f) {
+        fclose(f);
+    }
+    TEST_ASSERT(!have_chosen, "Results off the interface should not be cached");
+    count = backend_probe_run(&config, results, 8);
+    int unbound = 1;
+    for (int i = 0; i < count; i++) {
+        unbound &= !results[i].nic_bound;
+    }
+    TEST_ASSERT(unbound, "Loopback sink results should not count as NIC-bound");
+    unlink(path);
+#else
+    TEST_ASSERT(backend_probe_run(&config, results, 8) < 0, "Probe needs Linux");
+#endif
+}
+
+/* Test polymorphic backend instances */
+void test_backend_instances(void) {
+    TEST_ASSERT_NULL(netstress_backend_ops(BACKEND_NONE), "No table for BACKEND_NONE");
+    const netstress_backend_ops_t* ops = netstress_backend_ops(BACKEND_SENDMMSG);
+    TEST_ASSERT_NOT_NULL(ops, "sendmmsg is always compiled in");
+    if (!ops) {
+        return;
+    }
+    TEST_ASSERT_EQ(ops->type, BACKEND_SENDMMSG, "Table should report its type");
+    TEST_ASSERT_EQ(ops->layer, BACKEND_LAYER_PAYLOAD, "sendmmsg sends UDP payloads");
+    TEST_ASSERT_NULL(netstress_backend_open(BACKEND_SENDMMSG, NULL), "NULL config should fail");
+    TEST_ASSERT_EQ(netstress_backend_type(NULL), BACKEND_NONE, "NULL instance has no type");
+    netstress_backend_close(NULL);
+    
+#ifdef __linux__
+    driver_config_t base;
+    memset(&base, 0, sizeof(base));
+    base.burst_size = 16;
+    netstress_backend_config_t config;
+    netstress_backend_config_init(&config, &base);
+    TEST_ASSERT_EQ(config.base.burst_size, 16, "Config should copy the driver config");
+    
+    uint16_t port = (uint16_t)(21000 + getpid() % 1000);
+    config.bind_port = port;
+    netstress_backend_t* rx = netstress_backend_open(BACKEND_SENDMMSG, &config);
+    config.bind_port = 0;
+    config.dst_ip = htonl(0x7F000001);
+    config.dst_port = port;
+    netstress_backend_t* tx = netstress_backend_open(BACKEND_SENDMMSG, &config);
+    TEST_ASSERT_NOT_NULL(rx, "Receiving instance should open");
+    TEST_ASSERT_NOT_NULL(tx, "Sending instance should open");
+    if (!rx || !tx) {
+        netstress_backend_close(rx);
+        netstress_backend_close(tx);
+        return;
+    }
+    TEST_ASSERT_EQ(netstress_backend_layer(tx), BACKEND_LAYER_PAYLOAD, "Instance should report its layer");
+    
+    uint8_t payload[100];
+    memset(payload, 0x5A, sizeof(payload));
+    const uint8_t* packets[4] = {payload, payload, payload, payload};
+    uint32_t lengths[4] = {100, 100, 100, 100};
+    TEST_ASSERT_EQ(netstress_backend_send_batch(tx, packets, lengths, 4), 4, "Batch should be sent");
+    
+    rx_desc_t descs[8];
+    int got = 0;
+    for (int tries = 0; tries < 100 && got < 4; tries++) {
+        int n = netstress_backend_recv_batch(rx, descs + got, 8 - (uint32_t)got);
+        if (n < 0) {
+            break;
+        }
+        got += n;
+        if (got < 4) {
+            struct timespec wait = {0, 1000000};
+            nanosleep(&wait, NULL);
+        }
+    }
+    TEST_ASSERT_EQ(got, 4, "Every datagram should be received");
+    TEST_ASSERT(got > 0 && descs[0].len == 100 && descs[0].data[99] == 0x5A, "Payload should arrive intact");
+    TEST_ASSERT_EQ(netstress_backend_release(rx, descs, (uint32_t)got), got, "Borrowed slots should be released");
+    TEST_ASSERT(netstress_backend_release(rx, descs, 1) < 0, "Over-release should fail");
+    TEST_ASSERT(netstress_backend_recv_batch(tx, descs, 8) < 0, "Unbound instance cannot receive");
+    
+    driver_stats_t stats;
+    TEST_ASSERT_EQ(netstress_backend_get_stats(tx, &stats), 0, "Stats should be readable");
+    TEST_ASSERT(stats.packets_sent == 4 && stats.bytes_sent == 400, "TX should be counted per instance");
+    netstress_backend_get_stats(rx, &stats);
+    TEST_ASSERT(stats.packets_received == 4 && stats.packets_sent == 0, "RX should be counted per instance");
+    
+    /* Socket backends cannot see their queue, so only acceptance is reported */
+    tx_result_t result;
+    TEST_ASSERT_EQ(netstress_backend_burst(tx), 16, "Burst should start at burst_size");
+    TEST_ASSERT_EQ(netstress_backend_send_batch_ex(tx, packets, lengths, 4, &result), 4, "Reported send should succeed");
+    TEST_ASSERT(result.accepted == 4 && result.held == 0 && result.ring_size == 0, "Result should report acceptance");
+    TEST_ASSERT_EQ(result.next_burst, 16, "A short offer should not grow the burst");
+    TEST_ASSERT_EQ(netstress_backend_set_burst_limits(tx, 32, 64), 0, "Limits should be accepted");
+    TEST_ASSERT_EQ(netstress_backend_burst(tx), 32, "Burst should be raised to the new minimum");
+    TEST_ASSERT_EQ(netstress_backend_set_burst_limits(NULL, 1, 1), -1, "NULL instance limits should fail");
+    TEST_ASSERT_EQ(netstress_backend_burst(NULL), 0, "NULL instance has no burst");
+    
+    netstress_backend_close(tx);
+    netstress_backend_close(rx);
+#endif
+}
+
+/* Test the adaptive TX burst controller */
+void test_tx_burst_ctl(void) {
+    tx_burst_ctl_t ctl;
+    tx_result_t r;
+    memset(&r, 0, sizeof(r));
+    
+    tx_burst_ctl_init(&ctl, 16, 1, 64);
+    TEST_ASSERT_EQ(ctl.burst, 16, "Burst should start where asked");
+    r.accepted = 16;
+    TEST_ASSERT_EQ(tx_burst_ctl_update(&ctl, 16, &r), 18, "A fully taken burst should grow by an eighth");
+    r.accepted = 4;
+    TEST_ASSERT_EQ(tx_burst_ctl_update(&ctl, 4, &r), 18, "A short offer should not grow the burst");
+    
+    /* Accepted, but the ring has less than a burst free */
+    r.accepted = 18;
+    r.ring_used = 100;
+    r.ring_size = 110;
+    TEST_ASSERT_EQ(tx_burst_ctl_update(&ctl, 18, &r), 18, "A nearly full ring should stop growth");
+    r.ring_used = 10;
+    TEST_ASSERT_EQ(tx_burst_ctl_update(&ctl, 18, &r), 20, "Headroom should allow growth");
+    
+    /* Shortfalls back off to what went out, at most halving */
+    r.accepted = 15;
+    TEST_ASSERT_EQ(tx_burst_ctl_update(&ctl, 20, &r), 15, "Burst should shrink to the accepted count");
+    r.accepted = 1;
+    TEST_ASSERT_EQ(tx_burst_ctl_update(&ctl, 15, &r), 7, "Burst should at most halve");
+    r.accepted = 7;
+    r.held = 7;
+    TEST_ASSERT_EQ(tx_burst_ctl_update(&ctl, 7, &r), 3, "Held packets should count as refused");
+    r.accepted = 0;
+    r.held = 0;
+    for (int i = 0; i < 8; i++) {
+        tx_burst_ctl_update(&ctl, 8, &r);
+    }
+    TEST_ASSERT_EQ(ctl.burst, 1, "Burst should not drop below the minimum");
+    
+    r.accepted = 1000;
+    r.ring_size = 0;
+    for (int i = 0; i < 100; i++) {
+        tx_burst_ctl_update(&ctl, 1000, &r);
+    }
+    TEST_ASSERT_EQ(ctl.burst, 64, "Burst should not grow past the maximum");
+    TEST_ASSERT_EQ(tx_burst_ctl_update(&ctl, 0, &r), 64, "An empty offer should change nothing");
+    TEST_ASSERT_EQ(tx_burst_ctl_update(&ctl, 8, NULL), 64, "A missing result should change nothing");
+    TEST_ASSERT_EQ(tx_burst_ctl_update(NULL, 8, &r), 0, "NULL controller should be rejected");
+    
+    tx_burst_ctl_init(&ctl, 200, 0, 0);
+    TEST_ASSERT(ctl.min_burst == 1 && ctl.max_burst == 200, "Zero limits should default to 1 and the start");
+    tx_burst_ctl_init(&ctl, 2, 8, 4);
+    TEST_ASSERT(ctl.burst == 8 && ctl.max_burst == 8, "Start and maximum should respect the minimum");
+}
+
 /* Test sendmmsg batch functions */
 void test_sendmmsg_batch(void) {
     /* Create a UDP socket for testing */
@@ -206,6 +875,1514 @@ void test_sendmmsg_batch(void) {
     close(sockfd);
 }
 
+/* Test persistent sendmmsg context and UDP GSO */
+void test_sendmmsg_context(void) {
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rx < 0 || tx < 0) {
+        TEST_ASSERT(0, "Failed to create UDP sockets for testing");
+        return;
+    }
+    
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl_test(0x7F000001);
+    addr.sin_port = 0;
+    TEST_ASSERT_EQ(bind(rx, (struct sockaddr*)&addr, sizeof(addr)), 0, "Receiver should bind to loopback");
+    getsockname(rx, (struct sockaddr*)&addr, &addr_len);
+    uint16_t port = htons_test(addr.sin_port);
+    
+    TEST_ASSERT_NULL(sendmmsg_ctx_create(-1, 16), "Invalid socket should fail");
+    sendmmsg_ctx_t* ctx = sendmmsg_ctx_create(tx, 4);
+    TEST_ASSERT_NOT_NULL(ctx, "sendmmsg context should be created");
+    if (!ctx) {
+        close(rx);
+        close(tx);
+        return;
+    }
+    
+    /* More packets than max_batch exercises chunking */
+    enum { N = 10, LEN = 100 };
+    static uint8_t payload[N][LEN];
+    const uint8_t* packets[N];
+    uint32_t lengths[N];
+    for (int i = 0; i < N; i++) {
+        memset(payload[i], 'a' + i, LEN);
+        packets[i] = payload[i];
+        lengths[i] = LEN;
+    }
+    
+    int sent = sendmmsg_ctx_send_same_dest(ctx, packets, lengths, addr.sin_addr.s_addr, port, N);
+    TEST_ASSERT_EQ(sent, N, "Context should send every packet across chunks");
+    
+    int gso = sendmmsg_ctx_set_gso(ctx, 1);
+    TEST_ASSERT(gso == 0 || gso == -1, "GSO enable returned valid result");
+    sent = sendmmsg_ctx_send_same_dest(ctx, packets, lengths, addr.sin_addr.s_addr, port, N);
+    TEST_ASSERT_EQ(sent, N, "GSO send should report one count per datagram");
+    
+    /* Both rounds must arrive as individual, intact datagrams */
+    uint8_t buf[2048];
+    int received = 0;
+    int intact = 1;
+    for (int i = 0; i < 2 * N; i++) {
+        ssize_t n = recv(rx, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n < 0) {
+            break;
+        }
+        if (n != LEN || buf[0] != 'a' + (i % N) || buf[LEN - 1] != 'a' + (i % N)) {
+            intact = 0;
+        }
+        received++;
+    }
+    TEST_ASSERT_EQ(received, 2 * N, "Receiver should get every datagram");
+    TEST_ASSERT(intact, "Datagrams should be split at packet boundaries and in order");
+    
+    TEST_ASSERT_EQ(sendmmsg_ctx_set_gso(ctx, 0), 0, "GSO disable should succeed");
+    
+    /* 20 kpps in pairs: 10 packets span at least 4 slots of 100us */
+    int paced = sendmmsg_ctx_set_pacing(ctx, 20000, 0, 2);
+    TEST_ASSERT(paced == 0 || paced == 1, "Pacing enable returned valid result");
+    uint64_t t0 = get_timestamp_ns();
+    sent = sendmmsg_ctx_send_same_dest(ctx, packets, lengths, addr.sin_addr.s_addr, port, N);
+    uint64_t elapsed = get_timestamp_ns() - t0;
+    TEST_ASSERT_EQ(sent, N, "Paced send should send every packet");
+    TEST_ASSERT(elapsed >= 350000ULL, "Paced send should be spread over several slots");
+    for (received = 0; received < N; received++) {
+        if (recv(rx, buf, sizeof(buf), MSG_DONTWAIT) < 0) {
+            break;
+        }
+    }
+    TEST_ASSERT_EQ(received, N, "Receiver should get every paced datagram");
+    TEST_ASSERT_EQ(sendmmsg_ctx_set_pacing(ctx, 0, 0, 0), 0, "Pacing disable should succeed");
+    sendmmsg_ctx_destroy(ctx);
+    close(rx);
+    close(tx);
+}
+
+/* Test contiguous SoA packet batches */
+void test_pkt_batch(void) {
+    TEST_ASSERT_NULL(pkt_batch_create(0, 1024, 0, -1), "Zero capacity should fail");
+    pkt_batch_t* batch = pkt_batch_create(8, 1024, 1, -1);
+    TEST_ASSERT_NOT_NULL(batch, "Batch should be created");
+    if (!batch) {
+        return;
+    }
+    TEST_ASSERT((uintptr_t)batch->arena % PKT_BATCH_ALIGN == 0, "Arena should be cache-aligned");
+    TEST_ASSERT((uintptr_t)batch->lengths % PKT_BATCH_ALIGN == 0, "Length array should be cache-aligned");
+    TEST_ASSERT_NOT_NULL(batch->dst_ips, "Per-packet destinations should be allocated");
+    
+    uint8_t a[10], b[100], c[20];
+    memset(a, 'a', sizeof(a));
+    memset(b, 'b', sizeof(b));
+    memset(c, 'c', sizeof(c));
+    
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl_test(0x7F000001);
+    TEST_ASSERT_EQ(bind(rx, (struct sockaddr*)&addr, sizeof(addr)), 0, "Receiver should bind to loopback");
+    getsockname(rx, (struct sockaddr*)&addr, &addr_len);
+    uint16_t port = htons_test(addr.sin_port);
+    
+    TEST_ASSERT_EQ(pkt_batch_append(batch, a, sizeof(a), addr.sin_addr.s_addr, port), 0, "First append");
+    TEST_ASSERT_EQ(pkt_batch_append(batch, b, sizeof(b), addr.sin_addr.s_addr, port), 1, "Second append");
+    TEST_ASSERT_EQ(pkt_batch_append(batch, c, sizeof(c), addr.sin_addr.s_addr, port), 2, "Third append");
+    TEST_ASSERT(batch->offsets[1] == 64 && batch->offsets[2] == 192, "Packets should start on cache lines");
+    TEST_ASSERT_NULL(pkt_batch_reserve(batch, 2048, 0, 0), "Oversized packet should not fit");
+    TEST_ASSERT_EQ(batch->count, 3, "Failed reserve should not add a packet");
+    
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    sendmmsg_ctx_t* ctx = sendmmsg_ctx_create(tx, 2);
+    TEST_ASSERT_EQ(sendmmsg_ctx_send_pkt_batch(ctx, batch, 0), 3, "Batch should be sent across chunks");
+    TEST_ASSERT_EQ(sendmmsg_ctx_send_pkt_batch(ctx, batch, 2), 1, "Send should resume from first");
+    TEST_ASSERT(sendmmsg_ctx_send_pkt_batch(ctx, batch, 4) < 0, "First past count should fail");
+    
+    uint8_t buf[256];
+    ssize_t lens[4] = {-1, -1, -1, -1};
+    uint8_t heads[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+        lens[i] = recv(rx, buf, sizeof(buf), MSG_DONTWAIT);
+        heads[i] = buf[0];
+    }
+    TEST_ASSERT(lens[0] == 10 && lens[1] == 100 && lens[2] == 20 && lens[3] == 20,
+                "Datagrams should keep their lengths");
+    TEST_ASSERT(heads[0] == 'a' && heads[1] == 'b' && heads[2] == 'c' && heads[3] == 'c',
+                "Datagrams should carry their packet bytes");
+    
+    /* Batch without destinations goes to the backend instance's */
+    pkt_batch_t* plain = pkt_batch_create(4, 256, 0, -1);
+    uint8_t* slot = pkt_batch_reserve(plain, 30, 0, 0);
+    TEST_ASSERT_NOT_NULL(slot, "Reserve should return arena space");
+    if (slot) {
+        memset(slot, 'z', 30);
+    }
+    netstress_backend_config_t config;
+    netstress_backend_config_init(&config, NULL);
+    config.dst_ip = addr.sin_addr.s_addr;
+    config.dst_port = port;
+    netstress_backend_t* backend = netstress_backend_open(BACKEND_SENDMMSG, &config);
+    TEST_ASSERT_EQ(netstress_backend_send_pkt_batch(backend, plain, 0), 1, "Instance should send the batch");
+    TEST_ASSERT(recv(rx, buf, sizeof(buf), MSG_DONTWAIT) == 30 && buf[0] == 'z', "Instance destination should apply");
+    driver_stats_t stats;
+    netstress_backend_get_stats(backend, &stats);
+    TEST_ASSERT(stats.packets_sent == 1 && stats.bytes_sent == 30, "Batch sends should be counted");
+    
+    pkt_batch_reset(batch);
+    TEST_ASSERT(batch->count == 0 && batch->arena_used == 0, "Reset should empty the batch");
+    
+    netstress_backend_close(backend);
+    sendmmsg_ctx_destroy(ctx);
+    close(tx);
+    close(rx);
+    pkt_batch_destroy(plain);
+    pkt_batch_destroy(batch);
+    pkt_batch_destroy(NULL);
+}
+
+/* Test huge-page regions and their fallback */
+void test_mem_region(void) {
+    mem_region_t region;
+    TEST_ASSERT_EQ(mem_region_alloc(&region, 0, NULL), -1, "Zero size should fail");
+    TEST_ASSERT_EQ(mem_region_alloc(NULL, 4096, NULL), -1, "NULL region should fail");
+    mem_region_free(NULL);
+    
+#ifndef _WIN32
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    mem_region_config_t config;
+    mem_region_config_init(&config);
+    config.prefault = 1;
+    config.lock = 1;
+    TEST_ASSERT_EQ(mem_region_alloc(&region, page * 3 + 1, &config), 0, "Locked region should map");
+    TEST_ASSERT(region.size == page * 4 && region.pages == MEM_PAGES_DEFAULT, "Size should round up to pages");
+#ifdef __linux__
+    unsigned char resident[4] = {0, 0, 0, 0};
+    mincore(region.addr, region.size, resident);
+    TEST_ASSERT((resident[0] & resident[1] & resident[2] & resident[3] & 1) == 1,
+                "Every page should be faulted in");
+#endif
+    memset(region.addr, 0x5A, region.size);
+    mem_region_free(&region);
+    TEST_ASSERT(region.addr == NULL && region.size == 0, "Free should clear the region");
+    
+    /* Huge pages when the host has them, base pages otherwise */
+    config.pages = MEM_PAGES_2M;
+    config.lock = 0;
+    TEST_ASSERT_EQ(mem_region_alloc(&region, 100000, &config), 0, "Huge request should fall back");
+    size_t expected = region.pages == MEM_PAGES_2M ? (size_t)2 << 20 : (100000 + page - 1) / page * page;
+    TEST_ASSERT_EQ(region.size, expected, "Size should match the page size obtained");
+    mem_region_free(&region);
+    config.require_huge = 1;
+    if (mem_region_alloc(&region, 1, &config) == 0) {
+        TEST_ASSERT(region.pages == MEM_PAGES_2M && region.size == (size_t)2 << 20,
+                    "Required huge pages should not fall back");
+        mem_region_free(&region);
+    }
+    config.hugetlbfs_dir = "/tmp";
+    TEST_ASSERT_EQ(mem_region_alloc(&region, 1, &config), -1, "A directory that is not hugetlbfs should fail");
+    config.require_huge = 0;
+    TEST_ASSERT_EQ(mem_region_alloc(&region, 1, &config), 0, "...unless base pages are acceptable");
+    mem_region_free(&region);
+    
+    /* Batches on a configured region keep their layout */
+    config.hugetlbfs_dir = NULL;
+    config.lock = 1;
+    pkt_batch_t* batch = pkt_batch_create_in(64, 1 << 16, 1, &config);
+    TEST_ASSERT_NOT_NULL(batch, "Batch should be created on the region");
+    if (batch) {
+        TEST_ASSERT((uintptr_t)batch->arena % PKT_BATCH_ALIGN == 0 && batch->dst_ports != NULL,
+                    "Arena and destinations should be laid out");
+        uint8_t data[1500];
+        memset(data, 0x11, sizeof(data));
+        int appended = 0;
+        while (pkt_batch_append(batch, data, sizeof(data), 0, 0) >= 0) {
+            appended++;
+        }
+        TEST_ASSERT_EQ(appended, 42, "Arena should hold as many 1536-byte slots as requested");
+        pkt_batch_destroy(batch);
+    }
+#endif
+}
+
+/* Check every generated packet against the field program and both checksums */
+static int tmpl_test_verify(const pkt_batch_t* batch, uint32_t first_index) {
+    static const uint16_t ports[3] = {9000, 9001, 9002};
+    for (uint32_t i = 0; i < batch->count; i++) {
+        const uint8_t* p = batch->arena + batch->offsets[i];
+        uint32_t n = first_index + i;
+        uint32_t src = ((uint32_t)p[26] << 24) | ((uint32_t)p[27] << 16) | ((uint32_t)p[28] << 8) | p[29];
+        uint16_t id = (uint16_t)((p[18] << 8) | p[19]);
+        uint16_t sport = (uint16_t)((p[34] << 8) | p[35]);
+        uint16_t dport = (uint16_t)((p[36] << 8) | p[37]);
+        uint16_t odd = (uint16_t)((p[43] << 8) | p[44]);
+        if (batch->lengths[i] != 64 || src != 0x0A000001 + n || id != (uint16_t)(0xFFFE + n) ||
+            sport != 1000 + (n * 3) % 4 || dport != ports[n % 3] || odd != (uint16_t)(n * 257)) {
+            return -1;
+        }
+        if (calculate_checksum(p + 14, 20) != 0 ||
+            calculate_transport_checksum(src, 0xC0A80114, 17, p + 34, 30) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void test_pkt_template(void) {
+    /* 64-byte Ethernet/IPv4/UDP frame with valid checksums */
+    uint8_t frame[64];
+    memset(frame, 0, sizeof(frame));
+    frame[12] = 0x08;
+    uint8_t* ip = frame + 14;
+    ip[0] = 0x45;
+    ip[3] = 50;
+    ip[8] = 64;
+    ip[9] = 17;
+    ip[12] = 10; ip[15] = 1;
+    ip[16] = 192; ip[17] = 168; ip[18] = 1; ip[19] = 20;
+    uint16_t csum = calculate_checksum(ip, 20);
+    ip[10] = (uint8_t)(csum >> 8);
+    ip[11] = (uint8_t)csum;
+    uint8_t* udp = ip + 20;
+    udp[0] = 0x03; udp[1] = 0xE8;
+    udp[2] = 0x23; udp[3] = 0x28;
+    udp[5] = 30;
+    memset(udp + 8, 'x', 22);
+    csum = calculate_transport_checksum(0x0A000001, 0xC0A80114, 17, udp, 30);
+    udp[6] = (uint8_t)(csum >> 8);
+    udp[7] = (uint8_t)csum;
+    
+    /* Source address counter under both checksums, a wrapping IP ID, a
+     * source port range, a destination port list and an odd-offset payload word */
+    static const uint32_t ports[3] = {9000, 9001, 9002};
+    pkt_field_t fields[5];
+    pkt_field_init(&fields[0], PKT_FIELD_COUNTER, 26, 4);
+    fields[0].start = 0x0A000001;
+    fields[0].csum_offsets[0] = 24;
+    fields[0].csum_offsets[1] = 40;
+    pkt_field_init(&fields[1], PKT_FIELD_COUNTER, 18, 2);
+    fields[1].start = 0xFFFE;
+    fields[1].csum_offsets[0] = 24;
+    pkt_field_init(&fields[2], PKT_FIELD_RANGE, 34, 2);
+    fields[2].start = 1000;
+    fields[2].max = 1003;
+    fields[2].step = 3;
+    fields[2].csum_offsets[0] = 40;
+    pkt_field_init(&fields[3], PKT_FIELD_LIST, 36, 2);
+    fields[3].values = ports;
+    fields[3].count = 3;
+    fields[3].csum_offsets[0] = 40;
+    pkt_field_init(&fields[4], PKT_FIELD_COUNTER, 43, 2);
+    fields[4].step = 257;
+    fields[4].csum_offsets[0] = 40;
+    
+    TEST_ASSERT_NULL(pkt_template_create(NULL, 64, fields, 5), "NULL packet should fail");
+    pkt_field_t bad = fields[2];
+    bad.offset = 35;
+    pkt_field_t overlap[2] = {fields[3], bad};
+    TEST_ASSERT_NULL(pkt_template_create(frame, 64, overlap, 2), "Overlapping fields should fail");
+    bad = fields[3];
+    bad.csum_offsets[0] = 36;
+    TEST_ASSERT_NULL(pkt_template_create(frame, 64, &bad, 1), "Field over its checksum should fail");
+    bad = fields[2];
+    bad.max = 999;
+    TEST_ASSERT_NULL(pkt_template_create(frame, 64, &bad, 1), "Empty range should fail");
+    bad = fields[0];
+    bad.size = 3;
+    TEST_ASSERT_NULL(pkt_template_create(frame, 64, &bad, 1), "Three-byte field should fail");
+    bad = fields[0];
+    bad.offset = 62;
+    TEST_ASSERT_NULL(pkt_template_create(frame, 64, &bad, 1), "Field past the end should fail");
+    
+    pkt_template_t* tmpl = pkt_template_create(frame, 64, fields, 5);
+    pkt_batch_t* batch = pkt_batch_create(256, 256 * 64, 0, -1);
+    TEST_ASSERT_NOT_NULL(tmpl, "Template should be created");
+    TEST_ASSERT_NOT_NULL(batch, "Batch should be created");
+    if (!tmpl || !batch) {
+        pkt_template_destroy(tmpl);
+        pkt_batch_destroy(batch);
+        return;
+    }
+    TEST_ASSERT_EQ(pkt_template_len(tmpl), 64, "Length should be the template's");
+    
+    /* 200 packets span several chunks and both kernels agree */
+    TEST_ASSERT_EQ(pkt_template_fill_batch(tmpl, batch, 200), 200, "Batch should take 200 packets");
+    TEST_ASSERT_EQ(tmpl_test_verify(batch, 0), 0, "Fields and checksums should match the program");
+    TEST_ASSERT_EQ(pkt_template_tell(tmpl), 200, "Position should advance");
+    
+    uint8_t* simd = (uint8_t*)malloc(200 * 64);
+    if (simd) {
+        for (uint32_t i = 0; i < 200; i++) {
+            memcpy(simd + i * 64, batch->arena + batch->offsets[i], 64);
+        }
+        checksum_impl_t impl = checksum_get_impl();
+        TEST_ASSERT_EQ(checksum_set_impl(CHECKSUM_IMPL_PORTABLE), 0, "Portable kernel should be selectable");
+        pkt_batch_reset(batch);
+        pkt_template_seek(tmpl, 0);
+        pkt_template_fill_batch(tmpl, batch, 200);
+        int same = 1;
+        for (uint32_t i = 0; i < 200; i++) {
+            same &= memcmp(simd + i * 64, batch->arena + batch->offsets[i], 64) == 0;
+        }
+        TEST_ASSERT(same, "Portable and SIMD kernels should generate the same packets");
+        checksum_set_impl(impl);
+        free(simd);
+    }
+    
+    /* Seeking lands mid-program; a full batch stops generation */
+    pkt_batch_reset(batch);
+    pkt_template_seek(tmpl, 1000);
+    TEST_ASSERT_EQ(pkt_template_fill_batch(tmpl, batch, 300), 256, "Full batch should stop generation");
+    TEST_ASSERT_EQ(tmpl_test_verify(batch, 1000), 0, "Seeked packets should continue the program");
+    TEST_ASSERT_EQ(pkt_template_tell(tmpl), 1256, "Only appended packets should count");
+    
+    /* Caller buffers */
+    uint8_t out[3][64];
+    uint8_t* bufs[3] = {out[0], out[1], out[2]};
+    pkt_template_seek(tmpl, 0);
+    TEST_ASSERT_EQ(pkt_template_fill(tmpl, bufs, 3), 3, "Fill should generate into buffers");
+    TEST_ASSERT(out[2][37] == (9002 & 0xFF) && out[2][29] == 3, "Third packet should take the third values");
+    TEST_ASSERT_EQ(pkt_template_fill(NULL, bufs, 3), -1, "NULL template should fail");
+    
+    pkt_template_destroy(tmpl);
+    pkt_batch_destroy(batch);
+}
+
+/* Test the safety envelope: allowlist, ceiling and kill switch */
+void test_safety_envelope(void) {
+    safety_envelope_t* env = safety_envelope_create();
+    TEST_ASSERT_NOT_NULL(env, "Envelope should be created");
+    if (!env) {
+        return;
+    }
+    uint32_t lab = htonl_test(0x0A010203);      /* 10.1.2.3 */
+    uint32_t other = htonl_test(0xC0A80101);    /* 192.168.1.1 */
+    TEST_ASSERT_EQ(safety_envelope_permits(env, lab), 0, "Empty allowlist should deny");
+    
+    TEST_ASSERT(safety_envelope_allow_cidr(env, "10.1.0.0/33") < 0, "Prefix over 32 should fail");
+    TEST_ASSERT(safety_envelope_allow_cidr(env, "10.1.0.0/") < 0, "Missing length should fail");
+    TEST_ASSERT(safety_envelope_allow_cidr(env, "10.1.0.256") < 0, "Bad octet should fail");
+    TEST_ASSERT(safety_envelope_allow_cidr(env, "10.1.0.0/16x") < 0, "Trailing text should fail");
+    TEST_ASSERT_EQ(safety_envelope_allow_cidr(env, "10.1.2.0/23"), 0, "Prefix should be accepted");
+    TEST_ASSERT_EQ(safety_envelope_allow_cidr(env, "172.16.5.9"), 0, "Bare address should be accepted");
+    TEST_ASSERT(safety_envelope_permits(env, lab) && safety_envelope_permits(env, htonl_test(0x0A0103FF)),
+                "Both halves of the /23 should be allowed");
+    TEST_ASSERT(!safety_envelope_permits(env, htonl_test(0x0A010400)), "Next /23 should be denied");
+    TEST_ASSERT(safety_envelope_permits(env, htonl_test(0xAC100509)) &&
+                !safety_envelope_permits(env, htonl_test(0xAC10050A)), "Host route should match exactly");
+    TEST_ASSERT(!safety_envelope_permits(env, other), "Unlisted address should be denied");
+    
+    /* A shorter prefix covers what was under it */
+    TEST_ASSERT_EQ(safety_envelope_allow(env, htonl_test(0x0A000000), 8), 0, "Covering /8 should be accepted");
+    TEST_ASSERT(safety_envelope_permits(env, htonl_test(0x0AFE0001)), "Covering prefix should allow its range");
+    
+    /* Batches admit up to the first denied destination */
+    uint32_t len = 100;
+    uint32_t same[4] = {lab, lab, lab, lab};
+    uint32_t spread[4] = {lab, htonl_test(0x0A010204), htonl_test(0x0A7F0001), htonl_test(0x0A000001)};
+    uint32_t mixed[4] = {lab, lab, other, lab};
+    uint32_t denied[2] = {other, lab};
+    TEST_ASSERT_EQ(safety_admit(BACKEND_SENDMMSG, same, 4, &len, 1, 4), 4, "Uninstalled backend should admit all");
+    TEST_ASSERT_EQ(safety_install(BACKEND_SENDMMSG, env), 0, "Envelope should install");
+    TEST_ASSERT(safety_install(BACKEND_NONE, env) < 0, "BACKEND_NONE cannot hold an envelope");
+    TEST_ASSERT_EQ(safety_admit(BACKEND_SENDMMSG, same, 4, &len, 1, 4), 4, "Single target should be admitted");
+    TEST_ASSERT_EQ(safety_admit(BACKEND_SENDMMSG, spread, 4, &len, 1, 4), 4, "Targets inside the /8 should be admitted");
+    TEST_ASSERT_EQ(safety_admit(BACKEND_SENDMMSG, mixed, 4, &len, 1, 4), 2, "Admission should stop at a denied target");
+    errno = 0;
+    TEST_ASSERT(safety_admit(BACKEND_SENDMMSG, denied, 2, &len, 1, 2) < 0 && errno == EACCES,
+                "Denied first target should fail with EACCES");
+    TEST_ASSERT_EQ(safety_admit(BACKEND_SENDMMSG, &lab, 1, &len, 1, 0), 0, "Empty batch should admit nothing");
+    
+    /* Sends through the shim are checked the same way */
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl_test(0x7F000001);
+    bind(rx, (struct sockaddr*)&addr, sizeof(addr));
+    getsockname(rx, (struct sockaddr*)&addr, &addr_len);
+    uint16_t port = htons_test(addr.sin_port);
+    
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    uint8_t payload[32];
+    memset(payload, 'p', sizeof(payload));
+    const uint8_t* packets[2] = {payload, payload};
+    uint32_t lengths[2] = {sizeof(payload), sizeof(payload)};
+    errno = 0;
+    TEST_ASSERT(sendmmsg_batch_same_dest(tx, packets, lengths, addr.sin_addr.s_addr, port, 2) < 0 &&
+                errno == EACCES, "Loopback should be outside the allowlist");
+    
+    TEST_ASSERT_EQ(safety_envelope_allow_cidr(env, "127.0.0.0/8"), 0, "Loopback should be added");
+    TEST_ASSERT_EQ(sendmmsg_batch_same_dest(tx, packets, lengths, addr.sin_addr.s_addr, port, 2), 2,
+                   "Allowed target should be sent");
+    
+    safety_kill();
+    TEST_ASSERT(safety_is_killed(), "Kill switch should be set");
+    errno = 0;
+    TEST_ASSERT(sendmmsg_batch_same_dest(tx, packets, lengths, addr.sin_addr.s_addr, port, 2) < 0 &&
+                errno == ECANCELED, "Killed sends should fail with ECANCELED");
+    TEST_ASSERT(safety_admit(BACKEND_DPDK, &lab, 1, &len, 1, 1) < 0, "Kill switch should cover every backend");
+    safety_rearm();
+    TEST_ASSERT(!safety_is_killed(), "Rearm should clear the kill switch");
+    TEST_ASSERT_EQ(sendmmsg_batch_same_dest(tx, packets, lengths, addr.sin_addr.s_addr, port, 1), 1,
+                   "Sends should resume after rearm");
+    
+    /* Raw sockets with IP_HDRINCL are judged by the header's destination */
+    int raw = raw_socket_create(IPPROTO_RAW);
+    safety_envelope_t* lo_only = safety_envelope_create();
+    if (raw >= 0 && lo_only) {
+        safety_envelope_allow_cidr(lo_only, "127.0.0.0/8");
+        uint8_t hdr[28];
+        memset(hdr, 0, sizeof(hdr));
+        hdr[0] = 0x45;
+        hdr[3] = sizeof(hdr);
+        hdr[8] = 64;
+        hdr[9] = 17;
+        memcpy(hdr + 16, &other, 4);
+        safety_install(BACKEND_RAW_SOCKET, lo_only);
+        raw_socket_set_hdrincl(raw);
+        errno = 0;
+        TEST_ASSERT(raw_socket_send(raw, addr.sin_addr.s_addr, hdr, sizeof(hdr)) < 0 && errno == EACCES,
+                    "Header destination outside the allowlist should be refused");
+        safety_install(BACKEND_RAW_SOCKET, NULL);
+    }
+    if (raw >= 0) {
+        raw_socket_close(raw);
+    }
+    safety_envelope_destroy(lo_only);
+    
+    /* 100k pps allows a 1 ms burst of 100 packets, then holds back */
+    TEST_ASSERT(safety_envelope_set_ceiling(env, 0, 1000) < 0, "Ceiling below 8 kbit/s should fail");
+    TEST_ASSERT_EQ(safety_envelope_set_ceiling(env, 100000, 0), 0, "pps ceiling should be set");
+    uint64_t start = get_timestamp_ns();
+    int burst = safety_admit(BACKEND_SENDMMSG, &lab, 1, &len, 1, 1000);
+    int after = safety_admit(BACKEND_SENDMMSG, &lab, 1, &len, 1, 1000);
+    uint64_t slack = (get_timestamp_ns() - start) / 10000 + 1;
+    TEST_ASSERT(burst >= 100 && (uint64_t)burst <= 100 + slack, "Burst should be capped at the tolerance");
+    TEST_ASSERT((uint64_t)after <= slack, "Ceiling should hold back the rest");
+    
+    /* 8 Mbit/s is 1000 bytes per ms: ten 100-byte packets */
+    TEST_ASSERT_EQ(safety_envelope_set_ceiling(env, 0, 8000000), 0, "bps ceiling should be set");
+    usleep(2000);
+    int bytes_burst = safety_admit(BACKEND_SENDMMSG, &lab, 1, &len, 1, 100);
+    TEST_ASSERT(bytes_burst >= 10 && bytes_burst <= 12, "Byte ceiling should cap the burst");
+    
+    safety_stats_t stats;
+    TEST_ASSERT_EQ(safety_envelope_get_stats(env, &stats), 0, "Stats should be readable");
+    TEST_ASSERT(stats.denied == 2 && stats.throttled >= 2 && stats.admitted >= 12 + 100 + 10,
+                "Admission should be counted");
+    
+    TEST_ASSERT_EQ(safety_install(BACKEND_SENDMMSG, NULL), 0, "Envelope should uninstall");
+    TEST_ASSERT_EQ(safety_admit(BACKEND_SENDMMSG, denied, 2, &len, 1, 2), 2, "Uninstalled backend should admit all");
+    
+    close(tx);
+    close(rx);
+    safety_envelope_destroy(env);
+    safety_envelope_destroy(NULL);
+}
+
+/* Capture test packets: Ethernet/IPv4/UDP from 192.168.1.1 to 192.168.7.20 */
+#define REPLAY_TEST_PACKETS 8
+
+static uint32_t replay_test_frame(uint8_t* f, int i, uint16_t dst_port) {
+    uint32_t payload = 10 + (uint32_t)i;
+    memset(f, 0, 64);
+    memset(f, 0xAA, 12);
+    f[12] = 0x08;
+    uint8_t* ip = f + 14;
+    ip[0] = 0x45;
+    ip[3] = (uint8_t)(28 + payload);
+    ip[8] = 64;
+    ip[9] = 17;
+    ip[12] = 192; ip[13] = 168; ip[14] = 1; ip[15] = 1;
+    ip[16] = 192; ip[17] = 168; ip[18] = 7; ip[19] = 20;
+    uint16_t csum = calculate_checksum(ip, 20);
+    ip[10] = (uint8_t)(csum >> 8);
+    ip[11] = (uint8_t)csum;
+    uint8_t* udp = ip + 20;
+    udp[0] = 0x30;
+    udp[1] = (uint8_t)(i * 7);
+    udp[2] = (uint8_t)(dst_port >> 8);
+    udp[3] = (uint8_t)dst_port;
+    udp[5] = (uint8_t)(8 + payload);
+    memset(udp + 8, 'a' + i, payload);
+    csum = calculate_transport_checksum(0xC0A80101, 0xC0A80714, 17, udp, 8 + payload);
+    udp[6] = (uint8_t)(csum >> 8);
+    udp[7] = (uint8_t)csum;
+    uint32_t len = 42 + payload;
+    return len < 60 ? 60 : len;  /* Ethernet minimum, padded */
+}
+
+static void replay_put32(FILE* f, uint32_t v) {
+    fwrite(&v, 4, 1, f);
+}
+
+/* Classic pcap: the test frames 2 ms apart, an ARP frame and a truncated record */
+static int replay_write_pcap(const char* path, uint16_t dst_port) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    uint8_t frame[64];
+    replay_put32(f, 0xA1B2C3D4);
+    replay_put32(f, 0x00040002);
+    replay_put32(f, 0);
+    replay_put32(f, 0);
+    replay_put32(f, 65535);
+    replay_put32(f, 1);
+    for (int i = 0; i < REPLAY_TEST_PACKETS; i++) {
+        uint32_t len = replay_test_frame(frame, i, dst_port);
+        replay_put32(f, 100);
+        replay_put32(f, (uint32_t)i * 2000);
+        replay_put32(f, len);
+        replay_put32(f, len);
+        fwrite(frame, 1, len, f);
+    }
+    memset(frame, 0, 60);
+    frame[12] = 0x08;
+    frame[13] = 0x06;
+    replay_put32(f, 100);
+    replay_put32(f, 15000);
+    replay_put32(f, 60);
+    replay_put32(f, 60);
+    fwrite(frame, 1, 60, f);
+    replay_test_frame(frame, 0, dst_port);
+    replay_put32(f, 100);
+    replay_put32(f, 16000);
+    replay_put32(f, 40);
+    replay_put32(f, 60);
+    fwrite(frame, 1, 40, f);
+    fclose(f);
+    return 0;
+}
+
+/* pcapng with nanosecond timestamps: the same test frames 1 ms apart */
+static int replay_write_pcapng(const char* path, uint16_t dst_port) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    uint8_t frame[64];
+    replay_put32(f, 0x0A0D0D0A);
+    replay_put32(f, 28);
+    replay_put32(f, 0x1A2B3C4D);
+    replay_put32(f, 0x00000001);
+    replay_put32(f, 0xFFFFFFFF);
+    replay_put32(f, 0xFFFFFFFF);
+    replay_put32(f, 28);
+    /* IDB with if_tsresol = 9 */
+    replay_put32(f, 1);
+    replay_put32(f, 32);
+    replay_put32(f, 1);
+    replay_put32(f, 65535);
+    replay_put32(f, 0x00010009);
+    replay_put32(f, 9);
+    replay_put32(f, 0);
+    replay_put32(f, 32);
+    for (int i = 0; i < REPLAY_TEST_PACKETS; i++) {
+        uint32_t len = replay_test_frame(frame, i, dst_port);
+        uint32_t padded = (len + 3) & ~3u;
+        uint64_t ts = 5000000000ULL + (uint64_t)i * 1000000ULL;
+        replay_put32(f, 6);
+        replay_put32(f, 32 + padded);
+        replay_put32(f, 0);
+        replay_put32(f, (uint32_t)(ts >> 32));
+        replay_put32(f, (uint32_t)ts);
+        replay_put32(f, len);
+        replay_put32(f, len);
+        memset(frame + len, 0, padded - len);
+        fwrite(frame, 1, padded, f);
+        replay_put32(f, 32 + padded);
+    }
+    fclose(f);
+    return 0;
+}
+
+static int replay_drain(pcap_cursor_t* cursor) {
+    pcap_view_t view;
+    int total = 0;
+    int n;
+    while ((n = pcap_cursor_next(cursor, &view)) > 0) {
+        total += n;
+    }
+    return n < 0 ? n : total;
+}
+
+/* Test pcap/pcapng replay */
+void test_pcap_replay(void) {
+    pcap_replay_config_t config;
+    pcap_replay_config_init(&config);
+    TEST_ASSERT_NULL(pcap_replay_open("/nonexistent/capture.pcap"), "Missing file should fail");
+#ifndef _WIN32
+    char path[64], ng_path[64];
+    snprintf(path, sizeof(path), "/tmp/netstress-replay-test-%d.pcap", (int)getpid());
+    snprintf(ng_path, sizeof(ng_path), "/tmp/netstress-replay-test-%d.pcapng", (int)getpid());
+    
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl_test(0x7F000001);
+    bind(rx, (struct sockaddr*)&addr, sizeof(addr));
+    getsockname(rx, (struct sockaddr*)&addr, &addr_len);
+    uint16_t port = htons_test(addr.sin_port);
+    
+    TEST_ASSERT_EQ(replay_write_pcap(path, port), 0, "Capture should be written");
+    TEST_ASSERT_EQ(replay_write_pcapng(ng_path, port), 0, "pcapng capture should be written");
+    pcap_replay_t* replay = pcap_replay_open(path);
+    pcap_replay_t* ng = pcap_replay_open(ng_path);
+    TEST_ASSERT_NOT_NULL(replay, "pcap should open");
+    TEST_ASSERT_NOT_NULL(ng, "pcapng should open");
+    if (!replay || !ng) {
+        pcap_replay_close(replay);
+        pcap_replay_close(ng);
+        close(rx);
+        return;
+    }
+    
+    pcap_replay_info_t info;
+    TEST_ASSERT_EQ(pcap_replay_get_info(replay, &info), 0, "Info should be readable");
+    TEST_ASSERT(info.format == PCAP_FORMAT_PCAP && info.packets == REPLAY_TEST_PACKETS + 2,
+                "Every record should be counted");
+    TEST_ASSERT(info.first_ns == 100000000000ULL && info.last_ns == 100016000000ULL,
+                "Microsecond timestamps should be converted");
+    TEST_ASSERT_EQ(pcap_replay_get_info(ng, &info), 0, "pcapng info should be readable");
+    TEST_ASSERT(info.format == PCAP_FORMAT_PCAPNG && info.packets == REPLAY_TEST_PACKETS &&
+                info.first_ns == 5000000000ULL && info.last_ns == 5007000000ULL,
+                "pcapng records and if_tsresol should be honoured");
+    
+    /* L2 keeps ARP; L3 trims padding and drops non-IPv4; truncated records never go out */
+    config.batch_size = 4;
+    pcap_cursor_t* cursor = pcap_cursor_create(replay, &config);
+    TEST_ASSERT_EQ(replay_drain(cursor), REPLAY_TEST_PACKETS + 1, "L2 should replay every whole frame");
+    pcap_cursor_stats_t stats;
+    pcap_cursor_get_stats(cursor, &stats);
+    TEST_ASSERT(stats.skipped == 1 && stats.passes == 1, "Truncated record should be skipped");
+    pcap_cursor_destroy(cursor);
+    
+    config.layer = BACKEND_LAYER_L3;
+    cursor = pcap_cursor_create(replay, &config);
+    pcap_view_t view;
+    TEST_ASSERT_EQ(pcap_cursor_next(cursor, &view), 4, "Batch should fill to batch_size");
+    TEST_ASSERT(view.lengths[0] == 38 && view.packets[0][0] == 0x45 && view.dests == NULL,
+                "L3 packets should start at the IPv4 header without padding");
+    TEST_ASSERT_EQ(replay_drain(cursor), REPLAY_TEST_PACKETS - 4, "L3 should skip the ARP frame");
+    pcap_cursor_destroy(cursor);
+    
+    /* Payload view with rewrite: host bits kept, then advanced per pass */
+    config.layer = BACKEND_LAYER_PAYLOAD;
+    config.loops = 2;
+    config.batch_size = REPLAY_TEST_PACKETS;
+    config.rewrite_ip = htonl_test(0x0A090000);
+    config.rewrite_prefix = 16;
+    cursor = pcap_cursor_create(ng, &config);
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        TEST_ASSERT_EQ(pcap_cursor_next(cursor, &view), REPLAY_TEST_PACKETS, "Pass should be one batch");
+        TEST_ASSERT(view.dests != NULL && view.dests[3].sin_addr.s_addr == htonl_test(0x0A090714 + pass) &&
+                    view.dests[3].sin_port == htons_test(port), "Destination should move into the range");
+        TEST_ASSERT(view.lengths[3] == 13 && view.packets[3][0] == 'd', "Payload should follow the UDP header");
+        
+        const uint8_t* ip = view.packets[3] - 28;
+        TEST_ASSERT_EQ(calculate_checksum(ip, 20), 0, "IPv4 checksum should stay valid");
+        uint8_t udp[64];
+        memcpy(udp, ip + 20, 21);
+        uint16_t stored = (uint16_t)((udp[6] << 8) | udp[7]);
+        udp[6] = udp[7] = 0;
+        TEST_ASSERT_EQ(calculate_transport_checksum(0xC0A80101, 0x0A090714 + pass, 17, udp, 21), stored,
+                       "UDP checksum should follow the rewrite");
+    }
+    TEST_ASSERT_EQ(pcap_cursor_next(cursor, &view), 0, "Cursor should finish after its loops");
+    pcap_cursor_destroy(cursor);
+    
+    /* Two shards split the capture without overlap */
+    config.loops = 1;
+    config.rewrite_prefix = 0;
+    config.shard_count = 2;
+    config.shard_index = 2;
+    TEST_ASSERT_NULL(pcap_cursor_create(ng, &config), "Shard index past the count should fail");
+    int seen[REPLAY_TEST_PACKETS] = {0};
+    int total = 0;
+    for (uint32_t shard = 0; shard < 2; shard++) {
+        config.shard_index = shard;
+        cursor = pcap_cursor_create(ng, &config);
+        int n;
+        while ((n = pcap_cursor_next(cursor, &view)) > 0) {
+            for (int i = 0; i < n; i++) {
+                int id = view.packets[i][0] - 'a';
+                if (id >= 0 && id < REPLAY_TEST_PACKETS) {
+                    seen[id]++;
+                }
+            }
+            total += n;
+        }
+        pcap_cursor_destroy(cursor);
+    }
+    int once = 1;
+    for (int i = 0; i < REPLAY_TEST_PACKETS; i++) {
+        once &= seen[i] == 1;
+    }
+    TEST_ASSERT(total == REPLAY_TEST_PACKETS && once, "Each packet should go to exactly one shard");
+    config.shard_count = 1;
+    config.shard_index = 0;
+    
+    /* Timing: 14 ms of capture at 2x speed, 7 ms of pcapng at original speed */
+    config.mode = REPLAY_SCALED;
+    config.speed = 0.0;
+    TEST_ASSERT_NULL(pcap_cursor_create(replay, &config), "Scaled replay needs a positive speed");
+    config.speed = 2.0;
+    cursor = pcap_cursor_create(replay, &config);
+    uint64_t start = get_timestamp_ns();
+    TEST_ASSERT_EQ(replay_drain(cursor), REPLAY_TEST_PACKETS, "Scaled replay should send everything");
+    uint64_t elapsed = get_timestamp_ns() - start;
+    TEST_ASSERT(elapsed >= 6500000ULL && elapsed < 500000000ULL, "Scaled replay should take half the capture time");
+    pcap_cursor_destroy(cursor);
+    
+    config.mode = REPLAY_ORIGINAL;
+    cursor = pcap_cursor_create(ng, &config);
+    start = get_timestamp_ns();
+    TEST_ASSERT(pcap_cursor_next(cursor, &view) == 1, "First batch should hold only the due packet");
+    TEST_ASSERT_EQ(replay_drain(cursor), REPLAY_TEST_PACKETS - 1, "Original timing should send the rest");
+    elapsed = get_timestamp_ns() - start;
+    TEST_ASSERT(elapsed >= 6500000ULL && elapsed < 500000000ULL, "Original timing should follow the capture");
+    pcap_cursor_destroy(cursor);
+    
+    /* Straight into a backend instance: each payload goes to its record's
+     * rewritten destination, not the instance's */
+    config.mode = REPLAY_MAX_RATE;
+    config.rewrite_ip = htonl_test(0x7F000001);
+    config.rewrite_prefix = 32;
+    int decoy = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in decoy_addr = addr;
+    decoy_addr.sin_port = 0;
+    addr_len = sizeof(decoy_addr);
+    bind(decoy, (struct sockaddr*)&decoy_addr, sizeof(decoy_addr));
+    getsockname(decoy, (struct sockaddr*)&decoy_addr, &addr_len);
+    netstress_backend_config_t bconfig;
+    netstress_backend_config_init(&bconfig, NULL);
+    bconfig.dst_ip = decoy_addr.sin_addr.s_addr;
+    bconfig.dst_port = htons_test(decoy_addr.sin_port);
+    netstress_backend_t* backend = netstress_backend_open(BACKEND_SENDMMSG, &bconfig);
+    cursor = pcap_cursor_create(ng, &config);
+    config.layer = BACKEND_LAYER_L2;
+    pcap_cursor_t* l2 = pcap_cursor_create(ng, &config);
+    TEST_ASSERT(pcap_cursor_send(l2, backend) < 0, "Layer mismatch should fail");
+    TEST_ASSERT_EQ(pcap_cursor_send(cursor, backend), REPLAY_TEST_PACKETS, "Batch should be sent");
+    TEST_ASSERT_EQ(pcap_cursor_send(cursor, backend), 0, "Finished cursor should send nothing");
+    uint8_t buf[256];
+    int received = 0;
+    while (recv(rx, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+        received++;
+    }
+    TEST_ASSERT_EQ(received, REPLAY_TEST_PACKETS, "Replayed payloads should reach the record's destination");
+    TEST_ASSERT(recv(decoy, buf, sizeof(buf), MSG_DONTWAIT) < 0, "Nothing should go to the instance's destination");
+    close(decoy);
+    
+    pcap_cursor_destroy(l2);
+    pcap_cursor_destroy(cursor);
+    pcap_cursor_destroy(NULL);
+    netstress_backend_close(backend);
+    pcap_replay_close(replay);
+    pcap_replay_close(ng);
+    
+    /* Files that are neither format */
+    FILE* f = fopen(path, "wb");
+    if (f) {
+        fwrite("not a capture, just some text", 1, 29, f);
+        fclose(f);
+    }
+    TEST_ASSERT_NULL(pcap_replay_open(path), "Unknown format should fail");
+    unlink(path);
+    unlink(ng_path);
+    close(rx);
+#endif
+}
+
+/* Test the sampled capture tap */
+void test_capture_tap(void) {
+    TEST_ASSERT_NULL(capture_tap_create(NULL, NULL), "NULL path should fail");
+    TEST_ASSERT_EQ(tap_ring_record(NULL, NULL, NULL, 0, TAP_DIR_TX), -1, "NULL ring should fail");
+    TEST_ASSERT_EQ(netstress_backend_set_tap(NULL, NULL, NULL), -1, "NULL instance should fail");
+#ifdef __linux__
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/netstress-tap-test-%d.pcapng", (int)getpid());
+    
+    /* 60-byte IPv4 packets numbered by their IP ID */
+    uint8_t frames[32][60];
+    const uint8_t* packets[32];
+    uint32_t lengths[32];
+    for (int i = 0; i < 32; i++) {
+        uint8_t* ip = frames[i];
+        memset(ip, 0, 60);
+        ip[0] = 0x45;
+        ip[3] = 60;
+        ip[5] = (uint8_t)i;
+        ip[8] = 64;
+        ip[9] = 17;
+        packets[i] = ip;
+        lengths[i] = 60;
+    }
+    
+    /* 1 in 3 into a 4-slot ring; the writer only runs on flush */
+    capture_tap_config_t config;
+    capture_tap_config_init(&config);
+    config.sample_every = 3;
+    config.ring_slots = 3;
+    config.drain_interval_us = 60000000;
+    capture_tap_t* tap = capture_tap_create(path, &config);
+    TEST_ASSERT_NOT_NULL(tap, "Tap should be created");
+    if (!tap) {
+        return;
+    }
+    tap_ring_t* ring = capture_tap_add_ring(tap, BACKEND_LAYER_L3, "q0", -1);
+    TEST_ASSERT_NOT_NULL(ring, "Ring should be added");
+    
+    TEST_ASSERT_EQ(tap_ring_record(ring, packets, lengths, 10, TAP_DIR_TX), 4, "Packets 0, 3, 6, 9 sampled");
+    TEST_ASSERT_EQ(capture_tap_flush(tap), 0, "Flush should succeed");
+    TEST_ASSERT_EQ(tap_ring_record(ring, packets + 10, lengths, 2, TAP_DIR_TX), 0,
+                   "Sampling phase should carry across batches");
+    TEST_ASSERT_EQ(tap_ring_record(ring, packets + 12, lengths, 15, TAP_DIR_RX), 4,
+                   "Full ring should keep the first four");
+    TEST_ASSERT_EQ(capture_tap_flush(tap), 0, "Flush should succeed");
+    capture_tap_stats_t stats;
+    TEST_ASSERT_EQ(capture_tap_get_stats(tap, &stats), 0, "Stats should be readable");
+    TEST_ASSERT(stats.seen == 27 && stats.captured == 8 && stats.dropped == 1 && stats.written == 8,
+                "Counters should account for every packet");
+    capture_tap_destroy(tap);
+    
+    /* The file reads back as pcapng raw IPv4 with the sampled packets in order */
+    pcap_replay_t* replay = pcap_replay_open(path);
+    TEST_ASSERT_NOT_NULL(replay, "Tap output should be valid pcapng");
+    if (replay) {
+        pcap_replay_info_t info;
+        pcap_replay_get_info(replay, &info);
+        TEST_ASSERT(info.format == PCAP_FORMAT_PCAPNG && info.packets == 8, "Every capture should be written");
+        TEST_ASSERT(info.first_ns > 1000000000ULL * 1000000000ULL, "Timestamps should be wall clock");
+        pcap_replay_config_t rconfig;
+        pcap_replay_config_init(&rconfig);
+        rconfig.layer = BACKEND_LAYER_L3;
+        rconfig.batch_size = 16;
+        pcap_cursor_t* cursor = pcap_cursor_create(replay, &rconfig);
+        pcap_view_t view;
+        TEST_ASSERT_EQ(pcap_cursor_next(cursor, &view), 8, "Captures should replay");
+        static const uint8_t expected[8] = {0, 3, 6, 9, 12, 15, 18, 21};
+        int ordered = 1;
+        for (int i = 0; i < 8; i++) {
+            ordered &= view.count == 8 && view.lengths[i] == 60 && view.packets[i][5] == expected[i];
+        }
+        TEST_ASSERT(ordered, "Captures should be whole and in sampling order");
+        pcap_cursor_destroy(cursor);
+        pcap_replay_close(replay);
+    }
+    
+    /* Snap length and backend instances in both directions */
+    capture_tap_config_init(&config);
+    config.snaplen = 16;
+    tap = capture_tap_create(path, &config);
+    tap_ring_t* tx_ring = capture_tap_add_ring(tap, BACKEND_LAYER_PAYLOAD, "tx", -1);
+    tap_ring_t* rx_ring = capture_tap_add_ring(tap, BACKEND_LAYER_PAYLOAD, "rx", -1);
+    
+    uint16_t port = (uint16_t)(23000 + getpid() % 1000);
+    netstress_backend_config_t bconfig;
+    netstress_backend_config_init(&bconfig, NULL);
+    bconfig.bind_port = port;
+    bconfig.dst_ip = htonl_test(0x7F000001);
+    bconfig.dst_port = port;
+    netstress_backend_t* backend = netstress_backend_open(BACKEND_SENDMMSG, &bconfig);
+    TEST_ASSERT_NOT_NULL(backend, "Looped-back instance should open");
+    if (backend) {
+        TEST_ASSERT_EQ(netstress_backend_set_tap(backend, tx_ring, rx_ring), 0, "Tap should attach");
+        TEST_ASSERT_EQ(netstress_backend_send_batch(backend, packets, lengths, 3), 3, "Batch should be sent");
+        rx_desc_t descs[8];
+        int got = 0;
+        for (int tries = 0; tries < 100 && got < 3; tries++) {
+            int n = netstress_backend_recv_batch(backend, descs, 8);
+            if (n > 0) {
+                netstress_backend_release(backend, descs, (uint32_t)n);
+                got += n;
+            } else {
+                struct timespec wait = {0, 1000000};
+                nanosleep(&wait, NULL);
+            }
+        }
+        TEST_ASSERT_EQ(got, 3, "Datagrams should loop back");
+        netstress_backend_set_tap(backend, NULL, NULL);
+        netstress_backend_send_batch(backend, packets, lengths, 3);
+        netstress_backend_close(backend);
+    }
+    capture_tap_flush(tap);
+    capture_tap_get_stats(tap, &stats);
+    TEST_ASSERT(stats.seen == 6 && stats.captured == 6 && stats.written == 6,
+                "Both directions should be captured until detached");
+    capture_tap_destroy(tap);
+    
+    /* Walk the blocks: two interfaces, then cut packets flagged by direction */
+    uint8_t file[4096];
+    size_t size = 0;
+    FILE* f = fopen(path, "rb");
+    if (f) {
+        size = fread(file, 1, sizeof(file), f);
+        fclose(f);
+    }
+    int idbs = 0, cut = 0, outbound = 0, inbound = 0;
+    for (size_t off = 0; off + 12 <= size;) {
+        uint32_t type, len;
+        memcpy(&type, file + off, 4);
+        memcpy(&len, file + off + 4, 4);
+        if (len < 12 || off + len > size) {
+            break;
+        }
+        if (type == 1) {
+            idbs++;
+        } else if (type == 6 && len >= 44) {
+            uint32_t caplen, origlen, flags;
+            memcpy(&caplen, file + off + 20, 4);
+            memcpy(&origlen, file + off + 24, 4);
+            memcpy(&flags, file + off + 28 + ((caplen + 3) & ~3u) + 4, 4);
+            cut += caplen == 16 && origlen == 60;
+            outbound += flags == 2;
+            inbound += flags == 1;
+        }
+        off += len;
+    }
+    TEST_ASSERT(idbs == 2 && cut == 6, "Packets should be cut to the snap length");
+    TEST_ASSERT(outbound == 3 && inbound == 3, "Direction should be recorded per packet");
+    unlink(path);
+#endif
+}
+
+/* Hand one engine's queued frames to another, dropping every drop_every-th */
+static void tcp_test_deliver(tcp_engine_t* from, tcp_engine_t* to, uint64_t now,
+                             uint32_t drop_every, uint32_t* counter) {
+    static const uint8_t* frames[4096];
+    static uint32_t lengths[4096];
+    pkt_batch_t* tx = tcp_engine_tx_batch(from);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < tx->count; i++) {
+        if (drop_every > 0 && ++*counter % drop_every == 0) {
+            continue;
+        }
+        frames[n] = tx->arena + tx->offsets[i];
+        lengths[n] = tx->lengths[i];
+        n++;
+    }
+    if (to != NULL) {
+        tcp_engine_input(to, frames, lengths, n, now);
+    }
+    pkt_batch_reset(tx);
+}
+
+static void tcp_test_run(tcp_engine_t* client, tcp_engine_t* server, uint32_t drop_every,
+                         uint64_t step_ns, uint32_t rounds) {
+    uint64_t now = 1000;
+    uint32_t counter = 0;
+    for (uint32_t r = 0; r < rounds && !tcp_engine_done(client); r++) {
+        tcp_engine_poll(client, now);
+        if (server != NULL) {
+            tcp_engine_poll(server, now);
+        }
+        tcp_test_deliver(client, server, now, drop_every, &counter);
+        if (server != NULL) {
+            tcp_test_deliver(server, client, now, drop_every, &counter);
+        }
+        now += step_ns;
+    }
+    /* The last ACK of the last connection */
+    tcp_test_deliver(client, server, now, 0, &counter);
+}
+
+static void tcp_test_configs(tcp_engine_config_t* client, tcp_engine_config_t* server) {
+    tcp_engine_config_init(client);
+    client->server_ip = htonl_test(0x0A000064);
+    client->client_ip = htonl_test(0x0A000001);
+    client->client_ip_count = 4;
+    client->client_port_min = 10000;
+    client->client_port_max = 10099;
+    client->request_len = 300;
+    client->response_len = 5000;
+    client->max_concurrent = 512;
+    client->max_connections = 5000;
+    *server = *client;
+    server->role = TCP_ENGINE_SERVER;
+    server->max_connections = 0;
+}
+
+void test_tcp_engine(void) {
+    tcp_engine_config_t cc, sc;
+    tcp_test_configs(&cc, &sc);
+    TEST_ASSERT_NULL(tcp_engine_create(NULL), "NULL config should fail");
+    tcp_engine_config_t bad = cc;
+    bad.server_ip = 0;
+    TEST_ASSERT_NULL(tcp_engine_create(&bad), "Client without a server should fail");
+    bad = cc;
+    bad.client_port_min = 20000;
+    TEST_ASSERT_NULL(tcp_engine_create(&bad), "Inverted port range should fail");
+    TEST_ASSERT_EQ(tcp_engine_poll(NULL, 0), -1, "NULL engine should fail");
+    TEST_ASSERT_EQ(tcp_engine_run(NULL, NULL, 0, NULL), -1, "NULL engine should fail to run");
+    
+    tcp_engine_t* client = tcp_engine_create(&cc);
+    tcp_engine_t* server = tcp_engine_create(&sc);
+    TEST_ASSERT_NOT_NULL(client, "Client should be created");
+    TEST_ASSERT_NOT_NULL(server, "Server should be created");
+    if (!client || !server) {
+        tcp_engine_destroy(client);
+        tcp_engine_destroy(server);
+        return;
+    }
+    
+    /* The first SYN is a well-formed frame with an MSS option */
+    tcp_engine_poll(client, 1000);
+    pkt_batch_t* tx = tcp_engine_tx_batch(client);
+    TEST_ASSERT_EQ(tx->count, 256, "One poll should open at most 256 connections");
+    const uint8_t* syn = tx->arena + tx->offsets[0];
+    TEST_ASSERT(tx->lengths[0] == 58 && syn[14 + 33] == 0x02 && syn[14 + 40] == 2,
+                "SYN should carry an MSS option");
+    TEST_ASSERT_EQ(calculate_checksum(syn + 14, 20), 0, "IP checksum should verify");
+    TEST_ASSERT_EQ(calculate_transport_checksum(0x0A000001, 0x0A000064, 6, syn + 34, 24), 0,
+                   "TCP checksum should verify");
+    
+    /* 5000 connections over 400 tuples: handshake, 300-byte request, four
+     * response segments and the close, with tuples reused straight away */
+    tcp_test_run(client, server, 0, 10000, 100000);
+    tcp_engine_stats_t cs, ss;
+    tcp_engine_get_stats(client, &cs);
+    tcp_engine_get_stats(server, &ss);
+    TEST_ASSERT(tcp_engine_done(client), "Client should finish");
+    TEST_ASSERT(cs.attempted == 5000 && cs.established == 5000 && cs.completed == 5000,
+                "Every client connection should complete");
+    TEST_ASSERT(ss.attempted == 5000 && ss.completed == 5000, "Every server connection should complete");
+    TEST_ASSERT(cs.failed == 0 && ss.failed == 0 && cs.retransmits == 0 && ss.retransmits == 0,
+                "A lossless run should not retransmit");
+    TEST_ASSERT(cs.active == 0 && ss.active == 0, "Flow tables should drain");
+    TEST_ASSERT(cs.rx_ignored == 0 && cs.tx_dropped == 0, "No frame should be lost");
+    TEST_ASSERT(cs.connect.received == 5000 && cs.lifetime.received == 5000,
+                "Every connection should be timed");
+    TEST_ASSERT(cs.lifetime.p50_ns >= 20000 && cs.lifetime.p50_ns > cs.connect.p50_ns &&
+                cs.lifetime.max_ns >= cs.lifetime.p99_ns,
+                "Request and close should take two more rounds than the handshake");
+    TEST_ASSERT(cs.cps > 0.0, "CPS should be reported");
+    tcp_engine_destroy(client);
+    tcp_engine_destroy(server);
+    
+    /* One frame in seven lost: timers recover every connection */
+    cc.max_connections = 500;
+    cc.rto_ns = 1000000;
+    cc.max_retries = 10;
+    sc.rto_ns = cc.rto_ns;
+    sc.max_retries = cc.max_retries;
+    client = tcp_engine_create(&cc);
+    server = tcp_engine_create(&sc);
+    if (client && server) {
+        tcp_test_run(client, server, 7, 100000, 100000);
+        tcp_engine_get_stats(client, &cs);
+        tcp_engine_get_stats(server, &ss);
+        TEST_ASSERT(cs.completed == 500 && cs.failed == 0, "Lossy client connections should complete");
+        TEST_ASSERT(ss.completed == 500 && ss.active == 0, "Lossy server connections should complete");
+        TEST_ASSERT(cs.retransmits > 0 && ss.retransmits > 0, "Losses should be retransmitted");
+    }
+    tcp_engine_destroy(client);
+    tcp_engine_destroy(server);
+    
+    /* Nobody answers: each connection is reset after its retries */
+    cc.max_connections = 5;
+    cc.max_retries = 2;
+    client = tcp_engine_create(&cc);
+    if (client) {
+        tcp_test_run(client, NULL, 0, 100000, 1000);
+        tcp_engine_get_stats(client, &cs);
+        TEST_ASSERT(tcp_engine_done(client), "Failed connections should finish the run");
+        TEST_ASSERT(cs.failed == 5 && cs.completed == 0 && cs.retransmits == 10,
+                    "Unanswered SYNs should be retried then fail");
+    }
+    tcp_engine_destroy(client);
+    
+    /* A server resets segments for unknown flows and ignores other ports */
+    server = tcp_engine_create(&sc);
+    if (server) {
+        uint8_t frame[54];
+        memset(frame, 0, sizeof(frame));
+        frame[12] = 0x08;
+        frame[14] = 0x45;
+        frame[17] = 40;
+        frame[22] = 64;
+        frame[23] = 6;
+        uint32_t src = htonl_test(0x0A000001), dst = htonl_test(0x0A000064);
+        memcpy(frame + 26, &src, 4);
+        memcpy(frame + 30, &dst, 4);
+        frame[34] = 0x27;
+        frame[35] = 0x10;
+        frame[37] = 80;
+        frame[46] = 0x50;
+        frame[47] = 0x10;       /* ACK */
+        frame[45] = 7;          /* Acknowledges 7 */
+        const uint8_t* frames[1] = {frame};
+        uint32_t lengths[1] = {sizeof(frame)};
+        TEST_ASSERT_EQ(tcp_engine_input(server, frames, lengths, 1, 1000), 1, "Segment should be ours");
+        tx = tcp_engine_tx_batch(server);
+        const uint8_t* rst = tx->arena + tx->offsets[0];
+        TEST_ASSERT(tx->count == 1 && rst[47] == 0x04 && rst[41] == 7,
+                    "Stray ACK should get a RST at its ack number");
+        frame[37] = 81;
+        TEST_ASSERT_EQ(tcp_engine_input(server, frames, lengths, 1, 1000), 0, "Other ports should be ignored");
+        tcp_engine_get_stats(server, &ss);
+        TEST_ASSERT(ss.rx_frames == 2 && ss.rx_ignored == 1 && ss.active == 0, "Server should count both frames");
+    }
+    tcp_engine_destroy(server);
+    
+    /* Driven by a backend instance: only L2 instances carry its frames */
+    cc.max_connections = 5;
+    cc.max_retries = 1;
+    cc.rto_ns = 1000000;
+    client = tcp_engine_create(&cc);
+    netstress_backend_config_t bconfig;
+    netstress_backend_config_init(&bconfig, NULL);
+    bconfig.dst_ip = htonl(0x7F000001);
+    bconfig.dst_port = (uint16_t)(24000 + getpid() % 1000);
+    netstress_backend_t* payload = netstress_backend_open(BACKEND_SENDMMSG, &bconfig);
+    if (client && payload) {
+        TEST_ASSERT_EQ(tcp_engine_run(client, payload, 1000000, NULL), -1, "Payload instances cannot carry frames");
+    }
+    netstress_backend_close(payload);
+#ifdef HAS_AF_XDP
+    /* Nobody answers on loopback: the run ends once every SYN has failed */
+    driver_config_t base;
+    memset(&base, 0, sizeof(base));
+    base.interface = "lo";
+    base.burst_size = 64;
+    netstress_backend_config_init(&bconfig, &base);
+    netstress_backend_t* l2 = netstress_backend_open(BACKEND_AF_XDP, &bconfig);
+    if (client && l2) {
+        TEST_ASSERT_EQ(tcp_engine_run(client, l2, 5000000000ULL, NULL), 0, "Run should return");
+        tcp_engine_get_stats(client, &cs);
+        TEST_ASSERT(tcp_engine_done(client) && cs.attempted == 5 && cs.failed == 5,
+                    "Unanswered connections should fail within the run");
+        driver_stats_t bstats;
+        netstress_backend_get_stats(l2, &bstats);
+        TEST_ASSERT(bstats.packets_sent >= 10, "SYNs and retries should go through the instance");
+    }
+    netstress_backend_close(l2);
+#endif
+    tcp_engine_destroy(client);
+}
+
+/* Latency probe header as the shim lays it out: magic, probe id, seq, tx time */
+static void sink_test_probe(uint8_t* p, uint32_t probe_id, uint64_t seq) {
+    uint32_t magic = LATENCY_PROBE_MAGIC;
+    memset(p, 0, LATENCY_PROBE_HDR_LEN);
+    memcpy(p, &magic, 4);
+    memcpy(p + 4, &probe_id, 4);
+    memcpy(p + 8, &seq, 8);
+}
+
+/* Ethernet + IPv4 + UDP frame carrying a probe header after the UDP header */
+static void sink_test_frame(uint8_t* f, uint32_t probe_id, uint64_t seq) {
+    memset(f, 0, 80);
+    for (int i = 0; i < 6; i++) {
+        f[i] = 0x02;
+        f[6 + i] = 0x04;
+    }
+    f[12] = 0x08;
+    uint8_t* ip = f + 14;
+    ip[0] = 0x45;
+    ip[9] = 17;
+    ip[12] = 10; ip[15] = 1;
+    ip[16] = 10; ip[19] = 2;
+    uint8_t* udp = ip + 20;
+    udp[0] = 0x30; udp[1] = 0x39;
+    udp[2] = 0x00; udp[3] = 0x50;
+    sink_test_probe(udp + 8, probe_id, seq);
+}
+
+void test_sink(void) {
+    sink_config_t config;
+    sink_config_init(&config);
+    TEST_ASSERT(config.probe_offset == LATENCY_PROBE_AUTO && config.burst == 64, "Defaults should be set");
+    TEST_ASSERT_EQ(sink_input(NULL, NULL, NULL, 0, 0), -1, "NULL sink should fail");
+    TEST_ASSERT_EQ(sink_poll(NULL, NULL), -1, "NULL sink should fail to poll");
+    TEST_ASSERT_EQ(sink_get_stats(NULL, NULL), -1, "NULL sink should have no stats");
+    sink_destroy(NULL);
+    
+    sink_t* sink = sink_create(NULL);
+    TEST_ASSERT_NOT_NULL(sink, "Sink should be created");
+    if (!sink) {
+        return;
+    }
+    
+    /* 0 1 3 4 2 2 6 5 9: 2 and 5 come late, 2 twice, 7 and 8 never */
+    static const uint64_t seqs[] = {0, 1, 3, 4, 2, 2, 6, 5, 9};
+    uint8_t frames[9][80];
+    uint8_t* ptrs[9];
+    uint32_t lengths[9];
+    for (int i = 0; i < 9; i++) {
+        sink_test_frame(frames[i], 3, seqs[i]);
+        ptrs[i] = frames[i];
+        lengths[i] = 80;
+    }
+    TEST_ASSERT_EQ(sink_input(sink, ptrs, lengths, 5, 1000), 0, "No frames are reflected by default");
+    TEST_ASSERT_EQ(sink_input(sink, ptrs + 5, lengths + 5, 4, 1000001000), 0, "No frames are reflected by default");
+    
+    sink_stats_t stats;
+    TEST_ASSERT_EQ(sink_get_stats(sink, &stats), 0, "Stats should be readable");
+    TEST_ASSERT(stats.rx_frames == 9 && stats.rx_bytes == 720, "Every frame should be counted");
+    TEST_ASSERT(stats.sequenced == 9 && stats.streams == 1, "Frames should join one stream");
+    TEST_ASSERT_EQ(stats.lost, 2, "Only 7 and 8 should be lost");
+    TEST_ASSERT_EQ(stats.reordered, 2, "2 and 5 should be reordered");
+    TEST_ASSERT_EQ(stats.duplicates, 1, "The second 2 should be a duplicate");
+    TEST_ASSERT(stats.pps > 8.9 && stats.pps < 9.1, "Rate should span the first to the last frame");
+    
+    /* A jump past the window forgets it; a second stream starts where it is seen */
+    uint8_t* one[1] = {frames[0]};
+    uint32_t len[1] = {80};
+    sink_test_frame(frames[0], 3, 9 + SINK_SEQ_WINDOW * 2);
+    sink_input(sink, one, len, 1, 1000001000);
+    sink_test_frame(frames[0], 3, 10);
+    sink_input(sink, one, len, 1, 1000001000);
+    sink_test_frame(frames[0], 4, 500);
+    sink_input(sink, one, len, 1, 1000001000);
+    sink_test_frame(frames[0], 4, 499);
+    sink_input(sink, one, len, 1, 1000001000);
+    sink_get_stats(sink, &stats);
+    TEST_ASSERT_EQ(stats.lost, 2 + SINK_SEQ_WINDOW * 2 - 1, "Only late frames inside the window should repay a loss");
+    TEST_ASSERT_EQ(stats.reordered, 4, "Frames past the window or before a stream should count as reordered");
+    TEST_ASSERT_EQ(stats.streams, 2, "A new probe id should start a stream");
+    
+    /* Frames without a probe header are counted but not sequenced */
+    uint8_t plain[80];
+    memset(plain, 0, sizeof(plain));
+    one[0] = plain;
+    sink_input(sink, one, len, 1, 1000001000);
+    sink_get_stats(sink, &stats);
+    TEST_ASSERT(stats.rx_frames == 14 && stats.sequenced == 13, "Plain frames should not be sequenced");
+    sink_destroy(sink);
+    
+    /* Reflection swaps addresses and ports and skips what it cannot parse */
+    config.reflect = 1;
+    config.probe_offset = 42;
+    sink = sink_create(&config);
+    TEST_ASSERT_NOT_NULL(sink, "Reflecting sink should be created");
+    if (!sink) {
+        return;
+    }
+    sink_test_frame(frames[0], 1, 0);
+    sink_test_frame(frames[1], 1, 1);
+    sink_test_frame(frames[2], 1, 2);
+    memset(frames[2], 0xFF, 6);
+    uint8_t* mixed[4] = {frames[0], plain, frames[2], frames[1]};
+    uint32_t mixed_len[4] = {80, 80, 80, 80};
+    TEST_ASSERT_EQ(sink_input(sink, mixed, mixed_len, 4, 0), 2, "Both unicast IPv4 frames should be reflected");
+    TEST_ASSERT(mixed[0] == frames[0] && mixed[1] == frames[1], "Reflected frames should come first");
+    uint8_t* f = frames[1];
+    TEST_ASSERT(f[0] == 0x04 && f[6] == 0x02, "MAC addresses should be swapped");
+    TEST_ASSERT(f[14 + 15] == 2 && f[14 + 19] == 1, "IP addresses should be swapped");
+    TEST_ASSERT(f[34 + 1] == 0x50 && f[34 + 3] == 0x39, "Ports should be swapped");
+    sink_get_stats(sink, &stats);
+    TEST_ASSERT(stats.reflect_skipped == 2 && stats.sequenced == 3, "Non-IP and broadcast frames should be skipped");
+    TEST_ASSERT(frames[2][0] == 0xFF && frames[2][6] == 0x04, "Broadcast frames should be left alone");
+    
+#ifdef __linux__
+    /* Payload instances carry no headers to swap */
+    netstress_backend_config_t bconfig;
+    netstress_backend_config_init(&bconfig, NULL);
+    bconfig.bind_port = (uint16_t)(23000 + getpid() % 1000);
+    netstress_backend_t* rx = netstress_backend_open(BACKEND_SENDMMSG, &bconfig);
+    if (rx) {
+        TEST_ASSERT_EQ(sink_poll(sink, rx), -1, "Reflection should need an L2 instance");
+    }
+    sink_destroy(sink);
+    
+    /* A payload sink reads the probe header at offset 0 */
+    config.reflect = 0;
+    config.probe_offset = 0;
+    sink = sink_create(&config);
+    bconfig.bind_port = 0;
+    bconfig.dst_ip = htonl(0x7F000001);
+    bconfig.dst_port = (uint16_t)(23000 + getpid() % 1000);
+    netstress_backend_t* tx = netstress_backend_open(BACKEND_SENDMMSG, &bconfig);
+    if (rx && tx && sink) {
+        uint8_t payloads[4][64];
+        const uint8_t* packets[4];
+        uint32_t plens[4] = {64, 64, 64, 64};
+        for (int i = 0; i < 4; i++) {
+            memset(payloads[i], 0, 64);
+            sink_test_probe(payloads[i], 9, (uint64_t)(i < 2 ? i : i + 1));
+            packets[i] = payloads[i];
+        }
+        TEST_ASSERT_EQ(netstress_backend_send_batch(tx, packets, plens, 4), 4, "Probes should be sent");
+        for (int tries = 0; tries < 100; tries++) {
+            sink_poll(sink, rx);
+            sink_get_stats(sink, &stats);
+            if (stats.rx_frames >= 4) {
+                break;
+            }
+            struct timespec wait = {0, 1000000};
+            nanosleep(&wait, NULL);
+        }
+        TEST_ASSERT(stats.rx_frames == 4 && stats.sequenced == 4, "Every probe should be received");
+        TEST_ASSERT_EQ(stats.lost, 1, "The skipped sequence should be lost");
+        TEST_ASSERT_EQ(sink_run(sink, rx, 1000000, NULL), 0, "Run should return after its duration");
+        
+        /* A command ring pauses the run and ends it */
+        worker_ctrl_t* ctrl = worker_ctrl_create(0, -1);
+        if (ctrl) {
+            worker_cmd_t cmd;
+            memset(&cmd, 0, sizeof(cmd));
+            cmd.type = WORKER_CMD_PAUSE;
+            worker_ctrl_post(ctrl, &cmd);
+            TEST_ASSERT_EQ(netstress_backend_send_batch(tx, packets, plens, 1), 1, "Probe should be sent");
+            TEST_ASSERT_EQ(sink_run(sink, rx, 2000000, ctrl), 0, "Paused run should return after its duration");
+            sink_get_stats(sink, &stats);
+            TEST_ASSERT_EQ(stats.rx_frames, 4, "A paused sink should receive nothing");
+            cmd.type = WORKER_CMD_RATE;
+            uint64_t seq = worker_ctrl_post(ctrl, &cmd);
+            TEST_ASSERT_EQ(sink_run(sink, rx, 1000000, ctrl), 0, "Run should return after its duration");
+            errno = 0;
+            TEST_ASSERT(worker_ctrl_wait(ctrl, seq, 0) == -1 && errno == ENOTSUP, "A sink should refuse rate changes");
+            cmd.type = WORKER_CMD_STOP;
+            seq = worker_ctrl_post(ctrl, &cmd);
+            TEST_ASSERT_EQ(sink_run(sink, rx, 0, ctrl), 0, "Stop should end an unbounded run");
+            TEST_ASSERT_EQ(worker_ctrl_acked(ctrl), seq, "Stop should be acknowledged");
+        }
+        worker_ctrl_destroy(ctrl);
+    }
+    netstress_backend_close(tx);
+    netstress_backend_close(rx);
+#endif
+    sink_destroy(sink);
+}
+
+#ifndef _WIN32
+typedef struct {
+    worker_ctrl_t* ctrl;
+    volatile uint64_t batches;
+    volatile uint64_t rate_pps;
+} worker_ctrl_test_t;
+
+/* Stands in for a send loop: one poll per batch, sending nothing while paused */
+static void* worker_ctrl_test_thread(void* arg) {
+    worker_ctrl_test_t* w = (worker_ctrl_test_t*)arg;
+    worker_params_t params;
+    memset(&params, 0, sizeof(params));
+    for (;;) {
+        uint32_t changed = worker_ctrl_poll(w->ctrl, &params);
+        if (params.stopped) {
+            break;
+        }
+        if (changed & WORKER_CHANGED_RATE) {
+            w->rate_pps = params.rate_pps;
+        }
+        if (!params.paused) {
+            w->batches++;
+        }
+    }
+    return NULL;
+}
+#endif
+
+void test_worker_ctrl(void) {
+    TEST_ASSERT_NULL(worker_ctrl_create(1u << 20, -1), "Oversized ring should fail");
+    TEST_ASSERT_EQ(worker_ctrl_post(NULL, NULL), 0, "NULL ring should fail");
+    TEST_ASSERT_EQ(worker_ctrl_poll(NULL, NULL), 0, "NULL ring should have nothing to apply");
+    TEST_ASSERT_EQ(worker_ctrl_wait(NULL, 1, 0), -1, "NULL ring should fail to wait");
+    worker_ctrl_destroy(NULL);
+    
+    worker_ctrl_t* ctrl = worker_ctrl_create(3, -1);
+    TEST_ASSERT_NOT_NULL(ctrl, "Ring should be created");
+    if (!ctrl) {
+        return;
+    }
+    worker_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = (worker_cmd_type_t)99;
+    TEST_ASSERT_EQ(worker_ctrl_post(ctrl, &cmd), 0, "Unknown commands should be refused");
+    
+    /* Three slots round up to four; the fifth post finds the ring full */
+    cmd.type = WORKER_CMD_RATE;
+    cmd.rate_pps = 1000;
+    cmd.burst = 8;
+    TEST_ASSERT_EQ(worker_ctrl_post(ctrl, &cmd), 1, "Sequence numbers should start at 1");
+    cmd.type = WORKER_CMD_PACKET_SIZE;
+    cmd.packet_size = 512;
+    TEST_ASSERT_EQ(worker_ctrl_post(ctrl, &cmd), 2, "Sequence numbers should count posts");
+    cmd.type = WORKER_CMD_RESUME;
+    worker_ctrl_post(ctrl, &cmd);
+    cmd.type = WORKER_CMD_TEMPLATE;
+    cmd.tmpl = (pkt_template_t*)&cmd;
+    TEST_ASSERT_EQ(worker_ctrl_post(ctrl, &cmd), 4, "Ring should take a power of two");
+    TEST_ASSERT_EQ(worker_ctrl_post(ctrl, &cmd), 0, "Full ring should refuse posts");
+    
+    worker_params_t params;
+    memset(&params, 0, sizeof(params));
+    uint32_t changed = worker_ctrl_poll(ctrl, &params);
+    TEST_ASSERT_EQ(changed, WORKER_CHANGED_RATE | WORKER_CHANGED_PACKET_SIZE | WORKER_CHANGED_TEMPLATE,
+                   "A resume while running should change nothing");
+    TEST_ASSERT(params.rate_pps == 1000 && params.burst == 8 && params.packet_size == 512 &&
+                params.tmpl == (pkt_template_t*)&cmd, "Commands should be applied in order");
+    TEST_ASSERT_EQ(params.applied, 4, "Applied sequence should be tracked");
+    TEST_ASSERT_EQ(worker_ctrl_acked(ctrl), 0, "Commands should wait a batch for their ack");
+    TEST_ASSERT_EQ(worker_ctrl_wait(ctrl, 4, 1000), -1, "Wait should time out before the ack");
+    TEST_ASSERT_EQ(worker_ctrl_poll(ctrl, &params), 0, "Empty ring should change nothing");
+    TEST_ASSERT_EQ(worker_ctrl_acked(ctrl), 4, "Next poll should acknowledge");
+    
+    cmd.type = WORKER_CMD_PAUSE;
+    uint64_t seq = worker_ctrl_post(ctrl, &cmd);
+    TEST_ASSERT_EQ(worker_ctrl_poll(ctrl, &params), WORKER_CHANGED_PAUSE, "Pause should flip paused");
+    TEST_ASSERT(params.paused && worker_ctrl_acked(ctrl) == seq, "Pause should be acknowledged at once");
+    TEST_ASSERT_EQ(worker_ctrl_wait(ctrl, seq, 1000), 0, "Applied pause should wait cleanly");
+    
+    /* A worker that cannot change rate acks the command as refused */
+    params.supported = WORKER_CHANGED_PAUSE | WORKER_CHANGED_STOP;
+    cmd.type = WORKER_CMD_RATE;
+    cmd.rate_pps = 5;
+    seq = worker_ctrl_post(ctrl, &cmd);
+    TEST_ASSERT_EQ(worker_ctrl_poll(ctrl, &params), 0, "Refused rate should change nothing");
+    TEST_ASSERT_EQ(params.rate_pps, 1000, "Refused rate should not be applied");
+    errno = 0;
+    TEST_ASSERT(worker_ctrl_wait(ctrl, seq, 1000) == -1 && errno == ENOTSUP, "Refused rate should fail its wait");
+    cmd.type = WORKER_CMD_RESUME;
+    seq = worker_ctrl_post(ctrl, &cmd);
+    TEST_ASSERT_EQ(worker_ctrl_poll(ctrl, &params), WORKER_CHANGED_PAUSE, "Supported resume should apply");
+    worker_ctrl_poll(ctrl, &params);
+    TEST_ASSERT_EQ(worker_ctrl_wait(ctrl, seq, 1000), 0, "Supported resume should wait cleanly");
+    worker_ctrl_destroy(ctrl);
+    
+#ifndef _WIN32
+    worker_ctrl_test_t w;
+    memset(&w, 0, sizeof(w));
+    w.ctrl = worker_ctrl_create(0, -1);
+    pthread_t worker;
+    if (w.ctrl && pthread_create(&worker, NULL, worker_ctrl_test_thread, &w) == 0) {
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.type = WORKER_CMD_RATE;
+        cmd.rate_pps = 250000;
+        seq = worker_ctrl_post(w.ctrl, &cmd);
+        TEST_ASSERT_EQ(worker_ctrl_wait(w.ctrl, seq, 1000000000ULL), 0, "Running worker should acknowledge");
+        TEST_ASSERT_EQ(w.rate_pps, 250000, "Acknowledged rate should be in effect");
+        
+        cmd.type = WORKER_CMD_PAUSE;
+        seq = worker_ctrl_post(w.ctrl, &cmd);
+        TEST_ASSERT_EQ(worker_ctrl_wait(w.ctrl, seq, 1000000000ULL), 0, "Pause should be acknowledged");
+        uint64_t frozen = w.batches;
+        struct timespec wait = {0, 1000000};
+        nanosleep(&wait, NULL);
+        TEST_ASSERT_EQ(w.batches, frozen, "Paused worker should send nothing");
+        
+        cmd.type = WORKER_CMD_RESUME;
+        seq = worker_ctrl_post(w.ctrl, &cmd);
+        TEST_ASSERT_EQ(worker_ctrl_wait(w.ctrl, seq, 1000000000ULL), 0, "Resume should be acknowledged");
+        TEST_ASSERT(w.batches > frozen, "Resumed worker should send again");
+        
+        cmd.type = WORKER_CMD_STOP;
+        seq = worker_ctrl_post(w.ctrl, &cmd);
+        TEST_ASSERT_EQ(worker_ctrl_wait(w.ctrl, seq, 1000000000ULL), 0, "Stop should be acknowledged");
+        pthread_join(worker, NULL);
+    }
+    worker_ctrl_destroy(w.ctrl);
+#endif
+}
+
 /* Test driver stats structure */
 void test_driver_stats(void) {
     driver_stats_t stats;
@@ -218,6 +2395,238 @@ void test_driver_stats(void) {
     /* Test structure size and alignment */
     TEST_ASSERT(sizeof(driver_stats_t) >= 20, "driver_stats_t should be at least 20 bytes");
     TEST_ASSERT(sizeof(driver_stats_t) % 4 == 0, "driver_stats_t should be 4-byte aligned");
+    TEST_ASSERT_EQ(sizeof(stats.bytes_sent), 8, "Byte counters should be 64-bit");
+}
+
+#ifndef _WIN32
+static volatile int stats_writer_stop = 0;
+
+static void* stats_writer_thread(void* arg) {
+    driver_stats_block_t* block = (driver_stats_block_t*)arg;
+    while (!stats_writer_stop) {
+        stats_block_add_tx(block, 1, 1500);
+    }
+    return NULL;
+}
+#endif
+
+/* Test per-worker stats blocks and aggregate snapshot */
+void test_stats_blocks(void) {
+    driver_stats_t before, after, single;
+    TEST_ASSERT(driver_stats_snapshot(&before) >= 0, "Snapshot should succeed");
+    TEST_ASSERT_EQ(driver_stats_snapshot(NULL), -1, "NULL snapshot should fail");
+    
+    driver_stats_block_t* a = stats_block_create();
+    driver_stats_block_t* b = stats_block_create();
+    TEST_ASSERT_NOT_NULL(a, "First block should be created");
+    TEST_ASSERT_NOT_NULL(b, "Second block should be created");
+    if (!a || !b) {
+        return;
+    }
+    
+    uintptr_t gap = (uintptr_t)a > (uintptr_t)b ? (uintptr_t)a - (uintptr_t)b : (uintptr_t)b - (uintptr_t)a;
+    TEST_ASSERT_EQ((uintptr_t)a % 64, 0, "Blocks should be cache-line aligned");
+    TEST_ASSERT(gap >= 64, "Blocks should not share a cache line");
+    
+    /* Past 2^32 bytes, where the old 32-bit counters wrapped */
+    stats_block_add_tx(a, 4000000, 6000000000ULL);
+    stats_block_add_rx(a, 10, 640);
+    stats_block_add_tx(b, 5, 500);
+    stats_block_add_errors(b, 2);
+    
+    TEST_ASSERT_EQ(stats_block_read(a, &single), 0, "Block read should succeed");
+    TEST_ASSERT(single.bytes_sent == 6000000000ULL, "Block should hold 64-bit byte count");
+    TEST_ASSERT_EQ(single.packets_received, 10, "Block should count RX packets");
+    TEST_ASSERT_EQ(stats_block_read(NULL, &single), -1, "NULL block read should fail");
+    
+    driver_stats_snapshot(&after);
+    TEST_ASSERT(after.bytes_sent - before.bytes_sent == 6000000500ULL, "Snapshot should sum blocks");
+    TEST_ASSERT_EQ(after.packets_sent - before.packets_sent, 4000005, "Snapshot should sum packets");
+    TEST_ASSERT_EQ(after.errors - before.errors, 2, "Snapshot should sum errors");
+    
+    /* Released counts stay in the aggregate */
+    stats_block_destroy(b);
+    driver_stats_snapshot(&after);
+    TEST_ASSERT_EQ(after.packets_sent - before.packets_sent, 4000005, "Released block should stay counted");
+    
+#ifndef _WIN32
+    /* Snapshots while a writer runs must never go backwards */
+    pthread_t writer;
+    stats_writer_stop = 0;
+    if (pthread_create(&writer, NULL, stats_writer_thread, a) == 0) {
+        int monotonic = 1;
+        uint64_t last = 0;
+        for (int i = 0; i < 10000; i++) {
+            driver_stats_snapshot(&after);
+            if (after.packets_sent < last) {
+                monotonic = 0;
+            }
+            last = after.packets_sent;
+        }
+        stats_writer_stop = 1;
+        pthread_join(writer, NULL);
+        TEST_ASSERT(monotonic, "Concurrent snapshots should be monotonic");
+    }
+#endif
+    
+    stats_block_destroy(a);
+    stats_block_destroy(NULL);
+}
+
+/* Test send-path stage counters (live only in NETSTRESS_STAGE_CYCLES builds) */
+void test_stage_stats(void) {
+    stage_stats_t stages;
+    int enabled = stats_stages_enabled();
+    TEST_ASSERT(enabled == 0 || enabled == 1, "Stage flag should be 0 or 1");
+    TEST_ASSERT_STR_EQ(stats_stage_name(STATS_STAGE_KICK), "kick", "Stage should have a name");
+    TEST_ASSERT_STR_EQ(stats_stage_name(STATS_STAGE_COUNT), "unknown", "Out-of-range stage should be unknown");
+    TEST_ASSERT_EQ(stats_block_read_stages(NULL, &stages), -1, "NULL block stage read should fail");
+    TEST_ASSERT_EQ(driver_stages_snapshot(NULL), -1, "NULL stage snapshot should fail");
+    TEST_ASSERT(driver_stages_snapshot(&stages) >= 0, "Stage snapshot should succeed");
+    
+    driver_stats_block_t* block = stats_block_create();
+    TEST_ASSERT_NOT_NULL(block, "Block should be created");
+    if (block) {
+        TEST_ASSERT_EQ(stats_block_read_stages(block, &stages), 0, "Block stage read should succeed");
+        TEST_ASSERT_EQ(stages.calls[STATS_STAGE_COPY], 0, "Fresh block should have no stage calls");
+        stats_block_destroy(block);
+    }
+    
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rx < 0 || tx < 0) {
+        TEST_ASSERT(0, "Failed to create UDP sockets for testing");
+        return;
+    }
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl_test(0x7F000001);
+    TEST_ASSERT_EQ(bind(rx, (struct sockaddr*)&addr, sizeof(addr)), 0, "Receiver should bind to loopback");
+    getsockname(rx, (struct sockaddr*)&addr, &addr_len);
+    
+    sendmmsg_ctx_t* ctx = sendmmsg_ctx_create(tx, 4);
+    TEST_ASSERT_NOT_NULL(ctx, "sendmmsg context should be created");
+    if (ctx) {
+        enum { N = 10 };
+        static uint8_t payload[64];
+        const uint8_t* packets[N];
+        uint32_t lengths[N];
+        for (int i = 0; i < N; i++) {
+            packets[i] = payload;
+            lengths[i] = sizeof(payload);
+        }
+        int sent = sendmmsg_ctx_send_same_dest(ctx, packets, lengths, addr.sin_addr.s_addr,
+                                               htons_test(addr.sin_port), N);
+        TEST_ASSERT_EQ(sent, N, "Context should send every packet");
+        TEST_ASSERT_EQ(sendmmsg_ctx_get_stages(NULL, &stages), -1, "NULL context stage read should fail");
+        TEST_ASSERT_EQ(sendmmsg_ctx_get_stages(ctx, &stages), 0, "Context stage read should succeed");
+#ifdef __linux__
+        /* Ten packets in chunks of four: three syscalls */
+        uint64_t expect = enabled ? 3 : 0;
+#else
+        uint64_t expect = 0;
+#endif
+        TEST_ASSERT_EQ(stages.calls[STATS_STAGE_KICK], expect, "Each syscall should be one kick");
+        TEST_ASSERT_EQ(stages.calls[STATS_STAGE_COPY], expect, "Each chunk should be one copy");
+        TEST_ASSERT_EQ(stages.calls[STATS_STAGE_REAP], 0, "sendmmsg has no reap stage");
+        if (!enabled) {
+            TEST_ASSERT_EQ(stages.cycles[STATS_STAGE_KICK], 0, "Disabled build should charge nothing");
+        }
+        sendmmsg_ctx_destroy(ctx);
+    }
+    close(rx);
+    close(tx);
+}
+
+/* Test shared-memory telemetry region */
+void test_stats_shm(void) {
+#ifndef _WIN32
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/netstress-stats-test-%d", (int)getpid());
+    
+    TEST_ASSERT_NULL(stats_shm_create(NULL, 0), "NULL path should fail");
+    stats_shm_t* shm = stats_shm_create(path, 0);
+    TEST_ASSERT_NOT_NULL(shm, "Telemetry region should be created");
+    driver_stats_block_t* block = stats_block_create();
+    if (!shm || !block) {
+        stats_block_destroy(block);
+        stats_shm_destroy(shm);
+        return;
+    }
+    
+    stats_block_add_tx(block, 777, 777000);
+    stats_block_record_latency(block, 100);    /* bucket 6 */
+    stats_block_record_latency(block, 5000);   /* bucket 12 */
+    stats_block_record_latency(block, 0);      /* bucket 0 */
+    TEST_ASSERT(stats_shm_publish(shm) >= 1, "Publish should report live blocks");
+    
+    /* Read through an independent mapping, as an external reader would */
+    int fd = open(path, O_RDONLY);
+    TEST_ASSERT(fd >= 0, "Region file should exist");
+    size_t size = sizeof(stats_shm_header_t) + (DRIVER_STATS_MAX_BLOCKS + 1) * sizeof(stats_shm_slot_t);
+    void* region = fd >= 0 ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (fd >= 0) {
+        close(fd);
+    }
+    TEST_ASSERT(region != MAP_FAILED, "Region should be mappable");
+    if (region != MAP_FAILED) {
+        const stats_shm_header_t* hdr = (const stats_shm_header_t*)region;
+        TEST_ASSERT_EQ(hdr->magic, STATS_SHM_MAGIC, "Header magic should be set");
+        TEST_ASSERT_EQ(hdr->version, STATS_SHM_VERSION, "Header version should be set");
+        TEST_ASSERT_EQ(hdr->slot_size, sizeof(stats_shm_slot_t), "Header slot size should match");
+        
+        stats_shm_slot_t slot;
+        int found = 0;
+        for (int i = 0; i < (int)hdr->num_slots; i++) {
+            if (stats_shm_read(region, i, &slot) == 0 && slot.active && slot.counters.packets_sent == 777) {
+                found = 1;
+                break;
+            }
+        }
+        TEST_ASSERT(found, "Block slot should be published");
+        TEST_ASSERT_EQ(slot.seq % 2, 0, "Published slot seq should be even");
+        TEST_ASSERT_EQ(slot.latency[6], 1, "100ns sample should land in bucket 6");
+        TEST_ASSERT_EQ(slot.latency[12], 1, "5us sample should land in bucket 12");
+        TEST_ASSERT_EQ(slot.latency[0], 1, "0ns sample should land in bucket 0");
+        
+        TEST_ASSERT_EQ(stats_shm_read(region, -1, &slot), 0, "Aggregate slot should be readable");
+        TEST_ASSERT(slot.counters.packets_sent >= 777, "Aggregate should include the block");
+        TEST_ASSERT_EQ(stats_shm_read(region, (int)hdr->num_slots, &slot), -1, "Out-of-range slot should fail");
+        
+        /* A writer that died mid-update leaves the seq odd for good */
+        uint8_t* copy = (uint8_t*)malloc(size);
+        if (copy) {
+            memcpy(copy, region, size);
+            stats_shm_slot_t* agg = (stats_shm_slot_t*)(copy + sizeof(stats_shm_header_t));
+            agg->seq |= 1;
+            TEST_ASSERT_EQ(stats_shm_read(copy, -1, &slot), -EAGAIN, "Stuck slot should give up");
+            free(copy);
+        }
+        munmap(region, size);
+    }
+    stats_shm_destroy(shm);
+    
+    /* Background publisher picks up new counts on its own */
+    shm = stats_shm_create(path, 1000);
+    TEST_ASSERT_NOT_NULL(shm, "Region with publisher should be created");
+    if (shm) {
+        stats_shm_slot_t before, after;
+        stats_shm_read(stats_shm_region(shm), -1, &before);
+        stats_block_add_tx(block, 1000, 64000);
+        struct timespec wait = { 0, 20 * 1000 * 1000 };
+        nanosleep(&wait, NULL);
+        stats_shm_read(stats_shm_region(shm), -1, &after);
+        TEST_ASSERT(after.counters.packets_sent >= before.counters.packets_sent + 1000,
+                    "Publisher should refresh the aggregate");
+        TEST_ASSERT(((const stats_shm_header_t*)stats_shm_region(shm))->publish_count > 1,
+                    "Publisher should run repeatedly");
+        stats_shm_destroy(shm);
+        TEST_ASSERT(access(path, F_OK) != 0, "Destroy should unlink the region");
+    }
+    stats_block_destroy(block);
+#endif
 }
 
 /* Test driver config structure */
@@ -249,10 +2658,34 @@ void test_stub_functions(void) {
     TEST_ASSERT_EQ(init_dpdk_port(0), -1, "DPDK port init stub should return -1");
     TEST_ASSERT_EQ(dpdk_send_burst(0, NULL, NULL, 0), -1, "DPDK send stub should return -1");
     TEST_ASSERT_EQ(dpdk_recv_burst(0, NULL, 0), -1, "DPDK recv stub should return -1");
+    TEST_ASSERT_EQ(init_dpdk_port_config(NULL), -1, "DPDK config init stub should return -1");
+    TEST_ASSERT_EQ(dpdk_get_queue_count(0), 0, "DPDK queue count stub should return 0");
+    TEST_ASSERT_EQ(dpdk_send_burst_queue(0, 1, NULL, NULL, 0), -1, "DPDK queue send stub should return -1");
+    TEST_ASSERT_EQ(dpdk_recv_burst_queue(0, 1, NULL, 0), -1, "DPDK queue recv stub should return -1");
+    TEST_ASSERT_EQ(dpdk_tx_alloc_bulk(0, NULL, NULL, 64, 32), -1, "DPDK mbuf alloc stub should return -1");
+    TEST_ASSERT_EQ(dpdk_tx_burst_mbufs(0, 0, NULL, 0), -1, "DPDK mbuf send stub should return -1");
+    TEST_ASSERT_NULL(dpdk_template_create(test_packet_udp, sizeof(test_packet_udp), 512, -1),
+                     "DPDK template create stub should return NULL");
+    TEST_ASSERT_EQ(dpdk_template_alloc(NULL, NULL, NULL, 0), -1, "DPDK template alloc stub should return -1");
+    TEST_ASSERT_EQ(dpdk_template_send_repeat(0, 0, NULL, 32), -1, "DPDK template repeat stub should return -1");
+    TEST_ASSERT_EQ(dpdk_get_tx_offloads(0), 0, "DPDK offload query stub should return 0");
+    TEST_ASSERT_EQ(dpdk_tx_offload_prepare(0, 0, NULL, 0, 0), -1, "DPDK offload prepare stub should return -1");
     TEST_ASSERT_EQ(cleanup_dpdk(), 0, "DPDK cleanup stub should return 0");
     
     driver_stats_t stats;
     TEST_ASSERT_EQ(dpdk_get_stats(0, &stats), -1, "DPDK stats stub should return -1");
+    
+    uint64_t ns;
+    TEST_ASSERT_EQ(dpdk_set_queue_rate(0, 0, 1000, 0, 1), -1, "DPDK pacing stub should return -1");
+    TEST_ASSERT_EQ(dpdk_set_queue_latency_probe(0, 0, NULL), -1, "DPDK probe stub should return -1");
+    rx_desc_t descs[4];
+    TEST_ASSERT_EQ(dpdk_rx_burst_borrow(0, 0, descs, 4), -1, "DPDK RX borrow stub should return -1");
+    dpdk_rx_release(descs, 0);
+    TEST_ASSERT_EQ(dpdk_timesync_enable(0), -1, "DPDK timesync stub should return -1");
+    TEST_ASSERT_EQ(dpdk_timesync_read_clock(0, &ns), -1, "DPDK clock read stub should return -1");
+    TEST_ASSERT_EQ(dpdk_timesync_read_rx(0, 0, &ns), -1, "DPDK RX timestamp stub should return -1");
+    TEST_ASSERT_EQ(dpdk_timesync_read_tx(0, &ns), -1, "DPDK TX timestamp stub should return -1");
+    TEST_ASSERT_NULL(netstress_backend_ops(BACKEND_DPDK), "No DPDK table without DPDK");
 #endif
 
 #ifndef HAS_AF_XDP
@@ -260,6 +2693,18 @@ void test_stub_functions(void) {
     TEST_ASSERT_EQ(af_xdp_send(NULL, 0), -1, "AF_XDP send stub should return -1");
     TEST_ASSERT_EQ(af_xdp_send_batch(NULL, NULL, 0), -1, "AF_XDP batch send stub should return -1");
     TEST_ASSERT_EQ(af_xdp_recv(NULL, 0), -1, "AF_XDP recv stub should return -1");
+    TEST_ASSERT_EQ(af_xdp_get_queue_count("eth0"), -1, "AF_XDP queue count stub should return -1");
+    TEST_ASSERT_NULL(af_xdp_queue_create("eth0", 1, NULL), "AF_XDP queue create stub should return NULL");
+    TEST_ASSERT_EQ(af_xdp_queue_send_batch(NULL, NULL, NULL, 0), -1, "AF_XDP queue send stub should return -1");
+    TEST_ASSERT_EQ(af_xdp_queue_reclaim(NULL), -1, "AF_XDP queue reclaim stub should return -1");
+    TEST_ASSERT_EQ(af_xdp_queue_recv(NULL, NULL, 0), -1, "AF_XDP queue recv stub should return -1");
+    TEST_ASSERT_EQ(af_xdp_queue_tx_offloads(NULL), 0, "AF_XDP offload query stub should return 0");
+    TEST_ASSERT_EQ(af_xdp_queue_set_rate(NULL, 1000, 0, 1), -1, "AF_XDP pacing stub should return -1");
+    TEST_ASSERT_EQ(af_xdp_queue_set_latency_probe(NULL, NULL), -1, "AF_XDP probe stub should return -1");
+    rx_desc_t xdp_descs[4];
+    TEST_ASSERT_EQ(af_xdp_queue_rx_borrow(NULL, xdp_descs, 4), -1, "AF_XDP RX borrow stub should return -1");
+    TEST_ASSERT_EQ(af_xdp_queue_rx_release(NULL, xdp_descs, 4), -1, "AF_XDP RX release stub should return -1");
+    TEST_ASSERT_NULL(netstress_backend_ops(BACKEND_AF_XDP), "No AF_XDP table without AF_XDP");
     TEST_ASSERT_EQ(cleanup_af_xdp(), 0, "AF_XDP cleanup stub should return 0");
 #endif
 
@@ -267,10 +2712,17 @@ void test_stub_functions(void) {
     TEST_ASSERT_EQ(init_io_uring(256), -1, "io_uring init stub should return -1");
     TEST_ASSERT_EQ(io_uring_send_single(NULL, 0, NULL), -1, "io_uring send stub should return -1");
     TEST_ASSERT_EQ(io_uring_send_batch(NULL, NULL, NULL, 0), -1, "io_uring batch send stub should return -1");
+    TEST_ASSERT_EQ(init_io_uring_config(NULL), -1, "io_uring config init stub should return -1");
+    TEST_ASSERT_NULL(io_uring_ctx_create(NULL), "io_uring context create stub should return NULL");
+    TEST_ASSERT_EQ(io_uring_ctx_send_batch(NULL, NULL, NULL, NULL, 0), -1, "io_uring context send stub should return -1");
+    TEST_ASSERT_EQ(io_uring_ctx_reap(NULL), -1, "io_uring context reap stub should return -1");
+    TEST_ASSERT_EQ(io_uring_reap(), -1, "io_uring reap stub should return -1");
+    TEST_ASSERT_EQ(io_uring_drain(), -1, "io_uring drain stub should return -1");
     TEST_ASSERT_EQ(cleanup_io_uring(), 0, "io_uring cleanup stub should return 0");
+    TEST_ASSERT_NULL(netstress_backend_ops(BACKEND_IO_URING), "No io_uring table without io_uring");
     
-    driver_stats_t stats;
-    TEST_ASSERT_EQ(io_uring_get_stats(&stats), -1, "io_uring stats stub should return -1");
+    driver_stats_t uring_stats;
+    TEST_ASSERT_EQ(io_uring_get_stats(&uring_stats), -1, "io_uring stats stub should return -1");
 #endif
 }
 
@@ -356,11 +2808,34 @@ int main(void) {
     
     RUN_TEST(test_checksum_calculation);
     RUN_TEST(test_transport_checksum);
+    RUN_TEST(test_checksum_kernels);
+    RUN_TEST(test_incremental_checksum);
     RUN_TEST(test_raw_socket_creation);
     RUN_TEST(test_utility_functions);
+    RUN_TEST(test_clock_source);
+    RUN_TEST(test_socket_timestamps);
+    RUN_TEST(test_pacer);
+    RUN_TEST(test_latency_probe);
+    RUN_TEST(test_numa_functions);
     RUN_TEST(test_backend_detection);
+    RUN_TEST(test_backend_probe);
+    RUN_TEST(test_backend_instances);
+    RUN_TEST(test_tx_burst_ctl);
     RUN_TEST(test_sendmmsg_batch);
+    RUN_TEST(test_sendmmsg_context);
+    RUN_TEST(test_pkt_batch);
+    RUN_TEST(test_mem_region);
+    RUN_TEST(test_pkt_template);
+    RUN_TEST(test_safety_envelope);
+    RUN_TEST(test_pcap_replay);
+    RUN_TEST(test_capture_tap);
+    RUN_TEST(test_tcp_engine);
+    RUN_TEST(test_sink);
+    RUN_TEST(test_worker_ctrl);
     RUN_TEST(test_driver_stats);
+    RUN_TEST(test_stats_blocks);
+    RUN_TEST(test_stage_stats);
+    RUN_TEST(test_stats_shm);
     RUN_TEST(test_driver_config);
     RUN_TEST(test_stub_functions);
     RUN_TEST(test_packet_validation);
@@ -146,6 +146,9 @@ impl StatsSnapshot {
 }
 
 /// Per-thread statistics for scalable counting
+///
+/// Aligned to a cache line so counters of different threads never share one.
+#[repr(align(64))]
 pub struct ThreadStats {
     /// Thread ID
     pub thread_id: usize,
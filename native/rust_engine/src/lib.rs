@@ -36,7 +36,7 @@ pub use audit::{AuditEntry, AuditEventType, AuditLogger, ChainVerificationResult
 pub use backend_selector::{BackendSelector, CapabilityReport};
 pub use engine::{EngineConfig, EngineState, FloodEngine};
 pub use packet::{PacketBuilder, PacketFlags, Protocol};
-pub use pool::PacketPool;
+pub use pool::{ArenaPages, PacketBatch, PacketPool, PktBatchFfi};
 pub use protocol_builder::{BatchPacketGenerator, FragmentConfig, ProtocolBuilder, SpoofConfig};
 pub use safety::{EmergencyStop, SafetyController, SafetyError, TargetAuthorization};
 pub use stats::Stats;
@@ -61,6 +61,58 @@ extern "C" {
         lengths: *const u32,
         count: u32,
     ) -> i32;
+    fn dpdk_send_burst_queue(
+        port_id: i32,
+        queue_id: u16,
+        packets: *const *const u8,
+        lengths: *const u32,
+        count: u32,
+    ) -> i32;
+    fn dpdk_get_queue_count(port_id: i32) -> i32;
+    // Batch TX read in place from a PacketBatch arena (PacketBatch::as_ffi)
+    fn dpdk_send_pkt_batch(
+        port_id: i32,
+        queue_id: u16,
+        batch: *const PktBatchFfi,
+        first: u32,
+    ) -> i32;
+    // Zero-copy TX: mbufs are opaque, packet bytes are written through `data`
+    fn dpdk_tx_alloc_bulk(
+        port_id: i32,
+        mbufs: *mut *mut std::ffi::c_void,
+        data: *mut *mut u8,
+        len: u32,
+        count: u32,
+    ) -> i32;
+    fn dpdk_tx_burst_mbufs(
+        port_id: i32,
+        queue_id: u16,
+        mbufs: *mut *mut std::ffi::c_void,
+        count: u32,
+    ) -> i32;
+    fn dpdk_tx_free_bulk(mbufs: *mut *mut std::ffi::c_void, count: u32);
+    fn dpdk_template_create(
+        packet: *const u8,
+        len: u32,
+        num_mbufs: u32,
+        socket_id: i32,
+    ) -> *mut std::ffi::c_void;
+    fn dpdk_template_alloc(
+        tmpl: *mut std::ffi::c_void,
+        mbufs: *mut *mut std::ffi::c_void,
+        data: *mut *mut u8,
+        count: u32,
+    ) -> i32;
+    fn dpdk_template_destroy(tmpl: *mut std::ffi::c_void);
+    fn dpdk_get_tx_offloads(port_id: i32) -> u32;
+    // Pacing runs inside the shim's send loop, between bursts
+    fn dpdk_set_queue_rate(
+        port_id: i32,
+        queue_id: u16,
+        rate_pps: u64,
+        rate_bps: u64,
+        burst: u32,
+    ) -> i32;
     fn cleanup_dpdk() -> i32;
 }
 
@@ -69,6 +121,18 @@ extern "C" {
     fn init_af_xdp(ifname: *const i8) -> i32;
     fn af_xdp_send(data: *const u8, len: u32) -> i32;
     fn cleanup_af_xdp() -> i32;
+    // Per-queue sockets; a NULL config takes the driver defaults
+    fn af_xdp_queue_create(
+        ifname: *const std::ffi::c_char,
+        queue_id: u32,
+        config: *const std::ffi::c_void,
+    ) -> *mut std::ffi::c_void;
+    fn af_xdp_queue_send_pkt_batch(
+        queue: *mut std::ffi::c_void,
+        batch: *const PktBatchFfi,
+        first: u32,
+    ) -> i32;
+    fn af_xdp_queue_destroy(queue: *mut std::ffi::c_void);
 }
 
 // Fallback stubs when features not enabled
@@ -85,6 +149,38 @@ mod dpdk_stub {
     ) -> i32 {
         -1
     }
+    pub unsafe fn dpdk_send_burst_queue(
+        _port_id: i32,
+        _queue_id: u16,
+        _packets: *const *const u8,
+        _lengths: *const u32,
+        _count: u32,
+    ) -> i32 {
+        -1
+    }
+    pub unsafe fn dpdk_get_queue_count(_port_id: i32) -> i32 {
+        0
+    }
+    pub unsafe fn dpdk_send_pkt_batch(
+        _port_id: i32,
+        _queue_id: u16,
+        _batch: *const crate::PktBatchFfi,
+        _first: u32,
+    ) -> i32 {
+        -1
+    }
+    pub unsafe fn dpdk_get_tx_offloads(_port_id: i32) -> u32 {
+        0
+    }
+    pub unsafe fn dpdk_set_queue_rate(
+        _port_id: i32,
+        _queue_id: u16,
+        _rate_pps: u64,
+        _rate_bps: u64,
+        _burst: u32,
+    ) -> i32 {
+        -1
+    }
     pub unsafe fn cleanup_dpdk() -> i32 {
         0
     }
@@ -92,6 +188,69 @@ mod dpdk_stub {
 #[cfg(not(feature = "dpdk"))]
 use dpdk_stub::*;
 
+#[cfg(not(feature = "af_xdp"))]
+mod af_xdp_stub {
+    pub unsafe fn af_xdp_queue_create(
+        _ifname: *const std::ffi::c_char,
+        _queue_id: u32,
+        _config: *const std::ffi::c_void,
+    ) -> *mut std::ffi::c_void {
+        std::ptr::null_mut()
+    }
+    pub unsafe fn af_xdp_queue_send_pkt_batch(
+        _queue: *mut std::ffi::c_void,
+        _batch: *const crate::PktBatchFfi,
+        _first: u32,
+    ) -> i32 {
+        -1
+    }
+    pub unsafe fn af_xdp_queue_destroy(_queue: *mut std::ffi::c_void) {}
+}
+#[cfg(not(feature = "af_xdp"))]
+use af_xdp_stub::*;
+
+/// Send packets `first..` of a batch on a DPDK TX queue, read in place
+/// from the batch arena. Returns packets sent (or held), negative on error.
+pub fn dpdk_send_batch(port_id: i32, queue_id: u16, batch: &mut PacketBatch, first: u32) -> i32 {
+    let ffi = batch.as_ffi();
+    // SAFETY: `ffi` borrows `batch`, which outlives the call and is not
+    // touched while the driver reads it
+    unsafe { dpdk_send_pkt_batch(port_id, queue_id, &ffi, first) }
+}
+
+/// One AF_XDP socket bound to a NIC queue, owned by a single thread
+pub struct AfXdpQueue {
+    queue: *mut std::ffi::c_void,
+}
+
+// The queue is only ever used through `&mut self`
+unsafe impl Send for AfXdpQueue {}
+
+impl AfXdpQueue {
+    /// Bind `queue_id` of `ifname` with the driver's default settings
+    pub fn open(ifname: &str, queue_id: u32) -> Option<Self> {
+        let name = std::ffi::CString::new(ifname).ok()?;
+        // SAFETY: `name` is a valid C string for the duration of the call
+        let queue = unsafe { af_xdp_queue_create(name.as_ptr(), queue_id, std::ptr::null()) };
+        (!queue.is_null()).then_some(Self { queue })
+    }
+
+    /// Queue packets `first..` of a batch, copied from the arena straight
+    /// into UMEM frames. Returns packets queued, negative on error.
+    pub fn send_batch(&mut self, batch: &mut PacketBatch, first: u32) -> i32 {
+        let ffi = batch.as_ffi();
+        // SAFETY: the queue is live and `ffi` borrows `batch` for the call
+        unsafe { af_xdp_queue_send_pkt_batch(self.queue, &ffi, first) }
+    }
+}
+
+impl Drop for AfXdpQueue {
+    fn drop(&mut self) {
+        // SAFETY: created by af_xdp_queue_create and destroyed only here
+        unsafe { af_xdp_queue_destroy(self.queue) }
+    }
+}
+
 /// Python-exposed PacketEngine class
 #[pyclass]
 pub struct PacketEngine {
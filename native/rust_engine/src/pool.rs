@@ -145,6 +145,317 @@ impl BatchPool {
     }
 }
 
+/// Alignment of packets inside a [`PacketBatch`] arena (one cache line)
+pub const PKT_BATCH_ALIGN: usize = 64;
+
+/// FFI view of a [`PacketBatch`], laid out like the C driver's `pkt_batch_t`.
+/// Valid only while the batch it came from is alive and unmodified.
+#[repr(C)]
+pub struct PktBatchFfi {
+    pub arena: *mut u8,
+    pub offsets: *mut u32,
+    pub lengths: *mut u32,
+    pub dst_ips: *mut u32,
+    pub dst_ports: *mut u16,
+    pub count: u32,
+    pub capacity: u32,
+    pub arena_used: u32,
+    pub arena_size: u32,
+    pub dst_ip: u32,
+    pub dst_port: u16,
+    pub reserved: u16,
+}
+
+#[repr(C, align(64))]
+#[derive(Clone, Copy)]
+struct CacheLine([u8; PKT_BATCH_ALIGN]);
+
+/// Page size backing a [`PacketBatch`] arena
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Default)]
+pub enum ArenaPages {
+    /// Base pages
+    #[default]
+    Default,
+    /// 2 MB huge pages
+    Huge2M,
+    /// 1 GB huge pages
+    Huge1G,
+}
+
+/// Arena bytes: heap cache lines, or an anonymous mapping that was
+/// pre-faulted (and optionally mlocked) up front
+enum Arena {
+    Heap(Vec<CacheLine>),
+    #[cfg(target_os = "linux")]
+    Mapped(MappedArena),
+}
+
+#[cfg(target_os = "linux")]
+struct MappedArena {
+    ptr: *mut u8,
+    len: usize,
+    pages: ArenaPages,
+}
+
+// The mapping is owned exclusively, like the Vec it replaces
+#[cfg(target_os = "linux")]
+unsafe impl Send for MappedArena {}
+#[cfg(target_os = "linux")]
+unsafe impl Sync for MappedArena {}
+
+#[cfg(target_os = "linux")]
+impl MappedArena {
+    /// Map at least `len` bytes, rounded up to the page size; None if the
+    /// host has no pages of that size reserved
+    fn new(len: usize, pages: ArenaPages, lock: bool) -> Option<Self> {
+        let base = unsafe { libc::sysconf(libc::_SC_PAGESIZE) }.max(4096) as usize;
+        let (page, huge) = match pages {
+            ArenaPages::Default => (base, 0),
+            ArenaPages::Huge2M => (2 << 20, libc::MAP_HUGETLB | libc::MAP_HUGE_2MB),
+            ArenaPages::Huge1G => (1 << 30, libc::MAP_HUGETLB | libc::MAP_HUGE_1GB),
+        };
+        let len = len.checked_add(page - 1)? & !(page - 1);
+        let ptr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_PRIVATE | libc::MAP_ANONYMOUS | huge,
+                -1,
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return None;
+        }
+
+        // Fault every page in now so first touches stay out of the send path
+        let ptr = ptr as *mut u8;
+        for off in (0..len).step_by(page) {
+            unsafe { std::ptr::write_volatile(ptr.add(off), 0) };
+        }
+        if lock {
+            // Best effort: RLIMIT_MEMLOCK may be too low, the pages are faulted in either way
+            unsafe { libc::mlock(ptr as *const libc::c_void, len) };
+        }
+        Some(Self { ptr, len, pages })
+    }
+}
+
+#[cfg(target_os = "linux")]
+impl Drop for MappedArena {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.ptr as *mut libc::c_void, self.len) };
+    }
+}
+
+impl Arena {
+    fn as_ptr(&self) -> *const u8 {
+        match self {
+            Arena::Heap(lines) => lines.as_ptr() as *const u8,
+            #[cfg(target_os = "linux")]
+            Arena::Mapped(m) => m.ptr,
+        }
+    }
+
+    fn as_mut_ptr(&mut self) -> *mut u8 {
+        match self {
+            Arena::Heap(lines) => lines.as_mut_ptr() as *mut u8,
+            #[cfg(target_os = "linux")]
+            Arena::Mapped(m) => m.ptr,
+        }
+    }
+
+    fn len(&self) -> usize {
+        match self {
+            Arena::Heap(lines) => lines.len() * PKT_BATCH_ALIGN,
+            #[cfg(target_os = "linux")]
+            Arena::Mapped(m) => m.len,
+        }
+    }
+
+    fn pages(&self) -> ArenaPages {
+        match self {
+            Arena::Heap(_) => ArenaPages::Default,
+            #[cfg(target_os = "linux")]
+            Arena::Mapped(m) => m.pages,
+        }
+    }
+}
+
+/// Contiguous structure-of-arrays batch: packet bytes in one cache-aligned
+/// arena plus parallel offset/length/destination arrays. The C backends
+/// consume it directly, so no per-packet pointer array crosses the FFI.
+pub struct PacketBatch {
+    arena: Arena,
+    offsets: Vec<u32>,
+    lengths: Vec<u32>,
+    dst_ips: Option<Vec<u32>>,
+    dst_ports: Option<Vec<u16>>,
+    arena_used: usize,
+    capacity: usize,
+    dst_ip: u32,
+    dst_port: u16,
+}
+
+impl PacketBatch {
+    /// Create a batch of up to `capacity` packets in `arena_size` bytes
+    pub fn new(capacity: usize, arena_size: usize, per_packet_dests: bool) -> Self {
+        let arena_size = arena_size.clamp(1, u32::MAX as usize - PKT_BATCH_ALIGN);
+        let lines = (arena_size + PKT_BATCH_ALIGN - 1) / PKT_BATCH_ALIGN;
+        let arena = Arena::Heap(vec![CacheLine([0u8; PKT_BATCH_ALIGN]); lines]);
+        Self::with_arena(capacity, arena, per_packet_dests)
+    }
+
+    /// Create a batch whose arena is mapped on `pages`, pre-faulted and,
+    /// with `lock`, mlocked. Falls back to a base-page mapping, still
+    /// pre-faulted and locked, when the host has no such pages, and to a
+    /// heap arena only off Linux; see [`PacketBatch::arena_pages`].
+    pub fn with_pages(
+        capacity: usize,
+        arena_size: usize,
+        per_packet_dests: bool,
+        pages: ArenaPages,
+        lock: bool,
+    ) -> Self {
+        #[cfg(target_os = "linux")]
+        {
+            let size = arena_size.clamp(1, (u32::MAX as usize + 1) / 2);
+            let mapped = MappedArena::new(size, pages, lock)
+                .or_else(|| MappedArena::new(size, ArenaPages::Default, lock));
+            if let Some(mapped) = mapped {
+                return Self::with_arena(capacity, Arena::Mapped(mapped), per_packet_dests);
+            }
+        }
+        #[cfg(not(target_os = "linux"))]
+        let _ = (pages, lock);
+        Self::new(capacity, arena_size, per_packet_dests)
+    }
+
+    fn with_arena(capacity: usize, arena: Arena, per_packet_dests: bool) -> Self {
+        let capacity = capacity.min(u32::MAX as usize);
+        Self {
+            arena,
+            offsets: Vec::with_capacity(capacity),
+            lengths: Vec::with_capacity(capacity),
+            dst_ips: per_packet_dests.then(|| Vec::with_capacity(capacity)),
+            dst_ports: per_packet_dests.then(|| Vec::with_capacity(capacity)),
+            arena_used: 0,
+            capacity,
+            dst_ip: 0,
+            dst_port: 0,
+        }
+    }
+
+    fn arena_size(&self) -> usize {
+        self.arena.len()
+    }
+
+    /// Page size the arena actually ended up on
+    pub fn arena_pages(&self) -> ArenaPages {
+        self.arena.pages()
+    }
+
+    fn arena_bytes(&self) -> &[u8] {
+        // Either storage is one contiguous run of plain bytes
+        unsafe { std::slice::from_raw_parts(self.arena.as_ptr(), self.arena_size()) }
+    }
+
+    fn arena_bytes_mut(&mut self) -> &mut [u8] {
+        let size = self.arena_size();
+        unsafe { std::slice::from_raw_parts_mut(self.arena.as_mut_ptr(), size) }
+    }
+
+    /// Append a packet slot and return its bytes to fill in place
+    pub fn reserve(&mut self, len: usize, dst_ip: u32, dst_port: u16) -> Option<&mut [u8]> {
+        if self.offsets.len() >= self.capacity {
+            return None;
+        }
+        let offset = (self.arena_used + PKT_BATCH_ALIGN - 1) & !(PKT_BATCH_ALIGN - 1);
+        if offset + len > self.arena_size() {
+            return None;
+        }
+
+        self.offsets.push(offset as u32);
+        self.lengths.push(len as u32);
+        if let Some(ips) = self.dst_ips.as_mut() {
+            ips.push(dst_ip);
+        }
+        if let Some(ports) = self.dst_ports.as_mut() {
+            ports.push(dst_port);
+        }
+        self.arena_used = offset + len;
+        Some(&mut self.arena_bytes_mut()[offset..offset + len])
+    }
+
+    /// Copy a packet into the batch, returning its index
+    pub fn push(&mut self, data: &[u8], dst_ip: u32, dst_port: u16) -> Option<usize> {
+        let slot = self.reserve(data.len(), dst_ip, dst_port)?;
+        slot.copy_from_slice(data);
+        Some(self.offsets.len() - 1)
+    }
+
+    /// Destination used when the batch has no per-packet destinations
+    pub fn set_destination(&mut self, dst_ip: u32, dst_port: u16) {
+        self.dst_ip = dst_ip;
+        self.dst_port = dst_port;
+    }
+
+    pub fn packet(&self, index: usize) -> Option<&[u8]> {
+        let offset = *self.offsets.get(index)? as usize;
+        let len = self.lengths[index] as usize;
+        Some(&self.arena_bytes()[offset..offset + len])
+    }
+
+    pub fn len(&self) -> usize {
+        self.offsets.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.offsets.is_empty()
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    pub fn clear(&mut self) {
+        self.offsets.clear();
+        self.lengths.clear();
+        if let Some(ips) = self.dst_ips.as_mut() {
+            ips.clear();
+        }
+        if let Some(ports) = self.dst_ports.as_mut() {
+            ports.clear();
+        }
+        self.arena_used = 0;
+    }
+
+    /// Borrow the batch as a C `pkt_batch_t`
+    pub fn as_ffi(&mut self) -> PktBatchFfi {
+        PktBatchFfi {
+            arena: self.arena.as_mut_ptr(),
+            offsets: self.offsets.as_mut_ptr(),
+            lengths: self.lengths.as_mut_ptr(),
+            dst_ips: self
+                .dst_ips
+                .as_mut()
+                .map_or(std::ptr::null_mut(), |v| v.as_mut_ptr()),
+            dst_ports: self
+                .dst_ports
+                .as_mut()
+                .map_or(std::ptr::null_mut(), |v| v.as_mut_ptr()),
+            count: self.offsets.len() as u32,
+            capacity: self.capacity as u32,
+            arena_used: self.arena_used as u32,
+            arena_size: self.arena_size() as u32,
+            dst_ip: self.dst_ip,
+            dst_port: self.dst_port,
+            reserved: 0,
+        }
+    }
+}
+
 /// Ring buffer for packet data
 pub struct RingBuffer {
     data: Vec<u8>,
@@ -236,6 +547,43 @@ mod tests {
         assert_eq!(pool.available(), 10);
     }
 
+    #[test]
+    fn test_packet_batch() {
+        let mut batch = PacketBatch::new(4, 512, true);
+        assert!(batch.is_empty());
+        assert_eq!(batch.push(&[1u8; 10], 0x0100007f, 9), Some(0));
+        assert_eq!(batch.push(&[2u8; 100], 0x0100007f, 9), Some(1));
+        assert!(batch.reserve(4096, 0, 0).is_none());
+        assert_eq!(batch.packet(1), Some(&[2u8; 100][..]));
+
+        let ffi = batch.as_ffi();
+        assert_eq!(ffi.count, 2);
+        assert_eq!(ffi.arena as usize % PKT_BATCH_ALIGN, 0);
+        assert!(!ffi.dst_ips.is_null());
+        assert_eq!(unsafe { *ffi.offsets.add(1) }, 64);
+
+        batch.clear();
+        assert_eq!(batch.len(), 0);
+        assert!(PacketBatch::new(1, 64, false).as_ffi().dst_ports.is_null());
+    }
+
+    #[test]
+    fn test_packet_batch_pages() {
+        // Hosts without reserved huge pages fall back to base pages
+        let mut batch = PacketBatch::with_pages(8, 100_000, false, ArenaPages::Huge2M, true);
+        let expected = match batch.arena_pages() {
+            ArenaPages::Huge2M => 2 << 20,
+            _ => 100_032,
+        };
+        assert!(batch.as_ffi().arena_size as usize >= expected);
+        assert_eq!(batch.as_ffi().arena as usize % PKT_BATCH_ALIGN, 0);
+        assert_eq!(batch.push(&[7u8; 1500], 0, 0), Some(0));
+        assert_eq!(batch.packet(0), Some(&[7u8; 1500][..]));
+
+        let mut locked = PacketBatch::with_pages(1, 64, false, ArenaPages::Default, true);
+        assert!(locked.as_ffi().arena_size >= 64);
+    }
+
     #[test]
     fn test_ring_buffer() {
         let mut ring = RingBuffer::new(16);
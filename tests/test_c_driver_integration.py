@@ -210,22 +210,23 @@ class TestCDriverIntegration:
         # Define the stats structure
         class DriverStats(ctypes.Structure):
             _fields_ = [
-                ("packets_sent", ctypes.c_uint32),
-                ("packets_received", ctypes.c_uint32),
-                ("bytes_sent", ctypes.c_uint32),
-                ("bytes_received", ctypes.c_uint32),
-                ("errors", ctypes.c_uint32),
+                ("packets_sent", ctypes.c_uint64),
+                ("packets_received", ctypes.c_uint64),
+                ("bytes_sent", ctypes.c_uint64),
+                ("bytes_received", ctypes.c_uint64),
+                ("errors", ctypes.c_uint64),
             ]
         
         # Create and initialize
         stats = DriverStats()
         stats.packets_sent = 1000
-        stats.bytes_sent = 100000
+        stats.bytes_sent = 6_000_000_000  # Past the old 32-bit wrap
         stats.errors = 5
         
         assert stats.packets_sent == 1000
-        assert stats.bytes_sent == 100000
+        assert stats.bytes_sent == 6_000_000_000
         assert stats.errors == 5
+        assert ctypes.sizeof(DriverStats) == 40
 
     def test_driver_config_structure(self):
         """Test driver configuration structure"""
@@ -241,6 +242,7 @@ class TestCDriverIntegration:
                 ("ring_size", ctypes.c_uint32),
                 ("burst_size", ctypes.c_uint32),
                 ("promiscuous", ctypes.c_int),
+                ("tx_offloads", ctypes.c_uint32),
             ]
         
         # Create and initialize
@@ -6,6 +6,8 @@ Tests the integration between native engines and the Python analytics system.
 """
 
 import asyncio
+import struct
+import tempfile
 import time
 import unittest
 import sys
@@ -15,7 +17,7 @@ import os
 sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
 
 from core.analytics.native_stats_bridge import (
-    NativeStatsBridge, NativeStatsSnapshot, 
+    NativeStatsBridge, NativeStatsSnapshot, SharedStatsReader,
     get_native_stats_bridge, register_native_engine, unregister_native_engine
 )
 from core.analytics.metrics_collector import get_metrics_collector
@@ -164,6 +166,76 @@ class TestNativeStatsBridge(unittest.TestCase):
         self.assertNotIn(engine_id, global_bridge._native_engines)
 
 
+class TestSharedStatsReader(unittest.TestCase):
+    """Test reading the C shim's shared-memory telemetry layout"""
+    
+    NUM_SLOTS = 4
+    
+    def write_region(self, magic=SharedStatsReader.MAGIC, slots=None):
+        header = SharedStatsReader.HEADER.pack(
+            magic, SharedStatsReader.VERSION, self.NUM_SLOTS, SharedStatsReader.SLOT.size, 10000, 1)
+        body = b''
+        slots = slots or {}
+        for index in range(-1, self.NUM_SLOTS):
+            seq, ts, active, counters = slots.get(index, (0, 0, 0, (0, 0, 0, 0, 0)))
+            latency = [0] * SharedStatsReader.LATENCY_BUCKETS
+            latency[6] = index + 2
+            body += SharedStatsReader.SLOT.pack(seq, ts, active, 0, *counters, *latency)
+        
+        tmp = tempfile.NamedTemporaryFile(delete=False)
+        tmp.write(header + body)
+        tmp.close()
+        self.addCleanup(os.unlink, tmp.name)
+        return tmp.name
+    
+    def test_layout_sizes(self):
+        """Struct sizes match driver_shim.h"""
+        self.assertEqual(SharedStatsReader.HEADER.size, 64)
+        self.assertEqual(SharedStatsReader.SLOT.size, 320)
+    
+    def test_read_slots(self):
+        """Aggregate and per-queue slots are decoded"""
+        path = self.write_region(slots={
+            -1: (4, 2000000, 1, (300, 7, 45000, 700, 2)),
+            1: (2, 2000000, 1, (300, 7, 45000, 700, 2)),
+        })
+        with SharedStatsReader(path) as reader:
+            aggregate = reader.read_slot(-1)
+            self.assertEqual(aggregate['packets_sent'], 300)
+            self.assertEqual(aggregate['bytes_received'], 700)
+            self.assertEqual(aggregate['latency_histogram'][6], 1)
+            
+            queues = reader.read_queues()
+            self.assertEqual(len(queues), 1)
+            self.assertEqual(queues[0]['slot'], 1)
+            
+            with self.assertRaises(IndexError):
+                reader.read_slot(self.NUM_SLOTS)
+    
+    def test_slot_being_written(self):
+        """A slot with an odd sequence is never returned torn"""
+        path = self.write_region(slots={0: (3, 1, 1, (1, 1, 1, 1, 1))})
+        with SharedStatsReader(path) as reader:
+            reader.MAX_RETRIES = 5
+            self.assertIsNone(reader.read_slot(0))
+    
+    def test_stats_feed_bridge_snapshot(self):
+        """get_stats() output converts to a NativeStatsSnapshot"""
+        path = self.write_region(slots={-1: (2, 1000000, 1, (1000, 0, 1472000, 0, 3))})
+        with SharedStatsReader(path) as reader:
+            snapshot = NativeStatsSnapshot.from_native_dict(reader.get_stats())
+            self.assertEqual(snapshot.packets_sent, 1000)
+            self.assertEqual(snapshot.errors, 3)
+            self.assertEqual(snapshot.backend, 'native_shm')
+            self.assertTrue(snapshot.is_native)
+    
+    def test_rejects_foreign_file(self):
+        """Files without the region magic are rejected"""
+        path = self.write_region(magic=0)
+        with self.assertRaises(ValueError):
+            SharedStatsReader(path)
+
+
 class TestNativeStatsSnapshot(unittest.TestCase):
     """Test the NativeStatsSnapshot class"""
     